@@ -132,6 +132,7 @@ hyperdex_client_returncode_to_string(enum hyperdex_client_returncode status)
         CSTRINGIFY(HYPERDEX_CLIENT_INTERRUPTED);
         CSTRINGIFY(HYPERDEX_CLIENT_CLUSTER_JUMP);
         CSTRINGIFY(HYPERDEX_CLIENT_OFFLINE);
+        CSTRINGIFY(HYPERDEX_CLIENT_OVERLOADED);
         CSTRINGIFY(HYPERDEX_CLIENT_INTERNAL);
         CSTRINGIFY(HYPERDEX_CLIENT_EXCEPTION);
         CSTRINGIFY(HYPERDEX_CLIENT_GARBAGE);
@@ -179,6 +180,15 @@ hyperdex_client_destroy_attrs(const hyperdex_client_attribute* attrs, size_t /*a
     free(const_cast<hyperdex_client_attribute*>(attrs));
 }
 
+HYPERDEX_API void
+hyperdex_client_set_read_mode(hyperdex_client* _cl,
+                              enum hyperdex_client_read_mode mode,
+                              uint64_t max_lag_ms)
+{
+    hyperdex::client* cl = reinterpret_cast<hyperdex::client*>(_cl);
+    cl->set_read_mode(mode, max_lag_ms);
+}
+
 HYPERDEX_API int64_t
 hyperdex_client_get(hyperdex_client* _cl,
                     const char* space,
@@ -78,6 +78,8 @@ client :: client(const char* coordinator, uint16_t port)
     , m_busybee(&m_busybee_mapper, busybee_generate_id())
     , m_next_client_id(1)
     , m_next_server_nonce(1)
+    , m_read_mode(HYPERDEX_CLIENT_READ_POINT_LEADER)
+    , m_read_max_lag_ms(0)
     , m_pending_ops()
     , m_failed()
     , m_yielding()
@@ -118,12 +120,57 @@ client :: get(const char* space, const char* _key, size_t _key_sz,
         return -1;
     }
 
+    if (m_read_mode == HYPERDEX_CLIENT_READ_POINT_LEADER)
+    {
+        e::intrusive_ptr<pending> op;
+        op = new pending_get(m_next_client_id++, status, attrs, attrs_sz,
+                             virtual_server_id(), key);
+        size_t sz = HYPERDEX_CLIENT_HEADER_SIZE_REQ + sizeof(uint32_t) + key.size();
+        std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+        msg->pack_at(HYPERDEX_CLIENT_HEADER_SIZE_REQ) << key;
+        return send_keyop(space, key, REQ_GET, msg, op, status);
+    }
+
+    std::vector<virtual_server_id> replicas;
+    m_coord.config()->key_replicas(space, key, &replicas);
+
+    if (replicas.empty())
+    {
+        ERROR(OFFLINE) << "all servers for key \""
+                       << e::strescape(std::string(reinterpret_cast<const char*>(key.data()), key.size()))
+                       << "\" in space \"" << e::strescape(space)
+                       << "\" are offline: bring one or more online to remedy the issue";
+        return -1;
+    }
+
+    int64_t nonce = m_next_server_nonce++;
+    virtual_server_id vsi = replicas.back();
+
+    if (m_read_mode == HYPERDEX_CLIENT_READ_ANY_REPLICA)
+    {
+        vsi = replicas[nonce % replicas.size()];
+    }
+
+    // The point leader is remembered so that a replica which cannot honor
+    // the staleness bound can bounce the read there.
     e::intrusive_ptr<pending> op;
-    op = new pending_get(m_next_client_id++, status, attrs, attrs_sz);
-    size_t sz = HYPERDEX_CLIENT_HEADER_SIZE_REQ + sizeof(uint32_t) + key.size();
+    op = new pending_get(m_next_client_id++, status, attrs, attrs_sz,
+                         replicas.front(), key);
+    size_t sz = HYPERDEX_CLIENT_HEADER_SIZE_REQ
+              + sizeof(uint32_t) + key.size()
+              + sizeof(uint64_t);
     std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(HYPERDEX_CLIENT_HEADER_SIZE_REQ) << key;
-    return send_keyop(space, key, REQ_GET, msg, op, status);
+    msg->pack_at(HYPERDEX_CLIENT_HEADER_SIZE_REQ) << key << m_read_max_lag_ms;
+
+    if (send(REQ_GET, vsi, nonce, msg, op, status))
+    {
+        return op->client_visible_id();
+    }
+    else
+    {
+        ERROR(RECONFIGURE) << "could not send " << REQ_GET << " to " << vsi;
+        return -1;
+    }
 }
 
 #define SEARCH_BOILERPLATE \
@@ -333,6 +380,13 @@ client :: perform_funcall(const hyperdex_client_keyop_info* opinfo,
     return send_keyop(space, key, REQ_ATOMIC, msg, op, status);
 }
 
+void
+client :: set_read_mode(hyperdex_client_read_mode mode, uint64_t max_lag_ms)
+{
+    m_read_mode = mode;
+    m_read_max_lag_ms = max_lag_ms;
+}
+
 int64_t
 client :: loop(int timeout, hyperdex_client_returncode* status)
 {
@@ -447,6 +501,16 @@ client :: loop(int timeout, hyperdex_client_returncode* status)
             continue;
         }
 
+        // the server shed the request; fail it as if the server went away,
+        // but tell the caller that retrying will help
+        if (msg_type == OVERLOADED)
+        {
+            op->handle_failure(psp.si, psp.vsi);
+            op->handle_overload(psp.si, psp.vsi);
+            m_yielding = op;
+            continue;
+        }
+
         if (vfrom == psp.vsi &&
             id == psp.si &&
             m_coord.config()->get_server_id(vfrom) == id)
@@ -933,6 +997,7 @@ operator << (std::ostream& lhs, hyperdex_client_returncode rhs)
         STRINGIFY(HYPERDEX_CLIENT_INTERRUPTED);
         STRINGIFY(HYPERDEX_CLIENT_CLUSTER_JUMP);
         STRINGIFY(HYPERDEX_CLIENT_OFFLINE);
+        STRINGIFY(HYPERDEX_CLIENT_OVERLOADED);
         STRINGIFY(HYPERDEX_CLIENT_INTERNAL);
         STRINGIFY(HYPERDEX_CLIENT_EXCEPTION);
         STRINGIFY(HYPERDEX_CLIENT_GARBAGE);
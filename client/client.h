@@ -91,6 +91,8 @@ class client
                                 hyperdex_client_returncode* status);
         // looping/polling
         int64_t loop(int timeout, hyperdex_client_returncode* status);
+        // read routing
+        void set_read_mode(hyperdex_client_read_mode mode, uint64_t max_lag_ms);
         // error handling
         const char* error_message();
         const char* error_location();
@@ -166,6 +168,8 @@ class client
         busybee_st m_busybee;
         int64_t m_next_client_id;
         uint64_t m_next_server_nonce;
+        hyperdex_client_read_mode m_read_mode;
+        uint64_t m_read_max_lag_ms;
         pending_map_t m_pending_ops;
         pending_queue_t m_failed;
         e::intrusive_ptr<pending> m_yielding;
@@ -42,6 +42,14 @@ pending :: ~pending() throw ()
 {
 }
 
+void
+pending :: handle_overload(const server_id& si,
+                           const virtual_server_id& vsi)
+{
+    PENDING_ERROR(OVERLOADED) << "server " << vsi << "/" << si
+                              << " is overloaded and shed the request; retry later";
+}
+
 std::ostream&
 pending :: error(const char* file, size_t line)
 {
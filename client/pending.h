@@ -68,6 +68,9 @@ class pending
                                     const virtual_server_id& vsi) = 0;
         virtual void handle_failure(const server_id& si,
                                     const virtual_server_id& vsi) = 0;
+        // called after handle_failure when the server shed the request
+        void handle_overload(const server_id& si,
+                             const virtual_server_id& vsi);
         virtual bool handle_message(client* cl,
                                     const server_id& si,
                                     const virtual_server_id& vsi,
@@ -28,6 +28,7 @@
 // HyperClient
 #include "common/network_returncode.h"
 #include "client/client.h"
+#include "client/constants.h"
 #include "client/pending_get.h"
 #include "client/util.h"
 
@@ -36,11 +37,15 @@ using hyperdex::pending_get;
 pending_get :: pending_get(uint64_t id,
                            hyperdex_client_returncode* status,
                            const hyperdex_client_attribute** attrs,
-                           size_t* attrs_sz)
+                           size_t* attrs_sz,
+                           const virtual_server_id& point_leader,
+                           const e::slice& key)
     : pending(id, status)
     , m_state(INITIALIZED)
     , m_attrs(attrs)
     , m_attrs_sz(attrs_sz)
+    , m_point_leader(point_leader)
+    , m_key(reinterpret_cast<const char*>(key.data()), key.size())
 {
 }
 
@@ -51,7 +56,7 @@ pending_get :: ~pending_get() throw ()
 bool
 pending_get :: can_yield()
 {
-    assert(m_state == RECV || m_state == YIELDED);
+    assert(m_state == SENT || m_state == RECV || m_state == YIELDED);
     return m_state == RECV;
 }
 
@@ -151,6 +156,8 @@ pending_get :: handle_message(client* cl,
                                     << " reports that the operation would"
                                     << " cause a number overflow";
             return true;
+        case NET_STALE:
+            return retry_at_point_leader(cl, vsi, status, err);
         default:
             PENDING_ERROR(SERVERERROR) << "server " << si
                                        << " returned non-sensical returncode"
@@ -187,3 +194,35 @@ pending_get :: handle_message(client* cl,
     set_error(e::error());
     return true;
 }
+
+bool
+pending_get :: retry_at_point_leader(client* cl,
+                                     const virtual_server_id& vsi,
+                                     hyperdex_client_returncode* status,
+                                     e::error* err)
+{
+    if (m_point_leader == virtual_server_id() || m_point_leader == vsi)
+    {
+        PENDING_ERROR(SERVERERROR) << "server " << vsi
+                                   << " reports that it is too stale to serve"
+                                   << " a read it should always serve";
+        return true;
+    }
+
+    e::slice key(m_key);
+    size_t sz = HYPERDEX_CLIENT_HEADER_SIZE_REQ + sizeof(uint32_t) + key.size();
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(HYPERDEX_CLIENT_HEADER_SIZE_REQ) << key;
+    m_state = INITIALIZED;
+
+    if (!cl->send(REQ_GET, m_point_leader, cl->m_next_server_nonce++, msg, this, status))
+    {
+        m_state = RECV;
+        PENDING_ERROR(RECONFIGURE) << "could not send GET to " << m_point_leader;
+        return true;
+    }
+
+    *status = HYPERDEX_CLIENT_SUCCESS;
+    *err = e::error();
+    return true;
+}
@@ -28,6 +28,9 @@
 #ifndef hyperdex_client_pending_get_h_
 #define hyperdex_client_pending_get_h_
 
+// STL
+#include <string>
+
 // HyperDex
 #include "namespace.h"
 #include "client/pending.h"
@@ -39,7 +42,9 @@ class pending_get : public pending
     public:
         pending_get(uint64_t client_visible_id,
                     hyperdex_client_returncode* status,
-                    const hyperdex_client_attribute** attrs, size_t* attrs_sz);
+                    const hyperdex_client_attribute** attrs, size_t* attrs_sz,
+                    const virtual_server_id& point_leader,
+                    const e::slice& key);
         virtual ~pending_get() throw ();
 
     // return to client
@@ -62,6 +67,12 @@ class pending_get : public pending
                                     hyperdex_client_returncode* status,
                                     e::error* error);
 
+    private:
+        bool retry_at_point_leader(client* cl,
+                                   const virtual_server_id& vsi,
+                                   hyperdex_client_returncode* status,
+                                   e::error* error);
+
     // noncopyable
     private:
         pending_get(const pending_get& other);
@@ -71,6 +82,9 @@ class pending_get : public pending
         enum { INITIALIZED, SENT, RECV, YIELDED } m_state;
         const hyperdex_client_attribute** m_attrs;
         size_t* m_attrs_sz;
+        // where to retry reads that a replica deems too stale
+        virtual_server_id m_point_leader;
+        std::string m_key;
 };
 
 END_HYPERDEX_NAMESPACE
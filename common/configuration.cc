@@ -28,11 +28,16 @@
 
 #define __STDC_LIMIT_MACROS
 
+// C
+#include <string.h>
+
 // STL
 #include <algorithm>
+#include <memory>
 #include <sstream>
 
 // HyperDex
+#include "cityhash/city.h"
 #include "common/configuration.h"
 #include "common/configuration_flags.h"
 #include "common/hash.h"
@@ -44,26 +49,55 @@ using hyperdex::region_id;
 using hyperdex::schema;
 using hyperdex::server;
 using hyperdex::server_id;
+using hyperdex::space;
+using hyperdex::space_id;
 using hyperdex::subspace;
 using hyperdex::subspace_id;
+using hyperdex::transfer;
 using hyperdex::virtual_server_id;
 
+namespace
+{
+
+// never zero, which id_index reserves for empty slots
+uint64_t
+name_key(const char* name)
+{
+    uint64_t h = CityHash64(name, strlen(name));
+    return h ? h : 1;
+}
+
+template <typename T>
+bool
+same_packing(const T& lhs, const T& rhs)
+{
+    size_t sz = pack_size(lhs);
+
+    if (sz != pack_size(rhs))
+    {
+        return false;
+    }
+
+    std::auto_ptr<e::buffer> l(e::buffer::create(sz));
+    std::auto_ptr<e::buffer> r(e::buffer::create(sz));
+    l->pack_at(0) << lhs;
+    r->pack_at(0) << rhs;
+    return memcmp(l->data(), r->data(), sz) == 0;
+}
+
+} // namespace
+
 configuration :: configuration()
     : m_cluster(0)
     , m_version(0)
     , m_flags(0)
     , m_servers()
-    , m_region_ids_by_virtual()
-    , m_server_ids_by_virtual()
-    , m_schemas_by_region()
-    , m_subspaces_by_region()
-    , m_subspace_ids_by_region()
     , m_subspace_ids_for_prev()
     , m_subspace_ids_for_next()
-    , m_heads_by_region()
-    , m_tails_by_region()
-    , m_next_by_virtual()
-    , m_point_leaders_by_virtual()
+    , m_regions()
+    , m_virtuals()
+    , m_names()
+    , m_region_indices()
     , m_spaces()
     , m_transfers()
 {
@@ -75,17 +109,12 @@ configuration :: configuration(const configuration& other)
     , m_version(other.m_version)
     , m_flags(other.m_flags)
     , m_servers(other.m_servers)
-    , m_region_ids_by_virtual(other.m_region_ids_by_virtual)
-    , m_server_ids_by_virtual(other.m_server_ids_by_virtual)
-    , m_schemas_by_region(other.m_schemas_by_region)
-    , m_subspaces_by_region(other.m_subspaces_by_region)
-    , m_subspace_ids_by_region(other.m_subspace_ids_by_region)
     , m_subspace_ids_for_prev(other.m_subspace_ids_for_prev)
     , m_subspace_ids_for_next(other.m_subspace_ids_for_next)
-    , m_heads_by_region(other.m_heads_by_region)
-    , m_tails_by_region(other.m_tails_by_region)
-    , m_next_by_virtual(other.m_next_by_virtual)
-    , m_point_leaders_by_virtual(other.m_point_leaders_by_virtual)
+    , m_regions()
+    , m_virtuals()
+    , m_names()
+    , m_region_indices()
     , m_spaces(other.m_spaces)
     , m_transfers(other.m_transfers)
 {
@@ -171,111 +200,55 @@ configuration :: get_state(const server_id& id) const
 region_id
 configuration :: get_region_id(const virtual_server_id& id) const
 {
-    std::vector<pair_uint64_t>::const_iterator it;
-    it = std::lower_bound(m_region_ids_by_virtual.begin(),
-                          m_region_ids_by_virtual.end(),
-                          pair_uint64_t(id.get(), 0));
-
-    if (it != m_region_ids_by_virtual.end() && it->first == id.get())
-    {
-        return region_id(it->second);
-    }
-
-    return region_id();
+    const virtual_entry* e = m_virtuals.find(id.get());
+    return e ? region_id(e->rid) : region_id();
 }
 
 server_id
 configuration :: get_server_id(const virtual_server_id& id) const
 {
-    std::vector<pair_uint64_t>::const_iterator it;
-    it = std::lower_bound(m_server_ids_by_virtual.begin(),
-                          m_server_ids_by_virtual.end(),
-                          pair_uint64_t(id.get(), 0));
-
-    if (it != m_server_ids_by_virtual.end() && it->first == id.get())
-    {
-        return server_id(it->second);
-    }
-
-    return server_id();
+    const virtual_entry* e = m_virtuals.find(id.get());
+    return e ? server_id(e->sid) : server_id();
 }
 
 const schema*
 configuration :: get_schema(const char* sname) const
 {
-    for (size_t s = 0; s < m_spaces.size(); ++s)
-    {
-        if (strcmp(sname, m_spaces[s].name) == 0)
-        {
-            return &m_spaces[s].sc;
-        }
-    }
-
-    return NULL;
+    const space* s = space_named(sname);
+    return s ? &s->sc : NULL;
 }
 
 const schema*
 configuration :: get_schema(const region_id& ri) const
 {
-    std::vector<uint64_schema_t>::const_iterator it;
-    it = std::lower_bound(m_schemas_by_region.begin(),
-                          m_schemas_by_region.end(),
-                          uint64_schema_t(ri.get(), NULL));
-
-    if (it != m_schemas_by_region.end() && it->first == ri.get())
-    {
-        return it->second;
-    }
-
-    return NULL;
+    const region_entry* e = m_regions.find(ri.get());
+    return e ? &e->s->sc : NULL;
 }
 
 const subspace*
 configuration :: get_subspace(const region_id& ri) const
 {
-    std::vector<uint64_subspace_t>::const_iterator it;
-    it = std::lower_bound(m_subspaces_by_region.begin(),
-                          m_subspaces_by_region.end(),
-                          uint64_subspace_t(ri.get(), NULL));
-
-    if (it != m_subspaces_by_region.end() && it->first == ri.get())
-    {
-        return it->second;
-    }
+    const region_entry* e = m_regions.find(ri.get());
+    return e ? e->ss : NULL;
+}
 
-    return NULL;
+const hyperdex::region*
+configuration :: get_region(const region_id& ri) const
+{
+    const region_entry* e = m_regions.find(ri.get());
+    return e ? e->r : NULL;
 }
 
 virtual_server_id
 configuration :: get_virtual(const region_id& ri, const server_id& si) const
 {
-    for (size_t w = 0; w < m_spaces.size(); ++w)
-    {
-        const space& s(m_spaces[w]);
+    const region* r = get_region(ri);
 
-        for (size_t x = 0; x < s.subspaces.size(); ++x)
+    for (size_t i = 0; r && i < r->replicas.size(); ++i)
+    {
+        if (r->replicas[i].si == si)
         {
-            const subspace& ss(s.subspaces[x]);
-
-            for (size_t y = 0; y < ss.regions.size(); ++y)
-            {
-                const region& r(ss.regions[y]);
-
-                if (r.id != ri)
-                {
-                    continue;
-                }
-
-                for (size_t z = 0; z < r.replicas.size(); ++z)
-                {
-                    if (r.replicas[z].si == si)
-                    {
-                        return r.replicas[z].vsi;
-                    }
-                }
-
-                return virtual_server_id();
-            }
+            return r->replicas[i].vsi;
         }
     }
 
@@ -285,17 +258,8 @@ configuration :: get_virtual(const region_id& ri, const server_id& si) const
 subspace_id
 configuration :: subspace_of(const region_id& ri) const
 {
-    std::vector<pair_uint64_t>::const_iterator it;
-    it = std::lower_bound(m_subspace_ids_by_region.begin(),
-                          m_subspace_ids_by_region.end(),
-                          pair_uint64_t(ri.get(), 0));
-
-    if (it != m_subspace_ids_by_region.end() && it->first == ri.get())
-    {
-        return subspace_id(it->second);
-    }
-
-    return subspace_id();
+    const region_entry* e = m_regions.find(ri.get());
+    return e ? e->ss->id : subspace_id();
 }
 
 subspace_id
@@ -333,49 +297,34 @@ configuration :: subspace_next(const subspace_id& ss) const
 virtual_server_id
 configuration :: head_of_region(const region_id& ri) const
 {
-    std::vector<pair_uint64_t>::const_iterator it;
-    it = std::lower_bound(m_heads_by_region.begin(),
-                          m_heads_by_region.end(),
-                          pair_uint64_t(ri.get(), 0));
+    const region* r = get_region(ri);
 
-    if (it != m_heads_by_region.end() && it->first == ri.get())
+    if (!r || r->replicas.empty())
     {
-        return virtual_server_id(it->second);
+        return virtual_server_id();
     }
 
-    return virtual_server_id();
+    return r->replicas.front().vsi;
 }
 
 virtual_server_id
 configuration :: tail_of_region(const region_id& ri) const
 {
-    std::vector<pair_uint64_t>::const_iterator it;
-    it = std::lower_bound(m_tails_by_region.begin(),
-                          m_tails_by_region.end(),
-                          pair_uint64_t(ri.get(), 0));
+    const region* r = get_region(ri);
 
-    if (it != m_tails_by_region.end() && it->first == ri.get())
+    if (!r || r->replicas.empty())
     {
-        return virtual_server_id(it->second);
+        return virtual_server_id();
     }
 
-    return virtual_server_id();
+    return r->replicas.back().vsi;
 }
 
 virtual_server_id
 configuration :: next_in_region(const virtual_server_id& vsi) const
 {
-    std::vector<pair_uint64_t>::const_iterator it;
-    it = std::lower_bound(m_next_by_virtual.begin(),
-                          m_next_by_virtual.end(),
-                          pair_uint64_t(vsi.get(), 0));
-
-    if (it != m_next_by_virtual.end() && it->first == vsi.get())
-    {
-        return virtual_server_id(it->second);
-    }
-
-    return virtual_server_id();
+    const virtual_entry* e = m_virtuals.find(vsi.get());
+    return e ? virtual_server_id(e->next) : virtual_server_id();
 }
 
 void
@@ -416,81 +365,83 @@ configuration :: key_regions(const server_id& si, std::vector<region_id>* server
 bool
 configuration :: is_point_leader(const virtual_server_id& e) const
 {
-    return std::binary_search(m_point_leaders_by_virtual.begin(),
-                              m_point_leaders_by_virtual.end(),
-                              e.get());
+    const virtual_entry* v = m_virtuals.find(e.get());
+    return v && v->point_leader;
 }
 
 virtual_server_id
 configuration :: point_leader(const char* sname, const e::slice& key) const
 {
-    for (size_t s = 0; s < m_spaces.size(); ++s)
-    {
-        if (strcmp(sname, m_spaces[s].name) != 0)
-        {
-            continue;
-        }
+    const space* s = space_named(sname);
 
-        uint64_t h;
-        hash(m_spaces[s].sc, key, &h);
+    if (!s)
+    {
+        return virtual_server_id();
+    }
 
-        for (size_t pl = 0; pl < m_spaces[s].subspaces[0].regions.size(); ++pl)
-        {
-            if (m_spaces[s].subspaces[0].regions[pl].lower_coord[0] <= h &&
-                h <= m_spaces[s].subspaces[0].regions[pl].upper_coord[0])
-            {
-                if (m_spaces[s].subspaces[0].regions[pl].replicas.empty())
-                {
-                    return virtual_server_id();
-                }
-
-                return m_spaces[s].subspaces[0].regions[pl].replicas[0].vsi;
-            }
-        }
+    const region* r = key_region(*s, key);
 
+    if (!r)
+    {
         abort();
     }
 
-    return virtual_server_id();
+    if (r->replicas.empty())
+    {
+        return virtual_server_id();
+    }
+
+    return r->replicas[0].vsi;
 }
 
 virtual_server_id
 configuration :: point_leader(const region_id& rid, const e::slice& key) const
 {
-    for (size_t s = 0; s < m_spaces.size(); ++s)
+    const space* s = space_of(rid);
+
+    if (!s)
     {
-        for (size_t ss = 0; ss < m_spaces[s].subspaces.size(); ++ss)
-        {
-            for (size_t r = 0; r < m_spaces[s].subspaces[ss].regions.size(); ++r)
-            {
-                if (m_spaces[s].subspaces[ss].regions[r].id != rid)
-                {
-                    continue;
-                }
+        return virtual_server_id();
+    }
 
-                uint64_t h;
-                hash(m_spaces[s].sc, key, &h);
+    const region* r = key_region(*s, key);
 
-                for (size_t pl = 0; pl < m_spaces[s].subspaces[0].regions.size(); ++pl)
-                {
-                    if (m_spaces[s].subspaces[0].regions[pl].lower_coord[0] <= h &&
-                        h <= m_spaces[s].subspaces[0].regions[pl].upper_coord[0])
-                    {
-                        if (m_spaces[s].subspaces[0].regions[pl].replicas.empty())
-                        {
-                            return virtual_server_id();
-                        }
+    if (!r)
+    {
+        abort();
+    }
 
-                        return m_spaces[s].subspaces[0].regions[pl].replicas[0].vsi;
-                    }
-                }
+    if (r->replicas.empty())
+    {
+        return virtual_server_id();
+    }
 
-                abort();
-            }
-        }
+    return r->replicas[0].vsi;
+}
+
+void
+configuration :: key_replicas(const char* sname, const e::slice& key,
+                              std::vector<virtual_server_id>* replicas) const
+{
+    replicas->clear();
+    const space* s = space_named(sname);
+
+    if (!s)
+    {
+        return;
     }
 
-    return virtual_server_id();
+    const region* r = key_region(*s, key);
+
+    if (!r)
+    {
+        abort();
+    }
+
+    for (size_t i = 0; i < r->replicas.size(); ++i)
+    {
+        replicas->push_back(r->replicas[i].vsi);
+    }
 }
 
 bool
@@ -619,38 +570,24 @@ configuration :: lookup_region(const subspace_id& ssid,
                                const std::vector<uint64_t>& hashes,
                                region_id* rid) const
 {
-    for (size_t s = 0; s < m_spaces.size(); ++s)
-    {
-        for (size_t ss = 0; ss < m_spaces[s].subspaces.size(); ++ss)
-        {
-            if (m_spaces[s].subspaces[ss].id != ssid)
-            {
-                continue;
-            }
+    const region_index* idx = get_region_index(ssid);
 
-            assert(m_spaces[s].sc.attrs_sz == hashes.size());
+    if (!idx)
+    {
+        *rid = region_id();
+        return;
+    }
 
-            for (size_t r = 0; r < m_spaces[s].subspaces[ss].regions.size(); ++r)
-            {
-                bool matches = true;
+    std::vector<uint64_t> coords(idx->ss->attrs.size());
 
-                for (size_t a = 0; matches && a < m_spaces[s].subspaces[ss].attrs.size(); ++a)
-                {
-                    assert(a < m_spaces[s].sc.attrs_sz);
-                    matches &= m_spaces[s].subspaces[ss].regions[r].lower_coord[a] <= hashes[m_spaces[s].subspaces[ss].attrs[a]] &&
-                               hashes[m_spaces[s].subspaces[ss].attrs[a]] <= m_spaces[s].subspaces[ss].regions[r].upper_coord[a];
-                }
-
-                if (matches)
-                {
-                    *rid = m_spaces[s].subspaces[ss].regions[r].id;
-                    return;
-                }
-            }
-        }
+    for (size_t a = 0; a < coords.size(); ++a)
+    {
+        assert(idx->ss->attrs[a] < hashes.size());
+        coords[a] = hashes[idx->ss->attrs[a]];
     }
 
-    *rid = region_id();
+    const region* r = idx->tree.find(coords);
+    *rid = r ? r->id : region_id();
 }
 
 void
@@ -658,16 +595,7 @@ configuration :: lookup_search(const char* space_name,
                                const std::vector<attribute_check>& chks,
                                std::vector<virtual_server_id>* servers) const
 {
-    const space* s = NULL;
-
-    for (size_t i = 0; i < m_spaces.size(); ++i)
-    {
-        if (strcmp(space_name, m_spaces[i].name) == 0)
-        {
-            s = &m_spaces[i];
-            break;
-        }
-    }
+    const space* s = space_named(space_name);
 
     if (!s)
     {
@@ -693,8 +621,43 @@ configuration :: lookup_search(const char* space_name,
     for (size_t i = 0; i < s->subspaces.size(); ++i)
     {
         std::vector<virtual_server_id> this_server_set;
+        const region_index* idx = get_region_index(s->subspaces[i].id);
+        std::vector<uint64_t> coords(s->subspaces[i].attrs.size());
+        size_t pinned = 0;
 
-        for (size_t j = 0; j < s->subspaces[i].regions.size(); ++j)
+        // when equality checks pin every attribute of the subspace, exactly
+        // one region can match and the index finds it without a scan
+        for (size_t l = 0; idx && l < coords.size(); ++l)
+        {
+            for (size_t k = 0; k < ranges.size(); ++k)
+            {
+                if (ranges[k].attr == s->subspaces[i].attrs[l] &&
+                    ranges[k].has_start && ranges[k].has_end &&
+                    ranges[k].start == ranges[k].end &&
+                    (ranges[k].type == HYPERDATATYPE_STRING ||
+                     ranges[k].type == HYPERDATATYPE_INT64 ||
+                     ranges[k].type == HYPERDATATYPE_FLOAT))
+                {
+                    coords[l] = hash(ranges[k].type, ranges[k].start);
+                    ++pinned;
+                    break;
+                }
+            }
+        }
+
+        bool direct = idx && !coords.empty() && pinned == coords.size();
+
+        if (direct)
+        {
+            const region* reg = idx->tree.find(coords);
+
+            if (reg && !reg->replicas.empty())
+            {
+                this_server_set.push_back(reg->replicas.back().vsi);
+            }
+        }
+
+        for (size_t j = 0; !direct && j < s->subspaces[i].regions.size(); ++j)
         {
             const region& reg(s->subspaces[i].regions[j]);
 
@@ -787,6 +750,227 @@ configuration :: lookup_search(const char* space_name,
     servers->swap(smallest_server_set);
 }
 
+const configuration::region_index*
+configuration :: get_region_index(const subspace_id& ssid) const
+{
+    size_t lo = 0;
+    size_t hi = m_region_indices.size();
+
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (m_region_indices[mid].ssid < ssid.get())
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    if (lo < m_region_indices.size() && m_region_indices[lo].ssid == ssid.get())
+    {
+        return &m_region_indices[lo];
+    }
+
+    return NULL;
+}
+
+const space*
+configuration :: space_of(const region_id& ri) const
+{
+    const region_entry* e = m_regions.find(ri.get());
+    return e ? e->s : NULL;
+}
+
+const space*
+configuration :: space_of(const space_id& si) const
+{
+    for (size_t i = 0; i < m_spaces.size(); ++i)
+    {
+        if (m_spaces[i].id == si)
+        {
+            return &m_spaces[i];
+        }
+    }
+
+    return NULL;
+}
+
+const space*
+configuration :: space_named(const char* name) const
+{
+    for (const name_entry* e = m_names.find(name_key(name)); e; e = m_names.next(e))
+    {
+        if (strcmp(name, e->s->name) == 0)
+        {
+            return e->s;
+        }
+    }
+
+    return NULL;
+}
+
+void
+configuration :: spaces_hosting(const server_id& si, std::vector<uint64_t>* spaces) const
+{
+    for (size_t w = 0; w < m_spaces.size(); ++w)
+    {
+        const space& s(m_spaces[w]);
+        bool hosted = false;
+
+        for (size_t x = 0; !hosted && x < s.subspaces.size(); ++x)
+        {
+            const subspace& ss(s.subspaces[x]);
+
+            for (size_t y = 0; !hosted && y < ss.regions.size(); ++y)
+            {
+                for (size_t z = 0; !hosted && z < ss.regions[y].replicas.size(); ++z)
+                {
+                    hosted = ss.regions[y].replicas[z].si == si;
+                }
+            }
+        }
+
+        if (hosted)
+        {
+            spaces->push_back(s.id.get());
+        }
+    }
+
+    for (size_t i = 0; i < m_transfers.size(); ++i)
+    {
+        const space* s = space_of(m_transfers[i].rid);
+
+        if (s && (m_transfers[i].src == si || m_transfers[i].dst == si))
+        {
+            spaces->push_back(s->id.get());
+        }
+    }
+}
+
+void
+configuration :: transfers_within(const space_id& si, std::vector<transfer>* transfers) const
+{
+    for (size_t i = 0; i < m_transfers.size(); ++i)
+    {
+        const space* s = space_of(m_transfers[i].rid);
+
+        if (s && s->id == si)
+        {
+            transfers->push_back(m_transfers[i]);
+        }
+    }
+
+    std::sort(transfers->begin(), transfers->end());
+}
+
+void
+configuration :: regions_within(const subspace_id& ssid,
+                                const std::vector<uint64_t>& lower,
+                                const std::vector<uint64_t>& upper,
+                                std::vector<region_id>* rids) const
+{
+    const region_index* idx = get_region_index(ssid);
+
+    if (!idx)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < idx->regions.size(); ++i)
+    {
+        const region& r(*idx->regions[i]);
+
+        if (r.lower_coord.size() != lower.size() ||
+            r.upper_coord.size() != upper.size())
+        {
+            continue;
+        }
+
+        bool overlaps = true;
+
+        for (size_t a = 0; overlaps && a < lower.size(); ++a)
+        {
+            overlaps = r.lower_coord[a] <= upper[a] && lower[a] <= r.upper_coord[a];
+        }
+
+        if (overlaps)
+        {
+            rids->push_back(r.id);
+        }
+    }
+}
+
+const hyperdex::region*
+configuration :: key_region(const space& s, const e::slice& key) const
+{
+    assert(!s.subspaces.empty());
+    const region_index* idx = get_region_index(s.subspaces[0].id);
+
+    if (!idx)
+    {
+        return NULL;
+    }
+
+    uint64_t h;
+    hash(s.sc, key, &h);
+    std::vector<uint64_t> coords(1, h);
+    return idx->tree.find(coords);
+}
+
+bool
+configuration :: unchanged_for(const server_id& si, const configuration& other) const
+{
+    // leaving read-only mode must go through a full reconfiguration, which
+    // drops key states that a bulk load may have left stale
+    if (m_flags != other.m_flags ||
+        get_address(si) != other.get_address(si) ||
+        get_state(si) != other.get_state(si))
+    {
+        return false;
+    }
+
+    std::vector<uint64_t> spaces;
+    spaces_hosting(si, &spaces);
+    other.spaces_hosting(si, &spaces);
+    std::sort(spaces.begin(), spaces.end());
+    spaces.erase(std::unique(spaces.begin(), spaces.end()), spaces.end());
+
+    for (size_t i = 0; i < spaces.size(); ++i)
+    {
+        const space* lhs = space_of(space_id(spaces[i]));
+        const space* rhs = other.space_of(space_id(spaces[i]));
+
+        if (!lhs || !rhs || !same_packing(*lhs, *rhs))
+        {
+            return false;
+        }
+
+        std::vector<transfer> lhs_xfers;
+        std::vector<transfer> rhs_xfers;
+        transfers_within(space_id(spaces[i]), &lhs_xfers);
+        other.transfers_within(space_id(spaces[i]), &rhs_xfers);
+
+        if (lhs_xfers.size() != rhs_xfers.size())
+        {
+            return false;
+        }
+
+        for (size_t j = 0; j < lhs_xfers.size(); ++j)
+        {
+            if (!same_packing(lhs_xfers[j], rhs_xfers[j]))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
 std::string
 configuration :: dump() const
 {
@@ -904,17 +1088,8 @@ configuration :: operator = (const configuration& rhs)
     m_version = rhs.m_version;
     m_flags = rhs.m_flags;
     m_servers = rhs.m_servers;
-    m_region_ids_by_virtual = rhs.m_region_ids_by_virtual;
-    m_server_ids_by_virtual = rhs.m_server_ids_by_virtual;
-    m_schemas_by_region = rhs.m_schemas_by_region;
-    m_subspaces_by_region = rhs.m_subspaces_by_region;
-    m_subspace_ids_by_region = rhs.m_subspace_ids_by_region;
     m_subspace_ids_for_prev = rhs.m_subspace_ids_for_prev;
     m_subspace_ids_for_next = rhs.m_subspace_ids_for_next;
-    m_heads_by_region = rhs.m_heads_by_region;
-    m_tails_by_region = rhs.m_tails_by_region;
-    m_next_by_virtual = rhs.m_next_by_virtual;
-    m_point_leaders_by_virtual = rhs.m_point_leaders_by_virtual;
     m_spaces = rhs.m_spaces;
     m_transfers = rhs.m_transfers;
     refill_cache();
@@ -924,25 +1099,27 @@ configuration :: operator = (const configuration& rhs)
 void
 configuration :: refill_cache()
 {
-    m_region_ids_by_virtual.clear();
-    m_server_ids_by_virtual.clear();
-    m_schemas_by_region.clear();
-    m_subspaces_by_region.clear();
-    m_subspace_ids_by_region.clear();
     m_subspace_ids_for_prev.clear();
     m_subspace_ids_for_next.clear();
-    m_heads_by_region.clear();
-    m_tails_by_region.clear();
-    m_next_by_virtual.clear();
-    m_point_leaders_by_virtual.clear();
+    m_region_indices.clear();
+    std::vector<region_entry> regions;
+    std::vector<virtual_entry> virtuals;
+    std::vector<name_entry> names;
 
     for (size_t w = 0; w < m_spaces.size(); ++w)
     {
         space& s(m_spaces[w]);
+        names.push_back(name_entry());
+        names.back().key = name_key(s.name);
+        names.back().s = &s;
 
         for (size_t x = 0; x < s.subspaces.size(); ++x)
         {
             subspace& ss(s.subspaces[x]);
+            m_region_indices.push_back(region_index());
+            region_index& idx(m_region_indices.back());
+            idx.ssid = ss.id.get();
+            idx.ss = &ss;
 
             if (x > 0)
             {
@@ -959,61 +1136,80 @@ configuration :: refill_cache()
             for (size_t y = 0; y < ss.regions.size(); ++y)
             {
                 region& r(ss.regions[y]);
-                m_schemas_by_region.push_back(std::make_pair(r.id.get(), &s.sc));
-                m_subspaces_by_region.push_back(std::make_pair(r.id.get(), &ss));
-                m_subspace_ids_by_region.push_back(std::make_pair(r.id.get(), ss.id.get()));
-
-                if (r.replicas.empty())
-                {
-                    continue;
-                }
-
-                if (x == 0)
-                {
-                    m_point_leaders_by_virtual.push_back(r.replicas[0].vsi.get());
-                }
-
-                m_heads_by_region.push_back(std::make_pair(r.id.get(),
-                                                           r.replicas[0].vsi.get()));
-                m_tails_by_region.push_back(std::make_pair(r.id.get(),
-                                                           r.replicas[r.replicas.size() - 1].vsi.get()));
+                regions.push_back(region_entry());
+                regions.back().key = r.id.get();
+                regions.back().s = &s;
+                regions.back().ss = &ss;
+                regions.back().r = &r;
+                idx.regions.push_back(&r);
 
                 for (size_t z = 0; z < r.replicas.size(); ++z)
                 {
-                    m_region_ids_by_virtual.push_back(std::make_pair(r.replicas[z].vsi.get(),
-                                                                     r.id.get()));
-                    m_server_ids_by_virtual.push_back(std::make_pair(r.replicas[z].vsi.get(),
-                                                                     r.replicas[z].si.get()));
-
-                    if (z + 1 < r.replicas.size())
-                    {
-                        m_next_by_virtual.push_back(std::make_pair(r.replicas[z].vsi.get(),
-                                                                   r.replicas[z + 1].vsi.get()));
-                    }
+                    virtuals.push_back(virtual_entry());
+                    virtual_entry& v(virtuals.back());
+                    v.key = r.replicas[z].vsi.get();
+                    v.rid = r.id.get();
+                    v.sid = r.replicas[z].si.get();
+                    v.next = z + 1 < r.replicas.size() ? r.replicas[z + 1].vsi.get() : 0;
+                    v.point_leader = x == 0 && z == 0;
                 }
             }
         }
     }
 
+    // a transfer names its source's region and its destination's server
+    // before the destination joins the chain
     for (size_t i = 0; i < m_transfers.size(); ++i)
     {
         transfer& xfer(m_transfers[i]);
-        m_region_ids_by_virtual.push_back(std::make_pair(xfer.vsrc.get(), xfer.rid.get()));
-        m_server_ids_by_virtual.push_back(std::make_pair(xfer.vdst.get(), xfer.dst.get()));
+        virtuals.push_back(virtual_entry());
+        virtuals.back().key = xfer.vsrc.get();
+        virtuals.back().rid = xfer.rid.get();
+        virtuals.push_back(virtual_entry());
+        virtuals.back().key = xfer.vdst.get();
+        virtuals.back().sid = xfer.dst.get();
+    }
+
+    // fold the entries for each virtual server into one; the stable sort
+    // keeps the chain's entry ahead of those from transfers
+    std::stable_sort(virtuals.begin(), virtuals.end());
+    std::vector<virtual_entry>::iterator vend = virtuals.begin();
+
+    for (size_t i = 0; i < virtuals.size(); ++i)
+    {
+        if (virtuals[i].key == 0)
+        {
+            continue;
+        }
+
+        if (vend != virtuals.begin() && (vend - 1)->key == virtuals[i].key)
+        {
+            virtual_entry& v(*(vend - 1));
+            v.rid = v.rid ? v.rid : virtuals[i].rid;
+            v.sid = v.sid ? v.sid : virtuals[i].sid;
+            continue;
+        }
+
+        *vend = virtuals[i];
+        ++vend;
     }
 
+    virtuals.erase(vend, virtuals.end());
+    m_regions.build(regions);
+    m_virtuals.build(virtuals);
+    m_names.build(names);
     std::sort(m_servers.begin(), m_servers.end());
-    std::sort(m_region_ids_by_virtual.begin(), m_region_ids_by_virtual.end());
-    std::sort(m_server_ids_by_virtual.begin(), m_server_ids_by_virtual.end());
-    std::sort(m_schemas_by_region.begin(), m_schemas_by_region.end());
-    std::sort(m_subspaces_by_region.begin(), m_subspaces_by_region.end());
-    std::sort(m_subspace_ids_by_region.begin(), m_subspace_ids_by_region.end());
     std::sort(m_subspace_ids_for_prev.begin(), m_subspace_ids_for_prev.end());
     std::sort(m_subspace_ids_for_next.begin(), m_subspace_ids_for_next.end());
-    std::sort(m_heads_by_region.begin(), m_heads_by_region.end());
-    std::sort(m_tails_by_region.begin(), m_tails_by_region.end());
-    std::sort(m_next_by_virtual.begin(), m_next_by_virtual.end());
-    std::sort(m_point_leaders_by_virtual.begin(), m_point_leaders_by_virtual.end());
+
+    std::sort(m_region_indices.begin(), m_region_indices.end());
+
+    // built in place; sorting would copy every tree
+    for (size_t i = 0; i < m_region_indices.size(); ++i)
+    {
+        region_index& idx(m_region_indices[i]);
+        idx.tree.build(idx.regions, idx.ss->attrs.size());
+    }
 }
 
 e::unpacker
@@ -1058,3 +1254,169 @@ hyperdex :: operator >> (e::unpacker up, configuration& c)
     c.refill_cache();
     return up;
 }
+
+e::unpacker
+hyperdex :: apply_delta(e::unpacker up, configuration* c)
+{
+    uint64_t prev_version;
+    uint64_t version;
+    uint64_t flags;
+    up = up >> prev_version >> version >> flags;
+
+    if (up.error() || prev_version != c->m_version)
+    {
+        return up.as_error();
+    }
+
+    // servers
+    uint64_t num_servers_rm;
+    up = up >> num_servers_rm;
+
+    for (size_t i = 0; !up.error() && i < num_servers_rm; ++i)
+    {
+        server_id sid;
+        up = up >> sid;
+
+        for (size_t j = 0; j < c->m_servers.size(); ++j)
+        {
+            if (c->m_servers[j].id == sid)
+            {
+                c->m_servers[j] = c->m_servers.back();
+                c->m_servers.pop_back();
+                break;
+            }
+        }
+    }
+
+    uint64_t num_servers;
+    up = up >> num_servers;
+
+    for (size_t i = 0; !up.error() && i < num_servers; ++i)
+    {
+        server s;
+        up = up >> s;
+        size_t j = 0;
+
+        for (j = 0; j < c->m_servers.size(); ++j)
+        {
+            if (c->m_servers[j].id == s.id)
+            {
+                break;
+            }
+        }
+
+        if (j < c->m_servers.size())
+        {
+            c->m_servers[j] = s;
+        }
+        else
+        {
+            c->m_servers.push_back(s);
+        }
+    }
+
+    // spaces
+    uint64_t num_spaces_rm;
+    up = up >> num_spaces_rm;
+
+    for (size_t i = 0; !up.error() && i < num_spaces_rm; ++i)
+    {
+        space_id sid;
+        up = up >> sid;
+
+        for (size_t j = 0; j < c->m_spaces.size(); ++j)
+        {
+            if (c->m_spaces[j].id == sid)
+            {
+                c->m_spaces.erase(c->m_spaces.begin() + j);
+                break;
+            }
+        }
+    }
+
+    uint64_t num_spaces;
+    up = up >> num_spaces;
+
+    for (size_t i = 0; !up.error() && i < num_spaces; ++i)
+    {
+        space s;
+        up = up >> s;
+        size_t j = 0;
+
+        for (j = 0; j < c->m_spaces.size(); ++j)
+        {
+            if (c->m_spaces[j].id == s.id)
+            {
+                break;
+            }
+        }
+
+        if (j < c->m_spaces.size())
+        {
+            c->m_spaces[j] = s;
+        }
+        else
+        {
+            c->m_spaces.push_back(s);
+        }
+    }
+
+    // regions whose replicas changed within an otherwise unchanged space
+    uint64_t num_regions;
+    up = up >> num_regions;
+    std::vector<std::pair<uint64_t, region*> > regions;
+
+    for (size_t s = 0; num_regions > 0 && s < c->m_spaces.size(); ++s)
+    {
+        for (size_t ss = 0; ss < c->m_spaces[s].subspaces.size(); ++ss)
+        {
+            subspace& sub(c->m_spaces[s].subspaces[ss]);
+
+            for (size_t r = 0; r < sub.regions.size(); ++r)
+            {
+                regions.push_back(std::make_pair(sub.regions[r].id.get(), &sub.regions[r]));
+            }
+        }
+    }
+
+    std::sort(regions.begin(), regions.end());
+
+    for (size_t i = 0; !up.error() && i < num_regions; ++i)
+    {
+        region reg;
+        up = up >> reg;
+        std::vector<std::pair<uint64_t, region*> >::iterator it;
+        it = std::lower_bound(regions.begin(), regions.end(),
+                              std::make_pair(reg.id.get(), static_cast<region*>(NULL)));
+
+        if (it == regions.end() || it->first != reg.id.get())
+        {
+            return up.as_error();
+        }
+
+        *it->second = reg;
+    }
+
+    // transfers are few; the delta carries all of them
+    uint64_t num_transfers;
+    up = up >> num_transfers;
+    c->m_transfers.clear();
+    c->m_transfers.reserve(num_transfers);
+
+    for (size_t i = 0; !up.error() && i < num_transfers; ++i)
+    {
+        transfer xfer;
+        up = up >> xfer;
+        c->m_transfers.push_back(xfer);
+    }
+
+    if (up.error())
+    {
+        return up;
+    }
+
+    c->m_version = version;
+    c->m_flags = flags;
+    c->refill_cache();
+    return up;
+}
@@ -43,7 +43,9 @@
 #include "common/attribute.h"
 #include "common/attribute_check.h"
 #include "common/hyperspace.h"
+#include "common/id_index.h"
 #include "common/ids.h"
+#include "common/region_tree.h"
 #include "common/schema.h"
 #include "common/server.h"
 #include "common/transfer.h"
@@ -77,6 +79,7 @@ class configuration
         const schema* get_schema(const char* space) const;
         const schema* get_schema(const region_id& ri) const;
         const subspace* get_subspace(const region_id& ri) const;
+        const region* get_region(const region_id& ri) const;
         virtual_server_id get_virtual(const region_id& ri, const server_id& si) const;
         subspace_id subspace_of(const region_id& ri) const;
         subspace_id subspace_prev(const subspace_id& ss) const;
@@ -90,6 +93,9 @@ class configuration
         virtual_server_id point_leader(const char* space, const e::slice& key) const;
         // point leader for this key in the same space as ri
         virtual_server_id point_leader(const region_id& ri, const e::slice& key) const;
+        // the chain for key in its point leader's region, point leader first
+        void key_replicas(const char* space, const e::slice& key,
+                          std::vector<virtual_server_id>* replicas) const;
         // lhs and rhs are in adjacent subspaces such that lhs sends CHAIN_PUT
         // to rhs and rhs sends CHAIN_ACK to lhs
         bool subspace_adjacent(const virtual_server_id& lhs, const virtual_server_id& rhs) const;
@@ -114,10 +120,23 @@ class configuration
         void lookup_region(const subspace_id& subspace,
                            const std::vector<uint64_t>& hashes,
                            region_id* region) const;
+        // regions of "subspace" whose boxes overlap [lower, upper]
+        void regions_within(const subspace_id& subspace,
+                            const std::vector<uint64_t>& lower,
+                            const std::vector<uint64_t>& upper,
+                            std::vector<region_id>* regions) const;
         void lookup_search(const char* space,
                            const std::vector<attribute_check>& chks,
                            std::vector<virtual_server_id>* servers) const;
 
+    // reconfiguration
+    public:
+        // true if nothing "si" hosts differs in "other":  the cluster's flags,
+        // si's own entry, every space in which it holds a replica or a
+        // transfer end in either configuration, and the transfers within
+        // those spaces
+        bool unchanged_for(const server_id& si, const configuration& other) const;
+
     public:
         std::string dump() const;
         std::string list_spaces() const;
@@ -125,16 +144,62 @@ class configuration
     public:
         configuration& operator = (const configuration& rhs);
 
+    private:
+        // The regions of one subspace tile it, as a grid until splits and
+        // merges reshape it; "tree" finds the region holding a point either
+        // way in time logarithmic in the number of regions.
+        struct region_index
+        {
+            region_index() : ssid(), ss(NULL), regions(), tree() {}
+            bool operator < (const region_index& rhs) const { return ssid < rhs.ssid; }
+            uint64_t ssid;
+            const subspace* ss;
+            std::vector<const region*> regions;
+            region_tree<region> tree;
+        };
+
     private:
         void refill_cache();
+        const region_index* get_region_index(const subspace_id& ssid) const;
+        const region* key_region(const space& s, const e::slice& key) const;
+        const space* space_of(const region_id& ri) const;
+        const space* space_of(const space_id& si) const;
+        const space* space_named(const char* name) const;
+        void spaces_hosting(const server_id& si, std::vector<uint64_t>* spaces) const;
+        void transfers_within(const space_id& si, std::vector<transfer>* transfers) const;
         friend size_t pack_size(const configuration&);
         friend e::buffer::packer operator << (e::buffer::packer, const configuration& s);
         friend e::unpacker operator >> (e::unpacker, configuration& s);
+        friend e::unpacker apply_delta(e::unpacker, configuration* c);
 
     private:
+        // The per-region, per-virtual-server, and per-name facts that the
+        // accessors above return, each resolved with one hash probe.
+        struct region_entry
+        {
+            region_entry() : key(0), s(NULL), ss(NULL), r(NULL) {}
+            uint64_t key;
+            const space* s;
+            const subspace* ss;
+            const region* r;
+        };
+        struct virtual_entry
+        {
+            virtual_entry() : key(0), rid(0), sid(0), next(0), point_leader(false) {}
+            bool operator < (const virtual_entry& rhs) const { return key < rhs.key; }
+            uint64_t key;
+            uint64_t rid;
+            uint64_t sid;
+            uint64_t next;
+            bool point_leader;
+        };
+        struct name_entry
+        {
+            name_entry() : key(0), s(NULL) {}
+            uint64_t key;
+            const space* s;
+        };
         typedef std::pair<uint64_t, uint64_t> pair_uint64_t;
-        typedef std::pair<uint64_t, schema*> uint64_schema_t;
-        typedef std::pair<uint64_t, subspace*> uint64_subspace_t;
         typedef std::pair<uint64_t, po6::net::location> uint64_location_t;
 
     private:
@@ -142,17 +207,12 @@ class configuration
         uint64_t m_version;
         uint64_t m_flags;
         std::vector<server> m_servers;
-        std::vector<pair_uint64_t> m_region_ids_by_virtual;
-        std::vector<pair_uint64_t> m_server_ids_by_virtual;
-        std::vector<uint64_schema_t> m_schemas_by_region;
-        std::vector<uint64_subspace_t> m_subspaces_by_region;
-        std::vector<pair_uint64_t> m_subspace_ids_by_region;
         std::vector<pair_uint64_t> m_subspace_ids_for_prev;
         std::vector<pair_uint64_t> m_subspace_ids_for_next;
-        std::vector<pair_uint64_t> m_heads_by_region;
-        std::vector<pair_uint64_t> m_tails_by_region;
-        std::vector<pair_uint64_t> m_next_by_virtual;
-        std::vector<uint64_t> m_point_leaders_by_virtual;
+        id_index<region_entry> m_regions;
+        id_index<virtual_entry> m_virtuals;
+        id_index<name_entry> m_names;
+        std::vector<region_index> m_region_indices;
         std::vector<space> m_spaces;
         std::vector<transfer> m_transfers;
 };
@@ -164,6 +224,12 @@ operator >> (e::unpacker, configuration& c);
 size_t
 pack_size(const configuration&);
 
+// Apply one delta as packed by the coordinator.  The delta must pick up where
+// c's version leaves off; if it does not, or it names a region c does not
+// have, the returned unpacker is in error and c must be discarded.
+e::unpacker
+apply_delta(e::unpacker up, configuration* c);
+
 END_HYPERDEX_NAMESPACE
 
 #endif // hyperdex_common_configuration_h_
@@ -30,4 +30,8 @@
 
 #define HYPERDEX_CONFIG_READ_ONLY 1
 
+// replies to "config_delta" start with one of these
+#define HYPERDEX_CONFIG_FULL 0
+#define HYPERDEX_CONFIG_DELTAS 1
+
 #endif // hyperdex_common_configuration_flags_h_
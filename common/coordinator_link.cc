@@ -25,7 +25,11 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+// e
+#include <e/endian.h>
+
 // HyperDex
+#include "common/configuration_flags.h"
 #include "common/coordinator_link.h"
 
 using hyperdex::coordinator_link;
@@ -88,6 +92,7 @@ coordinator_link :: ensure_configuration(replicant_returncode* status)
                 timeout = 0;
                 break;
             case FETCHING_CONFIG:
+            case FETCHING_DELTA:
                 timeout = -1;
                 break;
             case NOTHING:
@@ -222,7 +227,8 @@ coordinator_link :: handle_internal_callback(replicant_returncode* status, bool*
     }
 
     assert(m_state == WAITING_ON_BROADCAST ||
-           m_state == FETCHING_CONFIG);
+           m_state == FETCHING_CONFIG ||
+           m_state == FETCHING_DELTA);
 
     if (m_state == WAITING_ON_BROADCAST)
     {
@@ -238,8 +244,51 @@ coordinator_link :: handle_internal_callback(replicant_returncode* status, bool*
 
     e::unpacker up(m_output, m_output_sz);
     configuration new_config;
-    up = up >> new_config;
-    reset();
+
+    if (m_state == FETCHING_DELTA)
+    {
+        uint8_t kind = 0;
+        up = up >> kind;
+
+        if (!up.error() && kind == HYPERDEX_CONFIG_DELTAS)
+        {
+            uint64_t cluster = 0;
+            uint64_t count = 0;
+            up = up >> cluster >> count;
+            new_config = m_config;
+
+            if (cluster != m_config.cluster())
+            {
+                up = up.as_error();
+            }
+
+            for (uint64_t i = 0; !up.error() && i < count; ++i)
+            {
+                up = apply_delta(up, &new_config);
+            }
+        }
+        else
+        {
+            up = up >> new_config;
+        }
+
+        reset();
+
+        // deltas that do not line up with our version; start over from a
+        // full configuration
+        if (up.error())
+        {
+            m_state = WAITING_ON_BROADCAST;
+            m_status = REPLICANT_SUCCESS;
+            *failed = !begin_fetching_config(status, true);
+            return false;
+        }
+    }
+    else
+    {
+        up = up >> new_config;
+        reset();
+    }
 
     if (up.error())
     {
@@ -285,16 +334,29 @@ coordinator_link :: begin_waiting_on_broadcast(replicant_returncode* status)
 }
 
 bool
-coordinator_link :: begin_fetching_config(replicant_returncode* status)
+coordinator_link :: begin_fetching_config(replicant_returncode* status, bool full)
 {
     assert(m_id == -1);
     assert(m_state == WAITING_ON_BROADCAST);
     assert(m_status == REPLICANT_SUCCESS);
     assert(m_output == NULL);
     assert(m_output_sz == 0);
-    m_id = m_repl.send("hyperdex", "config_get", "", 0,
-                       &m_status, &m_output, &m_output_sz);
-    m_state = FETCHING_CONFIG;
+
+    if (full || m_config.version() == 0)
+    {
+        m_id = m_repl.send("hyperdex", "config_get", "", 0,
+                           &m_status, &m_output, &m_output_sz);
+        m_state = FETCHING_CONFIG;
+    }
+    else
+    {
+        char buf[sizeof(uint64_t)];
+        e::pack64be(m_config.version(), buf);
+        m_id = m_repl.send("hyperdex", "config_delta", buf, sizeof(uint64_t),
+                           &m_status, &m_output, &m_output_sz);
+        m_state = FETCHING_DELTA;
+    }
+
     *status = m_status;
 
     if (m_id >= 0)
@@ -93,13 +93,14 @@ class coordinator_link
         //      failed == false:  no error, just working the state machine
         bool handle_internal_callback(replicant_returncode* status, bool* failed);
         bool begin_waiting_on_broadcast(replicant_returncode* status);
-        bool begin_fetching_config(replicant_returncode* status);
+        // fetch deltas from our version unless "full" or we have none
+        bool begin_fetching_config(replicant_returncode* status, bool full = false);
         void reset();
 
     private:
         replicant_client m_repl;
         configuration m_config;
-        enum { NOTHING, WAITING_ON_BROADCAST, FETCHING_CONFIG } m_state;
+        enum { NOTHING, WAITING_ON_BROADCAST, FETCHING_CONFIG, FETCHING_DELTA } m_state;
         int64_t m_id;
         replicant_returncode m_status;
         const char* m_output;
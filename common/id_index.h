@@ -0,0 +1,148 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_common_id_index_h_
+#define hyperdex_common_id_index_h_
+
+// C
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// STL
+#include <vector>
+
+// HyperDex
+#include "namespace.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// A read-only open-addressing hash table over entries of type T, each of which
+// carries a nonzero uint64_t "key".  The table is built in one shot, kept at
+// most half full, and probed linearly from a Fibonacci hash of the key, so a
+// lookup for a dense counter-assigned id almost always lands on its slot.
+// Keys need not be unique; find/next walk every entry sharing a key.
+template <typename T>
+class id_index
+{
+    public:
+        id_index() : m_slots(), m_shift(0) {}
+
+    public:
+        // replace the contents with a copy of entries
+        void build(const std::vector<T>& entries);
+        void clear() { m_slots.clear(); m_shift = 0; }
+        size_t capacity() const { return m_slots.size(); }
+        // the first entry with this key, or NULL
+        const T* find(uint64_t key) const;
+        // the entry after prev sharing its key, or NULL
+        const T* next(const T* prev) const;
+
+    private:
+        size_t slot_of(uint64_t key) const
+        { return (key * 0x9e3779b97f4a7c15ULL) >> m_shift; }
+        const T* probe(uint64_t key, size_t idx) const;
+
+    private:
+        std::vector<T> m_slots;
+        unsigned m_shift;
+};
+
+template <typename T>
+void
+id_index<T> :: build(const std::vector<T>& entries)
+{
+    unsigned bits = 1;
+
+    while ((size_t(1) << bits) < entries.size() * 2)
+    {
+        ++bits;
+    }
+
+    m_slots.clear();
+    m_slots.resize(size_t(1) << bits);
+    m_shift = 64 - bits;
+    const size_t mask = m_slots.size() - 1;
+
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        assert(entries[i].key != 0);
+        size_t idx = slot_of(entries[i].key);
+
+        while (m_slots[idx].key != 0)
+        {
+            idx = (idx + 1) & mask;
+        }
+
+        m_slots[idx] = entries[i];
+    }
+}
+
+template <typename T>
+const T*
+id_index<T> :: find(uint64_t key) const
+{
+    if (m_slots.empty() || key == 0)
+    {
+        return NULL;
+    }
+
+    return probe(key, slot_of(key));
+}
+
+template <typename T>
+const T*
+id_index<T> :: next(const T* prev) const
+{
+    assert(prev >= &m_slots[0] && prev < &m_slots[0] + m_slots.size());
+    size_t idx = ((prev - &m_slots[0]) + 1) & (m_slots.size() - 1);
+    return probe(prev->key, idx);
+}
+
+template <typename T>
+const T*
+id_index<T> :: probe(uint64_t key, size_t idx) const
+{
+    const size_t mask = m_slots.size() - 1;
+
+    // the table is never more than half full, so an empty slot ends the run
+    while (m_slots[idx].key != 0)
+    {
+        if (m_slots[idx].key == key)
+        {
+            return &m_slots[idx];
+        }
+
+        idx = (idx + 1) & mask;
+    }
+
+    return NULL;
+}
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_common_id_index_h_
@@ -55,14 +55,18 @@ hyperdex :: operator << (std::ostream& lhs, const network_msgtype& rhs)
         STRINGIFY(CHAIN_SUBSPACE);
         STRINGIFY(CHAIN_ACK);
         STRINGIFY(CHAIN_GC);
+        STRINGIFY(CHAIN_BATCH);
         STRINGIFY(XFER_OP);
         STRINGIFY(XFER_ACK);
         STRINGIFY(XFER_HS);
         STRINGIFY(XFER_HSA);
         STRINGIFY(XFER_HA);
         STRINGIFY(XFER_HW);
+        STRINGIFY(REGION_STATS);
+        STRINGIFY(BULK_LOAD);
         STRINGIFY(BACKUP);
         STRINGIFY(PERF_COUNTERS);
+        STRINGIFY(OVERLOADED);
         STRINGIFY(CONFIGMISMATCH);
         STRINGIFY(PACKET_NOP);
         default:
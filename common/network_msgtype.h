@@ -66,6 +66,7 @@ enum network_msgtype
     CHAIN_SUBSPACE  = 65,
     CHAIN_ACK       = 66,
     CHAIN_GC        = 67,
+    CHAIN_BATCH     = 68,
 
     XFER_OP  = 80,
     XFER_ACK = 81,
@@ -74,9 +75,12 @@ enum network_msgtype
     XFER_HA  = 84, // handshake ack
     XFER_HW  = 85, // wiped
 
+    REGION_STATS = 124,
+    BULK_LOAD = 125,
     BACKUP = 126,
     PERF_COUNTERS = 127,
 
+    OVERLOADED      = 253, // the server shed the request; retry later
     CONFIGMISMATCH  = 254,
     PACKET_NOP      = 255
 };
@@ -43,7 +43,8 @@ enum network_returncode
     NET_SERVERERROR = 8324,
     NET_CMPFAIL     = 8325,
     NET_READONLY    = 8327,
-    NET_OVERFLOW    = 8328
+    NET_OVERFLOW    = 8328,
+    NET_STALE       = 8329
 };
 
 END_HYPERDEX_NAMESPACE
@@ -0,0 +1,246 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_common_region_tree_h_
+#define hyperdex_common_region_tree_h_
+
+// C
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// STL
+#include <algorithm>
+#include <vector>
+
+// HyperDex
+#include "namespace.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// A k-d tree over non-overlapping boxes of type T, each with "lower_coord"
+// and "upper_coord" vectors holding inclusive bounds.  Splits and merges cut
+// a box in two along one dimension, so the regions of a subspace can always
+// be parted along some dimension without cutting through a region; each
+// interior node records such a cut, picked to part the regions as evenly as
+// possible.  A leaf holds whatever could not be parted, which is a single
+// region unless the regions were laid out some other way.
+template <typename T>
+class region_tree
+{
+    public:
+        region_tree() : m_nodes(), m_regions() {}
+
+    public:
+        // boxes without "dims" dimensions are left out
+        void build(const std::vector<const T*>& regions, size_t dims);
+        void clear() { m_nodes.clear(); m_regions.clear(); }
+        // the region holding coords, or NULL
+        const T* find(const std::vector<uint64_t>& coords) const;
+        // the most nodes a lookup passes through
+        size_t depth() const;
+
+    private:
+        struct node
+        {
+            node() : leaf(false), dim(0), cut(0), below(0), above(0) {}
+            bool leaf;
+            // interior: coords[dim] < cut go to the "below" node, the rest
+            // to the "above" node; leaf: m_regions[below, above)
+            size_t dim;
+            uint64_t cut;
+            size_t below;
+            size_t above;
+        };
+        class lower_lt
+        {
+            public:
+                lower_lt(size_t dim) : m_dim(dim) {}
+                bool operator () (const T* lhs, const T* rhs) const
+                { return lhs->lower_coord[m_dim] < rhs->lower_coord[m_dim]; }
+
+            private:
+                size_t m_dim;
+        };
+
+    private:
+        size_t build(size_t begin, size_t end, size_t dims);
+        size_t depth(size_t n) const;
+        static bool contains(const T& r, const std::vector<uint64_t>& coords);
+
+    private:
+        std::vector<node> m_nodes;
+        std::vector<const T*> m_regions;
+};
+
+template <typename T>
+void
+region_tree<T> :: build(const std::vector<const T*>& regions, size_t dims)
+{
+    clear();
+
+    for (size_t i = 0; i < regions.size(); ++i)
+    {
+        if (regions[i]->lower_coord.size() == dims &&
+            regions[i]->upper_coord.size() == dims)
+        {
+            m_regions.push_back(regions[i]);
+        }
+    }
+
+    if (!m_regions.empty())
+    {
+        build(0, m_regions.size(), dims);
+    }
+}
+
+template <typename T>
+const T*
+region_tree<T> :: find(const std::vector<uint64_t>& coords) const
+{
+    if (m_nodes.empty())
+    {
+        return NULL;
+    }
+
+    size_t n = 0;
+
+    while (!m_nodes[n].leaf)
+    {
+        assert(m_nodes[n].dim < coords.size());
+        n = coords[m_nodes[n].dim] < m_nodes[n].cut ? m_nodes[n].below
+                                                      : m_nodes[n].above;
+    }
+
+    for (size_t i = m_nodes[n].below; i < m_nodes[n].above; ++i)
+    {
+        if (contains(*m_regions[i], coords))
+        {
+            return m_regions[i];
+        }
+    }
+
+    return NULL;
+}
+
+template <typename T>
+size_t
+region_tree<T> :: depth() const
+{
+    return m_nodes.empty() ? 0 : depth(0);
+}
+
+template <typename T>
+size_t
+region_tree<T> :: build(size_t begin, size_t end, size_t dims)
+{
+    const size_t n = m_nodes.size();
+    m_nodes.push_back(node());
+    size_t best_dim = dims;
+    size_t best_split = 0;
+    size_t best_skew = end - begin;
+
+    // with the regions sorted by their lower bound, any region that starts
+    // beyond the furthest reach of those before it starts a valid cut
+    for (size_t d = 0; end - begin > 1 && d < dims; ++d)
+    {
+        std::sort(m_regions.begin() + begin, m_regions.begin() + end, lower_lt(d));
+        uint64_t reach = m_regions[begin]->upper_coord[d];
+
+        for (size_t i = begin + 1; i < end; ++i)
+        {
+            const T& r(*m_regions[i]);
+            size_t skew = i - begin < end - i ? end - i - (i - begin)
+                                              : i - begin - (end - i);
+
+            if (reach < r.lower_coord[d] && skew < best_skew)
+            {
+                best_dim = d;
+                best_split = i;
+                best_skew = skew;
+            }
+
+            reach = std::max(reach, r.upper_coord[d]);
+        }
+    }
+
+    if (best_dim == dims)
+    {
+        m_nodes[n].leaf = true;
+        m_nodes[n].below = begin;
+        m_nodes[n].above = end;
+        return n;
+    }
+
+    std::sort(m_regions.begin() + begin, m_regions.begin() + end, lower_lt(best_dim));
+    const uint64_t cut = m_regions[best_split]->lower_coord[best_dim];
+    // m_nodes grows as the children are built, so set the fields by index
+    const size_t below = build(begin, best_split, dims);
+    const size_t above = build(best_split, end, dims);
+    m_nodes[n].dim = best_dim;
+    m_nodes[n].cut = cut;
+    m_nodes[n].below = below;
+    m_nodes[n].above = above;
+    return n;
+}
+
+template <typename T>
+size_t
+region_tree<T> :: depth(size_t n) const
+{
+    if (m_nodes[n].leaf)
+    {
+        return 1;
+    }
+
+    return 1 + std::max(depth(m_nodes[n].below), depth(m_nodes[n].above));
+}
+
+template <typename T>
+bool
+region_tree<T> :: contains(const T& r, const std::vector<uint64_t>& coords)
+{
+    if (r.lower_coord.size() != coords.size() ||
+        r.upper_coord.size() != coords.size())
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < coords.size(); ++i)
+    {
+        if (coords[i] < r.lower_coord[i] || r.upper_coord[i] < coords[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_common_region_tree_h_
@@ -0,0 +1,89 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <stdint.h>
+
+// STL
+#include <memory>
+
+// e
+#include <e/buffer.h>
+
+// HyperDex
+#include "test/th.h"
+#include "common/configuration.h"
+#include "common/configuration_flags.h"
+
+using hyperdex::configuration;
+using hyperdex::server;
+using hyperdex::server_id;
+
+namespace
+{
+
+// a cluster of one server hosting no spaces
+void
+make_config(uint64_t version, uint64_t flags, configuration* c)
+{
+    server s(server_id(1));
+    s.state = server::AVAILABLE;
+    s.bind_to = po6::net::location("127.0.0.1", 2012);
+    const uint64_t cluster = 1;
+    const uint64_t num_servers = 1;
+    const uint64_t num_spaces = 0;
+    const uint64_t num_transfers = 0;
+    std::auto_ptr<e::buffer> buf(e::buffer::create(6 * sizeof(uint64_t) + pack_size(s)));
+    buf->pack_at(0) << cluster << version << flags
+                    << num_servers << num_spaces << num_transfers << s;
+    e::unpacker up = buf->unpack_from(0) >> *c;
+    ASSERT_FALSE(up.error());
+}
+
+} // namespace
+
+TEST(Configuration, UnchangedFor)
+{
+    configuration a;
+    configuration b;
+    make_config(1, 0, &a);
+    make_config(2, 0, &b);
+    ASSERT_TRUE(a.unchanged_for(server_id(1), b));
+}
+
+TEST(Configuration, FlagsChangeEverything)
+{
+    configuration rw;
+    configuration ro;
+    make_config(1, 0, &rw);
+    make_config(2, HYPERDEX_CONFIG_READ_ONLY, &ro);
+    ASSERT_FALSE(rw.read_only());
+    ASSERT_TRUE(ro.read_only());
+    // entering or leaving read-only mode never reconfigures in place
+    ASSERT_FALSE(rw.unchanged_for(server_id(1), ro));
+    ASSERT_FALSE(ro.unchanged_for(server_id(1), rw));
+}
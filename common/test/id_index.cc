@@ -0,0 +1,108 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <stdint.h>
+
+// STL
+#include <vector>
+
+// HyperDex
+#include "test/th.h"
+#include "common/id_index.h"
+
+using hyperdex::id_index;
+
+namespace
+{
+
+struct entry
+{
+    entry() : key(0), value(0) {}
+    entry(uint64_t k, uint64_t v) : key(k), value(v) {}
+    uint64_t key;
+    uint64_t value;
+};
+
+} // namespace
+
+TEST(IdIndex, Empty)
+{
+    id_index<entry> idx;
+    ASSERT_TRUE(idx.find(1) == NULL);
+    idx.build(std::vector<entry>());
+    ASSERT_TRUE(idx.find(1) == NULL);
+    ASSERT_TRUE(idx.find(0) == NULL);
+}
+
+TEST(IdIndex, Dense)
+{
+    std::vector<entry> entries;
+
+    for (uint64_t i = 1; i <= 1000; ++i)
+    {
+        entries.push_back(entry(i, i * 7));
+    }
+
+    id_index<entry> idx;
+    idx.build(entries);
+    ASSERT_GE(idx.capacity(), 2000U);
+
+    for (uint64_t i = 1; i <= 1000; ++i)
+    {
+        const entry* e = idx.find(i);
+        ASSERT_TRUE(e != NULL);
+        ASSERT_EQ(e->value, i * 7);
+        ASSERT_TRUE(idx.next(e) == NULL);
+    }
+
+    ASSERT_TRUE(idx.find(1001) == NULL);
+    idx.clear();
+    ASSERT_TRUE(idx.find(1) == NULL);
+}
+
+TEST(IdIndex, SharedKeys)
+{
+    std::vector<entry> entries;
+    entries.push_back(entry(42, 1));
+    entries.push_back(entry(43, 2));
+    entries.push_back(entry(42, 3));
+    entries.push_back(entry(0xffffffffffffffffULL, 4));
+    id_index<entry> idx;
+    idx.build(entries);
+    uint64_t seen = 0;
+
+    for (const entry* e = idx.find(42); e; e = idx.next(e))
+    {
+        ASSERT_EQ(e->key, 42U);
+        seen |= 1ULL << e->value;
+    }
+
+    ASSERT_EQ(seen, (1ULL << 1) | (1ULL << 3));
+    ASSERT_EQ(idx.find(43)->value, 2U);
+    ASSERT_EQ(idx.find(0xffffffffffffffffULL)->value, 4U);
+}
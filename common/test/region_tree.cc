@@ -0,0 +1,199 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <stdint.h>
+
+// STL
+#include <vector>
+
+// HyperDex
+#include "test/th.h"
+#include "common/region_tree.h"
+
+using hyperdex::region_tree;
+
+namespace
+{
+
+struct box
+{
+    box() : lower_coord(), upper_coord() {}
+    std::vector<uint64_t> lower_coord;
+    std::vector<uint64_t> upper_coord;
+};
+
+// halve "b" along "dim" into itself and a new box at the back of "boxes"
+void
+split(std::vector<box>* boxes, size_t b, size_t dim)
+{
+    box hi((*boxes)[b]);
+    uint64_t mid = (*boxes)[b].lower_coord[dim]
+                 + ((*boxes)[b].upper_coord[dim] - (*boxes)[b].lower_coord[dim]) / 2;
+    (*boxes)[b].upper_coord[dim] = mid;
+    hi.lower_coord[dim] = mid + 1;
+    boxes->push_back(hi);
+}
+
+const box*
+scan(const std::vector<box>& boxes, const std::vector<uint64_t>& coords)
+{
+    for (size_t i = 0; i < boxes.size(); ++i)
+    {
+        bool inside = true;
+
+        for (size_t d = 0; d < coords.size(); ++d)
+        {
+            inside = inside &&
+                     boxes[i].lower_coord[d] <= coords[d] &&
+                     coords[d] <= boxes[i].upper_coord[d];
+        }
+
+        if (inside)
+        {
+            return &boxes[i];
+        }
+    }
+
+    return NULL;
+}
+
+std::vector<const box*>
+pointers(const std::vector<box>& boxes)
+{
+    std::vector<const box*> ptrs;
+
+    for (size_t i = 0; i < boxes.size(); ++i)
+    {
+        ptrs.push_back(&boxes[i]);
+    }
+
+    return ptrs;
+}
+
+} // namespace
+
+TEST(RegionTree, Empty)
+{
+    region_tree<box> tree;
+    ASSERT_TRUE(tree.find(std::vector<uint64_t>(1, 5)) == NULL);
+    tree.build(std::vector<const box*>(), 1);
+    ASSERT_TRUE(tree.find(std::vector<uint64_t>(1, 5)) == NULL);
+    ASSERT_EQ(tree.depth(), 0U);
+}
+
+TEST(RegionTree, Partitions)
+{
+    // one dimension cut into 256 partitions, as a new space is
+    std::vector<box> boxes(1);
+    boxes[0].lower_coord.push_back(0);
+    boxes[0].upper_coord.push_back(UINT64_MAX);
+
+    for (size_t level = 0; level < 8; ++level)
+    {
+        for (size_t b = boxes.size(); b > 0; --b)
+        {
+            split(&boxes, b - 1, 0);
+        }
+    }
+
+    ASSERT_EQ(boxes.size(), 256U);
+    region_tree<box> tree;
+    tree.build(pointers(boxes), 1);
+    ASSERT_EQ(tree.depth(), 9U);
+
+    for (size_t i = 0; i < boxes.size(); ++i)
+    {
+        ASSERT_TRUE(tree.find(boxes[i].lower_coord) == &boxes[i]);
+        ASSERT_TRUE(tree.find(boxes[i].upper_coord) == &boxes[i]);
+    }
+}
+
+TEST(RegionTree, UnevenSplits)
+{
+    // a 4x4 grid in which a few regions split again, so that it no longer
+    // is a grid
+    std::vector<box> boxes(1);
+    boxes[0].lower_coord.resize(2, 0);
+    boxes[0].upper_coord.resize(2, UINT64_MAX);
+    split(&boxes, 0, 0);
+    split(&boxes, 0, 0);
+    split(&boxes, 1, 0);
+
+    for (size_t b = boxes.size(); b > 0; --b)
+    {
+        split(&boxes, b - 1, 1);
+    }
+
+    for (size_t b = boxes.size(); b > 0; --b)
+    {
+        split(&boxes, b - 1, 1);
+    }
+
+    split(&boxes, 5, 0);
+    split(&boxes, 5, 1);
+    split(&boxes, 16, 1);
+    split(&boxes, 9, 0);
+    ASSERT_EQ(boxes.size(), 20U);
+    region_tree<box> tree;
+    tree.build(pointers(boxes), 2);
+    ASSERT_GE(tree.depth(), 5U);
+    ASSERT_TRUE(tree.depth() <= 8U);
+    uint64_t x = 0x9e3779b97f4a7c15ULL;
+
+    for (size_t i = 0; i < 10000; ++i)
+    {
+        std::vector<uint64_t> coords(2);
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        coords[0] = x;
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        coords[1] = x;
+        const box* b = tree.find(coords);
+        ASSERT_TRUE(b != NULL);
+        ASSERT_TRUE(b == scan(boxes, coords));
+    }
+
+    for (size_t i = 0; i < boxes.size(); ++i)
+    {
+        ASSERT_TRUE(tree.find(boxes[i].lower_coord) == &boxes[i]);
+        ASSERT_TRUE(tree.find(boxes[i].upper_coord) == &boxes[i]);
+    }
+}
+
+TEST(RegionTree, WrongDimensions)
+{
+    std::vector<box> boxes(2);
+    boxes[0].lower_coord.push_back(0);
+    boxes[0].upper_coord.push_back(UINT64_MAX);
+    boxes[1].lower_coord.resize(2, 0);
+    boxes[1].upper_coord.resize(2, UINT64_MAX);
+    region_tree<box> tree;
+    tree.build(pointers(boxes), 1);
+    ASSERT_TRUE(tree.find(std::vector<uint64_t>(1, 7)) == &boxes[0]);
+}
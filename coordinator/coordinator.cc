@@ -40,11 +40,34 @@
 #include "coordinator/util.h"
 
 #define ALARM_INTERVAL 30
+#define CONFIG_DELTA_HISTORY 64
+// Snapshots lead with this tag and a format version.  Older snapshots lead
+// with the (random) cluster id and carry no region loads or splits.
+#define SNAPSHOT_MAGIC 0x4844434f4f524401ULL
+#define SNAPSHOT_VERSION 1
+// Split a region once it holds this many bytes or serves this many ops per
+// second.  The two halves of a split merge again when together they fall below
+// 1/REGION_MERGE_FRACTION of both, so that a region does not flap.
+#define REGION_SPLIT_BYTES (1ULL << 30)
+#define REGION_SPLIT_OPS 10000ULL
+#define REGION_MERGE_FRACTION 4ULL
+// A region is split at most this many times over; past that its load is
+// likely one hot key that no split will spread.
+#define REGION_SPLIT_DEPTH 8
+// Servers above CPU_SATURATED thousandths of their processors shed a region
+// to one below CPU_SPARE.  Point leader duty moves once the busiest leader
+// serves LEADER_IMBALANCE percent of the mean.
+#define CPU_SATURATED 850ULL
+#define CPU_SPARE 500ULL
+#define LEADER_IMBALANCE 150ULL
 
 using hyperdex::coordinator;
 using hyperdex::region;
 using hyperdex::region_intent;
+using hyperdex::region_load;
+using hyperdex::region_split;
 using hyperdex::server;
+using hyperdex::server_load;
 using hyperdex::transfer;
 
 // ASSUME:  I'm assuming only one server ever changes state at a time for a
@@ -62,6 +85,15 @@ to_string(const po6::net::location& loc)
     return oss.str();
 }
 
+template <typename T>
+std::string
+packed(const T& t)
+{
+    std::auto_ptr<e::buffer> buf(e::buffer::create(pack_size(t)));
+    buf->pack_at(0) << t;
+    return std::string(reinterpret_cast<const char*>(buf->data()), buf->size());
+}
+
 template <typename T>
 void
 shift_and_pop(size_t idx, std::vector<T>* v)
@@ -140,6 +172,9 @@ coordinator :: coordinator()
     , m_deferred_init()
     , m_offline()
     , m_transfers()
+    , m_loads()
+    , m_server_loads()
+    , m_splits()
     , m_config_ack_through(0)
     , m_config_ack_barrier()
     , m_config_stable_through(0)
@@ -149,6 +184,11 @@ coordinator :: coordinator()
     , m_checkpoint_gc_through(0)
     , m_checkpoint_stable_barrier()
     , m_latest_config()
+    , m_delta_base(0)
+    , m_packed_servers()
+    , m_packed_spaces()
+    , m_packed_regions()
+    , m_config_deltas()
 {
     assert(m_config_ack_through == m_config_ack_barrier.min_version());
     assert(m_config_stable_through == m_config_stable_barrier.min_version());
@@ -485,6 +525,7 @@ coordinator :: server_forget(replicant_state_machine_context* ctx,
     std::stable_sort(m_servers.begin(), m_servers.end());
     remove_permutation(sid);
     remove_offline(sid);
+    remove_id(sid, &m_server_loads);
     rebalance_replica_sets(ctx);
     generate_next_configuration(ctx);
     return generate_response(ctx, COORD_SUCCESS);
@@ -591,6 +632,33 @@ coordinator :: space_rm(replicant_state_machine_context* ctx, const char* name)
             }
         }
 
+        for (size_t i = 0; i < m_loads.size(); )
+        {
+            if (std::binary_search(rids.begin(), rids.end(), m_loads[i].id))
+            {
+                shift_and_pop(i, &m_loads);
+            }
+            else
+            {
+                ++i;
+            }
+        }
+
+        // both halves of a split share a space, and so does every split
+        // that one of them descends from
+        for (size_t i = 0; i < m_splits.size(); )
+        {
+            if (std::binary_search(rids.begin(), rids.end(), m_splits[i].lo) ||
+                std::binary_search(rids.begin(), rids.end(), m_splits[i].hi))
+            {
+                shift_and_pop(i, &m_splits);
+            }
+            else
+            {
+                ++i;
+            }
+        }
+
         remove(sid, &m_deferred_init);
         generate_next_configuration(ctx);
         return generate_response(ctx, COORD_SUCCESS);
@@ -698,6 +766,56 @@ coordinator :: config_get(replicant_state_machine_context* ctx)
     replicant_state_machine_set_response(ctx, output, output_sz);
 }
 
+void
+coordinator :: config_delta(replicant_state_machine_context* ctx, uint64_t version)
+{
+    assert(m_cluster != 0 && m_version != 0);
+    assert(m_latest_config.get());
+    std::list<std::pair<uint64_t, std::string> >::iterator start = m_config_deltas.begin();
+
+    while (start != m_config_deltas.end() && start->first != version)
+    {
+        ++start;
+    }
+
+    size_t sz = 0;
+    uint64_t count = 0;
+
+    for (std::list<std::pair<uint64_t, std::string> >::iterator it = start;
+            it != m_config_deltas.end(); ++it)
+    {
+        sz += it->second.size();
+        ++count;
+    }
+
+    std::auto_ptr<e::buffer> msg;
+
+    if (version == m_version ||
+        (start != m_config_deltas.end() && sz < m_latest_config->size()))
+    {
+        msg.reset(e::buffer::create(sizeof(uint8_t) + 2 * sizeof(uint64_t) + sz));
+        e::buffer::packer pa = msg->pack_at(0);
+        pa = pa << uint8_t(HYPERDEX_CONFIG_DELTAS) << m_cluster << count;
+
+        for (std::list<std::pair<uint64_t, std::string> >::iterator it = start;
+                it != m_config_deltas.end(); ++it)
+        {
+            pa = pa.copy(e::slice(it->second.data(), it->second.size()));
+        }
+    }
+    else
+    {
+        msg.reset(e::buffer::create(sizeof(uint8_t) + m_latest_config->size()));
+        e::buffer::packer pa = msg->pack_at(0);
+        pa = pa << uint8_t(HYPERDEX_CONFIG_FULL);
+        pa.copy(m_latest_config->as_slice());
+    }
+
+    const char* output = reinterpret_cast<const char*>(msg->data());
+    size_t output_sz = msg->size();
+    replicant_state_machine_set_response(ctx, output, output_sz);
+}
+
 void
 coordinator :: config_ack(replicant_state_machine_context* ctx,
                           const server_id& sid, uint64_t version)
@@ -751,11 +869,83 @@ coordinator :: checkpoint_stable(replicant_state_machine_context* ctx,
     generate_response(ctx, COORD_SUCCESS);
 }
 
+void
+coordinator :: region_report(replicant_state_machine_context* ctx,
+                             const server_id& sid, uint64_t cpu,
+                             const std::vector<region_load>& loads)
+{
+    if (!get_server(sid))
+    {
+        return generate_response(ctx, COORD_NOT_FOUND);
+    }
+
+    server_load* sl = get_server_load(sid);
+
+    if (sl)
+    {
+        sl->cpu = cpu;
+    }
+    else
+    {
+        size_t idx = m_server_loads.size();
+        m_server_loads.push_back(server_load(sid, cpu));
+
+        for (; idx > 0; --idx)
+        {
+            if (m_server_loads[idx - 1].id < m_server_loads[idx].id)
+            {
+                break;
+            }
+
+            std::swap(m_server_loads[idx - 1], m_server_loads[idx]);
+        }
+    }
+
+    for (size_t i = 0; i < loads.size(); ++i)
+    {
+        region* reg = get_region(loads[i].id);
+
+        // only the head speaks for a region, so each is counted once
+        if (!reg || reg->replicas.empty() || reg->replicas[0].si != sid)
+        {
+            continue;
+        }
+
+        region_load* rl = get_region_load(loads[i].id);
+
+        if (rl)
+        {
+            *rl = loads[i];
+            continue;
+        }
+
+        size_t idx = m_loads.size();
+        m_loads.push_back(loads[i]);
+
+        for (; idx > 0; --idx)
+        {
+            if (m_loads[idx - 1].id < m_loads[idx].id)
+            {
+                break;
+            }
+
+            std::swap(m_loads[idx - 1], m_loads[idx]);
+        }
+    }
+
+    generate_response(ctx, COORD_SUCCESS);
+}
+
 void
 coordinator :: alarm(replicant_state_machine_context* ctx)
 {
     replicant_state_machine_alarm(ctx, "alarm", ALARM_INTERVAL);
     checkpoint(ctx);
+
+    if (split_or_merge(ctx) || rebalance_load(ctx))
+    {
+        generate_next_configuration(ctx);
+    }
 }
 
 void
@@ -816,6 +1006,31 @@ coordinator :: debug_dump(replicant_state_machine_context* ctx)
                      m_offline[i].id.get(), m_offline[i].sid.get());
     }
 
+    fprintf(log, "region loads:\n");
+
+    for (size_t i = 0; i < m_loads.size(); ++i)
+    {
+        fprintf(log, " - rid=%lu bytes=%lu writes=%lu reads=%lu\n",
+                     m_loads[i].id.get(), m_loads[i].bytes,
+                     m_loads[i].writes, m_loads[i].reads);
+    }
+
+    fprintf(log, "server loads:\n");
+
+    for (size_t i = 0; i < m_server_loads.size(); ++i)
+    {
+        fprintf(log, " - sid=%lu cpu=%lu\n",
+                     m_server_loads[i].id.get(), m_server_loads[i].cpu);
+    }
+
+    fprintf(log, "region splits:\n");
+
+    for (size_t i = 0; i < m_splits.size(); ++i)
+    {
+        fprintf(log, " - rid=%lu lo=%lu hi=%lu\n",
+                     m_splits[i].id.get(), m_splits[i].lo.get(), m_splits[i].hi.get());
+    }
+
     fprintf(log, "config ack through: %lu\n", m_config_ack_through);
     fprintf(log, "config stable through: %lu\n", m_config_stable_through);
     fprintf(log, "checkpoint: latest=%lu, stable=%lu, gc=%lu\n",
@@ -836,10 +1051,31 @@ coordinator :: recreate(replicant_state_machine_context* ctx,
     }
 
     e::unpacker up(data, data_sz);
+    uint64_t magic = 0;
+    uint8_t version = 0;
+
+    if (!(e::unpacker(data, data_sz) >> magic).error() && magic == SNAPSHOT_MAGIC)
+    {
+        up = up >> magic >> version;
+    }
+
+    if (version > SNAPSHOT_VERSION)
+    {
+        fprintf(replicant_state_machine_log_stream(ctx),
+                "cannot recreate from snapshot version %u\n", unsigned(version));
+        return NULL;
+    }
+
     up = up >> c->m_cluster >> c->m_counter >> c->m_version >> c->m_flags >> c->m_servers
             >> c->m_permutation >> c->m_spares >> c->m_desired_spares >> c->m_intents
-            >> c->m_deferred_init >> c->m_offline >> c->m_transfers
-            >> c->m_config_ack_through >> c->m_config_ack_barrier
+            >> c->m_deferred_init >> c->m_offline >> c->m_transfers;
+
+    if (version >= 1)
+    {
+        up = up >> c->m_loads >> c->m_server_loads >> c->m_splits;
+    }
+
+    up = up >> c->m_config_ack_through >> c->m_config_ack_barrier
             >> c->m_config_stable_through >> c->m_config_stable_barrier
             >> c->m_checkpoint >> c->m_checkpoint_stable_through
             >> c->m_checkpoint_gc_through >> c->m_checkpoint_stable_barrier;
@@ -867,7 +1103,9 @@ void
 coordinator :: snapshot(replicant_state_machine_context* /*ctx*/,
                         const char** data, size_t* data_sz)
 {
-    size_t sz = sizeof(m_cluster)
+    size_t sz = sizeof(uint64_t)
+              + sizeof(uint8_t)
+              + sizeof(m_cluster)
               + sizeof(m_counter)
               + sizeof(m_version)
               + sizeof(m_flags)
@@ -879,6 +1117,9 @@ coordinator :: snapshot(replicant_state_machine_context* /*ctx*/,
               + pack_size(m_deferred_init)
               + pack_size(m_offline)
               + pack_size(m_transfers)
+              + pack_size(m_loads)
+              + pack_size(m_server_loads)
+              + pack_size(m_splits)
               + sizeof(m_config_ack_through)
               + pack_size(m_config_ack_barrier)
               + sizeof(m_config_stable_through)
@@ -897,9 +1138,11 @@ coordinator :: snapshot(replicant_state_machine_context* /*ctx*/,
 
     std::auto_ptr<e::buffer> buf(e::buffer::create(sz));
     e::buffer::packer pa = buf->pack_at(0);
-    pa = pa << m_cluster << m_counter << m_version << m_flags << m_servers
+    pa = pa << uint64_t(SNAPSHOT_MAGIC) << uint8_t(SNAPSHOT_VERSION)
+            << m_cluster << m_counter << m_version << m_flags << m_servers
             << m_permutation << m_spares << m_desired_spares << m_intents
             << m_deferred_init << m_offline << m_transfers
+            << m_loads << m_server_loads << m_splits
             << m_config_ack_through << m_config_ack_barrier
             << m_config_stable_through << m_config_stable_barrier
             << m_checkpoint << m_checkpoint_stable_through
@@ -1500,6 +1743,537 @@ coordinator :: remove_offline(const server_id& sid)
     }
 }
 
+region_load*
+coordinator :: get_region_load(const region_id& rid)
+{
+    for (size_t i = 0; i < m_loads.size(); ++i)
+    {
+        if (m_loads[i].id == rid)
+        {
+            return &m_loads[i];
+        }
+    }
+
+    return NULL;
+}
+
+server_load*
+coordinator :: get_server_load(const server_id& sid)
+{
+    for (size_t i = 0; i < m_server_loads.size(); ++i)
+    {
+        if (m_server_loads[i].id == sid)
+        {
+            return &m_server_loads[i];
+        }
+    }
+
+    return NULL;
+}
+
+bool
+coordinator :: rebalance_load(replicant_state_machine_context* ctx)
+{
+    // Make one move at a time and wait for it to finish, so that the next
+    // is judged on reports that reflect it.
+    if ((m_flags & HYPERDEX_CONFIG_READ_ONLY) ||
+        !m_intents.empty() || !m_transfers.empty())
+    {
+        return false;
+    }
+
+    return offload_saturated(ctx) || spread_point_leaders(ctx);
+}
+
+bool
+coordinator :: offload_saturated(replicant_state_machine_context* ctx)
+{
+    FILE* log = replicant_state_machine_log_stream(ctx);
+    server_id hot;
+    uint64_t hot_cpu = 0;
+    server_id cool;
+    uint64_t cool_cpu = CPU_SPARE + 1;
+
+    for (size_t i = 0; i < m_server_loads.size(); ++i)
+    {
+        const server_load& sl(m_server_loads[i]);
+        server* s = get_server(sl.id);
+
+        if (!s || s->state != server::AVAILABLE || !in_permutation(sl.id))
+        {
+            continue;
+        }
+
+        if (sl.cpu >= CPU_SATURATED && sl.cpu > hot_cpu)
+        {
+            hot = sl.id;
+            hot_cpu = sl.cpu;
+        }
+
+        if (sl.cpu < cool_cpu)
+        {
+            cool = sl.id;
+            cool_cpu = sl.cpu;
+        }
+    }
+
+    if (hot == server_id() || cool == server_id())
+    {
+        return false;
+    }
+
+    // the busiest region on the hot server that the cool one lacks
+    region* best = NULL;
+    uint64_t best_ops = 0;
+
+    for (space_map_t::iterator it = m_spaces.begin();
+            it != m_spaces.end(); ++it)
+    {
+        space& s(*it->second);
+
+        for (size_t i = 0; i < s.subspaces.size(); ++i)
+        {
+            for (size_t j = 0; j < s.subspaces[i].regions.size(); ++j)
+            {
+                region& reg(s.subspaces[i].regions[j]);
+                region_load* rl = get_region_load(reg.id);
+                bool has_hot = false;
+                bool has_cool = false;
+
+                for (size_t k = 0; k < reg.replicas.size(); ++k)
+                {
+                    has_hot = has_hot || reg.replicas[k].si == hot;
+                    has_cool = has_cool || reg.replicas[k].si == cool;
+                }
+
+                if (rl && has_hot && !has_cool &&
+                    rl->writes + rl->reads > best_ops && settled(reg))
+                {
+                    best = &reg;
+                    best_ops = rl->writes + rl->reads;
+                }
+            }
+        }
+    }
+
+    if (!best)
+    {
+        return false;
+    }
+
+    region_intent* ri = new_region_intent(best->id);
+
+    for (size_t i = 0; i < best->replicas.size(); ++i)
+    {
+        ri->replicas.push_back(best->replicas[i].si == hot ? cool : best->replicas[i].si);
+    }
+
+    fprintf(log, "moving region(%lu) with %lu ops/s from server(%lu) at %lu/1000 cpu "
+                 "to server(%lu) at %lu/1000 cpu\n",
+                 best->id.get(), best_ops, hot.get(), hot_cpu, cool.get(), cool_cpu);
+    // act on neither server again until both report after the move
+    remove_id(best->id, &m_loads);
+    remove_id(hot, &m_server_loads);
+    remove_id(cool, &m_server_loads);
+    converge_intent(ctx, best, ri);
+    return true;
+}
+
+bool
+coordinator :: spread_point_leaders(replicant_state_machine_context* ctx)
+{
+    FILE* log = replicant_state_machine_log_stream(ctx);
+    // the reads and writes each server handles as the head of a chain
+    std::map<server_id, uint64_t> led;
+    uint64_t total = 0;
+
+    for (size_t i = 0; i < m_permutation.size(); ++i)
+    {
+        server* s = get_server(m_permutation[i]);
+
+        if (s && s->state == server::AVAILABLE)
+        {
+            led[m_permutation[i]] = 0;
+        }
+    }
+
+    for (size_t i = 0; i < m_loads.size(); ++i)
+    {
+        region* reg = get_region(m_loads[i].id);
+
+        if (!reg || reg->replicas.empty() || led.find(reg->replicas[0].si) == led.end())
+        {
+            continue;
+        }
+
+        led[reg->replicas[0].si] += m_loads[i].writes + m_loads[i].reads;
+        total += m_loads[i].writes + m_loads[i].reads;
+    }
+
+    server_id busiest;
+    uint64_t busiest_ops = 0;
+
+    for (std::map<server_id, uint64_t>::iterator it = led.begin();
+            it != led.end(); ++it)
+    {
+        if (it->second > busiest_ops)
+        {
+            busiest = it->first;
+            busiest_ops = it->second;
+        }
+    }
+
+    if (led.empty() || busiest_ops * 100 <= LEADER_IMBALANCE * (total / led.size()))
+    {
+        return false;
+    }
+
+    // Hand one of its regions to the member of that region's chain for
+    // which the busier of the two servers ends up least busy.
+    region* best = NULL;
+    size_t best_idx = 0;
+    uint64_t best_peak = busiest_ops;
+
+    for (size_t i = 0; i < m_loads.size(); ++i)
+    {
+        region* reg = get_region(m_loads[i].id);
+        uint64_t ops = m_loads[i].writes + m_loads[i].reads;
+
+        if (!reg || reg->replicas.size() < 2 ||
+            reg->replicas[0].si != busiest || !settled(*reg))
+        {
+            continue;
+        }
+
+        for (size_t j = 1; j < reg->replicas.size(); ++j)
+        {
+            std::map<server_id, uint64_t>::iterator other = led.find(reg->replicas[j].si);
+
+            if (other == led.end())
+            {
+                continue;
+            }
+
+            uint64_t peak = std::max(busiest_ops - ops, other->second + ops);
+
+            if (peak < best_peak)
+            {
+                best = reg;
+                best_idx = j;
+                best_peak = peak;
+            }
+        }
+    }
+
+    if (!best)
+    {
+        return false;
+    }
+
+    // rotating the chain keeps the order of the rest of it
+    region_intent* ri = new_region_intent(best->id);
+
+    for (size_t i = 0; i < best->replicas.size(); ++i)
+    {
+        ri->replicas.push_back(best->replicas[(best_idx + i) % best->replicas.size()].si);
+    }
+
+    fprintf(log, "moving point leader duty for region(%lu) from server(%lu) "
+                 "to server(%lu) to spread %lu ops/s against a mean of %lu\n",
+                 best->id.get(), busiest.get(), ri->replicas[0].get(),
+                 busiest_ops, total / led.size());
+    remove_id(best->id, &m_loads);
+    converge_intent(ctx, best, ri);
+    return true;
+}
+
+bool
+coordinator :: locate_region(const region_id& rid, subspace** ss, size_t* idx)
+{
+    for (space_map_t::iterator it = m_spaces.begin();
+            it != m_spaces.end(); ++it)
+    {
+        space& s(*it->second);
+
+        for (size_t i = 0; i < s.subspaces.size(); ++i)
+        {
+            for (size_t j = 0; j < s.subspaces[i].regions.size(); ++j)
+            {
+                if (s.subspaces[i].regions[j].id == rid)
+                {
+                    *ss = &s.subspaces[i];
+                    *idx = j;
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+bool
+coordinator :: settled(const region& reg)
+{
+    if (reg.replicas.empty() ||
+        get_transfer(reg.id) ||
+        get_region_intent(reg.id))
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < m_offline.size(); ++i)
+    {
+        if (m_offline[i].id == reg.id)
+        {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < reg.replicas.size(); ++i)
+    {
+        server* s = get_server(reg.replicas[i].si);
+
+        if (!s || s->state != server::AVAILABLE)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+unsigned
+coordinator :: split_depth(region_id rid)
+{
+    unsigned depth = 0;
+
+    for (size_t i = 0; i < m_splits.size(); )
+    {
+        if (m_splits[i].lo == rid || m_splits[i].hi == rid)
+        {
+            rid = m_splits[i].id;
+            ++depth;
+            i = 0;
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    return depth;
+}
+
+bool
+coordinator :: split_or_merge(replicant_state_machine_context* ctx)
+{
+    // a bulk load needs the regions to hold still
+    if ((m_flags & HYPERDEX_CONFIG_READ_ONLY))
+    {
+        return false;
+    }
+
+    for (space_map_t::iterator it = m_spaces.begin();
+            it != m_spaces.end(); ++it)
+    {
+        space& s(*it->second);
+
+        for (size_t i = 0; i < s.subspaces.size(); ++i)
+        {
+            subspace& ss(s.subspaces[i]);
+
+            for (size_t j = 0; j < ss.regions.size(); ++j)
+            {
+                region& reg(ss.regions[j]);
+                region_load* rl = get_region_load(reg.id);
+
+                if (!rl || !settled(reg) ||
+                    (rl->bytes < REGION_SPLIT_BYTES &&
+                     rl->writes + rl->reads < REGION_SPLIT_OPS))
+                {
+                    continue;
+                }
+
+                bool wide = false;
+
+                for (size_t a = 0; a < reg.lower_coord.size(); ++a)
+                {
+                    wide = wide || reg.lower_coord[a] < reg.upper_coord[a];
+                }
+
+                if (wide && split_depth(reg.id) < REGION_SPLIT_DEPTH)
+                {
+                    split_region(ctx, &ss, j);
+                    return true;
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < m_splits.size(); ++i)
+    {
+        if (merge_regions(ctx, i))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void
+coordinator :: split_region(replicant_state_machine_context* ctx,
+                            subspace* ss, size_t idx)
+{
+    FILE* log = replicant_state_machine_log_stream(ctx);
+    region parent(ss->regions[idx]);
+    size_t dim = 0;
+
+    // halve the region along its widest side
+    for (size_t a = 1; a < parent.lower_coord.size(); ++a)
+    {
+        if (parent.upper_coord[a] - parent.lower_coord[a] >
+            parent.upper_coord[dim] - parent.lower_coord[dim])
+        {
+            dim = a;
+        }
+    }
+
+    uint64_t mid = parent.lower_coord[dim]
+                 + (parent.upper_coord[dim] - parent.lower_coord[dim]) / 2;
+    region lo(parent);
+    lo.id = region_id(m_counter);
+    ++m_counter;
+    lo.upper_coord[dim] = mid;
+    region hi(parent);
+    hi.id = region_id(m_counter);
+    ++m_counter;
+    hi.lower_coord[dim] = mid + 1;
+    ss->regions[idx] = lo;
+    ss->regions.insert(ss->regions.begin() + idx + 1, hi);
+    m_splits.push_back(region_split(parent.id, lo.id, hi.id));
+    remove_id(parent.id, &m_loads);
+    fprintf(log, "splitting region(%lu) into region(%lu) and region(%lu) "
+                 "along dimension %lu\n",
+                 parent.id.get(), lo.id.get(), hi.id.get(), dim);
+    reseed(&ss->regions[idx]);
+    reseed(&ss->regions[idx + 1]);
+}
+
+bool
+coordinator :: merge_regions(replicant_state_machine_context* ctx,
+                             size_t split_idx)
+{
+    FILE* log = replicant_state_machine_log_stream(ctx);
+    region_split split(m_splits[split_idx]);
+    subspace* ss = NULL;
+    size_t lo_idx = 0;
+    size_t hi_idx = 0;
+
+    // either half may since have split again
+    if (!locate_region(split.lo, &ss, &lo_idx) ||
+        !locate_region(split.hi, &ss, &hi_idx))
+    {
+        return false;
+    }
+
+    region_load* lo_load = get_region_load(split.lo);
+    region_load* hi_load = get_region_load(split.hi);
+
+    if (!lo_load || !hi_load ||
+        (lo_load->bytes + hi_load->bytes) * REGION_MERGE_FRACTION >= REGION_SPLIT_BYTES ||
+        (lo_load->writes + lo_load->reads + hi_load->writes + hi_load->reads)
+            * REGION_MERGE_FRACTION >= REGION_SPLIT_OPS ||
+        !settled(ss->regions[lo_idx]))
+    {
+        return false;
+    }
+
+    std::vector<server_id> servers;
+
+    for (size_t i = 0; i < ss->regions[lo_idx].replicas.size(); ++i)
+    {
+        servers.push_back(ss->regions[lo_idx].replicas[i].si);
+    }
+
+    region* hi = &ss->regions[hi_idx];
+    bool same = hi->replicas.size() == servers.size();
+
+    for (size_t i = 0; same && i < servers.size(); ++i)
+    {
+        same = hi->replicas[i].si == servers[i];
+    }
+
+    // the halves can only merge where both live; move "hi" next to "lo"
+    // first, and merge on a later alarm once the transfers are done
+    if (!same)
+    {
+        if (get_region_intent(hi->id) || get_transfer(hi->id))
+        {
+            return false;
+        }
+
+        region_intent* ri = new_region_intent(hi->id);
+        ri->replicas = servers;
+        fprintf(log, "moving region(%lu) to the servers of region(%lu) "
+                     "so that they may merge\n",
+                     hi->id.get(), split.lo.get());
+        converge_intent(ctx, hi, ri);
+        return true;
+    }
+
+    if (!settled(*hi))
+    {
+        return false;
+    }
+
+    region merged(ss->regions[lo_idx]);
+    merged.id = region_id(m_counter);
+    ++m_counter;
+    merged.upper_coord = hi->upper_coord;
+    ss->regions[lo_idx] = merged;
+    ss->regions.erase(ss->regions.begin() + hi_idx);
+    lo_idx = lo_idx < hi_idx ? lo_idx : lo_idx - 1;
+    shift_and_pop(split_idx, &m_splits);
+    remove_id(split.lo, &m_loads);
+    remove_id(split.hi, &m_loads);
+
+    // the merged region stands in for the one that was split
+    for (size_t i = 0; i < m_splits.size(); ++i)
+    {
+        if (m_splits[i].lo == split.id)
+        {
+            m_splits[i].lo = merged.id;
+        }
+
+        if (m_splits[i].hi == split.id)
+        {
+            m_splits[i].hi = merged.id;
+        }
+    }
+
+    fprintf(log, "merging region(%lu) and region(%lu) into region(%lu)\n",
+                 split.lo.get(), split.hi.get(), merged.id.get());
+    reseed(&ss->regions[lo_idx]);
+    return true;
+}
+
+void
+coordinator :: reseed(region* reg)
+{
+    // The region keeps its whole chain, and each server moves its own copy
+    // of the old regions' objects into it, so a split or merge never leaves
+    // the data on fewer servers than before.  The region is new, so every
+    // replica gets a new virtual server; chain operations in flight on the
+    // old regions are dropped, and their clients retry against the new one.
+    for (size_t i = 0; i < reg->replicas.size(); ++i)
+    {
+        reg->replicas[i].vsi = virtual_server_id(m_counter);
+        ++m_counter;
+    }
+}
+
 transfer*
 coordinator :: new_transfer(region* reg,
                             const server_id& sid)
@@ -1665,6 +2439,178 @@ coordinator :: generate_cached_configuration(replicant_state_machine_context*)
     }
 
     m_latest_config = new_config;
+    generate_config_delta();
+}
+
+void
+coordinator :: generate_config_delta()
+{
+    std::map<uint64_t, std::string> servers;
+    std::map<uint64_t, std::string> spaces;
+    std::map<uint64_t, std::string> regions;
+
+    for (size_t i = 0; i < m_servers.size(); ++i)
+    {
+        servers[m_servers[i].id.get()] = packed(m_servers[i]);
+    }
+
+    for (space_map_t::iterator it = m_spaces.begin(); it != m_spaces.end(); ++it)
+    {
+        space skel(*it->second);
+
+        for (size_t i = 0; i < skel.subspaces.size(); ++i)
+        {
+            for (size_t j = 0; j < skel.subspaces[i].regions.size(); ++j)
+            {
+                region& reg(skel.subspaces[i].regions[j]);
+                regions[reg.id.get()] = packed(reg);
+                reg.replicas.clear();
+            }
+        }
+
+        spaces[skel.id.get()] = packed(skel);
+    }
+
+    // a delta is only meaningful against the version right before this one;
+    // after a restore from snapshot the history starts over
+    if (m_delta_base == 0 || m_delta_base + 1 != m_version)
+    {
+        m_config_deltas.clear();
+    }
+    else
+    {
+        std::vector<uint64_t> servers_rm;
+        std::vector<const std::string*> servers_set;
+        std::vector<uint64_t> spaces_rm;
+        std::vector<std::string> spaces_set;
+        std::vector<const std::string*> regions_set;
+        std::map<uint64_t, std::string>::iterator old;
+        size_t sz = 10 * sizeof(uint64_t);
+
+        for (old = m_packed_servers.begin(); old != m_packed_servers.end(); ++old)
+        {
+            if (servers.find(old->first) == servers.end())
+            {
+                servers_rm.push_back(old->first);
+                sz += sizeof(uint64_t);
+            }
+        }
+
+        for (std::map<uint64_t, std::string>::iterator it = servers.begin();
+                it != servers.end(); ++it)
+        {
+            old = m_packed_servers.find(it->first);
+
+            if (old == m_packed_servers.end() || old->second != it->second)
+            {
+                servers_set.push_back(&it->second);
+                sz += it->second.size();
+            }
+        }
+
+        for (old = m_packed_spaces.begin(); old != m_packed_spaces.end(); ++old)
+        {
+            if (spaces.find(old->first) == spaces.end())
+            {
+                spaces_rm.push_back(old->first);
+                sz += sizeof(uint64_t);
+            }
+        }
+
+        for (space_map_t::iterator it = m_spaces.begin(); it != m_spaces.end(); ++it)
+        {
+            space& s(*it->second);
+            old = m_packed_spaces.find(s.id.get());
+
+            // anything but replicas changed:  send the space whole
+            if (old == m_packed_spaces.end() || old->second != spaces[s.id.get()])
+            {
+                spaces_set.push_back(packed(s));
+                sz += spaces_set.back().size();
+                continue;
+            }
+
+            for (size_t i = 0; i < s.subspaces.size(); ++i)
+            {
+                for (size_t j = 0; j < s.subspaces[i].regions.size(); ++j)
+                {
+                    uint64_t rid = s.subspaces[i].regions[j].id.get();
+                    const std::string& reg(regions[rid]);
+                    old = m_packed_regions.find(rid);
+
+                    if (old == m_packed_regions.end() || old->second != reg)
+                    {
+                        regions_set.push_back(&reg);
+                        sz += reg.size();
+                    }
+                }
+            }
+        }
+
+        for (size_t i = 0; i < m_transfers.size(); ++i)
+        {
+            sz += pack_size(m_transfers[i]);
+        }
+
+        std::auto_ptr<e::buffer> delta(e::buffer::create(sz));
+        e::buffer::packer pa = delta->pack_at(0);
+        pa = pa << m_delta_base << m_version << m_flags
+                << uint64_t(servers_rm.size());
+
+        for (size_t i = 0; i < servers_rm.size(); ++i)
+        {
+            pa = pa << servers_rm[i];
+        }
+
+        pa = pa << uint64_t(servers_set.size());
+
+        for (size_t i = 0; i < servers_set.size(); ++i)
+        {
+            pa = pa.copy(e::slice(servers_set[i]->data(), servers_set[i]->size()));
+        }
+
+        pa = pa << uint64_t(spaces_rm.size());
+
+        for (size_t i = 0; i < spaces_rm.size(); ++i)
+        {
+            pa = pa << spaces_rm[i];
+        }
+
+        pa = pa << uint64_t(spaces_set.size());
+
+        for (size_t i = 0; i < spaces_set.size(); ++i)
+        {
+            pa = pa.copy(e::slice(spaces_set[i].data(), spaces_set[i].size()));
+        }
+
+        pa = pa << uint64_t(regions_set.size());
+
+        for (size_t i = 0; i < regions_set.size(); ++i)
+        {
+            pa = pa.copy(e::slice(regions_set[i]->data(), regions_set[i]->size()));
+        }
+
+        pa = pa << uint64_t(m_transfers.size());
+
+        for (size_t i = 0; i < m_transfers.size(); ++i)
+        {
+            pa = pa << m_transfers[i];
+        }
+
+        assert(!pa.error());
+        m_config_deltas.push_back(std::make_pair(m_delta_base,
+                    std::string(reinterpret_cast<const char*>(delta->data()), delta->size())));
+
+        while (m_config_deltas.size() > CONFIG_DELTA_HISTORY)
+        {
+            m_config_deltas.pop_front();
+        }
+    }
+
+    m_delta_base = m_version;
+    m_packed_servers.swap(servers);
+    m_packed_spaces.swap(spaces);
+    m_packed_regions.swap(regions);
 }
 
 void
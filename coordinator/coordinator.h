@@ -29,6 +29,7 @@
 #define hyperdex_coordinator_coordinator_h_
 
 // STL
+#include <list>
 #include <map>
 #include <tr1/memory>
 
@@ -46,8 +47,11 @@
 #include "common/transfer.h"
 #include "coordinator/offline_server.h"
 #include "coordinator/region_intent.h"
+#include "coordinator/region_load.h"
+#include "coordinator/region_split.h"
 #include "coordinator/replica_sets.h"
 #include "coordinator/server_barrier.h"
+#include "coordinator/server_load.h"
 
 BEGIN_HYPERDEX_NAMESPACE
 
@@ -101,9 +105,18 @@ class coordinator
                                uint64_t version,
                                const transfer_id& xid);
 
+    // load management
+    public:
+        void region_report(replicant_state_machine_context* ctx,
+                           const server_id& sid, uint64_t cpu,
+                           const std::vector<region_load>& loads);
+
     // config management
     public:
         void config_get(replicant_state_machine_context* ctx);
+        // the changes since "version", or the whole configuration if they
+        // are no longer on hand or would be larger
+        void config_delta(replicant_state_machine_context* ctx, uint64_t version);
         void config_ack(replicant_state_machine_context* ctx,
                         const server_id& sid, uint64_t version);
         void config_stable(replicant_state_machine_context* ctx,
@@ -166,6 +179,31 @@ class coordinator
         void del_region_intent(const region_id& rid);
         void remove_offline(const region_id& rid);
         void remove_offline(const server_id& sid);
+        // load
+        region_load* get_region_load(const region_id& rid);
+        server_load* get_server_load(const server_id& sid);
+        // make one placement change toward even load; true if the
+        // configuration changed
+        bool rebalance_load(replicant_state_machine_context* ctx);
+        // replace a saturated server in its busiest region with an idle one
+        bool offload_saturated(replicant_state_machine_context* ctx);
+        // rotate a chain so that its point leader duty moves from the
+        // busiest leader to a less busy member of the chain
+        bool spread_point_leaders(replicant_state_machine_context* ctx);
+        // splits
+        bool locate_region(const region_id& rid, subspace** ss, size_t* idx);
+        bool settled(const region& reg);
+        // the number of splits between "rid" and the regions it came from
+        unsigned split_depth(region_id rid);
+        // split one region that is too large or too busy, or merge a pair of
+        // cold siblings; true if the configuration changed
+        bool split_or_merge(replicant_state_machine_context* ctx);
+        void split_region(replicant_state_machine_context* ctx,
+                          subspace* ss, size_t idx);
+        bool merge_regions(replicant_state_machine_context* ctx,
+                           size_t split_idx);
+        // give each replica of the new region "reg" a fresh virtual server
+        void reseed(region* reg);
         // transfers
         transfer* new_transfer(region* reg, const server_id& si);
         transfer* get_transfer(const region_id& rid);
@@ -176,6 +214,7 @@ class coordinator
         void check_stable_condition(replicant_state_machine_context* ctx);
         void generate_next_configuration(replicant_state_machine_context* ctx);
         void generate_cached_configuration(replicant_state_machine_context* ctx);
+        void generate_config_delta();
         void servers_in_configuration(std::vector<server_id>* sids);
         void regions_in_space(space_ptr s, std::vector<region_id>* rids);
         // checkpoints
@@ -201,6 +240,10 @@ class coordinator
         std::vector<offline_server> m_offline;
         // transfers
         std::vector<transfer> m_transfers;
+        // load, sorted by region or server
+        std::vector<region_load> m_loads;
+        std::vector<server_load> m_server_loads;
+        std::vector<region_split> m_splits;
         // barriers
         uint64_t m_config_ack_through;
         server_barrier m_config_ack_barrier;
@@ -213,6 +256,15 @@ class coordinator
         server_barrier m_checkpoint_stable_barrier;
         // cached config
         std::auto_ptr<e::buffer> m_latest_config;
+        // the configuration as of m_delta_base in packed pieces (spaces
+        // without their replicas), to diff the next one against
+        uint64_t m_delta_base;
+        std::map<uint64_t, std::string> m_packed_servers;
+        std::map<uint64_t, std::string> m_packed_spaces;
+        std::map<uint64_t, std::string> m_packed_regions;
+        // the most recent deltas, oldest first, keyed by the version each
+        // applies to; not part of the snapshot
+        std::list<std::pair<uint64_t, std::string> > m_config_deltas;
 
     private:
         coordinator(const coordinator&);
@@ -0,0 +1,107 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_coordinator_region_load_h_
+#define hyperdex_coordinator_region_load_h_
+
+// HyperDex
+#include "namespace.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// The most recent report from a region's head of how large and how busy the
+// region is.
+class region_load
+{
+    public:
+        region_load();
+        region_load(const region_load&);
+
+    public:
+        region_load& operator = (const region_load&);
+
+    public:
+        region_id id;
+        uint64_t bytes;
+        // ops per second
+        uint64_t writes;
+        uint64_t reads;
+};
+
+inline size_t
+pack_size(const region_load& rl)
+{
+    return pack_size(rl.id) + sizeof(rl.bytes) + sizeof(rl.writes) + sizeof(rl.reads);
+}
+
+inline e::buffer::packer
+operator << (e::buffer::packer pa, const region_load& rl)
+{
+    return pa << rl.id << rl.bytes << rl.writes << rl.reads;
+}
+
+inline e::unpacker
+operator >> (e::unpacker up, region_load& rl)
+{
+    return up >> rl.id >> rl.bytes >> rl.writes >> rl.reads;
+}
+
+inline
+region_load :: region_load()
+    : id()
+    , bytes(0)
+    , writes(0)
+    , reads(0)
+{
+}
+
+inline
+region_load :: region_load(const region_load& other)
+    : id(other.id)
+    , bytes(other.bytes)
+    , writes(other.writes)
+    , reads(other.reads)
+{
+}
+
+inline region_load&
+region_load :: operator = (const region_load& rhs)
+{
+    if (this != &rhs)
+    {
+        id = rhs.id;
+        bytes = rhs.bytes;
+        writes = rhs.writes;
+        reads = rhs.reads;
+    }
+
+    return *this;
+}
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_coordinator_region_load_h_
@@ -0,0 +1,95 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_coordinator_region_split_h_
+#define hyperdex_coordinator_region_split_h_
+
+// HyperDex
+#include "namespace.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// Region "id" was split into "lo" and "hi", which may merge back into one
+// region covering the same box.
+class region_split
+{
+    public:
+        region_split();
+        region_split(const region_id& id, const region_id& lo, const region_id& hi);
+        region_split(const region_split& other);
+
+    public:
+        region_id id;
+        region_id lo;
+        region_id hi;
+};
+
+inline size_t
+pack_size(const region_split& rs)
+{
+    return pack_size(rs.id) + pack_size(rs.lo) + pack_size(rs.hi);
+}
+
+inline e::buffer::packer
+operator << (e::buffer::packer pa, const region_split& rs)
+{
+    return pa << rs.id << rs.lo << rs.hi;
+}
+
+inline e::unpacker
+operator >> (e::unpacker up, region_split& rs)
+{
+    return up >> rs.id >> rs.lo >> rs.hi;
+}
+
+inline
+region_split :: region_split()
+    : id()
+    , lo()
+    , hi()
+{
+}
+
+inline
+region_split :: region_split(const region_id& _id, const region_id& _lo, const region_id& _hi)
+    : id(_id)
+    , lo(_lo)
+    , hi(_hi)
+{
+}
+
+inline
+region_split :: region_split(const region_split& other)
+    : id(other.id)
+    , lo(other.lo)
+    , hi(other.hi)
+{
+}
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_coordinator_region_split_h_
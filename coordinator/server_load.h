@@ -0,0 +1,91 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_coordinator_server_load_h_
+#define hyperdex_coordinator_server_load_h_
+
+// HyperDex
+#include "namespace.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// The most recent report of how busy a server is.
+class server_load
+{
+    public:
+        server_load();
+        server_load(const server_id& id, uint64_t cpu);
+        server_load(const server_load& other);
+
+    public:
+        server_id id;
+        // thousandths of the server's processors
+        uint64_t cpu;
+};
+
+inline size_t
+pack_size(const server_load& sl)
+{
+    return pack_size(sl.id) + sizeof(sl.cpu);
+}
+
+inline e::buffer::packer
+operator << (e::buffer::packer pa, const server_load& sl)
+{
+    return pa << sl.id << sl.cpu;
+}
+
+inline e::unpacker
+operator >> (e::unpacker up, server_load& sl)
+{
+    return up >> sl.id >> sl.cpu;
+}
+
+inline
+server_load :: server_load()
+    : id()
+    , cpu(0)
+{
+}
+
+inline
+server_load :: server_load(const server_id& _id, uint64_t _cpu)
+    : id(_id)
+    , cpu(_cpu)
+{
+}
+
+inline
+server_load :: server_load(const server_load& other)
+    : id(other.id)
+    , cpu(other.cpu)
+{
+}
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_coordinator_server_load_h_
@@ -42,6 +42,7 @@ struct replicant_state_machine HYPERDEX_API rsm = {
     hyperdex_coordinator_destroy,
     hyperdex_coordinator_snapshot,
     {{"config_get", hyperdex_coordinator_config_get},
+     {"config_delta", hyperdex_coordinator_config_delta},
      {"config_ack", hyperdex_coordinator_config_ack},
      {"config_stable", hyperdex_coordinator_config_stable},
      {"server_register", hyperdex_coordinator_server_register},
@@ -56,6 +57,7 @@ struct replicant_state_machine HYPERDEX_API rsm = {
      {"transfer_go_live", hyperdex_coordinator_transfer_go_live},
      {"transfer_complete", hyperdex_coordinator_transfer_complete},
      {"checkpoint_stable", hyperdex_coordinator_checkpoint_stable},
+     {"region_report", hyperdex_coordinator_region_report},
      {"alarm", hyperdex_coordinator_alarm},
      {"read_only", hyperdex_coordinator_read_only},
      {"fault_tolerance", hyperdex_coordinator_fault_tolerance},
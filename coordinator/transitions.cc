@@ -202,6 +202,20 @@ hyperdex_coordinator_config_get(struct replicant_state_machine_context* ctx,
     c->config_get(ctx);
 }
 
+void
+hyperdex_coordinator_config_delta(struct replicant_state_machine_context* ctx,
+                                  void* obj, const char* data, size_t data_sz)
+{
+    PROTECT_UNINITIALIZED;
+    FILE* log = replicant_state_machine_log_stream(ctx);
+    coordinator* c = static_cast<coordinator*>(obj);
+    uint64_t version;
+    e::unpacker up(data, data_sz);
+    up = up >> version;
+    CHECK_UNPACK(config_delta);
+    c->config_delta(ctx, version);
+}
+
 void
 hyperdex_coordinator_config_ack(struct replicant_state_machine_context* ctx,
                                 void* obj, const char* data, size_t data_sz)
@@ -419,6 +433,30 @@ hyperdex_coordinator_checkpoint_stable(struct replicant_state_machine_context* c
     c->checkpoint_stable(ctx, sid, config, checkpoint);
 }
 
+void
+hyperdex_coordinator_region_report(struct replicant_state_machine_context* ctx,
+                                   void* obj, const char* data, size_t data_sz)
+{
+    PROTECT_UNINITIALIZED;
+    FILE* log = replicant_state_machine_log_stream(ctx);
+    coordinator* c = static_cast<coordinator*>(obj);
+    server_id sid;
+    uint64_t cpu;
+    std::vector<region_load> loads;
+    e::unpacker up(data, data_sz);
+    up = up >> sid >> cpu;
+
+    while (!up.error() && up.remain())
+    {
+        region_load rl;
+        up = up >> rl;
+        loads.push_back(rl);
+    }
+
+    CHECK_UNPACK(region_report);
+    c->region_report(ctx, sid, cpu, loads);
+}
+
 void
 hyperdex_coordinator_alarm(struct replicant_state_machine_context* ctx,
                            void* obj, const char*, size_t)
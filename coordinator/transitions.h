@@ -61,6 +61,7 @@ TRANSITION(read_only);
 TRANSITION(fault_tolerance);
 
 TRANSITION(config_get);
+TRANSITION(config_delta);
 TRANSITION(config_ack);
 TRANSITION(config_stable);
 
@@ -80,6 +81,8 @@ TRANSITION(transfer_complete);
 
 TRANSITION(checkpoint_stable);
 
+TRANSITION(region_report);
+
 TRANSITION(alarm);
 
 TRANSITION(debug_dump);
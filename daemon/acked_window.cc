@@ -0,0 +1,187 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// HyperDex
+#include "daemon/acked_window.h"
+
+using hyperdex::acked_window;
+
+#define BITS_PER_WORD 64ULL
+
+acked_window :: acked_window()
+    : m_base(0)
+    , m_bits()
+{
+}
+
+acked_window :: acked_window(const acked_window& other)
+    : m_base(other.m_base)
+    , m_bits(other.m_bits)
+{
+}
+
+acked_window :: ~acked_window() throw ()
+{
+}
+
+bool
+acked_window :: empty() const
+{
+    return m_bits.empty();
+}
+
+bool
+acked_window :: contains(uint64_t seq_id) const
+{
+    if (seq_id < m_base)
+    {
+        return false;
+    }
+
+    uint64_t word = (seq_id - m_base) / BITS_PER_WORD;
+    uint64_t bit = (seq_id - m_base) % BITS_PER_WORD;
+
+    if (word >= m_bits.size())
+    {
+        return false;
+    }
+
+    return m_bits[word] & (1ULL << bit);
+}
+
+void
+acked_window :: insert(uint64_t seq_id)
+{
+    uint64_t aligned = seq_id - seq_id % BITS_PER_WORD;
+
+    if (m_bits.empty())
+    {
+        m_base = aligned;
+    }
+
+    while (aligned < m_base)
+    {
+        m_bits.push_front(0);
+        m_base -= BITS_PER_WORD;
+    }
+
+    uint64_t word = (seq_id - m_base) / BITS_PER_WORD;
+    uint64_t bit = (seq_id - m_base) % BITS_PER_WORD;
+
+    if (word >= m_bits.size())
+    {
+        m_bits.resize(word + 1, 0);
+    }
+
+    m_bits[word] |= 1ULL << bit;
+}
+
+bool
+acked_window :: max(uint64_t* seq_id) const
+{
+    for (size_t i = m_bits.size(); i > 0; --i)
+    {
+        uint64_t w = m_bits[i - 1];
+
+        if (w == 0)
+        {
+            continue;
+        }
+
+        uint64_t bit = BITS_PER_WORD - 1;
+
+        while (!(w & (1ULL << bit)))
+        {
+            --bit;
+        }
+
+        *seq_id = m_base + (i - 1) * BITS_PER_WORD + bit;
+        return true;
+    }
+
+    return false;
+}
+
+void
+acked_window :: clear_below(uint64_t seq_id, std::vector<uint64_t>* cleared)
+{
+    while (!m_bits.empty() && m_base < seq_id)
+    {
+        uint64_t& w(m_bits.front());
+
+        for (uint64_t bit = 0; bit < BITS_PER_WORD; ++bit)
+        {
+            if (m_base + bit >= seq_id)
+            {
+                break;
+            }
+
+            if (w & (1ULL << bit))
+            {
+                cleared->push_back(m_base + bit);
+                w &= ~(1ULL << bit);
+            }
+        }
+
+        if (w != 0)
+        {
+            break;
+        }
+
+        m_bits.pop_front();
+        m_base += BITS_PER_WORD;
+    }
+
+    trim();
+}
+
+acked_window&
+acked_window :: operator = (const acked_window& rhs)
+{
+    if (this != &rhs)
+    {
+        m_base = rhs.m_base;
+        m_bits = rhs.m_bits;
+    }
+
+    return *this;
+}
+
+void
+acked_window :: trim()
+{
+    while (!m_bits.empty() && m_bits.front() == 0)
+    {
+        m_bits.pop_front();
+        m_base += BITS_PER_WORD;
+    }
+
+    while (!m_bits.empty() && m_bits.back() == 0)
+    {
+        m_bits.pop_back();
+    }
+}
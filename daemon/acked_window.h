@@ -0,0 +1,77 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_acked_window_h_
+#define hyperdex_daemon_acked_window_h_
+
+// C
+#include <stddef.h>
+#include <stdint.h>
+
+// STL
+#include <deque>
+#include <vector>
+
+// HyperDex
+#include "namespace.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// A bitmap over the sequence numbers a replica has acked for one (region,
+// point-leader region) pair.  Bits below the base have been cleared or were
+// never set.  External synchronization required.
+class acked_window
+{
+    public:
+        acked_window();
+        acked_window(const acked_window&);
+        ~acked_window() throw ();
+
+    public:
+        bool empty() const;
+        bool contains(uint64_t seq_id) const;
+        void insert(uint64_t seq_id);
+        // store the largest acked seq_id in "*seq_id"; false if empty
+        bool max(uint64_t* seq_id) const;
+        // clear all seq_ids < seq_id, appending the cleared ids to "cleared"
+        void clear_below(uint64_t seq_id, std::vector<uint64_t>* cleared);
+
+    public:
+        acked_window& operator = (const acked_window&);
+
+    private:
+        void trim();
+
+    private:
+        // word i covers [m_base + 64 * i, m_base + 64 * (i + 1))
+        uint64_t m_base;
+        std::deque<uint64_t> m_bits;
+};
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_daemon_acked_window_h_
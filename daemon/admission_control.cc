@@ -0,0 +1,220 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <algorithm>
+
+// e
+#include <e/time.h>
+
+// HyperDex
+#include "daemon/admission_control.h"
+
+using hyperdex::admission_control;
+
+// Every client may spend CLIENT_RATE tokens a second, saving up to
+// CLIENT_BURST while idle.  A point op costs POINT_COST; a scan SCAN_COST.
+#define CLIENT_RATE 20000ULL
+#define CLIENT_BURST 4000ULL
+#define POINT_COST 1ULL
+#define SCAN_COST 64ULL
+// once a shard tracks this many clients, forget those with full buckets
+#define SHARD_GC_THRESHOLD 1024
+
+class admission_control::bucket
+{
+    public:
+        bucket() : tokens(CLIENT_BURST), last(e::time()) {}
+
+    public:
+        // refill for the time since "last"; return true if the bucket is full
+        bool refill(uint64_t now)
+        {
+            if (now > last)
+            {
+                uint64_t add = (now - last) * CLIENT_RATE / 1000000000ULL;
+
+                if (add > 0)
+                {
+                    tokens = std::min<uint64_t>(tokens + add, CLIENT_BURST);
+                    last = now;
+                }
+            }
+
+            return tokens >= CLIENT_BURST;
+        }
+
+    public:
+        uint64_t tokens;
+        uint64_t last;
+};
+
+class admission_control::shard
+{
+    public:
+        shard() : mtx(), buckets() {}
+        ~shard() throw () {}
+
+    public:
+        po6::threads::mutex mtx;
+        std::tr1::unordered_map<uint64_t, bucket> buckets;
+
+    private:
+        shard(const shard&);
+        shard& operator = (const shard&);
+};
+
+admission_control :: admission_control()
+    : m_shards(new shard[SHARDS])
+    , m_threads(1)
+    , m_inflight()
+    , m_admitted()
+    , m_shed()
+{
+}
+
+admission_control :: ~admission_control() throw ()
+{
+}
+
+void
+admission_control :: set_threads(size_t threads)
+{
+    m_threads = threads > 0 ? threads : 1;
+}
+
+admission_control::traffic_class
+admission_control :: classify(network_msgtype type)
+{
+    switch (type)
+    {
+        case REQ_GET:
+        case REQ_ATOMIC:
+            return POINT;
+        case REQ_SEARCH_START:
+        case REQ_SORTED_SEARCH:
+        case REQ_GROUP_DEL:
+        case REQ_COUNT:
+        case REQ_SEARCH_DESCRIBE:
+            return SCAN;
+        case REQ_SEARCH_NEXT:
+        case REQ_SEARCH_STOP:
+        default:
+            return BACKGROUND;
+    }
+}
+
+bool
+admission_control :: admit(const server_id& client, traffic_class tc, uint64_t pending_scans)
+{
+    if (tc == BACKGROUND)
+    {
+        __sync_fetch_and_add(&m_inflight[tc], 1);
+        m_admitted[tc].tap();
+        return true;
+    }
+
+    uint64_t point = __sync_fetch_and_add(&m_inflight[POINT], 0);
+    uint64_t scan = __sync_fetch_and_add(&m_inflight[SCAN], 0);
+    uint64_t spare = (m_threads + 1) / 2;
+    bool admitted = true;
+
+    if (tc == SCAN && scan + pending_scans >= spare)
+    {
+        admitted = false;
+    }
+    else if (!draw_tokens(client, tc == SCAN ? SCAN_COST : POINT_COST))
+    {
+        // over its rate; serve it only while threads sit idle
+        admitted = point + scan < spare;
+    }
+
+    if (!admitted)
+    {
+        m_shed[tc].tap();
+        return false;
+    }
+
+    __sync_fetch_and_add(&m_inflight[tc], 1);
+    m_admitted[tc].tap();
+    return true;
+}
+
+void
+admission_control :: finish(traffic_class tc)
+{
+    __sync_fetch_and_sub(&m_inflight[tc], 1);
+}
+
+void
+admission_control :: collect_stats(std::ostringstream* ret)
+{
+    static const char* names[] = {"point", "scan", "background"};
+
+    for (size_t i = 0; i <= BACKGROUND; ++i)
+    {
+        *ret << " admission." << names[i] << "_inflight=" << __sync_fetch_and_add(&m_inflight[i], 0);
+        *ret << " admission." << names[i] << "_admitted=" << m_admitted[i].read();
+        *ret << " admission." << names[i] << "_shed=" << m_shed[i].read();
+    }
+}
+
+bool
+admission_control :: draw_tokens(const server_id& client, uint64_t cost)
+{
+    shard* s = &m_shards[client.get() % SHARDS];
+    uint64_t now = e::time();
+    po6::threads::mutex::hold hold(&s->mtx);
+
+    if (s->buckets.size() >= SHARD_GC_THRESHOLD)
+    {
+        std::tr1::unordered_map<uint64_t, bucket>::iterator it = s->buckets.begin();
+
+        while (it != s->buckets.end())
+        {
+            if (it->second.refill(now))
+            {
+                s->buckets.erase(it++);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    bucket& b(s->buckets[client.get()]);
+    b.refill(now);
+
+    if (b.tokens < cost)
+    {
+        return false;
+    }
+
+    b.tokens -= cost;
+    return true;
+}
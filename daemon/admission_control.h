@@ -0,0 +1,105 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_admission_control_h_
+#define hyperdex_daemon_admission_control_h_
+
+// STL
+#include <sstream>
+#include <tr1/unordered_map>
+
+// po6
+#include <po6/threads/mutex.h>
+
+// e
+#include <e/array_ptr.h>
+
+// HyperDex
+#include "namespace.h"
+#include "common/ids.h"
+#include "common/network_msgtype.h"
+#include "daemon/performance_counter.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// Decide which client requests the network threads serve when they are busy.
+//
+// Each client draws from its own token bucket; a scan costs many tokens and
+// a point op one.  Clients within their rate are served first.  Clients over
+// their rate are served only while the daemon has idle threads to spare, and
+// scans, counting those still queued for or running on the scan threads,
+// never outnumber half the threads, so one client's heavy scans cannot starve
+// other clients' point ops.  Replication, transfer and search
+// continuation traffic is never shed.
+class admission_control
+{
+    public:
+        enum traffic_class
+        {
+            POINT,
+            SCAN,
+            BACKGROUND
+        };
+
+    public:
+        admission_control();
+        ~admission_control() throw ();
+
+    public:
+        void set_threads(size_t threads);
+        static traffic_class classify(network_msgtype type);
+        // Return true if the daemon should process the request; the caller
+        // must then call "finish" once done.  False means the request should
+        // be answered with OVERLOADED.  "pending_scans" counts scans admitted
+        // earlier that are still queued or running off the network threads.
+        bool admit(const server_id& client, traffic_class tc, uint64_t pending_scans);
+        void finish(traffic_class tc);
+        void collect_stats(std::ostringstream* ret);
+
+    private:
+        class bucket;
+        class shard;
+        static const size_t SHARDS = 16;
+
+    private:
+        bool draw_tokens(const server_id& client, uint64_t cost);
+
+    private:
+        const e::array_ptr<shard> m_shards;
+        uint64_t m_threads;
+        uint64_t m_inflight[BACKGROUND + 1];
+        performance_counter m_admitted[BACKGROUND + 1];
+        performance_counter m_shed[BACKGROUND + 1];
+
+    private:
+        admission_control(const admission_control&);
+        admission_control& operator = (const admission_control&);
+};
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_daemon_admission_control_h_
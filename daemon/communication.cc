@@ -31,9 +31,23 @@
 #include "config.h"
 #endif
 
+// C
+#include <signal.h>
+#include <string.h>
+
+// STL
+#include <algorithm>
+#include <tr1/functional>
+
 // Google Log
 #include <glog/logging.h>
 
+// BusyBee
+#include <busybee_mapper.h>
+
+// e
+#include <e/endian.h>
+
 // HyperDex
 #include "daemon/communication.h"
 #include "daemon/daemon.h"
@@ -77,32 +91,147 @@ communication :: early_message :: ~early_message() throw ()
 {
 }
 
+///////////////////////////////// Config Mapper ////////////////////////////////
+
+// Resolves servers against whichever configuration is current.
+class communication::config_mapper : public ::busybee_mapper
+{
+    public:
+        config_mapper(daemon* d);
+        virtual ~config_mapper() throw ();
+
+    public:
+        virtual bool lookup(uint64_t id, po6::net::location* addr);
+
+    private:
+        config_mapper(const config_mapper&);
+        config_mapper& operator = (const config_mapper&);
+
+    private:
+        daemon* m_daemon;
+};
+
+communication :: config_mapper :: config_mapper(daemon* d)
+    : m_daemon(d)
+{
+}
+
+communication :: config_mapper :: ~config_mapper() throw ()
+{
+}
+
+bool
+communication :: config_mapper :: lookup(uint64_t id, po6::net::location* addr)
+{
+    *addr = m_daemon->m_config->get_address(server_id(id));
+    return *addr != po6::net::location();
+}
+
+///////////////////////////////// Chain Batches ////////////////////////////////
+
+// Each message in a CHAIN_BATCH is its type, the config version it was sent
+// under, its virtual source and destination, and the body that would have
+// followed its header.
+#define CHAIN_BATCH_ENTRY_HEADER_SIZE (sizeof(uint8_t) \
+                                       + sizeof(uint64_t) \
+                                       + sizeof(uint64_t) \
+                                       + sizeof(uint64_t) \
+                                       + sizeof(uint32_t))
+// A frame stops taking messages once it would grow beyond this; a message
+// larger than this gets a frame of its own.
+#define CHAIN_BATCH_MAX_BYTES (1U << 20)
+
+class communication::chain_batch
+{
+    public:
+        class frame;
+        typedef std::list<frame> frame_list_t;
+
+    public:
+        chain_batch(const server_id& to);
+        ~chain_batch() throw ();
+
+    public:
+        const server_id to;
+        po6::threads::mutex mtx;
+        bool sending;
+        // frames waiting to go out, oldest first
+        frame_list_t frames;
+
+    private:
+        chain_batch(const chain_batch&);
+        chain_batch& operator = (const chain_batch&);
+};
+
+class communication::chain_batch::frame
+{
+    public:
+        frame();
+
+    public:
+        // newest config version of any message in the frame
+        uint64_t version;
+        uint32_t count;
+        std::string entries;
+};
+
+communication :: chain_batch :: chain_batch(const server_id& t)
+    : to(t)
+    , mtx()
+    , sending(false)
+    , frames()
+{
+}
+
+communication :: chain_batch :: ~chain_batch() throw ()
+{
+}
+
+communication :: chain_batch :: frame :: frame()
+    : version(0)
+    , count(0)
+    , entries()
+{
+}
+
 ///////////////////////////////// Public Class /////////////////////////////////
 
 communication :: communication(daemon* d)
     : m_daemon(d)
-    , m_busybee_mapper(&m_daemon->m_config)
+    , m_busybee_mapper(new config_mapper(d))
     , m_busybee()
     , m_early_messages()
+    , m_chain_batches_protect()
+    , m_chain_batches()
+    , m_batch_flusher(std::tr1::bind(&communication::batch_flusher, this))
+    , m_block_batch_flusher()
+    , m_wakeup_batch_flusher(&m_block_batch_flusher)
+    , m_handed_off()
+    , m_batch_flusher_shutdown(true)
 {
 }
 
 communication :: ~communication() throw ()
 {
+    shutdown_batch_flusher();
 }
 
 bool
 communication :: setup(const po6::net::location& bind_to,
                        unsigned threads)
 {
-    m_busybee.reset(new busybee_mta(&m_busybee_mapper, bind_to, m_daemon->m_us.get(), threads));
+    m_busybee.reset(new busybee_mta(m_busybee_mapper.get(), bind_to, m_daemon->m_us.get(), threads));
     m_busybee->set_ignore_signals();
+    po6::threads::mutex::hold hold(&m_block_batch_flusher);
+    m_batch_flusher.start();
+    m_batch_flusher_shutdown = false;
     return true;
 }
 
 void
 communication :: teardown()
 {
+    shutdown_batch_flusher();
 }
 
 void
@@ -139,7 +268,7 @@ communication :: send_client(const virtual_server_id& from,
 {
     assert(msg->size() >= HYPERDEX_HEADER_SIZE_VC);
 
-    if (m_daemon->m_us != m_daemon->m_config.get_server_id(from) &&
+    if (m_daemon->m_us != m_daemon->m_config->get_server_id(from) &&
         from != virtual_server_id(UINT64_MAX))
     {
         return false;
@@ -190,7 +319,7 @@ communication :: send(const virtual_server_id& from,
 {
     assert(msg->size() >= HYPERDEX_HEADER_SIZE_VV);
 
-    if (m_daemon->m_us != m_daemon->m_config.get_server_id(from))
+    if (m_daemon->m_us != m_daemon->m_config->get_server_id(from))
     {
         return false;
     }
@@ -198,7 +327,7 @@ communication :: send(const virtual_server_id& from,
     uint8_t mt = static_cast<uint8_t>(msg_type);
     uint8_t flags = 1;
     virtual_server_id vto(UINT64_MAX);
-    msg->pack_at(BUSYBEE_HEADER_SIZE) << mt << flags << m_daemon->m_config.version() << vto.get() << from.get();
+    msg->pack_at(BUSYBEE_HEADER_SIZE) << mt << flags << m_daemon->m_config->version() << vto.get() << from.get();
 
     if (to == server_id())
     {
@@ -247,15 +376,15 @@ communication :: send(const virtual_server_id& from,
 {
     assert(msg->size() >= HYPERDEX_HEADER_SIZE_VV);
 
-    if (m_daemon->m_us != m_daemon->m_config.get_server_id(from))
+    if (m_daemon->m_us != m_daemon->m_config->get_server_id(from))
     {
         return false;
     }
 
     uint8_t mt = static_cast<uint8_t>(msg_type);
     uint8_t flags = 1;
-    msg->pack_at(BUSYBEE_HEADER_SIZE) << mt << flags << m_daemon->m_config.version() << vto.get() << from.get();
-    server_id to = m_daemon->m_config.get_server_id(vto);
+    msg->pack_at(BUSYBEE_HEADER_SIZE) << mt << flags << m_daemon->m_config->version() << vto.get() << from.get();
+    server_id to = m_daemon->m_config->get_server_id(vto);
 
     if (to == server_id())
     {
@@ -305,8 +434,8 @@ communication :: send(const virtual_server_id& vto,
 
     uint8_t mt = static_cast<uint8_t>(msg_type);
     uint8_t flags = 0;
-    msg->pack_at(BUSYBEE_HEADER_SIZE) << mt << flags << m_daemon->m_config.version() << vto.get();
-    server_id to = m_daemon->m_config.get_server_id(vto);
+    msg->pack_at(BUSYBEE_HEADER_SIZE) << mt << flags << m_daemon->m_config->version() << vto.get();
+    server_id to = m_daemon->m_config->get_server_id(vto);
 
     if (to == server_id())
     {
@@ -355,15 +484,15 @@ communication :: send_exact(const virtual_server_id& from,
 {
     assert(msg->size() >= HYPERDEX_HEADER_SIZE_VV);
 
-    if (m_daemon->m_us != m_daemon->m_config.get_server_id(from))
+    if (m_daemon->m_us != m_daemon->m_config->get_server_id(from))
     {
         return false;
     }
 
     uint8_t mt = static_cast<uint8_t>(msg_type);
     uint8_t flags = 1 | 2;
-    msg->pack_at(BUSYBEE_HEADER_SIZE) << mt << flags << m_daemon->m_config.version() << vto.get() << from.get();
-    server_id to = m_daemon->m_config.get_server_id(vto);
+    msg->pack_at(BUSYBEE_HEADER_SIZE) << mt << flags << m_daemon->m_config->version() << vto.get() << from.get();
+    server_id to = m_daemon->m_config->get_server_id(vto);
 
     if (to == server_id())
     {
@@ -405,7 +534,82 @@ communication :: send_exact(const virtual_server_id& from,
 }
 
 bool
-communication :: recv(server_id* from,
+communication :: send_batched(const virtual_server_id& from,
+                              const virtual_server_id& vto,
+                              network_msgtype msg_type,
+                              std::auto_ptr<e::buffer> msg)
+{
+    assert(msg->size() >= HYPERDEX_HEADER_SIZE_VV);
+    server_id to = m_daemon->m_config->get_server_id(vto);
+
+    if (to == server_id() || to == m_daemon->m_us)
+    {
+        return send_exact(from, vto, msg_type, msg);
+    }
+
+    // checked now, rather than when the batch ships, so that the caller
+    // learns of it the way send_exact would tell it
+    if (m_daemon->m_us != m_daemon->m_config->get_server_id(from))
+    {
+        return false;
+    }
+
+    std::tr1::shared_ptr<chain_batch> cb = get_chain_batch(to);
+    uint64_t version = m_daemon->m_config->version();
+    bool drain = false;
+
+    {
+        po6::threads::mutex::hold hold(&cb->mtx);
+
+        // Nothing is queued unless a send is in progress; anything that is
+        // queued must go out before this message does.
+        if (!cb->sending)
+        {
+            assert(cb->frames.empty());
+            cb->sending = true;
+            drain = true;
+        }
+        else
+        {
+            size_t body_sz = msg->size() - HYPERDEX_HEADER_SIZE_VV;
+            size_t entry_sz = CHAIN_BATCH_ENTRY_HEADER_SIZE + body_sz;
+
+            if (cb->frames.empty() ||
+                (cb->frames.back().count > 0 &&
+                 cb->frames.back().entries.size() + entry_sz > CHAIN_BATCH_MAX_BYTES))
+            {
+                cb->frames.push_back(chain_batch::frame());
+            }
+
+            chain_batch::frame* f = &cb->frames.back();
+            char hdr[CHAIN_BATCH_ENTRY_HEADER_SIZE];
+            char* ptr = hdr;
+            ptr = e::pack8be(static_cast<uint8_t>(msg_type), ptr);
+            ptr = e::pack64be(version, ptr);
+            ptr = e::pack64be(from.get(), ptr);
+            ptr = e::pack64be(vto.get(), ptr);
+            ptr = e::pack32be(body_sz, ptr);
+            f->entries.append(hdr, CHAIN_BATCH_ENTRY_HEADER_SIZE);
+            f->entries.append(reinterpret_cast<const char*>(msg->data()) + HYPERDEX_HEADER_SIZE_VV, body_sz);
+            f->version = std::max(f->version, version);
+            ++f->count;
+            return true;
+        }
+    }
+
+    bool ret = send_exact(from, vto, msg_type, msg);
+
+    if (drain && drain_chain_batch(cb.get()))
+    {
+        hand_off_chain_batch(cb);
+    }
+
+    return ret;
+}
+
+bool
+communication :: recv(size_t slot,
+                      server_id* from,
                       virtual_server_id* vfrom,
                       virtual_server_id* vto,
                       network_msgtype* msg_type,
@@ -421,7 +625,9 @@ communication :: recv(server_id* from,
     while (true)
     {
         uint64_t id;
+        m_daemon->m_config.offline(slot);
         busybee_returncode rc = m_busybee->recv(&id, msg);
+        m_daemon->m_config.online(slot);
 
         switch (rc)
         {
@@ -471,24 +677,24 @@ communication :: recv(server_id* from,
         }
 
         bool from_valid = true;
-        bool to_valid = m_daemon->m_us == m_daemon->m_config.get_server_id(*vto) ||
+        bool to_valid = m_daemon->m_us == m_daemon->m_config->get_server_id(*vto) ||
                         *vto == virtual_server_id(UINT64_MAX);
 
         // If this is a virtual-virtual message
         if ((flags & 0x1))
         {
-            from_valid = *from == m_daemon->m_config.get_server_id(virtual_server_id(vidf));
+            from_valid = *from == m_daemon->m_config->get_server_id(virtual_server_id(vidf));
         }
 
         // No matter what, wait for the config the sender saw
-        if (version > m_daemon->m_config.version())
+        if (version > m_daemon->m_config->version())
         {
             early_message em(version, id, *msg);
             m_early_messages.push(em);
             continue;
         }
 
-        if ((flags & 0x2) && version < m_daemon->m_config.version())
+        if ((flags & 0x2) && version < m_daemon->m_config->version())
         {
             continue;
         }
@@ -511,10 +717,182 @@ communication :: recv(server_id* from,
     }
 }
 
+std::tr1::shared_ptr<communication::chain_batch>
+communication :: get_chain_batch(const server_id& to)
+{
+    po6::threads::mutex::hold hold(&m_chain_batches_protect);
+    chain_batch_map_t::iterator it = m_chain_batches.find(to);
+
+    if (it != m_chain_batches.end())
+    {
+        return it->second;
+    }
+
+    std::tr1::shared_ptr<chain_batch> cb(new chain_batch(to));
+    m_chain_batches.insert(std::make_pair(to, cb));
+    return cb;
+}
+
+bool
+communication :: drain_chain_batch(chain_batch* cb)
+{
+    // The caller may be holding locks that other senders wait on, so ship a
+    // single frame of whatever queued up behind its own send.  If more is
+    // left, "sending" stays set and the caller hands the batch to the
+    // flusher.
+    chain_batch::frame f;
+    server_id to;
+
+    {
+        po6::threads::mutex::hold hold(&cb->mtx);
+
+        if (cb->frames.empty())
+        {
+            cb->sending = false;
+            return false;
+        }
+
+        std::swap(f, cb->frames.front());
+        cb->frames.pop_front();
+        to = cb->to;
+    }
+
+    // The frame itself vouches for no virtual server, and is not tied to
+    // one config; the receiver checks each message on its own.  Its version
+    // is that of the newest message, so the receiver waits for that config.
+    size_t sz = HYPERDEX_HEADER_SIZE_SV
+              + sizeof(uint32_t)
+              + f.entries.size();
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    uint8_t mt = static_cast<uint8_t>(CHAIN_BATCH);
+    uint8_t flags = 0;
+    virtual_server_id vto(UINT64_MAX);
+    msg->pack_at(BUSYBEE_HEADER_SIZE) << mt << flags << f.version << vto.get() << f.count;
+    memmove(msg->data() + HYPERDEX_HEADER_SIZE_SV + sizeof(uint32_t),
+            f.entries.data(), f.entries.size());
+    msg->resize(sz);
+
+#ifdef HD_LOG_ALL_MESSAGES
+    LOG(INFO) << "SEND ->" << to << " " << CHAIN_BATCH << " " << msg->hex();
+#endif
+
+    busybee_returncode rc = m_busybee->send(to.get(), msg);
+
+    switch (rc)
+    {
+        case BUSYBEE_SUCCESS:
+            break;
+        case BUSYBEE_DISRUPTED:
+            handle_disruption(to.get());
+            break;
+        case BUSYBEE_SHUTDOWN:
+        case BUSYBEE_POLLFAILED:
+        case BUSYBEE_ADDFDFAIL:
+        case BUSYBEE_TIMEOUT:
+        case BUSYBEE_EXTERNAL:
+        case BUSYBEE_INTERRUPTED:
+        default:
+            LOG(ERROR) << "BusyBee unexpectedly returned " << rc;
+            break;
+    }
+
+    po6::threads::mutex::hold hold(&cb->mtx);
+
+    if (cb->frames.empty())
+    {
+        cb->sending = false;
+        return false;
+    }
+
+    return true;
+}
+
+void
+communication :: hand_off_chain_batch(std::tr1::shared_ptr<chain_batch> cb)
+{
+    po6::threads::mutex::hold hold(&m_block_batch_flusher);
+    m_handed_off.push_back(cb);
+    m_wakeup_batch_flusher.signal();
+}
+
+void
+communication :: batch_flusher()
+{
+    LOG(INFO) << "chain batch flusher started";
+    sigset_t ss;
+
+    if (sigfillset(&ss) < 0)
+    {
+        PLOG(ERROR) << "sigfillset";
+        return;
+    }
+
+    if (pthread_sigmask(SIG_BLOCK, &ss, NULL) < 0)
+    {
+        PLOG(ERROR) << "could not block signals";
+        return;
+    }
+
+    // sending maps server ids to addresses through the live configuration,
+    // and nothing pauses this thread across a reconfiguration
+    size_t slot = m_daemon->m_config.enroll();
+
+    while (true)
+    {
+        std::tr1::shared_ptr<chain_batch> cb;
+        m_daemon->m_config.offline(slot);
+
+        {
+            po6::threads::mutex::hold hold(&m_block_batch_flusher);
+
+            while (m_handed_off.empty() && !m_batch_flusher_shutdown)
+            {
+                m_wakeup_batch_flusher.wait();
+            }
+
+            if (m_handed_off.empty())
+            {
+                break;
+            }
+
+            cb = m_handed_off.front();
+            m_handed_off.pop_front();
+        }
+
+        m_daemon->m_config.online(slot);
+
+        // one batch per turn, so a busy server cannot starve the others
+        if (drain_chain_batch(cb.get()))
+        {
+            hand_off_chain_batch(cb);
+        }
+    }
+
+    LOG(INFO) << "chain batch flusher shutting down";
+}
+
+void
+communication :: shutdown_batch_flusher()
+{
+    bool is_shutdown;
+
+    {
+        po6::threads::mutex::hold hold(&m_block_batch_flusher);
+        m_wakeup_batch_flusher.broadcast();
+        is_shutdown = m_batch_flusher_shutdown;
+        m_batch_flusher_shutdown = true;
+    }
+
+    if (!is_shutdown)
+    {
+        m_batch_flusher.join();
+    }
+}
+
 void
 communication :: handle_disruption(uint64_t id)
 {
-    if (m_daemon->m_config.get_address(server_id(id)) != po6::net::location())
+    if (m_daemon->m_config->get_address(server_id(id)) != po6::net::location())
     {
         m_daemon->m_coord.report_tcp_disconnect(server_id(id));
         // XXX If the above line changes, then we need to sometimes tell
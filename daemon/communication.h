@@ -29,7 +29,16 @@
 #define hyperdex_daemon_communication_h_
 
 // STL
+#include <list>
+#include <map>
 #include <memory>
+#include <string>
+#include <tr1/memory>
+
+// po6
+#include <po6/threads/cond.h>
+#include <po6/threads/mutex.h>
+#include <po6/threads/thread.h>
 
 // BusyBee
 #include <busybee_constants.h>
@@ -41,8 +50,8 @@
 
 // HyperDex
 #include "namespace.h"
+#include "common/configuration.h"
 #include "common/ids.h"
-#include "common/mapper.h"
 #include "common/network_msgtype.h"
 #include "daemon/reconfigure_returncode.h"
 
@@ -105,7 +114,18 @@ class communication
                         const virtual_server_id& to,
                         network_msgtype msg_type,
                         std::auto_ptr<e::buffer> msg);
-        bool recv(server_id* from,
+        // Like send_exact, except that messages sent to a server while
+        // another send to it is in progress are queued, and shipped together
+        // in one CHAIN_BATCH once that send completes.  The sender ships at
+        // most one batch; anything queued behind it goes to the flusher.
+        bool send_batched(const virtual_server_id& from,
+                          const virtual_server_id& to,
+                          network_msgtype msg_type,
+                          std::auto_ptr<e::buffer> msg);
+        // "slot" is the caller's config_publisher slot; it goes offline
+        // while waiting on the network
+        bool recv(size_t slot,
+                  server_id* from,
                   virtual_server_id* vfrom,
                   virtual_server_id* vto,
                   network_msgtype* msg_type,
@@ -114,9 +134,20 @@ class communication
 
     private:
         class early_message;
+        class chain_batch;
+        class config_mapper;
+        typedef std::map<server_id, std::tr1::shared_ptr<chain_batch> >
+                chain_batch_map_t;
+        typedef std::list<std::tr1::shared_ptr<chain_batch> > chain_batch_list_t;
 
     private:
         void handle_disruption(uint64_t id);
+        std::tr1::shared_ptr<chain_batch> get_chain_batch(const server_id& to);
+        // ship one batch; true if more queued up and "sending" is still set
+        bool drain_chain_batch(chain_batch* cb);
+        void hand_off_chain_batch(std::tr1::shared_ptr<chain_batch> cb);
+        void batch_flusher();
+        void shutdown_batch_flusher();
 
     private:
         communication(const communication&);
@@ -124,9 +155,16 @@ class communication
 
     private:
         daemon* m_daemon;
-        mapper m_busybee_mapper;
+        std::auto_ptr<config_mapper> m_busybee_mapper;
         std::auto_ptr<busybee_mta> m_busybee;
         e::lockfree_fifo<early_message> m_early_messages;
+        po6::threads::mutex m_chain_batches_protect;
+        chain_batch_map_t m_chain_batches;
+        po6::threads::thread m_batch_flusher;
+        po6::threads::mutex m_block_batch_flusher;
+        po6::threads::cond m_wakeup_batch_flusher;
+        chain_batch_list_t m_handed_off;
+        bool m_batch_flusher_shutdown;
 };
 
 END_HYPERDEX_NAMESPACE
@@ -0,0 +1,321 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <string.h>
+
+// STL
+#include <algorithm>
+#include <vector>
+
+// HyperDex
+#include "daemon/compression.h"
+
+// the shortest match worth encoding
+#define MIN_MATCH 4
+// the block must end with this many literals, and the last match must start
+// at least MFLIMIT bytes before the end
+#define LAST_LITERALS 5
+#define MFLIMIT 12
+// offsets are 16 bits
+#define WINDOW_SZ 65536
+#define HASH_BITS 14
+#define NO_POS UINT32_MAX
+
+namespace
+{
+
+uint32_t
+read32(const uint8_t* ptr)
+{
+    uint32_t x;
+    memcpy(&x, ptr, sizeof(x));
+    return x;
+}
+
+uint32_t
+hash4(const uint8_t* ptr)
+{
+    return (read32(ptr) * 2654435761U) >> (32 - HASH_BITS);
+}
+
+uint8_t*
+write_length(uint8_t* op, size_t len)
+{
+    while (len >= 255)
+    {
+        *op++ = 255;
+        len -= 255;
+    }
+
+    *op++ = static_cast<uint8_t>(len);
+    return op;
+}
+
+uint8_t*
+write_sequence(uint8_t* op,
+               const uint8_t* literals, size_t lit_sz,
+               size_t offset, size_t match_sz)
+{
+    uint8_t* token = op++;
+    *token = static_cast<uint8_t>(std::min<size_t>(lit_sz, 15) << 4);
+
+    if (lit_sz >= 15)
+    {
+        op = write_length(op, lit_sz - 15);
+    }
+
+    memcpy(op, literals, lit_sz);
+    op += lit_sz;
+
+    // the final sequence is literals alone
+    if (match_sz == 0)
+    {
+        return op;
+    }
+
+    *op++ = static_cast<uint8_t>(offset & 0xff);
+    *op++ = static_cast<uint8_t>(offset >> 8);
+    match_sz -= MIN_MATCH;
+    *token |= static_cast<uint8_t>(std::min<size_t>(match_sz, 15));
+
+    if (match_sz >= 15)
+    {
+        op = write_length(op, match_sz - 15);
+    }
+
+    return op;
+}
+
+// read an extended length, failing rather than running past "end" or
+// exceeding "limit"
+bool
+read_length(const uint8_t** ip, const uint8_t* end, size_t limit, size_t* len)
+{
+    uint8_t b;
+
+    do
+    {
+        if (*ip >= end)
+        {
+            return false;
+        }
+
+        b = *(*ip)++;
+        *len += b;
+
+        if (*len > limit)
+        {
+            return false;
+        }
+    }
+    while (b == 255);
+
+    return true;
+}
+
+} // namespace
+
+size_t
+hyperdex :: lz_compress_bound(size_t sz)
+{
+    return sz + sz / 255 + 16;
+}
+
+size_t
+hyperdex :: lz_compress(const uint8_t* in, size_t in_sz, unsigned level, uint8_t* out)
+{
+    uint8_t* op = out;
+    size_t anchor = 0;
+
+    if (in_sz > MFLIMIT)
+    {
+        level = std::max(1U, std::min(level, 9U));
+        unsigned attempts = 1U << (level - 1);
+        std::vector<uint32_t> head(1U << HASH_BITS, NO_POS);
+        // earlier positions with the same hash; only kept above level 1
+        std::vector<uint32_t> chain(level > 1 ? WINDOW_SZ : 0, NO_POS);
+        const size_t match_start_limit = in_sz - MFLIMIT;
+        const size_t match_end_limit = in_sz - LAST_LITERALS;
+        size_t ip = 0;
+
+        while (ip < match_start_limit)
+        {
+            uint32_t h = hash4(in + ip);
+            uint32_t cand = head[h];
+            size_t best_sz = 0;
+            size_t best_off = 0;
+
+            for (unsigned a = 0; a < attempts && cand != NO_POS &&
+                                 ip - cand < WINDOW_SZ; ++a)
+            {
+                if (read32(in + cand) == read32(in + ip))
+                {
+                    size_t sz = MIN_MATCH;
+
+                    while (ip + sz < match_end_limit && in[cand + sz] == in[ip + sz])
+                    {
+                        ++sz;
+                    }
+
+                    if (sz > best_sz)
+                    {
+                        best_sz = sz;
+                        best_off = ip - cand;
+                    }
+                }
+
+                if (chain.empty())
+                {
+                    break;
+                }
+
+                uint32_t next = chain[cand & (WINDOW_SZ - 1)];
+
+                // the slot was reused by a newer position
+                if (next == NO_POS || next >= cand)
+                {
+                    break;
+                }
+
+                cand = next;
+            }
+
+            if (!chain.empty())
+            {
+                chain[ip & (WINDOW_SZ - 1)] = head[h];
+            }
+
+            head[h] = ip;
+
+            if (best_sz < MIN_MATCH)
+            {
+                ++ip;
+                continue;
+            }
+
+            op = write_sequence(op, in + anchor, ip - anchor, best_off, best_sz);
+
+            // positions inside the match are only worth indexing when we
+            // will search more than one candidate
+            if (!chain.empty())
+            {
+                for (size_t p = ip + 1; p < ip + best_sz && p < match_start_limit; ++p)
+                {
+                    uint32_t hp = hash4(in + p);
+                    chain[p & (WINDOW_SZ - 1)] = head[hp];
+                    head[hp] = p;
+                }
+            }
+
+            ip += best_sz;
+            anchor = ip;
+        }
+    }
+
+    op = write_sequence(op, in + anchor, in_sz - anchor, 0, 0);
+    return op - out;
+}
+
+bool
+hyperdex :: lz_decompress(const uint8_t* in, size_t in_sz, uint8_t* out, size_t out_sz)
+{
+    const uint8_t* ip = in;
+    const uint8_t* const iend = in + in_sz;
+    uint8_t* op = out;
+    uint8_t* const oend = out + out_sz;
+
+    while (true)
+    {
+        if (ip >= iend)
+        {
+            return false;
+        }
+
+        uint8_t token = *ip++;
+        size_t lit_sz = token >> 4;
+
+        if (lit_sz == 15 && !read_length(&ip, iend, out_sz, &lit_sz))
+        {
+            return false;
+        }
+
+        if (lit_sz > static_cast<size_t>(iend - ip) ||
+            lit_sz > static_cast<size_t>(oend - op))
+        {
+            return false;
+        }
+
+        memcpy(op, ip, lit_sz);
+        ip += lit_sz;
+        op += lit_sz;
+
+        if (ip == iend)
+        {
+            return op == oend;
+        }
+
+        if (iend - ip < 2)
+        {
+            return false;
+        }
+
+        size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+        ip += 2;
+
+        if (offset == 0 || offset > static_cast<size_t>(op - out))
+        {
+            return false;
+        }
+
+        size_t match_sz = token & 15;
+
+        if (match_sz == 15 && !read_length(&ip, iend, out_sz, &match_sz))
+        {
+            return false;
+        }
+
+        match_sz += MIN_MATCH;
+
+        if (match_sz > static_cast<size_t>(oend - op))
+        {
+            return false;
+        }
+
+        // the match may overlap the bytes it produces
+        const uint8_t* match = op - offset;
+
+        for (size_t i = 0; i < match_sz; ++i)
+        {
+            op[i] = match[i];
+        }
+
+        op += match_sz;
+    }
+}
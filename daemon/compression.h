@@ -0,0 +1,62 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_compression_h_
+#define hyperdex_daemon_compression_h_
+
+// C
+#include <stddef.h>
+#include <stdint.h>
+
+// HyperDex
+#include "namespace.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// A small LZ77 block compressor using the LZ4 block format, kept in-tree so
+// that compressing state transfer traffic needs no external library.
+//
+// Levels run from 1 (fastest; one match candidate per position) to 9
+// (smallest; searches a chain of up to 256 earlier candidates).
+
+// the largest compressed size of "sz" input bytes
+size_t
+lz_compress_bound(size_t sz);
+
+// compress "in" into "out", which must hold lz_compress_bound(in_sz) bytes;
+// return the compressed size
+size_t
+lz_compress(const uint8_t* in, size_t in_sz, unsigned level, uint8_t* out);
+
+// decompress a block that must expand to exactly "out_sz" bytes; the input
+// is untrusted, so malformed blocks return false rather than overrun
+bool
+lz_decompress(const uint8_t* in, size_t in_sz, uint8_t* out, size_t out_sz);
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_daemon_compression_h_
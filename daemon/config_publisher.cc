@@ -0,0 +1,142 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <assert.h>
+#include <time.h>
+
+// HyperDex
+#include "daemon/config_publisher.h"
+
+using hyperdex::config_publisher;
+
+config_publisher :: config_publisher()
+    : m_current(new configuration())
+    , m_epoch(1)
+    , m_enrolled(0)
+    , m_slots()
+    , m_retired()
+{
+}
+
+config_publisher :: ~config_publisher() throw ()
+{
+    for (retired_list_t::iterator it = m_retired.begin();
+            it != m_retired.end(); ++it)
+    {
+        delete it->second;
+    }
+
+    delete m_current;
+}
+
+size_t
+config_publisher :: enroll()
+{
+    size_t s = __sync_fetch_and_add(&m_enrolled, 1);
+    assert(s < CONFIG_PUBLISHER_MAX_READERS);
+    online(s);
+    return s;
+}
+
+void
+config_publisher :: offline(size_t s)
+{
+    e::atomic::store_64_release(&m_slots[s].epoch, 0);
+}
+
+void
+config_publisher :: online(size_t s)
+{
+    e::atomic::store_64_nobarrier(&m_slots[s].epoch, e::atomic::load_64_acquire(&m_epoch));
+    // the slot must be visible before this thread next loads m_current
+    e::atomic::memory_barrier();
+}
+
+void
+config_publisher :: publish(const configuration& config)
+{
+    configuration* old = m_current;
+    e::atomic::store_ptr_release(&m_current, new configuration(config));
+    uint64_t epoch = m_epoch + 1;
+    e::atomic::store_64_release(&m_epoch, epoch);
+    e::atomic::memory_barrier();
+    // slots online from "epoch" on loaded m_current after it changed
+    m_retired.push_back(std::make_pair(epoch, old));
+}
+
+void
+config_publisher :: synchronize()
+{
+    uint64_t epoch = e::atomic::load_64_acquire(&m_epoch);
+
+    while (oldest_online() < epoch)
+    {
+        timespec ts;
+        ts.tv_sec = 0;
+        ts.tv_nsec = 100 * 1000;
+        nanosleep(&ts, NULL);
+    }
+}
+
+void
+config_publisher :: reclaim()
+{
+    if (m_retired.empty())
+    {
+        return;
+    }
+
+    uint64_t oldest = oldest_online();
+
+    while (!m_retired.empty() && m_retired.front().first <= oldest)
+    {
+        delete m_retired.front().second;
+        m_retired.pop_front();
+    }
+}
+
+uint64_t
+config_publisher :: oldest_online()
+{
+    uint64_t enrolled = e::atomic::load_64_acquire(&m_enrolled);
+    uint64_t oldest = UINT64_MAX;
+
+    for (size_t i = 0; i < enrolled && i < CONFIG_PUBLISHER_MAX_READERS; ++i)
+    {
+        uint64_t e = e::atomic::load_64_acquire(&m_slots[i].epoch);
+
+        if (e > 0 && e < oldest)
+        {
+            oldest = e;
+        }
+    }
+
+    return oldest;
+}
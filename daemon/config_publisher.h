@@ -0,0 +1,113 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_config_publisher_h_
+#define hyperdex_daemon_config_publisher_h_
+
+// C
+#include <stdint.h>
+
+// STL
+#include <list>
+
+// e
+#include <e/atomic.h>
+
+// HyperDex
+#include "namespace.h"
+#include "common/configuration.h"
+
+#define CONFIG_PUBLISHER_MAX_READERS 512
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// The configuration the daemon runs with, published by pointer so that a new
+// one can be swapped in while requests are being served.
+//
+// Threads that read the configuration without being paused across a
+// reconfiguration enroll for a slot.  Whatever they get() stays valid until
+// they next go offline, which they must do before blocking; once every
+// enrolled thread has gone offline (or come back online) since a
+// configuration was replaced, reclaim() frees it.  Everything else reads the
+// configuration only while paused, or is the one thread that publishes.
+class config_publisher
+{
+    public:
+        config_publisher();
+        ~config_publisher() throw ();
+
+    public:
+        const configuration* get() const
+        { return e::atomic::load_ptr_acquire(&m_current); }
+        const configuration* operator -> () const { return get(); }
+        const configuration& operator * () const { return *get(); }
+
+    // readers
+    public:
+        // the new slot starts out online
+        size_t enroll();
+        void offline(size_t slot);
+        void online(size_t slot);
+
+    // the single writer
+    public:
+        void publish(const configuration& config);
+        // wait until no enrolled thread can still see a configuration
+        // replaced before this call
+        void synchronize();
+        // free the replaced configurations no enrolled thread can still see
+        void reclaim();
+
+    private:
+        // one per cache line; 0 when offline, else the epoch it came online
+        struct slot
+        {
+            slot() : epoch(0) {}
+            uint64_t epoch;
+            char pad[64 - sizeof(uint64_t)];
+        };
+        typedef std::list<std::pair<uint64_t, configuration*> > retired_list_t;
+
+    private:
+        // the oldest epoch any online slot came online in
+        uint64_t oldest_online();
+
+    private:
+        configuration* m_current;
+        uint64_t m_epoch;
+        uint64_t m_enrolled;
+        slot m_slots[CONFIG_PUBLISHER_MAX_READERS];
+        retired_list_t m_retired;
+
+    private:
+        config_publisher(const config_publisher&);
+        config_publisher& operator = (const config_publisher&);
+};
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_daemon_config_publisher_h_
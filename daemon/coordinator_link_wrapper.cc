@@ -33,6 +33,9 @@
 // POSIX
 #include <signal.h>
 
+// STL
+#include <algorithm>
+
 // Google Log
 #include <glog/logging.h>
 
@@ -352,7 +355,7 @@ coordinator_link_wrapper :: checkpoint_gc()
 void
 coordinator_link_wrapper :: transfer_go_live(const transfer_id& id)
 {
-    uint64_t version = m_daemon->m_config.version();
+    uint64_t version = m_daemon->m_config->version();
     char buf[2 * sizeof(uint64_t)];
     e::pack64be(id.get(), buf);
     e::pack64be(version, buf + sizeof(uint64_t));
@@ -365,7 +368,7 @@ coordinator_link_wrapper :: transfer_go_live(const transfer_id& id)
 void
 coordinator_link_wrapper :: transfer_complete(const transfer_id& id)
 {
-    uint64_t version = m_daemon->m_config.version();
+    uint64_t version = m_daemon->m_config->version();
     char buf[2 * sizeof(uint64_t)];
     e::pack64be(id.get(), buf);
     e::pack64be(version, buf + sizeof(uint64_t));
@@ -378,7 +381,7 @@ coordinator_link_wrapper :: transfer_complete(const transfer_id& id)
 void
 coordinator_link_wrapper :: report_tcp_disconnect(const server_id& id)
 {
-    uint64_t version = m_daemon->m_config.version();
+    uint64_t version = m_daemon->m_config->version();
     char buf[2 * sizeof(uint64_t)];
     e::pack64be(id.get(), buf);
     e::pack64be(version, buf + sizeof(uint64_t));
@@ -387,6 +390,28 @@ coordinator_link_wrapper :: report_tcp_disconnect(const server_id& id)
     make_rpc("server_suspect", buf, 2 * sizeof(uint64_t), rpc);
 }
 
+void
+coordinator_link_wrapper :: region_report(uint64_t cpu,
+                                          const std::vector<std::pair<region_id, region_stats> >& loads)
+{
+    const size_t per_region = pack_size(region_id()) + 3 * sizeof(uint64_t);
+    std::auto_ptr<e::buffer> buf(e::buffer::create(2 * sizeof(uint64_t) + loads.size() * per_region));
+    e::buffer::packer pa = buf->pack_at(0);
+    pa = pa << m_daemon->m_us << cpu;
+
+    for (size_t i = 0; i < loads.size(); ++i)
+    {
+        pa = pa << loads[i].first
+                << static_cast<uint64_t>(std::max<int64_t>(loads[i].second.bytes, 0))
+                << static_cast<uint64_t>(loads[i].second.writes)
+                << static_cast<uint64_t>(loads[i].second.reads);
+    }
+
+    e::intrusive_ptr<coord_rpc> rpc = new coord_rpc();
+    rpc->msg << "region report cpu=" << cpu << " regions=" << loads.size();
+    make_rpc("region_report", reinterpret_cast<const char*>(buf->data()), buf->size(), rpc);
+}
+
 void
 coordinator_link_wrapper :: config_ack(uint64_t version)
 {
@@ -41,6 +41,7 @@
 #include "common/configuration.h"
 #include "common/coordinator_link.h"
 #include "common/ids.h"
+#include "daemon/region_stats.h"
 
 BEGIN_HYPERDEX_NAMESPACE
 class daemon;
@@ -73,6 +74,10 @@ class coordinator_link_wrapper
         void config_ack(uint64_t version);
         void config_stable(uint64_t version);
         void checkpoint_report_stable(uint64_t checkpoint);
+        // "cpu" is in thousandths of the machine; each entry's "writes" and
+        // "reads" are the region's ops per second
+        void region_report(uint64_t cpu,
+                           const std::vector<std::pair<region_id, region_stats> >& loads);
 
     private:
         class coord_rpc;
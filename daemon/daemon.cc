@@ -28,6 +28,8 @@
 // POSIX
 #include <dirent.h>
 #include <signal.h>
+#include <sys/resource.h>
+#include <unistd.h>
 
 // STL
 #include <sstream>
@@ -44,7 +46,10 @@
 // HyperDex
 #include "common/coordinator_returncode.h"
 #include "common/serialization.h"
+#include "daemon/compression.h"
 #include "daemon/daemon.h"
+#include "daemon/merkle_tree.h"
+#include "daemon/scratch_arena.h"
 
 #ifdef __APPLE__
 #include <mach/mach.h>
@@ -105,6 +110,9 @@ daemon :: daemon()
     , m_repl(this)
     , m_stm(this)
     , m_sm(this)
+    , m_reads(this)
+    , m_admission()
+    , m_background()
     , m_config()
     , m_perf_req_get()
     , m_perf_req_atomic()
@@ -119,12 +127,15 @@ daemon :: daemon()
     , m_perf_chain_subspace()
     , m_perf_chain_ack()
     , m_perf_chain_gc()
+    , m_perf_chain_batch()
     , m_perf_xfer_handshake_syn()
     , m_perf_xfer_handshake_synack()
     , m_perf_xfer_handshake_ack()
     , m_perf_xfer_handshake_wiped()
     , m_perf_xfer_op()
     , m_perf_xfer_ack()
+    , m_perf_region_stats()
+    , m_perf_bulk_load()
     , m_perf_backup()
     , m_perf_perf_counters()
     , m_block_stat_path()
@@ -132,6 +143,8 @@ daemon :: daemon()
     , m_protect_stats()
     , m_stats_start(0)
     , m_stats()
+    , m_reported_stats()
+    , m_reported_cpu_us(0)
 {
 }
 
@@ -175,7 +188,11 @@ daemon :: run(bool daemonize,
               po6::net::location bind_to,
               bool set_coordinator,
               po6::net::hostname coordinator,
-              unsigned threads)
+              unsigned threads,
+              unsigned scan_threads,
+              unsigned transfer_compression,
+              uint64_t background_rate,
+              uint64_t latency_target)
 {
     if (!install_signal_handler(SIGHUP, exit_on_signal))
     {
@@ -321,8 +338,12 @@ daemon :: run(bool daemonize,
     determine_block_stat_path(data);
     m_comm.setup(bind_to, threads);
     m_repl.setup();
-    m_stm.setup();
-    m_sm.setup();
+    m_stm.setup(transfer_compression);
+    m_sm.setup(scan_threads);
+    m_reads.setup(threads);
+    m_admission.set_threads(threads);
+    m_background.set_rate(background_rate);
+    m_background.set_latency_target(latency_target);
 
     for (size_t i = 0; i < threads; ++i)
     {
@@ -375,33 +396,35 @@ daemon :: run(bool daemonize,
             requested_exit = true;
         }
 
-        if (m_config.version() > 0 &&
+        if (m_config->version() > 0 &&
             checkpoint < m_coord.checkpoint())
         {
             checkpoint = m_coord.checkpoint();
             m_repl.begin_checkpoint(checkpoint);
         }
 
-        if (m_config.version() > 0 &&
+        if (m_config->version() > 0 &&
             checkpoint_stable < m_coord.checkpoint_stable())
         {
             checkpoint_stable = m_coord.checkpoint_stable();
             m_repl.end_checkpoint(checkpoint_stable);
         }
 
-        if (m_config.version() > 0 &&
+        if (m_config->version() > 0 &&
             checkpoint_gc < m_coord.checkpoint_gc())
         {
             checkpoint_gc = m_coord.checkpoint_gc();
             m_data.set_checkpoint_lower_gc(checkpoint_gc);
         }
 
+        m_config.reclaim();
+
         if (!m_coord.maintain_link())
         {
             continue;
         }
 
-        const configuration& old_config(m_config);
+        const configuration& old_config(*m_config);
         const configuration& new_config(m_coord.config());
 
         if (old_config.cluster() != 0 &&
@@ -423,23 +446,76 @@ daemon :: run(bool daemonize,
             continue;
         }
 
-        LOG(INFO) << "moving to configuration version=" << new_config.version()
-                  << "; pausing all activity while we reconfigure";
+        // When nothing we host changed, network and read threads keep serving
+        // and move to the new configuration between requests; only the
+        // background threads and scans stop while it is swapped in.
+        bool in_place = old_config.version() > 0 &&
+                        old_config.unchanged_for(m_us, new_config);
+
+        if (in_place)
+        {
+            LOG(INFO) << "moving to configuration version=" << new_config.version()
+                      << "; nothing we host changed, so we keep serving";
+        }
+        else
+        {
+            LOG(INFO) << "moving to configuration version=" << new_config.version()
+                      << "; pausing all activity while we reconfigure";
+        }
+
         m_sm.pause();
+
+        if (!in_place)
+        {
+            m_reads.pause();
+        }
+
         m_stm.pause();
         m_repl.pause();
         m_data.pause();
-        m_comm.pause();
-        m_comm.reconfigure(old_config, new_config, m_us);
+
+        if (!in_place)
+        {
+            m_comm.pause();
+            m_comm.reconfigure(old_config, new_config, m_us);
+        }
+
         m_data.reconfigure(old_config, new_config, m_us);
-        m_repl.reconfigure(old_config, new_config, m_us);
+
+        if (in_place)
+        {
+            m_repl.reconfigure_in_place(new_config);
+        }
+        else
+        {
+            m_repl.reconfigure(old_config, new_config, m_us);
+        }
+
         m_stm.reconfigure(old_config, new_config, m_us);
         m_sm.reconfigure(old_config, new_config, m_us);
-        m_config = new_config;
-        m_comm.unpause();
+        m_config.publish(new_config);
+
+        if (in_place)
+        {
+            // a thread still on the old configuration may be holding back a
+            // message as early; release them once every thread has moved on
+            m_config.synchronize();
+            m_comm.reconfigure(old_config, new_config, m_us);
+        }
+        else
+        {
+            m_comm.unpause();
+        }
+
         m_data.unpause();
         m_repl.unpause();
         m_stm.unpause();
+
+        if (!in_place)
+        {
+            m_reads.unpause();
+        }
+
         m_sm.unpause();
         LOG(INFO) << "reconfiguration complete; resuming normal operation";
 
@@ -476,6 +552,7 @@ daemon :: run(bool daemonize,
     }
 
     m_sm.teardown();
+    m_reads.teardown();
     m_stm.teardown();
     m_repl.teardown();
     m_comm.teardown();
@@ -528,11 +605,24 @@ daemon :: loop(size_t thread)
     network_msgtype type;
     std::auto_ptr<e::buffer> msg;
     e::unpacker up;
+    scratch_arena* arena = scratch_arena::current();
+
+    size_t slot = m_config.enroll();
 
-    while (m_comm.recv(&from, &vfrom, &vto, &type, &msg, &up))
+    while (m_comm.recv(slot, &from, &vfrom, &vto, &type, &msg, &up))
     {
         assert(from != server_id());
         assert(vto != virtual_server_id());
+        admission_control::traffic_class tc = admission_control::classify(type);
+
+        uint64_t pending_scans = tc == admission_control::SCAN ? m_sm.pending_scans() : 0;
+
+        if (!m_admission.admit(from, tc, pending_scans))
+        {
+            shed_request(from, vto, up);
+            arena->reset();
+            continue;
+        }
 
         switch (type)
         {
@@ -588,6 +678,10 @@ daemon :: loop(size_t thread)
                 process_chain_gc(from, vfrom, vto, msg, up);
                 m_perf_chain_gc.tap();
                 break;
+            case CHAIN_BATCH:
+                process_chain_batch(from, vfrom, vto, msg, up);
+                m_perf_chain_batch.tap();
+                break;
             case XFER_HS:
                 process_xfer_handshake_syn(from, vfrom, vto, msg, up);
                 m_perf_xfer_handshake_syn.tap();
@@ -612,6 +706,14 @@ daemon :: loop(size_t thread)
                 process_xfer_ack(from, vfrom, vto, msg, up);
                 m_perf_xfer_ack.tap();
                 break;
+            case REGION_STATS:
+                process_region_stats(from, vfrom, vto, msg, up);
+                m_perf_region_stats.tap();
+                break;
+            case BULK_LOAD:
+                process_bulk_load(from, vfrom, vto, msg, up);
+                m_perf_bulk_load.tap();
+                break;
             case BACKUP:
                 process_backup(from, vfrom, vto, msg, up);
                 m_perf_backup.tap();
@@ -627,17 +729,39 @@ daemon :: loop(size_t thread)
             case RESP_GROUP_DEL:
             case RESP_COUNT:
             case RESP_SEARCH_DESCRIBE:
+            case OVERLOADED:
             case CONFIGMISMATCH:
             case PACKET_NOP:
             default:
                 LOG(INFO) << "received " << type << " message which servers do not process";
                 break;
         }
+
+        m_admission.finish(tc);
+        arena->reset();
     }
 
+    m_config.offline(slot);
     LOG(INFO) << "network thread shutting down";
 }
 
+void
+daemon :: shed_request(server_id from, virtual_server_id vto, e::unpacker up)
+{
+    uint64_t nonce;
+
+    if ((up >> nonce).error())
+    {
+        return;
+    }
+
+    size_t sz = HYPERDEX_HEADER_SIZE_VC
+              + sizeof(uint64_t);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce;
+    m_comm.send_client(vto, from, OVERLOADED, msg);
+}
+
 void
 daemon :: process_req_get(server_id from,
                           virtual_server_id,
@@ -645,8 +769,13 @@ daemon :: process_req_get(server_id from,
                           std::auto_ptr<e::buffer> msg,
                           e::unpacker up)
 {
+    // background work backs off when reads slow down; a read handed to the
+    // read manager is observed there, once it is answered
+    uint64_t start = e::time();
     uint64_t nonce;
     e::slice key;
+    uint64_t max_lag_ms = 0;
+    bool bounded = false;
 
     if ((up >> nonce >> key).error())
     {
@@ -654,34 +783,74 @@ daemon :: process_req_get(server_id from,
         return;
     }
 
+    // reads sent away from the point leader carry a staleness bound
+    if (up.remain() > 0)
+    {
+        bounded = !(up >> max_lag_ms).error();
+    }
+
+    region_id ri(m_config->get_region_id(vto));
     std::vector<e::slice> value;
     uint64_t version;
     datalayer::reference ref;
-    network_returncode result;
+    datalayer::returncode rc;
+    m_data.count_read(ri);
+
+    if (bounded && m_config->point_leader(ri, key) != vto &&
+        (m_config->is_server_blocked_by_live_transfer(m_us, ri) ||
+         m_repl.unpersisted_age(ri, key) > max_lag_ms * 1000ULL * 1000ULL))
+    {
+        respond_to_get(from, vto, nonce, NET_STALE, value);
+    }
+    else if (m_data.get_cached(ri, key, &value, &version, &ref, &rc))
+    {
+        respond_to_get(from, vto, nonce, get_returncode(rc), value);
+        m_background.observe(e::time() - start);
+    }
+    else if (!m_reads.busy())
+    {
+        // the read may go to disk; don't hold up this thread
+        m_reads.get(from, vto, nonce, msg, key, start);
+    }
+    else
+    {
+        rc = m_data.get(ri, key, &value, &version, &ref);
+        respond_to_get(from, vto, nonce, get_returncode(rc), value);
+        m_background.observe(e::time() - start);
+    }
+}
 
-    switch (m_data.get(m_config.get_region_id(vto), key, &value, &version, &ref))
+hyperdex::network_returncode
+daemon :: get_returncode(datalayer::returncode rc)
+{
+    switch (rc)
     {
         case datalayer::SUCCESS:
-            result = NET_SUCCESS;
-            break;
+            return NET_SUCCESS;
         case datalayer::NOT_FOUND:
-            result = NET_NOTFOUND;
-            break;
+            return NET_NOTFOUND;
         case datalayer::BAD_ENCODING:
         case datalayer::CORRUPTION:
         case datalayer::IO_ERROR:
         case datalayer::LEVELDB_ERROR:
         default:
             LOG(ERROR) << "GET returned unacceptable error code.";
-            result = NET_SERVERERROR;
-            break;
+            return NET_SERVERERROR;
     }
+}
 
+void
+daemon :: respond_to_get(const server_id& from,
+                         const virtual_server_id& vto,
+                         uint64_t nonce,
+                         network_returncode result,
+                         const std::vector<e::slice>& value)
+{
     size_t sz = HYPERDEX_HEADER_SIZE_VC
               + sizeof(uint64_t)
               + sizeof(uint16_t)
               + pack_size(value);
-    msg.reset(e::buffer::create(sz));
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
     e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VC);
     pa = pa << nonce << static_cast<uint16_t>(result) << value;
     m_comm.send_client(vto, from, RESP_GET, msg);
@@ -790,7 +959,7 @@ daemon :: process_req_sorted_search(server_id from,
         return;
     }
 
-    m_sm.sorted_search(from, vto, nonce, &checks, limit, sort_by, flags & 0x1);
+    m_sm.sorted_search(from, vto, msg, nonce, &checks, limit, sort_by, flags & 0x1);
 }
 
 void
@@ -810,7 +979,7 @@ daemon :: process_req_group_del(server_id from,
     }
 
     e::slice sl("\x01\x00\x00\x00\x00\x00\x00\x00\x00", 9);
-    m_sm.group_keyop(from, vto, nonce, &checks, REQ_ATOMIC, sl, RESP_GROUP_DEL);
+    m_sm.group_keyop(from, vto, msg, nonce, &checks, REQ_ATOMIC, sl, RESP_GROUP_DEL);
 }
 
 void
@@ -829,7 +998,7 @@ daemon :: process_req_count(server_id from,
         return;
     }
 
-    m_sm.count(from, vto, nonce, &checks);
+    m_sm.count(from, vto, msg, nonce, &checks);
 }
 
 void
@@ -848,7 +1017,7 @@ daemon :: process_req_search_describe(server_id from,
         return;
     }
 
-    m_sm.search_describe(from, vto, nonce, &checks);
+    m_sm.search_describe(from, vto, msg, nonce, &checks);
 }
 
 void
@@ -864,8 +1033,20 @@ daemon :: process_chain_op(server_id,
     uint64_t version;
     e::slice key;
     std::vector<e::slice> value;
+    e::slice funcs;
+    up = up >> flags >> reg_id >> seq_id >> version >> key;
 
-    if ((up >> flags >> reg_id >> seq_id >> version >> key >> value).error())
+    // a delta carries the funcalls that produce the value instead
+    if ((flags & 4))
+    {
+        up = up >> funcs;
+    }
+    else
+    {
+        up = up >> value;
+    }
+
+    if (up.error())
     {
         LOG(WARNING) << "unpack of CHAIN_OP failed; here's some hex:  " << msg->hex();
         return;
@@ -874,7 +1055,7 @@ daemon :: process_chain_op(server_id,
     bool fresh = flags & 1;
     bool has_value = flags & 2;
     bool retransmission = flags & 128;
-    m_repl.chain_op(vfrom, vto, retransmission, region_id(reg_id), seq_id, version, fresh, has_value, msg, key, value);
+    m_repl.chain_op(vfrom, vto, retransmission, region_id(reg_id), seq_id, version, fresh, has_value, msg, key, value, funcs);
 }
 
 void
@@ -917,7 +1098,7 @@ daemon :: process_chain_gc(server_id,
         return;
     }
 
-    region_id ri = m_config.get_region_id(vfrom);
+    region_id ri = m_config->get_region_id(vfrom);
     m_repl.chain_gc(ri, seq_id);
 }
 
@@ -944,6 +1125,76 @@ daemon :: process_chain_ack(server_id,
     m_repl.chain_ack(vfrom, vto, retransmission, region_id(reg_id), seq_id, version, key);
 }
 
+void
+daemon :: process_chain_batch(server_id from,
+                              virtual_server_id,
+                              virtual_server_id,
+                              std::auto_ptr<e::buffer> msg,
+                              e::unpacker up)
+{
+    uint32_t count;
+
+    if ((up >> count).error())
+    {
+        LOG(WARNING) << "unpack of CHAIN_BATCH failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint8_t mt;
+        uint64_t version;
+        uint64_t vidf;
+        uint64_t vidt;
+        e::slice body;
+
+        if ((up >> mt >> version >> vidf >> vidt >> body).error())
+        {
+            LOG(WARNING) << "unpack of CHAIN_BATCH failed; here's some hex:  " << msg->hex();
+            return;
+        }
+
+        // The frame's header vouches for no virtual server, and carries the
+        // newest version in the frame; check every message the way
+        // communication::recv would have checked it on its own.
+        virtual_server_id vfrom(vidf);
+        virtual_server_id vto(vidt);
+
+        if (version < m_config->version() ||
+            m_config->get_server_id(vfrom) != from ||
+            m_config->get_server_id(vto) != m_us)
+        {
+            continue;
+        }
+
+        // handlers keep their message as the backing for what they unpack
+        size_t sz = HYPERDEX_HEADER_SIZE_VV + body.size();
+        std::auto_ptr<e::buffer> sub(e::buffer::create(sz));
+        memmove(sub->data() + HYPERDEX_HEADER_SIZE_VV, body.data(), body.size());
+        sub->resize(sz);
+        e::unpacker sup = sub->unpack_from(HYPERDEX_HEADER_SIZE_VV);
+
+        switch (static_cast<network_msgtype>(mt))
+        {
+            case CHAIN_OP:
+                process_chain_op(from, vfrom, vto, sub, sup);
+                m_perf_chain_op.tap();
+                break;
+            case CHAIN_SUBSPACE:
+                process_chain_subspace(from, vfrom, vto, sub, sup);
+                m_perf_chain_subspace.tap();
+                break;
+            case CHAIN_ACK:
+                process_chain_ack(from, vfrom, vto, sub, sup);
+                m_perf_chain_ack.tap();
+                break;
+            default:
+                LOG(WARNING) << "dropping " << static_cast<network_msgtype>(mt) << " message found in a CHAIN_BATCH";
+                break;
+        }
+    }
+}
+
 void
 daemon :: process_xfer_handshake_syn(server_id,
                                      virtual_server_id vfrom,
@@ -952,6 +1203,7 @@ daemon :: process_xfer_handshake_syn(server_id,
                                      e::unpacker up)
 {
     transfer_id xid;
+    uint8_t codecs = 0;
 
     if ((up >> xid).error())
     {
@@ -959,7 +1211,22 @@ daemon :: process_xfer_handshake_syn(server_id,
         return;
     }
 
-    m_stm.handshake_syn(vfrom, xid);
+    // the codecs the sender offers; older senders offer none
+    if (up.remain() > 0 && (up >> codecs).error())
+    {
+        LOG(WARNING) << "unpack of XFER_HS failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    uint8_t flags = 0;
+
+    if (up.remain() > 0 && (up >> flags).error())
+    {
+        LOG(WARNING) << "unpack of XFER_HS failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    m_stm.handshake_syn(vfrom, xid, codecs, flags);
 }
 
 void
@@ -971,6 +1238,7 @@ daemon :: process_xfer_handshake_synack(server_id from,
 {
     transfer_id xid;
     uint64_t timestamp;
+    uint8_t codecs = 0;
 
     if ((up >> xid >> timestamp).error())
     {
@@ -978,7 +1246,31 @@ daemon :: process_xfer_handshake_synack(server_id from,
         return;
     }
 
-    m_stm.handshake_synack(from, to, xid, timestamp);
+    // the codecs the receiver accepted; older receivers accept none
+    if (up.remain() > 0 && (up >> codecs).error())
+    {
+        LOG(WARNING) << "unpack of XFER_HSA failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    // a digest of the receiver's copy, if it has one
+    uint8_t has_digest = XFER_DIGEST_NONE;
+    merkle_tree digest;
+
+    if (up.remain() > 0 && (up >> has_digest).error())
+    {
+        LOG(WARNING) << "unpack of XFER_HSA failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    if (has_digest == XFER_DIGEST_INCLUDED && (up >> digest).error())
+    {
+        LOG(WARNING) << "unpack of XFER_HSA failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    m_stm.handshake_synack(from, to, xid, timestamp, codecs, has_digest,
+                           has_digest == XFER_DIGEST_INCLUDED ? &digest : NULL);
 }
 
 void
@@ -997,8 +1289,26 @@ daemon :: process_xfer_handshake_ack(server_id,
         return;
     }
 
+    // a partial wipe names the buckets to drop
+    std::vector<uint32_t> buckets;
+
+    if ((flags & 0x2) && (up >> buckets).error())
+    {
+        LOG(WARNING) << "unpack of XFER_HA failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    for (size_t i = 0; i < buckets.size(); ++i)
+    {
+        if (buckets[i] >= merkle_tree::BUCKETS)
+        {
+            LOG(WARNING) << "XFER_HA names bucket " << buckets[i] << " which does not exist";
+            return;
+        }
+    }
+
     bool wipe = flags & 0x1;
-    m_stm.handshake_ack(vfrom, xid, wipe);
+    m_stm.handshake_ack(vfrom, xid, wipe, buckets);
 }
 
 void
@@ -1026,21 +1336,48 @@ daemon :: process_xfer_op(server_id,
                           std::auto_ptr<e::buffer> msg,
                           e::unpacker up)
 {
-    uint8_t flags;
     uint64_t xid;
-    uint64_t seq_no;
-    uint64_t version;
-    e::slice key;
-    std::vector<e::slice> value;
+    uint8_t flags;
+    uint16_t stream;
+    uint32_t count;
+
+    if ((up >> xid >> flags >> stream).error())
+    {
+        LOG(WARNING) << "unpack of XFER_OP failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    if ((flags & XFER_CODEC_LZ))
+    {
+        uint32_t raw_sz;
+
+        if ((up >> raw_sz).error() || raw_sz > XFER_MAX_FRAME_BYTES)
+        {
+            LOG(WARNING) << "unpack of XFER_OP failed; here's some hex:  " << msg->hex();
+            return;
+        }
+
+        e::slice z = up.as_slice();
+        std::auto_ptr<e::buffer> raw(e::buffer::create(raw_sz));
+
+        if (!lz_decompress(z.data(), z.size(), raw->data(), raw_sz))
+        {
+            LOG(WARNING) << "dropping XFER_OP that does not decompress";
+            return;
+        }
 
-    if ((up >> flags >> xid >> seq_no >> version >> key >> value).error())
+        raw->resize(raw_sz);
+        msg = raw;
+        up = msg->unpack_from(0);
+    }
+
+    if ((up >> count).error())
     {
         LOG(WARNING) << "unpack of XFER_OP failed; here's some hex:  " << msg->hex();
         return;
     }
 
-    bool has_value = flags & 1;
-    m_stm.xfer_op(vfrom, transfer_id(xid), seq_no, has_value, version, msg, key, value);
+    m_stm.xfer_op(vfrom, transfer_id(xid), stream, count, msg, up);
 }
 
 void
@@ -1052,15 +1389,83 @@ daemon :: process_xfer_ack(server_id from,
 {
     uint8_t flags;
     uint64_t xid;
+    uint16_t stream;
     uint64_t seq_no;
 
-    if ((up >> flags >> xid >> seq_no).error())
+    if ((up >> flags >> xid >> stream >> seq_no).error())
     {
         LOG(WARNING) << "unpack of XFER_ACK failed; here's some hex:  " << msg->hex();
         return;
     }
 
-    m_stm.xfer_ack(from, vto, transfer_id(xid), seq_no);
+    m_stm.xfer_ack(from, vto, transfer_id(xid), stream, seq_no);
+}
+
+void
+daemon :: process_region_stats(server_id from,
+                               virtual_server_id,
+                               virtual_server_id vto,
+                               std::auto_ptr<e::buffer> msg,
+                               e::unpacker up)
+{
+    uint64_t nonce;
+
+    if ((up >> nonce).error())
+    {
+        LOG(WARNING) << "unpack of REGION_STATS failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    std::string stats;
+    m_data.get_property(e::slice("hyperdex.region-stats"), &stats);
+    e::slice text(stats);
+    size_t sz = HYPERDEX_HEADER_SIZE_VC
+              + sizeof(uint64_t)
+              + sizeof(uint16_t)
+              + pack_size(text);
+    msg.reset(e::buffer::create(sz));
+    e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VC);
+    pa = pa << nonce << static_cast<uint16_t>(NET_SUCCESS) << text;
+    m_comm.send_client(vto, from, REGION_STATS, msg);
+}
+
+void
+daemon :: process_bulk_load(server_id from,
+                            virtual_server_id,
+                            virtual_server_id vto,
+                            std::auto_ptr<e::buffer> msg,
+                            e::unpacker up)
+{
+    uint64_t nonce;
+    e::slice _space;
+    e::slice _path;
+
+    if ((up >> nonce >> _space >> _path).error())
+    {
+        LOG(WARNING) << "unpack of BULK_LOAD failed; here's some hex:  " << msg->hex();
+        return;
+    }
+
+    std::string space(reinterpret_cast<const char*>(_space.data()), _space.size());
+    std::string path(reinterpret_cast<const char*>(_path.data()), _path.size());
+    // the load can take far longer than a reconfiguration should wait on a
+    // network thread, so it runs on the datalayer's bulk loading thread
+    m_data.request_bulk_load(from, vto, nonce, space, path);
+}
+
+void
+daemon :: respond_to_bulk_load(const server_id& from,
+                               const virtual_server_id& vto,
+                               uint64_t nonce,
+                               network_returncode result)
+{
+    size_t sz = HYPERDEX_HEADER_SIZE_VC
+              + sizeof(uint64_t)
+              + sizeof(uint16_t);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VC);
+    pa = pa << nonce << static_cast<uint16_t>(result);
+    m_comm.send_client(vto, from, BULK_LOAD, msg);
 }
 
 void
@@ -1156,6 +1561,8 @@ daemon :: process_perf_counters(server_id from,
 }
 
 #define INTERVAL 100000000ULL
+// report region load to the coordinator every this many intervals
+#define REGION_REPORT_INTERVALS 100ULL
 
 void
 daemon :: collect_stats()
@@ -1168,6 +1575,8 @@ daemon :: collect_stats()
         m_stats_start = target;
     }
 
+    uint64_t intervals = 0;
+
     while (__sync_fetch_and_add(&s_interrupts, 0) == 0)
     {
         // every INTERVAL nanoseconds collect stats
@@ -1186,6 +1595,8 @@ daemon :: collect_stats()
         std::ostringstream ret;
         ret << target;
         collect_stats_msgs(&ret);
+        collect_stats_memory(&ret);
+        collect_stats_regions(&ret);
         collect_stats_leveldb(&ret);
         collect_stats_io(&ret);
         ret << "\n";
@@ -1201,6 +1612,12 @@ daemon :: collect_stats()
 
         // next interval
         target += INTERVAL;
+        ++intervals;
+
+        if (intervals % REGION_REPORT_INTERVALS == 0)
+        {
+            report_region_load();
+        }
     }
 }
 
@@ -1220,9 +1637,75 @@ daemon :: collect_stats_msgs(std::ostringstream* ret)
     *ret << " msgs.chain_subspace=" << m_perf_chain_subspace.read();
     *ret << " msgs.chain_ack=" << m_perf_chain_ack.read();
     *ret << " msgs.chain_gc=" << m_perf_chain_gc.read();
+    *ret << " msgs.chain_batch=" << m_perf_chain_batch.read();
     *ret << " msgs.xfer_op=" << m_perf_xfer_op.read();
     *ret << " msgs.xfer_ack=" << m_perf_xfer_ack.read();
+    *ret << " msgs.region_stats=" << m_perf_region_stats.read();
+    *ret << " msgs.bulk_load=" << m_perf_bulk_load.read();
     *ret << " msgs.perf_counters=" << m_perf_perf_counters.read();
+    m_admission.collect_stats(ret);
+    *ret << " admission.scan_pending=" << m_sm.pending_scans();
+    m_background.collect_stats(ret);
+}
+
+void
+daemon :: collect_stats_memory(std::ostringstream* ret)
+{
+    *ret << " memory.scratch_mallocs=" << scratch_arena::mallocs();
+}
+
+void
+daemon :: collect_stats_regions(std::ostringstream* ret)
+{
+    std::vector<std::pair<region_id, region_stats> > stats;
+    m_data.get_region_stats(&stats);
+
+    for (size_t i = 0; i < stats.size(); ++i)
+    {
+        uint64_t ri = stats[i].first.get();
+        *ret << " region." << ri << ".objects=" << stats[i].second.objects;
+        *ret << " region." << ri << ".bytes=" << stats[i].second.bytes;
+        *ret << " region." << ri << ".index_bytes=" << stats[i].second.index_bytes;
+        *ret << " region." << ri << ".writes=" << stats[i].second.writes;
+        *ret << " region." << ri << ".reads=" << stats[i].second.reads;
+    }
+}
+
+void
+daemon :: report_region_load()
+{
+    std::vector<std::pair<region_id, region_stats> > stats;
+    m_data.get_region_stats(&stats);
+    const uint64_t seconds = (REGION_REPORT_INTERVALS * INTERVAL) / 1000000000ULL;
+
+    for (size_t i = 0; i < stats.size(); ++i)
+    {
+        // regions we have not seen before report their ops since startup
+        region_stats& last(m_reported_stats[stats[i].first]);
+        region_stats total = stats[i].second;
+        stats[i].second.writes = std::max<int64_t>(total.writes - last.writes, 0) / seconds;
+        stats[i].second.reads = std::max<int64_t>(total.reads - last.reads, 0) / seconds;
+        last = total;
+    }
+
+    // the share of the machine's processors we kept busy, in thousandths
+    struct rusage ru;
+    uint64_t cpu = 0;
+
+    if (getrusage(RUSAGE_SELF, &ru) == 0)
+    {
+        uint64_t now = (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000ULL
+                     + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        cpus = cpus > 0 ? cpus : 1;
+        cpu = now > m_reported_cpu_us
+            ? ((now - m_reported_cpu_us) * 1000ULL) / (seconds * 1000000ULL * cpus)
+            : 0;
+        m_reported_cpu_us = now;
+    }
+
+    // the coordinator sorts out which of these regions we lead
+    m_coord.region_report(std::min<uint64_t>(cpu, 1000), stats);
 }
 
 namespace
@@ -1244,6 +1727,7 @@ void
 daemon :: collect_stats_leveldb(std::ostringstream* ret)
 {
     *ret << " leveldb.size=" << m_data.approximate_size();
+    m_data.collect_cache_stats(ret);
     std::string tmp;
 
     if (m_data.get_property(e::slice("leveldb.stats"), &tmp))
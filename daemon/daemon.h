@@ -44,10 +44,15 @@
 // HyperDex
 #include "namespace.h"
 #include "common/ids.h"
+#include "common/network_returncode.h"
+#include "daemon/admission_control.h"
 #include "daemon/communication.h"
+#include "daemon/config_publisher.h"
 #include "daemon/coordinator_link_wrapper.h"
 #include "daemon/datalayer.h"
 #include "daemon/performance_counter.h"
+#include "daemon/rate_limiter.h"
+#include "daemon/read_manager.h"
 #include "daemon/replication_manager.h"
 #include "daemon/search_manager.h"
 #include "daemon/state_transfer_manager.h"
@@ -68,12 +73,20 @@ class daemon
                 po6::net::location bind_to,
                 bool set_coordinator,
                 po6::net::hostname coordinator,
-                unsigned threads);
+                unsigned threads,
+                unsigned scan_threads,
+                unsigned transfer_compression,
+                uint64_t background_rate,
+                uint64_t latency_target);
 
     private:
         void loop(size_t thread);
         void process_req_get(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        static network_returncode get_returncode(datalayer::returncode rc);
+        void respond_to_get(const server_id& from, const virtual_server_id& vto, uint64_t nonce, network_returncode result, const std::vector<e::slice>& value);
         void process_req_atomic(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        // answer a request admission control refused with OVERLOADED
+        void shed_request(server_id from, virtual_server_id vto, e::unpacker up);
         void process_req_search_start(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_req_search_next(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_req_search_stop(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
@@ -85,26 +98,36 @@ class daemon
         void process_chain_subspace(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_chain_ack(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_chain_gc(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        void process_chain_batch(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_xfer_handshake_syn(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_xfer_handshake_synack(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_xfer_handshake_ack(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_xfer_handshake_wiped(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_xfer_op(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_xfer_ack(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        void process_region_stats(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        void process_bulk_load(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        // called by the datalayer's bulk loading thread
+        void respond_to_bulk_load(const server_id& from, const virtual_server_id& vto, uint64_t nonce, network_returncode result);
         void process_backup(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_perf_counters(server_id from, virtual_server_id vfrom, virtual_server_id vto, std::auto_ptr<e::buffer> msg, e::unpacker up);
 
     private:
         void collect_stats();
         void collect_stats_msgs(std::ostringstream* ret);
+        void collect_stats_memory(std::ostringstream* ret);
+        void collect_stats_regions(std::ostringstream* ret);
         void collect_stats_leveldb(std::ostringstream* ret);
         void determine_block_stat_path(const po6::pathname& data);
         void collect_stats_io(std::ostringstream* ret);
+        // tell the coordinator how large and how busy we and our regions are
+        void report_region_load();
 
     private:
         friend class communication;
         friend class coordinator_link_wrapper;
         friend class datalayer;
+        friend class read_manager;
         friend class replication_manager;
         friend class search_manager;
         friend class state_transfer_manager;
@@ -119,7 +142,11 @@ class daemon
         replication_manager m_repl;
         state_transfer_manager m_stm;
         search_manager m_sm;
-        configuration m_config;
+        read_manager m_reads;
+        admission_control m_admission;
+        // paces state transfer and wipes
+        rate_limiter m_background;
+        config_publisher m_config;
         // counters
         performance_counter m_perf_req_get;
         performance_counter m_perf_req_atomic;
@@ -134,12 +161,15 @@ class daemon
         performance_counter m_perf_chain_subspace;
         performance_counter m_perf_chain_ack;
         performance_counter m_perf_chain_gc;
+        performance_counter m_perf_chain_batch;
         performance_counter m_perf_xfer_handshake_syn;
         performance_counter m_perf_xfer_handshake_synack;
         performance_counter m_perf_xfer_handshake_ack;
         performance_counter m_perf_xfer_handshake_wiped;
         performance_counter m_perf_xfer_op;
         performance_counter m_perf_xfer_ack;
+        performance_counter m_perf_region_stats;
+        performance_counter m_perf_bulk_load;
         performance_counter m_perf_backup;
         performance_counter m_perf_perf_counters;
         // iostat-like stats
@@ -149,6 +179,9 @@ class daemon
         po6::threads::mutex m_protect_stats;
         uint64_t m_stats_start;
         std::list<std::pair<uint64_t, std::string> > m_stats;
+        // the counters as of the last report to the coordinator
+        std::map<region_id, region_stats> m_reported_stats;
+        uint64_t m_reported_cpu_us;
 };
 
 END_HYPERDEX_NAMESPACE
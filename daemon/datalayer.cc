@@ -32,7 +32,11 @@
 #endif
 
 // POSIX
+#include <fcntl.h>
 #include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
 
 // STL
 #include <algorithm>
@@ -46,11 +50,19 @@
 #include <hyperleveldb/write_batch.h>
 #include <hyperleveldb/filter_policy.h>
 
+// po6
+#include <po6/io/fd.h>
+
 // e
+#include <e/atomic.h>
 #include <e/endian.h>
+#include <e/guard.h>
+#include <e/strescape.h>
 
 // HyperDex
+#include "cityhash/city.h"
 #include "common/datatypes.h"
+#include "common/hash.h"
 #include "common/macros.h"
 #include "common/range_searches.h"
 #include "common/serialization.h"
@@ -58,36 +70,97 @@
 #include "daemon/datalayer.h"
 #include "daemon/datalayer_encodings.h"
 #include "daemon/datalayer_iterator.h"
+#include "daemon/merkle_tree.h"
 
 #define STRLENOF(x)	(sizeof(x)-1)
 
+// write bulk loaded objects in batches of roughly this many bytes
+#define BULK_LOAD_BATCH_SIZE (16ULL * 1024ULL * 1024ULL)
+// objects of a dump read between checks for a reconfiguration to pause for
+#define BULK_LOAD_PAUSE_INTERVAL 4096
+// bytes of recently read objects kept in memory for the network threads
+#define OBJECT_CACHE_CAPACITY (64ULL * 1024ULL * 1024ULL)
+// objects moved per slice of a relabel; keyed operations on the new regions
+// wait for a slice to finish
+#define RELABEL_SLICE_OBJECTS 1024
+// a wiped region's 'i' and 'o' ranges are each compacted in this many slices,
+// split on the first byte after the region id
+#define COMPACT_SLICES 256
+// replay streams split a region at key prefixes up to this many bytes long
+#define REPLAY_SPLIT_DEPTH 3
+
 // ASSUME:  all keys put into leveldb have a first byte without the high bit set
 
 using hyperdex::datalayer;
 using hyperdex::reconfigure_returncode;
+using hyperdex::region_stats_slot;
+
+class hyperdex::region_stats_slot
+{
+    public:
+        region_stats_slot(uint32_t i) : id(i), mtx(), stats() {}
+        ~region_stats_slot() throw () {}
+
+    public:
+        const uint32_t id;
+        po6::threads::mutex mtx;
+        std::map<region_id, region_stats> stats;
+
+    private:
+        region_stats_slot(const region_stats_slot&);
+        region_stats_slot& operator = (const region_stats_slot&);
+};
+
+// the generation tells a thread's slot apart from one it held in a
+// datalayer that has since been destroyed
+static __thread region_stats_slot* s_stats_slot = NULL;
+static __thread uint64_t s_stats_generation = 0;
+static uint64_t s_stats_generations = 0;
 
 datalayer :: datalayer(daemon* d)
     : m_daemon(d)
     , m_db()
     , m_checkpointer(std::tr1::bind(&datalayer::checkpointer, this))
     , m_wiper(std::tr1::bind(&datalayer::wiper, this))
+    , m_bulk_loader(std::tr1::bind(&datalayer::bulk_loader, this))
     , m_protect()
     , m_wakeup_checkpointer(&m_protect)
     , m_wakeup_wiper(&m_protect)
+    , m_wakeup_bulk_loader(&m_protect)
     , m_wakeup_reconfigurer(&m_protect)
     , m_shutdown(true)
     , m_need_pause(false)
     , m_checkpointer_paused(false)
     , m_wiper_paused(false)
+    , m_bulk_loader_paused(false)
     , m_checkpoint_gc(0)
     , m_wiping()
+    , m_compacting()
+    , m_compact_slice(0)
+    , m_relabeling()
+    , m_bulk_loads()
+    , m_relabels(0)
+    , m_configured(false)
+    , m_relabel_protect()
+    , m_acked_protect()
+    , m_acked()
+    , m_stats_generation(e::atomic::increment_64_nobarrier(&s_stats_generations, 1))
+    , m_stats_protect()
+    , m_stats_slots()
+    , m_cache(OBJECT_CACHE_CAPACITY)
 {
     po6::threads::mutex::hold hold(&m_protect);
+    m_stats_slots.push_back(new region_stats_slot(0));
 }
 
 datalayer :: ~datalayer() throw ()
 {
     shutdown();
+
+    for (size_t i = 0; i < m_stats_slots.size(); ++i)
+    {
+        delete m_stats_slots[i];
+    }
 }
 
 bool
@@ -211,10 +284,16 @@ datalayer :: initialize(const po6::pathname& path,
         return false;
     }
 
+    if (!load_acked() || !load_region_stats() || !load_relabels())
+    {
+        return false;
+    }
+
     {
         po6::threads::mutex::hold hold(&m_protect);
         m_checkpointer.start();
         m_wiper.start();
+        m_bulk_loader.start();
         m_shutdown = false;
     }
 
@@ -269,23 +348,26 @@ datalayer :: unpause()
     assert(m_need_pause);
     m_wakeup_checkpointer.broadcast();
     m_wakeup_wiper.broadcast();
+    m_wakeup_bulk_loader.broadcast();
     m_need_pause = false;
 }
 
 void
-datalayer :: reconfigure(const configuration&,
-                         const configuration&,
-                         const server_id&)
+datalayer :: reconfigure(const configuration& old_config,
+                         const configuration& new_config,
+                         const server_id& us)
 {
     {
         po6::threads::mutex::hold hold(&m_protect);
         assert(m_need_pause);
 
-        while (!m_checkpointer_paused || !m_wiper_paused)
+        while (!m_checkpointer_paused || !m_wiper_paused || !m_bulk_loader_paused)
         {
             m_wakeup_reconfigurer.wait();
         }
     }
+
+    relabel_retired(old_config, new_config, us);
 }
 
 bool
@@ -293,9 +375,63 @@ datalayer :: get_property(const e::slice& property,
                           std::string* value)
 {
     leveldb::Slice prop(reinterpret_cast<const char*>(property.data()), property.size());
+
+    if (prop == leveldb::Slice("hyperdex.region-stats"))
+    {
+        std::vector<std::pair<region_id, region_stats> > stats;
+        get_region_stats(&stats);
+        std::ostringstream ostr;
+
+        for (size_t i = 0; i < stats.size(); ++i)
+        {
+            ostr << stats[i].first.get()
+                 << " " << stats[i].second.objects
+                 << " " << stats[i].second.bytes
+                 << " " << stats[i].second.index_bytes << "\n";
+        }
+
+        *value = ostr.str();
+        return true;
+    }
+
     return m_db->GetProperty(prop, value);
 }
 
+void
+datalayer :: collect_cache_stats(std::ostringstream* ret)
+{
+    m_cache.collect_stats(ret);
+}
+
+void
+datalayer :: get_region_stats(std::vector<std::pair<region_id, region_stats> >* stats)
+{
+    std::map<region_id, region_stats> totals;
+    po6::threads::mutex::hold hold(&m_stats_protect);
+
+    for (size_t i = 0; i < m_stats_slots.size(); ++i)
+    {
+        region_stats_slot* slot = m_stats_slots[i];
+        po6::threads::mutex::hold hold_slot(&slot->mtx);
+
+        for (std::map<region_id, region_stats>::iterator it = slot->stats.begin();
+                it != slot->stats.end(); ++it)
+        {
+            totals[it->first] += it->second;
+        }
+    }
+
+    stats->assign(totals.begin(), totals.end());
+}
+
+void
+datalayer :: count_read(const region_id& ri)
+{
+    region_stats delta;
+    delta.reads = 1;
+    update_region_stats(ri, delta);
+}
+
 std::string
 datalayer :: get_timestamp()
 {
@@ -315,6 +451,80 @@ datalayer :: approximate_size()
     return ret;
 }
 
+namespace
+{
+
+// the size of an object as the client sees it
+int64_t
+logical_size(const e::slice& key, const std::vector<e::slice>& value)
+{
+    int64_t sz = key.size();
+
+    for (size_t i = 0; i < value.size(); ++i)
+    {
+        sz += value[i].size();
+    }
+
+    return sz;
+}
+
+// Sums the change in index bytes a batch makes.  Index entries carry no
+// value, so the size of a deleted entry is known from its key alone.  When
+// given a batch to forward to, it copies every update it sees into it.
+class index_bytes_counter : public leveldb::WriteBatch::Handler
+{
+    public:
+        index_bytes_counter(leveldb::WriteBatch* forward)
+            : bytes(0), m_forward(forward) {}
+        virtual ~index_bytes_counter() throw () {}
+
+    public:
+        virtual void Put(const leveldb::Slice& key, const leveldb::Slice& value)
+        {
+            if (key.size() > 0 && key[0] == 'i')
+            {
+                bytes += key.size() + value.size();
+            }
+
+            if (m_forward)
+            {
+                m_forward->Put(key, value);
+            }
+        }
+        virtual void Delete(const leveldb::Slice& key)
+        {
+            if (key.size() > 0 && key[0] == 'i')
+            {
+                bytes -= key.size();
+            }
+
+            if (m_forward)
+            {
+                m_forward->Delete(key);
+            }
+        }
+
+    public:
+        int64_t bytes;
+
+    private:
+        leveldb::WriteBatch* m_forward;
+
+    private:
+        index_bytes_counter(const index_bytes_counter&);
+        index_bytes_counter& operator = (const index_bytes_counter&);
+};
+
+int64_t
+index_bytes(const leveldb::WriteBatch& updates)
+{
+    index_bytes_counter counter(NULL);
+    updates.Iterate(&counter);
+    return counter.bytes;
+}
+
+} // namespace
+
 datalayer::returncode
 datalayer :: get(const region_id& ri,
                  const e::slice& key,
@@ -322,14 +532,24 @@ datalayer :: get(const region_id& ri,
                  uint64_t* version,
                  reference* ref)
 {
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
-    std::vector<char> scratch;
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
+    scratch_arena::scope arena(scratch_arena::current());
 
     // create the encoded key
     leveldb::Slice lkey;
-    encode_key(ri, sc.attrs[0].type, key, &scratch, &lkey);
+    encode_key(ri, sc.attrs[0].type, key, arena.arena(), &lkey);
+    e::slice ckey(lkey.data(), lkey.size());
+
+    if (m_cache.lookup(ckey, &ref->m_backing))
+    {
+        e::slice v(ref->m_backing.data(), ref->m_backing.size());
+        return decode_value(v, value, version);
+    }
+
+    relabel_key(ri, key);
 
     // perform the read
+    uint64_t gen = m_cache.generation(ckey);
     leveldb::ReadOptions opts;
     opts.fill_cache = true;
     opts.verify_checksums = true;
@@ -337,6 +557,7 @@ datalayer :: get(const region_id& ri,
 
     if (st.ok())
     {
+        m_cache.insert(ckey, ref->m_backing, gen);
         e::slice v(ref->m_backing.data(), ref->m_backing.size());
         return decode_value(v, value, version);
     }
@@ -350,6 +571,31 @@ datalayer :: get(const region_id& ri,
     }
 }
 
+bool
+datalayer :: get_cached(const region_id& ri,
+                        const e::slice& key,
+                        std::vector<e::slice>* value,
+                        uint64_t* version,
+                        reference* ref,
+                        returncode* rc)
+{
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
+    scratch_arena::scope arena(scratch_arena::current());
+
+    // create the encoded key
+    leveldb::Slice lkey;
+    encode_key(ri, sc.attrs[0].type, key, arena.arena(), &lkey);
+
+    if (!m_cache.lookup(e::slice(lkey.data(), lkey.size()), &ref->m_backing))
+    {
+        return false;
+    }
+
+    e::slice v(ref->m_backing.data(), ref->m_backing.size());
+    *rc = decode_value(v, value, version);
+    return true;
+}
+
 datalayer::returncode
 datalayer :: del(const region_id& ri,
                  const region_id& reg_id,
@@ -358,38 +604,51 @@ datalayer :: del(const region_id& ri,
                  const std::vector<e::slice>& old_value)
 {
     leveldb::WriteBatch updates;
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
-    std::vector<char> scratch;
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
+    scratch_arena::scope arena(scratch_arena::current());
 
     // create the encoded key
     leveldb::Slice lkey;
-    encode_key(ri, sc.attrs[0].type, key, &scratch, &lkey);
+    encode_key(ri, sc.attrs[0].type, key, arena.arena(), &lkey);
 
     // delete the actual object
     updates.Delete(lkey);
 
     // delete the index entries
-    const subspace& sub(*m_daemon->m_config.get_subspace(ri));
-    create_index_changes(sc, sub, ri, key, &old_value, NULL, &updates);
+    const subspace& sub(*m_daemon->m_config->get_subspace(ri));
+    create_index_changes(sc, sub, ri, key, &old_value, NULL, arena.arena(), &updates);
+    region_stats delta;
+    delta.objects = -1;
+    delta.bytes = -logical_size(key, old_value);
+    delta.index_bytes = index_bytes(updates);
+    delta.writes = 1;
 
     // Mark acked as part of this batch write
     if (seq_id != 0)
     {
         char abacking[ACKED_BUF_SIZE];
-        seq_id = UINT64_MAX - seq_id;
-        encode_acked(ri, reg_id, seq_id, abacking);
+        encode_acked(ri, reg_id, UINT64_MAX - seq_id, abacking);
         leveldb::Slice akey(abacking, ACKED_BUF_SIZE);
         leveldb::Slice aval("", 0);
         updates.Put(akey, aval);
     }
 
+    stage_region_stats(ri, delta, &updates);
+
     // Perform the write
     leveldb::WriteOptions opts;
     opts.sync = false;
     leveldb::Status st = m_db->Write(opts, &updates);
+    m_cache.invalidate(e::slice(lkey.data(), lkey.size()));
 
     if (st.ok())
     {
+        if (seq_id != 0)
+        {
+            insert_acked(ri, reg_id, seq_id);
+        }
+
+        update_region_stats(ri, delta);
         return SUCCESS;
     }
     else if (st.IsNotFound())
@@ -411,43 +670,55 @@ datalayer :: put(const region_id& ri,
                  uint64_t version)
 {
     leveldb::WriteBatch updates;
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
-    std::vector<char> scratch1;
-    std::vector<char> scratch2;
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
+    scratch_arena::scope arena(scratch_arena::current());
 
     // create the encoded key
     leveldb::Slice lkey;
-    encode_key(ri, sc.attrs[0].type, key, &scratch1, &lkey);
+    encode_key(ri, sc.attrs[0].type, key, arena.arena(), &lkey);
 
     // create the encoded value
     leveldb::Slice lval;
-    encode_value(new_value, version, &scratch2, &lval);
+    encode_value(new_value, version, arena.arena(), &lval);
 
     // put the actual object
     updates.Put(lkey, lval);
 
     // put the index entries
-    const subspace& sub(*m_daemon->m_config.get_subspace(ri));
-    create_index_changes(sc, sub, ri, key, NULL, &new_value, &updates);
+    const subspace& sub(*m_daemon->m_config->get_subspace(ri));
+    create_index_changes(sc, sub, ri, key, NULL, &new_value, arena.arena(), &updates);
+    region_stats delta;
+    delta.objects = 1;
+    delta.bytes = logical_size(key, new_value);
+    delta.index_bytes = index_bytes(updates);
+    delta.writes = 1;
 
     // Mark acked as part of this batch write
     if (seq_id != 0)
     {
         char abacking[ACKED_BUF_SIZE];
-        seq_id = UINT64_MAX - seq_id;
-        encode_acked(ri, reg_id, seq_id, abacking);
+        encode_acked(ri, reg_id, UINT64_MAX - seq_id, abacking);
         leveldb::Slice akey(abacking, ACKED_BUF_SIZE);
         leveldb::Slice aval("", 0);
         updates.Put(akey, aval);
     }
 
+    stage_region_stats(ri, delta, &updates);
+
     // Perform the write
     leveldb::WriteOptions opts;
     opts.sync = false;
     leveldb::Status st = m_db->Write(opts, &updates);
+    m_cache.invalidate(e::slice(lkey.data(), lkey.size()));
 
     if (st.ok())
     {
+        if (seq_id != 0)
+        {
+            insert_acked(ri, reg_id, seq_id);
+        }
+
+        update_region_stats(ri, delta);
         return SUCCESS;
     }
     else
@@ -466,43 +737,54 @@ datalayer :: overput(const region_id& ri,
                      uint64_t version)
 {
     leveldb::WriteBatch updates;
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
-    std::vector<char> scratch1;
-    std::vector<char> scratch2;
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
+    scratch_arena::scope arena(scratch_arena::current());
 
     // create the encoded key
     leveldb::Slice lkey;
-    encode_key(ri, sc.attrs[0].type, key, &scratch1, &lkey);
+    encode_key(ri, sc.attrs[0].type, key, arena.arena(), &lkey);
 
     // create the encoded value
     leveldb::Slice lval;
-    encode_value(new_value, version, &scratch2, &lval);
+    encode_value(new_value, version, arena.arena(), &lval);
 
     // put the actual object
     updates.Put(lkey, lval);
 
     // put the index entries
-    const subspace& sub(*m_daemon->m_config.get_subspace(ri));
-    create_index_changes(sc, sub, ri, key, &old_value, &new_value, &updates);
+    const subspace& sub(*m_daemon->m_config->get_subspace(ri));
+    create_index_changes(sc, sub, ri, key, &old_value, &new_value, arena.arena(), &updates);
+    region_stats delta;
+    delta.bytes = logical_size(key, new_value) - logical_size(key, old_value);
+    delta.index_bytes = index_bytes(updates);
+    delta.writes = 1;
 
     // Mark acked as part of this batch write
     if (seq_id != 0)
     {
         char abacking[ACKED_BUF_SIZE];
-        seq_id = UINT64_MAX - seq_id;
-        encode_acked(ri, reg_id, seq_id, abacking);
+        encode_acked(ri, reg_id, UINT64_MAX - seq_id, abacking);
         leveldb::Slice akey(abacking, ACKED_BUF_SIZE);
         leveldb::Slice aval("", 0);
         updates.Put(akey, aval);
     }
 
+    stage_region_stats(ri, delta, &updates);
+
     // Perform the write
     leveldb::WriteOptions opts;
     opts.sync = false;
     leveldb::Status st = m_db->Write(opts, &updates);
+    m_cache.invalidate(e::slice(lkey.data(), lkey.size()));
 
     if (st.ok())
     {
+        if (seq_id != 0)
+        {
+            insert_acked(ri, reg_id, seq_id);
+        }
+
+        update_region_stats(ri, delta);
         return SUCCESS;
     }
     else
@@ -515,12 +797,13 @@ datalayer::returncode
 datalayer :: uncertain_del(const region_id& ri,
                            const e::slice& key)
 {
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
-    std::vector<char> scratch;
+    relabel_key(ri, key);
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
+    scratch_arena::scope arena(scratch_arena::current());
 
     // create the encoded key
     leveldb::Slice lkey;
-    encode_key(ri, sc.attrs[0].type, key, &scratch, &lkey);
+    encode_key(ri, sc.attrs[0].type, key, arena.arena(), &lkey);
 
     // perform the read
     std::string ref;
@@ -564,12 +847,13 @@ datalayer :: uncertain_put(const region_id& ri,
                            const std::vector<e::slice>& new_value,
                            uint64_t version)
 {
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
-    std::vector<char> scratch;
+    relabel_key(ri, key);
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
+    scratch_arena::scope arena(scratch_arena::current());
 
     // create the encoded key
     leveldb::Slice lkey;
-    encode_key(ri, sc.attrs[0].type, key, &scratch, &lkey);
+    encode_key(ri, sc.attrs[0].type, key, arena.arena(), &lkey);
 
     // perform the read
     std::string ref;
@@ -607,47 +891,150 @@ datalayer :: uncertain_put(const region_id& ri,
     }
 }
 
-bool
-datalayer :: check_acked(const region_id& ri,
-                         const region_id& reg_id,
-                         uint64_t seq_id)
+datalayer::returncode
+datalayer :: apply_transfer(const region_id& ri,
+                            const std::vector<transfer_object>& objs,
+                            std::string* written_max)
 {
-    // make it so that increasing seq_ids are ordered in reverse in the KVS
-    seq_id = UINT64_MAX - seq_id;
-    leveldb::ReadOptions opts;
-    opts.fill_cache = true;
-    opts.verify_checksums = true;
-    char abacking[ACKED_BUF_SIZE];
-    encode_acked(ri, reg_id, seq_id, abacking);
-    leveldb::Slice akey(abacking, ACKED_BUF_SIZE);
-    std::string val;
-    leveldb::Status st = m_db->Get(opts, akey, &val);
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
+    const subspace& sub(*m_daemon->m_config->get_subspace(ri));
+    leveldb::WriteBatch updates;
+    std::set<std::string> keys;
+    region_stats delta;
+    returncode ret = SUCCESS;
 
-    if (st.ok())
-    {
-        return true;
-    }
-    else if (st.IsNotFound())
+    for (size_t i = 0; i < objs.size(); ++i)
     {
-        return false;
+        const transfer_object& obj(objs[i]);
+        scratch_arena::scope arena(scratch_arena::current());
+
+        // create the encoded key
+        leveldb::Slice lkey;
+        encode_key(ri, sc.attrs[0].type, obj.key, arena.arena(), &lkey);
+        std::string k(lkey.data(), lkey.size());
+
+        // a key already in this batch has to be on disk before it can be
+        // read back
+        if (keys.find(k) != keys.end())
+        {
+            returncode rc = flush_transfer(ri, &updates, &keys, &delta);
+
+            if (rc != SUCCESS)
+            {
+                return rc;
+            }
+        }
+
+        std::string backing;
+        std::vector<e::slice> old_value;
+        const std::vector<e::slice>* old_value_ptr = NULL;
+
+        if (!written_max || k <= *written_max)
+        {
+            leveldb::ReadOptions opts;
+            opts.fill_cache = false;
+            opts.verify_checksums = true;
+            leveldb::Status st = m_db->Get(opts, lkey, &backing);
+
+            if (st.ok())
+            {
+                uint64_t old_version;
+                returncode rc = decode_value(e::slice(backing.data(), backing.size()),
+                                             &old_value, &old_version);
+
+                if (rc == SUCCESS && old_value.size() + 1 != sc.attrs_sz)
+                {
+                    rc = BAD_ENCODING;
+                }
+
+                if (rc != SUCCESS)
+                {
+                    ret = rc;
+                    continue;
+                }
+
+                old_value_ptr = &old_value;
+            }
+            else if (!st.IsNotFound())
+            {
+                ret = handle_error(st);
+                continue;
+            }
+        }
+        else
+        {
+            *written_max = k;
+        }
+
+        if (obj.has_value)
+        {
+            leveldb::Slice lval;
+            encode_value(*obj.value, obj.version, arena.arena(), &lval);
+            updates.Put(lkey, lval);
+            create_index_changes(sc, sub, ri, obj.key, old_value_ptr, obj.value, arena.arena(), &updates);
+            delta.objects += old_value_ptr ? 0 : 1;
+            delta.bytes += logical_size(obj.key, *obj.value)
+                         - (old_value_ptr ? logical_size(obj.key, old_value) : 0);
+        }
+        else if (old_value_ptr)
+        {
+            updates.Delete(lkey);
+            create_index_changes(sc, sub, ri, obj.key, old_value_ptr, NULL, arena.arena(), &updates);
+            delta.objects -= 1;
+            delta.bytes -= logical_size(obj.key, old_value);
+        }
+
+        keys.insert(k);
     }
-    else if (st.IsCorruption())
+
+    returncode rc = flush_transfer(ri, &updates, &keys, &delta);
+    return rc != SUCCESS ? rc : ret;
+}
+
+datalayer::returncode
+datalayer :: flush_transfer(const region_id& ri,
+                            leveldb::WriteBatch* updates,
+                            std::set<std::string>* keys,
+                            region_stats* delta)
+{
+    if (keys->empty())
     {
-        LOG(ERROR) << "corruption at the disk layer: region=" << reg_id
-                   << " seq_id=" << seq_id << " desc=" << st.ToString();
-        return false;
+        return SUCCESS;
     }
-    else if (st.IsIOError())
+
+    delta->index_bytes = index_bytes(*updates);
+    stage_region_stats(ri, *delta, updates);
+    leveldb::WriteOptions opts;
+    opts.sync = false;
+    leveldb::Status st = m_db->Write(opts, updates);
+
+    for (std::set<std::string>::iterator it = keys->begin(); it != keys->end(); ++it)
     {
-        LOG(ERROR) << "IO error at the disk layer: region=" << reg_id
-                   << " seq_id=" << seq_id << " desc=" << st.ToString();
-        return false;
+        m_cache.invalidate(e::slice(*it));
     }
-    else
+
+    updates->Clear();
+    keys->clear();
+
+    if (!st.ok())
     {
-        LOG(ERROR) << "LevelDB returned an unknown error that we don't know how to handle";
-        return false;
+        *delta = region_stats();
+        return handle_error(st);
     }
+
+    update_region_stats(ri, *delta);
+    *delta = region_stats();
+    return SUCCESS;
+}
+
+bool
+datalayer :: check_acked(const region_id& ri,
+                         const region_id& reg_id,
+                         uint64_t seq_id)
+{
+    po6::threads::mutex::hold hold(&m_acked_protect);
+    acked_map_t::iterator it = m_acked.find(std::make_pair(reg_id, ri));
+    return it != m_acked.end() && it->second.contains(seq_id);
 }
 
 void
@@ -655,19 +1042,18 @@ datalayer :: mark_acked(const region_id& ri,
                         const region_id& reg_id,
                         uint64_t seq_id)
 {
-    // make it so that increasing seq_ids are ordered in reverse in the KVS
-    seq_id = UINT64_MAX - seq_id;
     leveldb::WriteOptions opts;
     opts.sync = false;
     char abacking[ACKED_BUF_SIZE];
-    encode_acked(ri, reg_id, seq_id, abacking);
+    // make it so that increasing seq_ids are ordered in reverse in the KVS
+    encode_acked(ri, reg_id, UINT64_MAX - seq_id, abacking);
     leveldb::Slice akey(abacking, ACKED_BUF_SIZE);
     leveldb::Slice val("", 0);
     leveldb::Status st = m_db->Put(opts, akey, val);
 
     if (st.ok())
     {
-        // Yay!
+        insert_acked(ri, reg_id, seq_id);
     }
     else if (st.IsNotFound())
     {
@@ -694,122 +1080,328 @@ void
 datalayer :: max_seq_id(const region_id& reg_id,
                         uint64_t* seq_id)
 {
-    leveldb::ReadOptions opts;
-    opts.fill_cache = false;
-    opts.verify_checksums = true;
-    opts.snapshot = NULL;
-    std::auto_ptr<leveldb::Iterator> it(m_db->NewIterator(opts));
-    char abacking[ACKED_BUF_SIZE];
-    encode_acked(reg_id, reg_id, 0, abacking);
-    leveldb::Slice key(abacking, ACKED_BUF_SIZE);
-    it->Seek(key);
-
-    if (!it->Valid())
-    {
-        *seq_id = 0;
-        return;
-    }
-
-    key = it->key();
-    region_id tmp_ri;
-    region_id tmp_reg_id;
-    uint64_t tmp_seq_id;
-    datalayer::returncode rc = decode_acked(e::slice(key.data(), key.size()),
-                                            &tmp_ri, &tmp_reg_id, &tmp_seq_id);
+    po6::threads::mutex::hold hold(&m_acked_protect);
+    acked_map_t::iterator it = m_acked.find(std::make_pair(reg_id, reg_id));
+    *seq_id = 0;
 
-    if (rc != SUCCESS || tmp_ri != reg_id || tmp_reg_id != reg_id)
+    if (it != m_acked.end())
     {
-        *seq_id = 0;
-        return;
+        it->second.max(seq_id);
     }
-
-    *seq_id = UINT64_MAX - tmp_seq_id;
 }
 
 void
 datalayer :: clear_acked(const region_id& reg_id,
                          uint64_t seq_id)
 {
-    leveldb::ReadOptions opts;
-    opts.fill_cache = false;
-    opts.verify_checksums = true;
-    opts.snapshot = NULL;
-    std::auto_ptr<leveldb::Iterator> it(m_db->NewIterator(opts));
-    char abacking[ACKED_BUF_SIZE];
-    encode_acked(region_id(0), reg_id, 0, abacking);
-    it->Seek(leveldb::Slice(abacking, ACKED_BUF_SIZE));
-    encode_acked(region_id(0), region_id(reg_id.get() + 1), 0, abacking);
-    leveldb::Slice upper_bound(abacking, ACKED_BUF_SIZE);
-
-    while (it->Valid() &&
-           it->key().compare(upper_bound) < 0)
-    {
-        region_id tmp_ri;
-        region_id tmp_reg_id;
-        uint64_t tmp_seq_id;
-        datalayer::returncode rc = decode_acked(e::slice(it->key().data(), it->key().size()),
-                                                &tmp_ri, &tmp_reg_id, &tmp_seq_id);
-        tmp_seq_id = UINT64_MAX - tmp_seq_id;
-
-        if (rc == SUCCESS &&
-            tmp_reg_id == reg_id &&
-            tmp_seq_id < seq_id)
-        {
-            leveldb::WriteOptions wopts;
-            wopts.sync = false;
-            leveldb::Status st = m_db->Delete(wopts, it->key());
-
-            if (st.ok() || st.IsNotFound())
-            {
-                // WOOT!
-            }
-            else if (st.IsCorruption())
+    std::vector<std::pair<region_id, uint64_t> > cleared;
+
+    {
+        po6::threads::mutex::hold hold(&m_acked_protect);
+        acked_map_t::iterator it = m_acked.lower_bound(std::make_pair(reg_id, region_id(0)));
+        std::vector<uint64_t> seq_ids;
+
+        while (it != m_acked.end() && it->first.first == reg_id)
+        {
+            seq_ids.clear();
+            it->second.clear_below(seq_id, &seq_ids);
+
+            for (size_t i = 0; i < seq_ids.size(); ++i)
             {
-                LOG(ERROR) << "corruption at the disk layer: could not delete "
-                           << reg_id << " " << seq_id << ": desc=" << st.ToString();
+                cleared.push_back(std::make_pair(it->first.second, seq_ids[i]));
             }
-            else if (st.IsIOError())
+
+            if (it->second.empty())
             {
-                LOG(ERROR) << "IO error at the disk layer: could not delete "
-                           << reg_id << " " << seq_id << ": desc=" << st.ToString();
+                m_acked.erase(it++);
             }
             else
             {
-                LOG(ERROR) << "LevelDB returned an unknown error that we don't know how to handle";
+                ++it;
             }
         }
+    }
 
-        it->Next();
+    if (cleared.empty())
+    {
+        return;
     }
-}
 
-datalayer::snapshot
-datalayer :: make_snapshot()
-{
-    return leveldb_snapshot_ptr(m_db, m_db->GetSnapshot());
-}
+    // the in-memory window knows every record on disk, so there is no need to
+    // iterate LevelDB to find them
+    leveldb::WriteBatch updates;
 
-datalayer::iterator*
-datalayer :: make_region_iterator(snapshot snap,
-                                  const region_id& ri,
-                                  returncode* error)
-{
-    *error = datalayer::SUCCESS;
-    const size_t backing_sz = sizeof(uint8_t) + sizeof(uint64_t);
-    char backing[backing_sz];
-    char* ptr = backing;
-    ptr = e::pack8be('o', ptr);
-    ptr = e::pack64be(ri.get(), ptr);
+    for (size_t i = 0; i < cleared.size(); ++i)
+    {
+        char abacking[ACKED_BUF_SIZE];
+        encode_acked(cleared[i].first, reg_id, UINT64_MAX - cleared[i].second, abacking);
+        updates.Delete(leveldb::Slice(abacking, ACKED_BUF_SIZE));
+    }
 
-    leveldb::ReadOptions opts;
-    opts.fill_cache = true;
-    opts.verify_checksums = true;
-    opts.snapshot = snap.get();
-    leveldb_iterator_ptr iter;
-    iter.reset(snap, m_db->NewIterator(opts));
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
-    return new region_iterator(iter, ri, index_info::lookup(sc.attrs[0].type));
-}
+    leveldb::WriteOptions wopts;
+    wopts.sync = false;
+    leveldb::Status st = m_db->Write(wopts, &updates);
+
+    if (st.ok() || st.IsNotFound())
+    {
+        // WOOT!
+    }
+    else if (st.IsCorruption())
+    {
+        LOG(ERROR) << "corruption at the disk layer: could not delete "
+                   << reg_id << " " << seq_id << ": desc=" << st.ToString();
+    }
+    else if (st.IsIOError())
+    {
+        LOG(ERROR) << "IO error at the disk layer: could not delete "
+                   << reg_id << " " << seq_id << ": desc=" << st.ToString();
+    }
+    else
+    {
+        LOG(ERROR) << "LevelDB returned an unknown error that we don't know how to handle";
+    }
+}
+
+bool
+datalayer :: load_acked()
+{
+    leveldb::ReadOptions opts;
+    opts.fill_cache = false;
+    opts.verify_checksums = true;
+    opts.snapshot = NULL;
+    std::auto_ptr<leveldb::Iterator> it(m_db->NewIterator(opts));
+    leveldb::Slice prefix("a", 1);
+    it->Seek(prefix);
+    po6::threads::mutex::hold hold(&m_acked_protect);
+    m_acked.clear();
+
+    while (it->Valid() && it->key().starts_with(prefix))
+    {
+        region_id ri;
+        region_id reg_id;
+        uint64_t seq_id;
+        returncode rc = decode_acked(e::slice(it->key().data(), it->key().size()),
+                                     &ri, &reg_id, &seq_id);
+
+        if (rc != SUCCESS)
+        {
+            LOG(ERROR) << "could not restore from LevelDB because a previous "
+                       << "execution wrote an invalid acked record; "
+                       << "you'll need to manually erase this DB and create a new one";
+            return false;
+        }
+
+        m_acked[std::make_pair(reg_id, ri)].insert(UINT64_MAX - seq_id);
+        it->Next();
+    }
+
+    if (!it->status().ok())
+    {
+        LOG(ERROR) << "could not read acked records from LevelDB: " << it->status().ToString();
+        return false;
+    }
+
+    return true;
+}
+
+void
+datalayer :: insert_acked(const region_id& ri,
+                          const region_id& reg_id,
+                          uint64_t seq_id)
+{
+    po6::threads::mutex::hold hold(&m_acked_protect);
+    m_acked[std::make_pair(reg_id, ri)].insert(seq_id);
+}
+
+bool
+datalayer :: load_region_stats()
+{
+    leveldb::ReadOptions opts;
+    opts.fill_cache = false;
+    opts.verify_checksums = true;
+    opts.snapshot = NULL;
+    std::auto_ptr<leveldb::Iterator> it(m_db->NewIterator(opts));
+    leveldb::Slice prefix("r", 1);
+    it->Seek(prefix);
+    // fold the previous execution's slots into the base slot, so slot ids
+    // may be handed out afresh
+    std::map<region_id, region_stats> totals;
+    leveldb::WriteBatch updates;
+
+    while (it->Valid() && it->key().starts_with(prefix))
+    {
+        region_id ri;
+        uint32_t slot;
+        region_stats rs;
+        returncode rc = decode_region_stats(e::slice(it->key().data(), it->key().size()),
+                                            e::slice(it->value().data(), it->value().size()),
+                                            &ri, &slot, &rs);
+
+        if (rc != SUCCESS)
+        {
+            LOG(ERROR) << "could not restore from LevelDB because a previous "
+                       << "execution wrote an invalid region stats record; "
+                       << "you'll need to manually erase this DB and create a new one";
+            return false;
+        }
+
+        totals[ri] += rs;
+        updates.Delete(it->key());
+        it->Next();
+    }
+
+    if (!it->status().ok())
+    {
+        LOG(ERROR) << "could not read region stats from LevelDB: " << it->status().ToString();
+        return false;
+    }
+
+    for (std::map<region_id, region_stats>::iterator t = totals.begin();
+            t != totals.end(); ++t)
+    {
+        char kbacking[REGION_STATS_KEY_SIZE];
+        char vbacking[REGION_STATS_VALUE_SIZE];
+        encode_region_stats(t->first, 0, t->second, kbacking, vbacking);
+        updates.Put(leveldb::Slice(kbacking, REGION_STATS_KEY_SIZE),
+                    leveldb::Slice(vbacking, REGION_STATS_VALUE_SIZE));
+    }
+
+    leveldb::WriteOptions wopts;
+    wopts.sync = true;
+    leveldb::Status st = m_db->Write(wopts, &updates);
+
+    if (!st.ok())
+    {
+        LOG(ERROR) << "could not fold region stats in LevelDB: " << st.ToString();
+        return false;
+    }
+
+    po6::threads::mutex::hold hold(&m_stats_protect);
+    region_stats_slot* base = m_stats_slots[0];
+    po6::threads::mutex::hold hold_base(&base->mtx);
+    base->stats.swap(totals);
+    return true;
+}
+
+region_stats_slot*
+datalayer :: stats_slot()
+{
+    if (s_stats_slot && s_stats_generation == m_stats_generation)
+    {
+        return s_stats_slot;
+    }
+
+    po6::threads::mutex::hold hold(&m_stats_protect);
+    region_stats_slot* slot = new region_stats_slot(m_stats_slots.size());
+    m_stats_slots.push_back(slot);
+    s_stats_slot = slot;
+    s_stats_generation = m_stats_generation;
+    return slot;
+}
+
+void
+datalayer :: stage_region_stats(const region_id& ri,
+                                const region_stats& delta,
+                                leveldb::WriteBatch* updates)
+{
+    region_stats_slot* slot = stats_slot();
+    region_stats rs;
+
+    {
+        po6::threads::mutex::hold hold(&slot->mtx);
+        std::map<region_id, region_stats>::iterator it = slot->stats.find(ri);
+
+        if (it != slot->stats.end())
+        {
+            rs = it->second;
+        }
+    }
+
+    // a slot's totals may go negative (one thread deletes what another
+    // put); they wrap through the unsigned encoding and sum back correctly
+    rs += delta;
+    char kbacking[REGION_STATS_KEY_SIZE];
+    char vbacking[REGION_STATS_VALUE_SIZE];
+    encode_region_stats(ri, slot->id, rs, kbacking, vbacking);
+    updates->Put(leveldb::Slice(kbacking, REGION_STATS_KEY_SIZE),
+                 leveldb::Slice(vbacking, REGION_STATS_VALUE_SIZE));
+}
+
+void
+datalayer :: stage_region_stats(const std::map<region_id, region_stats>& deltas,
+                                leveldb::WriteBatch* updates)
+{
+    for (std::map<region_id, region_stats>::const_iterator d = deltas.begin();
+            d != deltas.end(); ++d)
+    {
+        stage_region_stats(d->first, d->second, updates);
+    }
+}
+
+void
+datalayer :: update_region_stats(const region_id& ri,
+                                 const region_stats& delta)
+{
+    region_stats_slot* slot = stats_slot();
+    po6::threads::mutex::hold hold(&slot->mtx);
+    slot->stats[ri] += delta;
+}
+
+void
+datalayer :: reset_region_stats(const region_id& ri)
+{
+    leveldb::WriteBatch updates;
+
+    {
+        po6::threads::mutex::hold hold(&m_stats_protect);
+
+        for (size_t i = 0; i < m_stats_slots.size(); ++i)
+        {
+            region_stats_slot* slot = m_stats_slots[i];
+            po6::threads::mutex::hold hold_slot(&slot->mtx);
+            slot->stats.erase(ri);
+            char kbacking[REGION_STATS_KEY_SIZE];
+            char vbacking[REGION_STATS_VALUE_SIZE];
+            encode_region_stats(ri, slot->id, region_stats(), kbacking, vbacking);
+            updates.Delete(leveldb::Slice(kbacking, REGION_STATS_KEY_SIZE));
+        }
+    }
+
+    leveldb::Status st = m_db->Write(leveldb::WriteOptions(), &updates);
+
+    if (!st.ok())
+    {
+        handle_error(st);
+    }
+}
+
+datalayer::snapshot
+datalayer :: make_snapshot()
+{
+    return leveldb_snapshot_ptr(m_db, m_db->GetSnapshot());
+}
+
+datalayer::iterator*
+datalayer :: make_region_iterator(snapshot snap,
+                                  const region_id& ri,
+                                  returncode* error)
+{
+    *error = datalayer::SUCCESS;
+    const size_t backing_sz = sizeof(uint8_t) + sizeof(uint64_t);
+    char backing[backing_sz];
+    char* ptr = backing;
+    ptr = e::pack8be('o', ptr);
+    ptr = e::pack64be(ri.get(), ptr);
+
+    leveldb::ReadOptions opts;
+    opts.fill_cache = true;
+    opts.verify_checksums = true;
+    opts.snapshot = snap.get();
+    leveldb_iterator_ptr iter;
+    iter.reset(snap, m_db->NewIterator(opts));
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
+    return new region_iterator(iter, ri, index_info::lookup(sc.attrs[0].type));
+}
 
 datalayer::iterator*
 datalayer :: make_search_iterator(snapshot snap,
@@ -817,14 +1409,14 @@ datalayer :: make_search_iterator(snapshot snap,
                                   const std::vector<attribute_check>& checks,
                                   std::ostringstream* ostr)
 {
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
     std::vector<e::intrusive_ptr<index_iterator> > iterators;
 
     // pull a set of range queries from checks
     std::vector<range> ranges;
     range_searches(checks, &ranges);
     index_info* ki = index_info::lookup(sc.attrs[0].type);
-    const subspace& sub(*m_daemon->m_config.get_subspace(ri));
+    const subspace& sub(*m_daemon->m_config->get_subspace(ri));
 
     // for each range query, construct an iterator
     for (size_t i = 0; i < ranges.size(); ++i)
@@ -978,277 +1570,242 @@ datalayer :: backup(const e::slice& _name)
     }
 }
 
-datalayer::returncode
-datalayer :: get_from_iterator(const region_id& ri,
-                               iterator* iter,
-                               e::slice* key,
-                               std::vector<e::slice>* value,
-                               uint64_t* version,
-                               reference* ref)
+static int
+compare_keys(const e::slice& lhs, const e::slice& rhs)
 {
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
-    std::vector<char> scratch;
-
-    // create the encoded key
-    leveldb::Slice lkey;
-    encode_key(ri, sc.attrs[0].type, iter->key(), &scratch, &lkey);
+    int cmp = memcmp(lhs.data(), rhs.data(), std::min(lhs.size(), rhs.size()));
 
-    // perform the read
-    leveldb::ReadOptions opts;
-    opts.fill_cache = true;
-    opts.verify_checksums = true;
-    opts.snapshot = iter->snap().get();
-    leveldb::Status st = m_db->Get(opts, lkey, &ref->m_backing);
-
-    if (st.ok())
+    if (cmp == 0)
     {
-        ref->m_backing += std::string(reinterpret_cast<const char*>(iter->key().data()), iter->key().size());
-        *key = e::slice(ref->m_backing.data()
-                        + ref->m_backing.size()
-                        - iter->key().size(),
-                        iter->key().size());
-        e::slice v(ref->m_backing.data(), ref->m_backing.size() - iter->key().size());
-        return decode_value(v, value, version);
-    }
-    else if (st.IsNotFound())
-    {
-        return NOT_FOUND;
-    }
-    else
-    {
-        return handle_error(st);
+        if (lhs.size() < rhs.size())
+        {
+            return -1;
+        }
+        else if (lhs.size() > rhs.size())
+        {
+            return 1;
+        }
     }
+
+    return cmp;
 }
 
-datalayer::returncode
-datalayer :: create_checkpoint(const region_timestamp& rt)
+static bool
+validate_object(const hyperdex::schema& sc,
+                const e::slice& key,
+                const std::vector<e::slice>& value)
 {
-    po6::threads::mutex::hold hold(&m_protect);
+    using hyperdex::datatype_info;
 
-    for (wipe_list_t::iterator it = m_wiping.begin(); it != m_wiping.end(); ++it)
+    if (value.size() + 1 != sc.attrs_sz ||
+        !datatype_info::lookup(sc.attrs[0].type)->validate(key))
     {
-        if (it->second == rt.rid)
-        {
-            return SUCCESS;
-        }
+        return false;
     }
 
-    char cbacking[CHECKPOINT_BUF_SIZE + 1024];
-    encode_checkpoint(rt.rid, rt.checkpoint, cbacking);
-    leveldb::WriteOptions opts;
-    opts.sync = false;
-    leveldb::Slice ckey(cbacking, CHECKPOINT_BUF_SIZE);
-    leveldb::Slice val(rt.local_timestamp);
-    leveldb::Status st = m_db->Put(opts, ckey, val);
-
-    if (!st.ok())
+    for (size_t i = 0; i < value.size(); ++i)
     {
-        return handle_error(st);
+        if (!datatype_info::lookup(sc.attrs[i + 1].type)->validate(value[i]))
+        {
+            return false;
+        }
     }
 
-    return SUCCESS;
+    return true;
 }
 
 void
-datalayer :: set_checkpoint_lower_gc(uint64_t checkpoint_gc)
+datalayer :: request_bulk_load(const server_id& from,
+                               const virtual_server_id& vto,
+                               uint64_t nonce,
+                               const std::string& space,
+                               const std::string& path)
 {
     po6::threads::mutex::hold hold(&m_protect);
-    m_checkpoint_gc = std::max(checkpoint_gc, m_checkpoint_gc);
-    m_wakeup_checkpointer.signal();
+    m_bulk_loads.push_back(bulk_load_request(from, vto, nonce, space, path));
+    m_wakeup_bulk_loader.broadcast();
 }
 
-void
-datalayer :: largest_checkpoint_for(const region_id& ri, uint64_t* checkpoint)
+bool
+datalayer :: bulk_load(const char* space,
+                       const char* path,
+                       std::vector<region_id>* _regions,
+                       uint64_t* loaded)
 {
-    po6::threads::mutex::hold hold(&m_protect);
+    *loaded = 0;
+    _regions->clear();
+    // re-read after every pause, as a reconfiguration replaces both
+    const configuration* config = m_daemon->m_config.get();
+    const schema* sc = config->get_schema(space);
 
-    for (wipe_list_t::iterator it = m_wiping.begin(); it != m_wiping.end(); ++it)
+    if (!sc)
     {
-        if (it->second == ri)
-        {
-            *checkpoint = 0;
-            return;
-        }
+        LOG(ERROR) << "cannot bulk load into space \"" << e::strescape(space)
+                   << "\" because it does not exist";
+        return false;
     }
 
-    leveldb::ReadOptions opts;
-    opts.verify_checksums = true;
-    std::auto_ptr<leveldb::Iterator> it;
-    it.reset(m_db->NewIterator(opts));
-    char cbacking[CHECKPOINT_BUF_SIZE];
-    encode_checkpoint(ri, 0, cbacking);
-    it->Seek(leveldb::Slice(cbacking, CHECKPOINT_BUF_SIZE));
-    *checkpoint = 0;
+    if (!config->read_only())
+    {
+        LOG(ERROR) << "refusing to bulk load while the cluster permits writes; "
+                   << "put the cluster into read-only mode first";
+        return false;
+    }
 
-    while (it->Valid())
+    std::vector<region_id> regions;
+    std::vector<subspace_id> subspaces;
+    bulk_load_regions(*config, sc, &regions, &subspaces);
+    *_regions = regions;
+
+    if (regions.empty())
     {
-        region_timestamp rt;
-        e::slice key(it->key().data(), it->key().size());
-        returncode rc = decode_checkpoint(key, &rt.rid, &rt.checkpoint);
+        LOG(INFO) << "this server holds no regions of space \"" << e::strescape(space)
+                  << "\"; there is nothing to bulk load";
+        return true;
+    }
 
-        if (rc != datalayer::SUCCESS)
-        {
-            break;
-        }
+    po6::io::fd fd(open(path, O_RDONLY));
+    struct stat buf;
 
-        if (rt.rid != ri)
-        {
-            break;
-        }
-
-        *checkpoint = std::max(*checkpoint, rt.checkpoint);
-        it->Next();
+    if (fd.get() < 0 || fstat(fd.get(), &buf) < 0)
+    {
+        PLOG(ERROR) << "could not open \"" << e::strescape(path) << "\" for bulk loading";
+        return false;
     }
-}
 
-void
-datalayer :: request_wipe(const transfer_id& xid,
-                          const region_id& ri)
-{
-    po6::threads::mutex::hold hold(&m_protect);
-    m_wiping.push_back(std::make_pair(xid, ri));
-    m_wakeup_wiper.broadcast();
-}
+    if (buf.st_size == 0)
+    {
+        return true;
+    }
 
-datalayer::replay_iterator*
-datalayer :: replay_region_from_checkpoint(const region_id& ri,
-                                           uint64_t checkpoint,
-                                           bool* wipe)
-{
-    po6::threads::mutex::hold hold(&m_protect);
-    leveldb::ReadOptions opts;
-    opts.verify_checksums = true;
-    std::auto_ptr<leveldb::Iterator> it;
-    it.reset(m_db->NewIterator(opts));
-    char cbacking[CHECKPOINT_BUF_SIZE];
-    encode_checkpoint(ri, 0, cbacking);
-    it->Seek(leveldb::Slice(cbacking, CHECKPOINT_BUF_SIZE));
-    std::string local_timestamp("all");
+    void* base = mmap(NULL, buf.st_size, PROT_READ, MAP_PRIVATE, fd.get(), 0);
 
-    while (it->Valid())
+    if (base == MAP_FAILED)
     {
-        region_timestamp rt;
-        e::slice key(it->key().data(), it->key().size());
-        returncode rc = decode_checkpoint(key, &rt.rid, &rt.checkpoint);
+        PLOG(ERROR) << "could not map \"" << e::strescape(path) << "\" for bulk loading";
+        return false;
+    }
 
-        if (rc != datalayer::SUCCESS)
-        {
-            break;
-        }
+    e::guard g = e::makeguard(munmap, base, buf.st_size); g.use_variable();
+    madvise(base, buf.st_size, MADV_SEQUENTIAL);
+    e::unpacker up(static_cast<const char*>(base), buf.st_size);
+    std::vector<uint64_t> hashes(sc->attrs_sz);
+    e::slice prev_key;
+    bool has_prev = false;
+    leveldb::WriteBatch updates;
+    size_t batched = 0;
+    std::map<region_id, region_stats> deltas;
+    uint64_t objects = 0;
 
-        if (rt.rid != ri || rt.checkpoint > checkpoint)
+    while (up.remain() > 0)
+    {
+        e::slice key;
+        std::vector<e::slice> value;
+        up = up >> key >> value;
+
+        if (up.error() || !validate_object(*sc, key, value))
         {
-            break;
+            LOG(ERROR) << "\"" << e::strescape(path) << "\" contains a malformed object after "
+                       << objects << " objects";
+            return false;
         }
 
-        local_timestamp.assign(it->value().data(), it->value().size());
-        it->Next();
-    }
+        ++objects;
 
-    for (wipe_list_t::iterator w = m_wiping.begin(); w != m_wiping.end(); ++w)
-    {
-        if (w->second == ri)
+        // The dump must be sorted so that every copy of a key is adjacent.
+        // Objects are read back from disk to generate index deltas, and a
+        // duplicate key sitting in an unwritten batch would not be seen.
+        if (has_prev)
         {
-            local_timestamp = "all";
-            break;
+            int cmp = compare_keys(prev_key, key);
+
+            if (cmp == 0)
+            {
+                LOG(WARNING) << "skipping duplicate key in \"" << e::strescape(path) << "\"";
+                continue;
+            }
+            else if (cmp > 0)
+            {
+                LOG(ERROR) << "\"" << e::strescape(path) << "\" is not sorted by key; "
+                           << "stopping the bulk load after " << objects << " objects";
+                return false;
+            }
         }
-    }
 
-    *wipe = local_timestamp == "all";
-    leveldb::ReplayIterator* iter;
-    leveldb::Status st = m_db->GetReplayIterator(local_timestamp, &iter);
+        prev_key = key;
+        has_prev = true;
+        hyperdex::hash(*sc, key, value, &hashes.front());
 
-    if (!st.ok())
-    {
-        LOG(ERROR) << "LevelDB corruption: invalid timestamp";
-        abort();
-    }
+        for (size_t i = 0; i < subspaces.size(); ++i)
+        {
+            region_id ri;
+            config->lookup_region(subspaces[i], hashes, &ri);
 
-    leveldb_replay_iterator_ptr ptr(m_db, iter);
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
-    return new replay_iterator(ri, ptr, index_info::lookup(sc.attrs[0].type));
-}
+            if (!std::binary_search(regions.begin(), regions.end(), ri))
+            {
+                continue;
+            }
 
-void
-datalayer :: collect_lower_checkpoints(uint64_t checkpoint_gc)
-{
-    po6::threads::mutex::hold hold(&m_protect);
-    leveldb::ReadOptions opts;
-    opts.verify_checksums = true;
-    std::auto_ptr<leveldb::Iterator> it;
-    it.reset(m_db->NewIterator(opts));
-    it->Seek(leveldb::Slice("c", 1));
-    std::string lower_bound_timestamp("now");
+            if (bulk_load_object(*sc, ri, key, value, &updates, &batched, &deltas[ri]) != SUCCESS)
+            {
+                return false;
+            }
 
-    while (it->Valid())
-    {
-        region_timestamp rt;
-        e::slice key(it->key().data(), it->key().size());
-        returncode rc = decode_checkpoint(key, &rt.rid, &rt.checkpoint);
+            ++*loaded;
+        }
 
-        if (rc != datalayer::SUCCESS)
+        if (batched >= BULK_LOAD_BATCH_SIZE &&
+            !bulk_load_write(false, &updates, &batched, &deltas))
         {
-            break;
+            return false;
         }
 
-        rt.local_timestamp = std::string(it->value().data(), it->value().size());
-
-        if (rt.checkpoint >= checkpoint_gc &&
-            m_db->ValidateTimestamp(rt.local_timestamp))
+        if (objects % BULK_LOAD_PAUSE_INTERVAL != 0 || !bulk_load_interrupted())
         {
-            if (m_db->CompareTimestamps(rt.local_timestamp, lower_bound_timestamp) < 0)
-            {
-                lower_bound_timestamp = rt.local_timestamp;
-            }
-
-            it->Next();
             continue;
         }
 
-        leveldb::WriteOptions wopts;
-        wopts.sync = false;
-        leveldb::Status st = m_db->Delete(wopts, it->key());
-
-        if (!st.ok())
+        // what is batched was computed under the configuration we pause for
+        if (!bulk_load_write(false, &updates, &batched, &deltas))
         {
-            break;
+            return false;
         }
 
-        it->Next();
-    }
+        if (!bulk_load_pause())
+        {
+            LOG(INFO) << "stopping the bulk load of \"" << e::strescape(path)
+                      << "\" after " << objects << " objects to shut down";
+            return false;
+        }
 
-    m_db->AllowGarbageCollectBeforeTimestamp(lower_bound_timestamp);
-}
+        config = m_daemon->m_config.get();
+        sc = config->get_schema(space);
+        std::vector<region_id> now_regions;
+        std::vector<subspace_id> now_subspaces;
 
-bool
-datalayer :: only_key_is_hyperdex_key()
-{
-    leveldb::ReadOptions opts;
-    opts.fill_cache = false;
-    opts.verify_checksums = true;
-    opts.snapshot = NULL;
-    std::auto_ptr<leveldb::Iterator> it(m_db->NewIterator(opts));
-    it->SeekToFirst();
-    bool seen = false;
+        if (sc)
+        {
+            bulk_load_regions(*config, sc, &now_regions, &now_subspaces);
+        }
 
-    while (it->Valid())
-    {
-        if (it->key().compare(leveldb::Slice("hyperdex", 8)) != 0)
+        if (!sc || !config->read_only() ||
+            now_regions != regions || now_subspaces != subspaces)
         {
+            LOG(ERROR) << "stopping the bulk load of \"" << e::strescape(path)
+                       << "\" after " << objects << " objects because a reconfiguration "
+                       << "changed the space, our regions of it, or read-only mode";
             return false;
         }
-
-        it->Next();
-        seen = true;
     }
 
-    return seen;
+    // the final write syncs everything before we report success
+    return bulk_load_write(true, &updates, &batched, &deltas);
 }
 
 void
-datalayer :: checkpointer()
+datalayer :: bulk_loader()
 {
-    LOG(INFO) << "checkpoint thread started";
+    LOG(INFO) << "bulk loading thread started";
     sigset_t ss;
 
     if (sigfillset(&ss) < 0)
@@ -1263,26 +1820,28 @@ datalayer :: checkpointer()
         return;
     }
 
-    bool need_checkpoint_gc = false;
-    uint64_t checkpoint_gc = 0;
-
     while (true)
     {
+        server_id from;
+        virtual_server_id vto;
+        uint64_t nonce;
+        std::string space;
+        std::string path;
+
         {
             po6::threads::mutex::hold hold(&m_protect);
 
-            while ((checkpoint_gc >= m_checkpoint_gc && !m_shutdown) ||
-                   m_need_pause)
+            while ((m_bulk_loads.empty() && !m_shutdown) || m_need_pause)
             {
-                m_checkpointer_paused = true;
+                m_bulk_loader_paused = true;
 
                 if (m_need_pause)
                 {
                     m_wakeup_reconfigurer.signal();
                 }
 
-                m_wakeup_checkpointer.wait();
-                m_checkpointer_paused = false;
+                m_wakeup_bulk_loader.wait();
+                m_bulk_loader_paused = false;
             }
 
             if (m_shutdown)
@@ -1290,146 +1849,1509 @@ datalayer :: checkpointer()
                 break;
             }
 
-            need_checkpoint_gc = checkpoint_gc < m_checkpoint_gc;
-            checkpoint_gc = m_checkpoint_gc;
+            from = m_bulk_loads.front().from;
+            vto = m_bulk_loads.front().vto;
+            nonce = m_bulk_loads.front().nonce;
+            space = m_bulk_loads.front().space;
+            path = m_bulk_loads.front().path;
         }
 
-        if (need_checkpoint_gc)
+        LOG(INFO) << "bulk loading \"" << e::strescape(path) << "\" into space \""
+                  << e::strescape(space) << "\"";
+        std::vector<region_id> regions;
+        uint64_t loaded = 0;
+        network_returncode result = NET_SUCCESS;
+
+        if (!bulk_load(space.c_str(), path.c_str(), &regions, &loaded))
         {
-            collect_lower_checkpoints(checkpoint_gc);
+            result = NET_SERVERERROR;
+            LOG(ERROR) << "bulk load failed after storing " << loaded << " objects";
+        }
+        else
+        {
+            LOG(INFO) << "bulk load succeeded and stored " << loaded << " objects";
+        }
+
+        // the load wrote around the key states, even if it failed part way
+        m_daemon->m_repl.forget_key_states(regions);
+        bool shutting_down;
+
+        {
+            po6::threads::mutex::hold hold(&m_protect);
+            m_bulk_loads.pop_front();
+            shutting_down = m_shutdown;
+        }
+
+        // not yet paused, so the configuration cannot change underneath the
+        // reply; the client loses its connection anyway if we are exiting
+        if (!shutting_down)
+        {
+            m_daemon->respond_to_bulk_load(from, vto, nonce, result);
         }
     }
 
-    LOG(INFO) << "checkpoint thread shutting down";
+    LOG(INFO) << "bulk loading thread shutting down";
 }
 
-void
-datalayer :: wiper()
+datalayer::returncode
+datalayer :: get_from_iterator(const region_id& ri,
+                               iterator* iter,
+                               e::slice* key,
+                               std::vector<e::slice>* value,
+                               uint64_t* version,
+                               reference* ref)
 {
-    LOG(INFO) << "wiping thread started";
-    sigset_t ss;
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
+    std::vector<char> scratch;
 
-    if (sigfillset(&ss) < 0)
+    // create the encoded key
+    leveldb::Slice lkey;
+    encode_key(ri, sc.attrs[0].type, iter->key(), &scratch, &lkey);
+
+    // perform the read
+    leveldb::ReadOptions opts;
+    opts.fill_cache = true;
+    opts.verify_checksums = true;
+    opts.snapshot = iter->snap().get();
+    leveldb::Status st = m_db->Get(opts, lkey, &ref->m_backing);
+
+    if (st.ok())
     {
-        PLOG(ERROR) << "sigfillset";
-        return;
+        ref->m_backing += std::string(reinterpret_cast<const char*>(iter->key().data()), iter->key().size());
+        *key = e::slice(ref->m_backing.data()
+                        + ref->m_backing.size()
+                        - iter->key().size(),
+                        iter->key().size());
+        e::slice v(ref->m_backing.data(), ref->m_backing.size() - iter->key().size());
+        return decode_value(v, value, version);
     }
-
-    if (pthread_sigmask(SIG_BLOCK, &ss, NULL) < 0)
+    else if (st.IsNotFound())
     {
-        PLOG(ERROR) << "could not block signals";
-        return;
+        return NOT_FOUND;
     }
-
-    while (true)
+    else
     {
-        transfer_id xid;
-        region_id rid;
-
-        {
-            po6::threads::mutex::hold hold(&m_protect);
-
-            while ((m_wiping.empty() && !m_shutdown) || m_need_pause)
-            {
-                m_wiper_paused = true;
-
-                if (m_need_pause)
-                {
-                    m_wakeup_reconfigurer.signal();
-                }
-
-                m_wakeup_wiper.wait();
-                m_wiper_paused = false;
-            }
+        return handle_error(st);
+    }
+}
 
-            if (m_shutdown)
-            {
-                break;
-            }
+datalayer::returncode
+datalayer :: create_checkpoint(const region_timestamp& rt)
+{
+    po6::threads::mutex::hold hold(&m_protect);
 
-            if (!m_wiping.empty())
-            {
-                xid = m_wiping.front().first;
-                rid = m_wiping.front().second;
-            }
+    for (wipe_list_t::iterator it = m_wiping.begin(); it != m_wiping.end(); ++it)
+    {
+        if (it->rid == rt.rid)
+        {
+            return SUCCESS;
         }
+    }
 
-        assert(rid != region_id());
-        wipe_checkpoints(rid);
+    leveldb::WriteBatch updates;
+    char cbacking[CHECKPOINT_BUF_SIZE + 1024];
+    encode_checkpoint(rt.rid, rt.checkpoint, cbacking);
+    leveldb::Slice ckey(cbacking, CHECKPOINT_BUF_SIZE);
+    leveldb::Slice val(rt.local_timestamp);
+    updates.Put(ckey, val);
+    leveldb::WriteOptions opts;
+    opts.sync = false;
+    leveldb::Status st = m_db->Write(opts, &updates);
 
-        if (wipe_some_indices(rid) &&
-            wipe_some_objects(rid))
-        {
-            m_daemon->m_stm.report_wiped(xid);
-            po6::threads::mutex::hold hold(&m_protect);
-            m_wiping.pop_front();
-        }
+    if (!st.ok())
+    {
+        return handle_error(st);
     }
 
-    LOG(INFO) << "wiping thread shutting down";
+    return SUCCESS;
 }
 
 void
-datalayer :: wipe_checkpoints(const region_id& ri)
+datalayer :: set_checkpoint_lower_gc(uint64_t checkpoint_gc)
 {
     po6::threads::mutex::hold hold(&m_protect);
-    std::auto_ptr<leveldb::Iterator> it;
-    it.reset(m_db->NewIterator(leveldb::ReadOptions()));
+    m_checkpoint_gc = std::max(checkpoint_gc, m_checkpoint_gc);
+    m_wakeup_checkpointer.signal();
+}
+
+void
+datalayer :: largest_checkpoint_for(const region_id& ri, uint64_t* checkpoint)
+{
+    po6::threads::mutex::hold hold(&m_protect);
+
+    for (wipe_list_t::iterator it = m_wiping.begin(); it != m_wiping.end(); ++it)
+    {
+        if (it->rid == ri)
+        {
+            *checkpoint = 0;
+            return;
+        }
+    }
+
+    leveldb::ReadOptions opts;
+    opts.verify_checksums = true;
+    std::auto_ptr<leveldb::Iterator> it;
+    it.reset(m_db->NewIterator(opts));
+    char cbacking[CHECKPOINT_BUF_SIZE];
+    encode_checkpoint(ri, 0, cbacking);
+    it->Seek(leveldb::Slice(cbacking, CHECKPOINT_BUF_SIZE));
+    *checkpoint = 0;
+
+    while (it->Valid())
+    {
+        region_timestamp rt;
+        e::slice key(it->key().data(), it->key().size());
+        returncode rc = decode_checkpoint(key, &rt.rid, &rt.checkpoint);
+
+        if (rc != datalayer::SUCCESS)
+        {
+            break;
+        }
+
+        if (rt.rid != ri)
+        {
+            break;
+        }
+
+        *checkpoint = std::max(*checkpoint, rt.checkpoint);
+        it->Next();
+    }
+}
+
+void
+datalayer :: request_wipe(const transfer_id& xid,
+                          const region_id& ri,
+                          const std::vector<uint32_t>& buckets)
+{
+    po6::threads::mutex::hold hold(&m_protect);
+
+    // the transfer asks again until the wipe is done
+    for (wipe_list_t::iterator it = m_wiping.begin(); it != m_wiping.end(); ++it)
+    {
+        if (it->xid == xid)
+        {
+            return;
+        }
+    }
+
+    m_wiping.push_back(wipe_request(xid, ri, buckets));
+    m_wakeup_wiper.broadcast();
+}
+
+void
+datalayer :: region_digest(const region_id& ri, merkle_tree* tree)
+{
+    leveldb::ReadOptions opts;
+    opts.fill_cache = false;
+    opts.verify_checksums = true;
+    std::auto_ptr<leveldb::Iterator> it(m_db->NewIterator(opts));
+    char backing[sizeof(uint8_t) + sizeof(uint64_t)];
+    e::pack8be('o', backing);
+    e::pack64be(ri.get(), backing + sizeof(uint8_t));
+    leveldb::Slice prefix(backing, sizeof(uint8_t) + sizeof(uint64_t));
+    it->Seek(prefix);
+
+    while (it->Valid() && it->key().starts_with(prefix))
+    {
+        uint64_t h = hash_key(it->key());
+        tree->add(h, CityHash64WithSeed(it->value().data(), it->value().size(), h));
+        it->Next();
+    }
+}
+
+bool
+datalayer :: can_replay_from_checkpoint(const region_id& ri, uint64_t checkpoint)
+{
+    std::string local_timestamp;
+    replay_timestamp(ri, checkpoint, &local_timestamp);
+    return local_timestamp != "all";
+}
+
+void
+datalayer :: replay_timestamp(const region_id& ri,
+                              uint64_t checkpoint,
+                              std::string* local_timestamp)
+{
+    local_timestamp->assign("all");
+    po6::threads::mutex::hold hold(&m_protect);
+    leveldb::ReadOptions opts;
+    opts.verify_checksums = true;
+    std::auto_ptr<leveldb::Iterator> it;
+    it.reset(m_db->NewIterator(opts));
+    char cbacking[CHECKPOINT_BUF_SIZE];
+    encode_checkpoint(ri, 0, cbacking);
+    it->Seek(leveldb::Slice(cbacking, CHECKPOINT_BUF_SIZE));
+
+    while (it->Valid())
+    {
+        region_timestamp rt;
+        e::slice key(it->key().data(), it->key().size());
+        returncode rc = decode_checkpoint(key, &rt.rid, &rt.checkpoint);
+
+        if (rc != datalayer::SUCCESS)
+        {
+            break;
+        }
+
+        if (rt.rid != ri || rt.checkpoint > checkpoint)
+        {
+            break;
+        }
+
+        local_timestamp->assign(it->value().data(), it->value().size());
+        it->Next();
+    }
+
+    for (wipe_list_t::iterator w = m_wiping.begin(); w != m_wiping.end(); ++w)
+    {
+        if (w->rid == ri)
+        {
+            local_timestamp->assign("all");
+            break;
+        }
+    }
+}
+
+typedef std::list<std::pair<std::string, uint64_t> > key_piece_list_t;
+
+// insert before "pos" the 256 pieces of the keys that start with "p", one for
+// each byte that may follow it, each named by the key it starts at and
+// weighed by its approximate size on disk
+static void
+split_piece(leveldb::DB* db,
+            const std::string& p,
+            key_piece_list_t* pieces,
+            key_piece_list_t::iterator pos)
+{
+    std::vector<std::string> keys(257, p);
+
+    for (unsigned i = 0; i < 256; ++i)
+    {
+        keys[i].push_back(static_cast<char>(i));
+    }
+
+    hyperdex::encode_bump(&keys[256][0], &keys[256][0] + keys[256].size());
+    std::vector<leveldb::Range> ranges(256);
+
+    for (unsigned i = 0; i < 256; ++i)
+    {
+        ranges[i] = leveldb::Range(keys[i], keys[i + 1]);
+    }
+
+    std::vector<uint64_t> sizes(256, 0);
+    db->GetApproximateSizes(&ranges[0], 256, &sizes[0]);
+
+    for (unsigned i = 0; i < 256; ++i)
+    {
+        pieces->insert(pos, std::make_pair(keys[i], sizes[i]));
+    }
+}
+
+void
+datalayer :: stream_bounds(const region_id& ri,
+                           unsigned streams,
+                           std::vector<std::string>* bounds)
+{
+    const size_t sz = sizeof(uint8_t) + sizeof(uint64_t);
+    char backing[sz];
+    e::pack8be('o', backing);
+    e::pack64be(ri.get(), backing + sizeof(uint8_t));
+    std::string prefix(backing, sz);
+    std::string end(prefix);
+    encode_bump(&end[0], &end[0] + end.size());
+    bounds->clear();
+    bounds->push_back(prefix);
+    key_piece_list_t pieces;
+
+    if (streams > 1)
+    {
+        split_piece(m_db.get(), prefix, &pieces, pieces.end());
+    }
+
+    uint64_t total = 0;
+
+    for (key_piece_list_t::iterator it = pieces.begin(); it != pieces.end(); ++it)
+    {
+        total += it->second;
+    }
+
+    // a piece bigger than a stream's share would leave the streams
+    // lopsided, so split it on the next byte
+    uint64_t share = total / std::max(streams, 1U);
+
+    for (unsigned depth = 1; share > 0 && depth < REPLAY_SPLIT_DEPTH; ++depth)
+    {
+        bool split = false;
+        key_piece_list_t::iterator it = pieces.begin();
+
+        while (it != pieces.end())
+        {
+            if (it->second > share)
+            {
+                std::string p(it->first);
+                it = pieces.erase(it);
+                split_piece(m_db.get(), p, &pieces, it);
+                split = true;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        if (!split)
+        {
+            break;
+        }
+    }
+
+    key_piece_list_t::iterator it = pieces.begin();
+    uint64_t seen = 0;
+
+    for (unsigned i = 1; i < streams; ++i)
+    {
+        while (it != pieces.end() && seen < total / streams * i)
+        {
+            seen += it->second;
+            ++it;
+        }
+
+        bounds->push_back(it != pieces.end() ? it->first : end);
+    }
+
+    bounds->push_back(end);
+}
+
+void
+datalayer :: replay_region_from_checkpoint(const region_id& ri,
+                                           uint64_t checkpoint,
+                                           unsigned streams,
+                                           merkle_tree* remote,
+                                           std::vector<replay_iterator*>* iters,
+                                           bool* wipe,
+                                           std::vector<uint32_t>* buckets)
+{
+    std::string local_timestamp;
+    replay_timestamp(ri, checkpoint, &local_timestamp);
+    *wipe = local_timestamp == "all";
+    buckets->clear();
+    leveldb_snapshot_ptr snap;
+    std::vector<bool> differ;
+
+    if (*wipe)
+    {
+        // Everything written from "local_timestamp" on is replayed, and
+        // everything the snapshot holds (in the buckets that differ, if
+        // there is a digest) is sent before that.  Unlike a replay from
+        // "all", the snapshot can seek, so each stream reads only its own
+        // keys.  Taking the timestamp first means writes that land in
+        // between are sent twice, which is harmless, rather than never.
+        m_db->GetReplayTimestamp(&local_timestamp);
+        snap = make_snapshot();
+    }
+
+    if (*wipe && remote)
+    {
+        merkle_tree local;
+        leveldb::ReadOptions opts;
+        opts.fill_cache = false;
+        opts.verify_checksums = true;
+        opts.snapshot = snap.get();
+        std::auto_ptr<leveldb::Iterator> it(m_db->NewIterator(opts));
+        char backing[sizeof(uint8_t) + sizeof(uint64_t)];
+        e::pack8be('o', backing);
+        e::pack64be(ri.get(), backing + sizeof(uint8_t));
+        leveldb::Slice prefix(backing, sizeof(uint8_t) + sizeof(uint64_t));
+        it->Seek(prefix);
+
+        while (it->Valid() && it->key().starts_with(prefix))
+        {
+            uint64_t h = hash_key(it->key());
+            local.add(h, CityHash64WithSeed(it->value().data(), it->value().size(), h));
+            it->Next();
+        }
+
+        local.diff(remote, buckets);
+        differ.resize(merkle_tree::BUCKETS, false);
+
+        for (size_t i = 0; i < buckets->size(); ++i)
+        {
+            differ[(*buckets)[i]] = true;
+        }
+
+        // Everything matches; there is nothing to wipe, and an empty list of
+        // buckets would tell the other end to wipe it all.  Replaying from
+        // the timestamp taken above catches it up.
+        if (buckets->empty())
+        {
+            *wipe = false;
+            snap = leveldb_snapshot_ptr();
+            differ.clear();
+        }
+
+        // nothing matches; cheaper to wipe it all than bucket by bucket
+        if (buckets->size() == merkle_tree::BUCKETS)
+        {
+            buckets->clear();
+            differ.clear();
+        }
+    }
+
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
+    std::vector<std::string> bounds;
+    stream_bounds(ri, streams, &bounds);
+    iters->clear();
+
+    for (unsigned i = 0; i < streams; ++i)
+    {
+        leveldb::ReplayIterator* iter;
+        leveldb::Status st = m_db->GetReplayIterator(local_timestamp, &iter);
+
+        if (!st.ok())
+        {
+            LOG(ERROR) << "LevelDB corruption: invalid timestamp";
+            abort();
+        }
+
+        leveldb_replay_iterator_ptr ptr(m_db, iter);
+        leveldb_iterator_ptr snap_iter;
+
+        if (snap.get())
+        {
+            leveldb::ReadOptions opts;
+            opts.fill_cache = false;
+            opts.verify_checksums = true;
+            opts.snapshot = snap.get();
+            snap_iter.reset(snap, m_db->NewIterator(opts));
+        }
+
+        iters->push_back(new replay_iterator(ri, ptr, index_info::lookup(sc.attrs[0].type),
+                                             bounds[i], bounds[i + 1], snap_iter, differ));
+    }
+}
+
+void
+datalayer :: collect_lower_checkpoints(uint64_t checkpoint_gc)
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    leveldb::ReadOptions opts;
+    opts.verify_checksums = true;
+    std::auto_ptr<leveldb::Iterator> it;
+    it.reset(m_db->NewIterator(opts));
+    it->Seek(leveldb::Slice("c", 1));
+    std::string lower_bound_timestamp("now");
+
+    while (it->Valid())
+    {
+        region_timestamp rt;
+        e::slice key(it->key().data(), it->key().size());
+        returncode rc = decode_checkpoint(key, &rt.rid, &rt.checkpoint);
+
+        if (rc != datalayer::SUCCESS)
+        {
+            break;
+        }
+
+        rt.local_timestamp = std::string(it->value().data(), it->value().size());
+
+        if (rt.checkpoint >= checkpoint_gc &&
+            m_db->ValidateTimestamp(rt.local_timestamp))
+        {
+            if (m_db->CompareTimestamps(rt.local_timestamp, lower_bound_timestamp) < 0)
+            {
+                lower_bound_timestamp = rt.local_timestamp;
+            }
+
+            it->Next();
+            continue;
+        }
+
+        leveldb::WriteOptions wopts;
+        wopts.sync = false;
+        leveldb::Status st = m_db->Delete(wopts, it->key());
+
+        if (!st.ok())
+        {
+            break;
+        }
+
+        it->Next();
+    }
+
+    m_db->AllowGarbageCollectBeforeTimestamp(lower_bound_timestamp);
+}
+
+bool
+datalayer :: relabel_pending(const region_id& ri)
+{
+    if (e::atomic::load_64_acquire(&m_relabels) == 0)
+    {
+        return false;
+    }
+
+    po6::threads::mutex::hold hold(&m_protect);
+
+    for (relabel_list_t::iterator it = m_relabeling.begin();
+            it != m_relabeling.end(); ++it)
+    {
+        if (!it->moved && std::binary_search(it->to.begin(), it->to.end(), ri))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void
+datalayer :: stop_relabel(const region_id& ri)
+{
+    if (e::atomic::load_64_acquire(&m_relabels) == 0)
+    {
+        return;
+    }
+
+    // wait out the slice in progress, which may be moving objects into "ri"
+    po6::threads::mutex::hold hold_relabel(&m_relabel_protect);
+    po6::threads::mutex::hold hold(&m_protect);
+
+    for (relabel_list_t::iterator it = m_relabeling.begin();
+            it != m_relabeling.end(); ++it)
+    {
+        std::vector<region_id>::iterator pos;
+        pos = std::lower_bound(it->to.begin(), it->to.end(), ri);
+
+        if (it->moved || pos == it->to.end() || *pos != ri)
+        {
+            continue;
+        }
+
+        LOG(INFO) << "no longer moving the objects of retired " << it->from
+                  << " into " << ri << " because a transfer replaces them";
+        it->to.erase(pos);
+        save_relabel(it->from, it->to);
+    }
+}
+
+bool
+datalayer :: only_key_is_hyperdex_key()
+{
+    leveldb::ReadOptions opts;
+    opts.fill_cache = false;
+    opts.verify_checksums = true;
+    opts.snapshot = NULL;
+    std::auto_ptr<leveldb::Iterator> it(m_db->NewIterator(opts));
+    it->SeekToFirst();
+    bool seen = false;
+
+    while (it->Valid())
+    {
+        if (it->key().compare(leveldb::Slice("hyperdex", 8)) != 0)
+        {
+            return false;
+        }
+
+        it->Next();
+        seen = true;
+    }
+
+    return seen;
+}
+
+void
+datalayer :: checkpointer()
+{
+    LOG(INFO) << "checkpoint thread started";
+    sigset_t ss;
+
+    if (sigfillset(&ss) < 0)
+    {
+        PLOG(ERROR) << "sigfillset";
+        return;
+    }
+
+    if (pthread_sigmask(SIG_BLOCK, &ss, NULL) < 0)
+    {
+        PLOG(ERROR) << "could not block signals";
+        return;
+    }
+
+    bool need_checkpoint_gc = false;
+    uint64_t checkpoint_gc = 0;
+
+    while (true)
+    {
+        {
+            po6::threads::mutex::hold hold(&m_protect);
+
+            while ((checkpoint_gc >= m_checkpoint_gc && !m_shutdown) ||
+                   m_need_pause)
+            {
+                m_checkpointer_paused = true;
+
+                if (m_need_pause)
+                {
+                    m_wakeup_reconfigurer.signal();
+                }
+
+                m_wakeup_checkpointer.wait();
+                m_checkpointer_paused = false;
+            }
+
+            if (m_shutdown)
+            {
+                break;
+            }
+
+            need_checkpoint_gc = checkpoint_gc < m_checkpoint_gc;
+            checkpoint_gc = m_checkpoint_gc;
+        }
+
+        if (need_checkpoint_gc)
+        {
+            collect_lower_checkpoints(checkpoint_gc);
+        }
+    }
+
+    LOG(INFO) << "checkpoint thread shutting down";
+}
+
+void
+datalayer :: wiper()
+{
+    LOG(INFO) << "wiping thread started";
+    sigset_t ss;
+
+    if (sigfillset(&ss) < 0)
+    {
+        PLOG(ERROR) << "sigfillset";
+        return;
+    }
+
+    if (pthread_sigmask(SIG_BLOCK, &ss, NULL) < 0)
+    {
+        PLOG(ERROR) << "could not block signals";
+        return;
+    }
+
+    while (true)
+    {
+        transfer_id xid;
+        region_id rid;
+        std::vector<bool> buckets;
+        std::string resume;
+        region_id relabel;
+        bool moved = false;
+        region_id compact;
+        unsigned slice = 0;
+
+        {
+            po6::threads::mutex::hold hold(&m_protect);
+
+            while ((m_wiping.empty() &&
+                    (m_relabeling.empty() || !m_configured) &&
+                    m_compacting.empty() && !m_shutdown) || m_need_pause)
+            {
+                m_wiper_paused = true;
+
+                if (m_need_pause)
+                {
+                    m_wakeup_reconfigurer.signal();
+                }
+
+                m_wakeup_wiper.wait();
+                m_wiper_paused = false;
+            }
+
+            if (m_shutdown)
+            {
+                break;
+            }
+
+            // wipes and relabels hold up transfers; compaction only
+            // reclaims space
+            if (!m_wiping.empty())
+            {
+                xid = m_wiping.front().xid;
+                rid = m_wiping.front().rid;
+                buckets = m_wiping.front().buckets;
+                resume = m_wiping.front().resume;
+            }
+            else if (!m_relabeling.empty() && m_configured)
+            {
+                relabel = m_relabeling.front().from;
+                resume = m_relabeling.front().resume;
+                moved = m_relabeling.front().moved;
+            }
+            else
+            {
+                compact = m_compacting.front();
+                slice = m_compact_slice;
+            }
+        }
+
+        assert(rid != region_id() || relabel != region_id() || compact != region_id());
+        uint64_t delay = m_daemon->m_background.delay();
+
+        if (delay > 0)
+        {
+            // sleep in short steps without m_protect so pausing is prompt
+            timespec ts;
+            ts.tv_sec = 0;
+            ts.tv_nsec = std::min<uint64_t>(delay, 10000000ULL);
+            nanosleep(&ts, NULL);
+            continue;
+        }
+
+        if (compact != region_id())
+        {
+            // one slice at a time, so a pause never waits on a whole region
+            bool done = compact_some(compact, slice);
+            po6::threads::mutex::hold hold(&m_protect);
+            assert(m_compacting.front() == compact);
+
+            if (done)
+            {
+                m_compacting.pop_front();
+                m_compact_slice = 0;
+            }
+            else
+            {
+                m_compact_slice = slice + 1;
+            }
+
+            continue;
+        }
+
+        if (relabel != region_id())
+        {
+            // the retired region's index entries go once every object moved
+            bool done = moved ? wipe_some_indices(relabel)
+                              : relabel_some(relabel, &resume);
+
+            if (done && moved)
+            {
+                wipe_checkpoints(relabel);
+                reset_region_stats(relabel);
+                erase_relabel(relabel);
+                LOG(INFO) << "finished moving the objects of retired " << relabel;
+            }
+
+            {
+                // only a reconfiguration adds to or removes from
+                // m_relabeling, and it waits for this thread to pause
+                po6::threads::mutex::hold hold(&m_protect);
+                assert(m_relabeling.front().from == relabel);
+
+                if (done && moved)
+                {
+                    m_relabeling.pop_front();
+                    e::atomic::store_64_release(&m_relabels, m_relabeling.size());
+                    m_compacting.push_back(relabel);
+                }
+                else if (done)
+                {
+                    m_relabeling.front().moved = true;
+                }
+                else
+                {
+                    m_relabeling.front().resume = resume;
+                }
+            }
+
+            // outgoing transfers of the new regions wait for this
+            if (done && !moved)
+            {
+                m_daemon->m_stm.kickstart();
+            }
+
+            continue;
+        }
+
+        wipe_checkpoints(rid);
+
+        if (!buckets.empty())
+        {
+            bool done = wipe_some_buckets(rid, buckets, &resume);
+
+            if (done)
+            {
+                m_daemon->m_stm.report_wiped(xid);
+            }
+
+            po6::threads::mutex::hold hold(&m_protect);
+
+            if (done)
+            {
+                m_wiping.pop_front();
+            }
+            else
+            {
+                m_wiping.front().resume = resume;
+            }
+        }
+        else if (wipe_some_indices(rid) &&
+                 wipe_some_objects(rid))
+        {
+            reset_region_stats(rid);
+            m_daemon->m_stm.report_wiped(xid);
+            po6::threads::mutex::hold hold(&m_protect);
+            m_wiping.pop_front();
+            m_compacting.push_back(rid);
+        }
+    }
+
+    LOG(INFO) << "wiping thread shutting down";
+}
+
+void
+datalayer :: wipe_checkpoints(const region_id& ri)
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    std::auto_ptr<leveldb::Iterator> it;
+    it.reset(m_db->NewIterator(leveldb::ReadOptions()));
     char cbacking[CHECKPOINT_BUF_SIZE];
     encode_checkpoint(ri, 0, cbacking);
     it->Seek(leveldb::Slice(cbacking, CHECKPOINT_BUF_SIZE));
 
-    while (it->Valid())
+    while (it->Valid())
+    {
+        region_timestamp rt;
+        e::slice key(it->key().data(), it->key().size());
+        returncode rc = decode_checkpoint(key, &rt.rid, &rt.checkpoint);
+
+        if (rc != datalayer::SUCCESS || rt.rid != ri)
+        {
+            break;
+        }
+
+        m_db->Delete(leveldb::WriteOptions(), it->key());
+        it->Next();
+    }
+}
+
+bool
+datalayer :: wipe_some_indices(const region_id& ri)
+{
+    return wipe_some_common('i', ri);
+}
+
+bool
+datalayer :: wipe_some_objects(const region_id& ri)
+{
+    return wipe_some_common('o', ri);
+}
+
+bool
+datalayer :: wipe_some_common(uint8_t c, const region_id& ri)
+{
+    // keep the wiped blocks out of the cache the foreground reads use
+    leveldb::ReadOptions opts;
+    opts.fill_cache = false;
+    std::auto_ptr<leveldb::Iterator> it;
+    it.reset(m_db->NewIterator(opts));
+    char backing[sizeof(uint8_t) + sizeof(uint64_t)];
+    e::pack8be(c, backing);
+    e::pack64be(ri.get(), backing + sizeof(uint8_t));
+    leveldb::Slice prefix(backing, sizeof(uint8_t) + sizeof(uint64_t));
+    it->Seek(prefix);
+    leveldb::WriteBatch updates;
+    uint64_t bytes = 0;
+    bool done = true;
+
+    for (uint64_t i = 0; it->Valid(); ++i)
+    {
+        if (!it->key().starts_with(prefix))
+        {
+            break;
+        }
+
+        if (i >= 65536)
+        {
+            done = false;
+            break;
+        }
+
+        updates.Delete(it->key());
+        bytes += it->key().size() + it->value().size();
+        it->Next();
+    }
+
+    // one write per chunk rather than one per key
+    leveldb::Status st = m_db->Write(leveldb::WriteOptions(), &updates);
+    m_cache.clear();
+    m_daemon->m_background.spend(bytes);
+
+    if (!st.ok())
+    {
+        handle_error(st);
+        return false;
+    }
+
+    return done;
+}
+
+bool
+datalayer :: wipe_some_buckets(const region_id& ri,
+                               const std::vector<bool>& buckets,
+                               std::string* resume)
+{
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
+    const subspace& sub(*m_daemon->m_config->get_subspace(ri));
+    index_info* ki = index_info::lookup(sc.attrs[0].type);
+    leveldb::ReadOptions opts;
+    opts.fill_cache = false;
+    std::auto_ptr<leveldb::Iterator> it;
+    it.reset(m_db->NewIterator(opts));
+    char backing[sizeof(uint8_t) + sizeof(uint64_t)];
+    e::pack8be('o', backing);
+    e::pack64be(ri.get(), backing + sizeof(uint8_t));
+    leveldb::Slice prefix(backing, sizeof(uint8_t) + sizeof(uint64_t));
+    it->Seek(resume->empty() ? prefix : leveldb::Slice(*resume));
+    leveldb::WriteBatch updates;
+    region_stats delta;
+    std::vector<char> decoded;
+    uint64_t bytes = 0;
+    bool done = true;
+
+    // unlike a whole wipe, objects stay behind, so count keys looked at
+    for (uint64_t i = 0; it->Valid(); ++i, it->Next())
+    {
+        if (!it->key().starts_with(prefix))
+        {
+            break;
+        }
+
+        if (i >= 65536)
+        {
+            resume->assign(it->key().data(), it->key().size());
+            done = false;
+            break;
+        }
+
+        if (!buckets[merkle_tree::bucket(hash_key(it->key()))])
+        {
+            continue;
+        }
+
+        scratch_arena::scope arena(scratch_arena::current());
+        e::slice ikey(it->key().data() + prefix.size(), it->key().size() - prefix.size());
+        decoded.resize(ki->decoded_size(ikey));
+        ki->decode(ikey, decoded.empty() ? NULL : &decoded.front());
+        e::slice key(decoded.empty() ? NULL : &decoded.front(), decoded.size());
+        std::vector<e::slice> old_value;
+        uint64_t old_version;
+        returncode rc = decode_value(e::slice(it->value().data(), it->value().size()),
+                                     &old_value, &old_version);
+        updates.Delete(it->key());
+        bytes += it->key().size() + it->value().size();
+
+        if (rc == SUCCESS && old_value.size() + 1 == sc.attrs_sz)
+        {
+            create_index_changes(sc, sub, ri, key, &old_value, NULL, arena.arena(), &updates);
+            delta.objects -= 1;
+            delta.bytes -= logical_size(key, old_value);
+        }
+    }
+
+    delta.index_bytes = index_bytes(updates);
+    stage_region_stats(ri, delta, &updates);
+    leveldb::Status st = m_db->Write(leveldb::WriteOptions(), &updates);
+    m_cache.clear();
+    m_daemon->m_background.spend(bytes);
+
+    if (!st.ok())
+    {
+        handle_error(st);
+        return false;
+    }
+
+    update_region_stats(ri, delta);
+    return done;
+}
+
+bool
+datalayer :: compact_some(const region_id& ri, unsigned slice)
+{
+    // slice i of COMPACT_SLICES covers the keys of the region whose first
+    // byte after the region id is i; the first and last slices reach out to
+    // the bounds of the region, so between them they cover every key
+    assert(slice < 2 * COMPACT_SLICES);
+    uint8_t c = slice < COMPACT_SLICES ? 'i' : 'o';
+    unsigned b = slice % COMPACT_SLICES;
+    const size_t sz = sizeof(uint8_t) + sizeof(uint64_t);
+    char lower[sz + sizeof(uint8_t)];
+    e::pack8be(c, lower);
+    e::pack64be(ri.get(), lower + sizeof(uint8_t));
+    e::pack8be(b, lower + sz);
+    char upper[sz + sizeof(uint8_t)];
+    e::pack8be(c, upper);
+
+    if (b + 1 < COMPACT_SLICES)
+    {
+        e::pack64be(ri.get(), upper + sizeof(uint8_t));
+        e::pack8be(b + 1, upper + sz);
+    }
+    else
+    {
+        e::pack64be(ri.get() + 1, upper + sizeof(uint8_t));
+    }
+
+    leveldb::Slice begin(lower, b == 0 ? sz : sz + 1);
+    leveldb::Slice end(upper, b + 1 < COMPACT_SLICES ? sz + 1 : sz);
+    leveldb::Range r(begin, end);
+    uint64_t bytes = 0;
+    m_db->GetApproximateSizes(&r, 1, &bytes);
+
+    // CompactRange flushes the memtable even when nothing on disk overlaps,
+    // so skip the slices that hold nothing to reclaim
+    if (bytes > 0)
+    {
+        m_db->CompactRange(&begin, &end);
+        m_daemon->m_background.spend(bytes);
+    }
+
+    return slice + 1 == 2 * COMPACT_SLICES;
+}
+
+static void
+replacements_for(const hyperdex::configuration& old_config,
+                 const hyperdex::configuration& new_config,
+                 const hyperdex::region_id& ri,
+                 std::vector<hyperdex::region_id>* to)
+{
+    // the coordinator gives the pieces of a split or merge fresh ids,
+    // so whatever now covers the retired region is new in this version
+    const hyperdex::region& r(*old_config.get_region(ri));
+    std::vector<hyperdex::region_id> covering;
+    new_config.regions_within(old_config.subspace_of(ri),
+                              r.lower_coord, r.upper_coord, &covering);
+
+    for (size_t i = 0; i < covering.size(); ++i)
+    {
+        if (!old_config.get_region(covering[i]))
+        {
+            to->push_back(covering[i]);
+        }
+    }
+}
+
+void
+datalayer :: relabel_retired(const configuration& old_config,
+                             const configuration& new_config,
+                             const server_id& us)
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    m_configured = true;
+
+    // Objects still on their way into a region this configuration retired
+    // go straight to its replacements.  On the first configuration after a
+    // restart, a new region that is gone was retired while we were down, and
+    // what would have gone into it is dropped.
+    for (relabel_list_t::iterator it = m_relabeling.begin();
+            it != m_relabeling.end(); )
+    {
+        std::vector<region_id> to;
+
+        for (size_t i = 0; i < it->to.size(); ++i)
+        {
+            if (new_config.get_region(it->to[i]))
+            {
+                to.push_back(it->to[i]);
+            }
+            else if (old_config.get_region(it->to[i]))
+            {
+                replacements_for(old_config, new_config, it->to[i], &to);
+            }
+        }
+
+        std::sort(to.begin(), to.end());
+        to.erase(std::unique(to.begin(), to.end()), to.end());
+
+        if (to == it->to)
+        {
+            ++it;
+        }
+        else if (to.empty())
+        {
+            // as below, a region dropped along with its space keeps its data
+            LOG(WARNING) << "no longer moving the objects of retired " << it->from
+                         << " because every region that replaced it is gone";
+            erase_relabel(it->from);
+            it = m_relabeling.erase(it);
+        }
+        else
+        {
+            it->to.swap(to);
+            save_relabel(it->from, it->to);
+            ++it;
+        }
+    }
+
+    std::vector<region_id> mapped;
+    old_config.mapped_regions(us, &mapped);
+
+    for (size_t i = 0; i < mapped.size(); ++i)
+    {
+        if (new_config.get_region(mapped[i]))
+        {
+            continue;
+        }
+
+        std::vector<region_id> to;
+        replacements_for(old_config, new_config, mapped[i], &to);
+
+        // a region dropped along with its space leaves its data as before
+        if (to.empty())
+        {
+            continue;
+        }
+
+        std::sort(to.begin(), to.end());
+        LOG(INFO) << "moving the objects of retired " << mapped[i]
+                  << " into the " << to.size() << " regions that replaced it";
+        save_relabel(mapped[i], to);
+        m_relabeling.push_back(relabel_request(mapped[i], to));
+    }
+
+    e::atomic::store_64_release(&m_relabels, m_relabeling.size());
+}
+
+bool
+datalayer :: relabel_some(const region_id& from,
+                          std::string* resume)
+{
+    po6::threads::mutex::hold hold_relabel(&m_relabel_protect);
+    std::vector<region_id> to;
+
     {
-        region_timestamp rt;
-        e::slice key(it->key().data(), it->key().size());
-        returncode rc = decode_checkpoint(key, &rt.rid, &rt.checkpoint);
+        po6::threads::mutex::hold hold(&m_protect);
+        assert(m_relabeling.front().from == from);
+        to = m_relabeling.front().to;
+    }
 
-        if (rc != datalayer::SUCCESS || rt.rid != ri)
+    // every region it was moving into has stopped
+    if (to.empty())
+    {
+        return wipe_some_objects(from);
+    }
+
+    const configuration& config(*m_daemon->m_config);
+    const schema& sc(*config.get_schema(to.front()));
+    index_info* ki = index_info::lookup(sc.attrs[0].type);
+    // created under m_relabel_protect, so no key moves behind its back
+    leveldb::ReadOptions opts;
+    opts.fill_cache = false;
+    std::auto_ptr<leveldb::Iterator> it;
+    it.reset(m_db->NewIterator(opts));
+    char backing[sizeof(uint8_t) + sizeof(uint64_t)];
+    e::pack8be('o', backing);
+    e::pack64be(from.get(), backing + sizeof(uint8_t));
+    leveldb::Slice prefix(backing, sizeof(uint8_t) + sizeof(uint64_t));
+    const std::string start(*resume);
+    it->Seek(start.empty() ? prefix : leveldb::Slice(start));
+    leveldb::WriteBatch updates;
+    std::map<region_id, region_stats> deltas;
+    std::vector<std::string> touched;
+    std::vector<char> decoded;
+    uint64_t bytes = 0;
+    uint64_t dropped = 0;
+    bool done = true;
+
+    for (uint64_t i = 0; it->Valid(); ++i, it->Next())
+    {
+        if (!it->key().starts_with(prefix))
         {
             break;
         }
 
-        m_db->Delete(leveldb::WriteOptions(), it->key());
-        it->Next();
+        if (i >= RELABEL_SLICE_OBJECTS)
+        {
+            resume->assign(it->key().data(), it->key().size());
+            done = false;
+            break;
+        }
+
+        scratch_arena::scope arena(scratch_arena::current());
+        e::slice ikey(it->key().data() + prefix.size(), it->key().size() - prefix.size());
+        decoded.resize(ki->decoded_size(ikey));
+        ki->decode(ikey, decoded.empty() ? NULL : &decoded.front());
+        e::slice key(decoded.empty() ? NULL : &decoded.front(), decoded.size());
+
+        if (!relabel_object(config, sc, to, key, it->key(), it->value(),
+                            arena.arena(), &updates, &deltas, &touched))
+        {
+            ++dropped;
+        }
+
+        bytes += it->key().size() + it->value().size();
+    }
+
+    // deleting each object in the write that moves it makes a slice
+    // idempotent; there is nothing to sync
+    stage_region_stats(deltas, &updates);
+    leveldb::Status st = m_db->Write(leveldb::WriteOptions(), &updates);
+
+    for (size_t i = 0; i < touched.size(); ++i)
+    {
+        m_cache.invalidate(e::slice(touched[i]));
+    }
+
+    m_daemon->m_background.spend(bytes);
+
+    if (!st.ok())
+    {
+        resume->assign(start);
+        handle_error(st);
+        return false;
+    }
+
+    for (std::map<region_id, region_stats>::iterator d = deltas.begin();
+            d != deltas.end(); ++d)
+    {
+        update_region_stats(d->first, d->second);
+    }
+
+    if (dropped > 0)
+    {
+        LOG(WARNING) << "dropped " << dropped << " objects of " << from
+                     << " that are bound for none of its replacements";
     }
+
+    return done;
 }
 
-bool
-datalayer :: wipe_some_indices(const region_id& ri)
+void
+datalayer :: relabel_key(const region_id& ri, const e::slice& key)
 {
-    return wipe_some_common('i', ri);
+    if (e::atomic::load_64_acquire(&m_relabels) == 0)
+    {
+        return;
+    }
+
+    po6::threads::mutex::hold hold_relabel(&m_relabel_protect);
+    std::vector<std::pair<region_id, std::vector<region_id> > > sources;
+
+    {
+        po6::threads::mutex::hold hold(&m_protect);
+
+        for (relabel_list_t::iterator it = m_relabeling.begin();
+                it != m_relabeling.end(); ++it)
+        {
+            if (!it->moved && std::binary_search(it->to.begin(), it->to.end(), ri))
+            {
+                sources.push_back(std::make_pair(it->from, it->to));
+            }
+        }
+    }
+
+    if (sources.empty())
+    {
+        return;
+    }
+
+    const configuration& config(*m_daemon->m_config);
+    const schema& sc(*config.get_schema(ri));
+
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        scratch_arena::scope arena(scratch_arena::current());
+        leveldb::Slice lkey;
+        encode_key(sources[i].first, sc.attrs[0].type, key, arena.arena(), &lkey);
+        leveldb::ReadOptions opts;
+        opts.verify_checksums = true;
+        std::string value;
+        leveldb::Status st = m_db->Get(opts, lkey, &value);
+
+        if (st.IsNotFound())
+        {
+            continue;
+        }
+        else if (!st.ok())
+        {
+            handle_error(st);
+            continue;
+        }
+
+        leveldb::WriteBatch updates;
+        std::map<region_id, region_stats> deltas;
+        std::vector<std::string> touched;
+        relabel_object(config, sc, sources[i].second, key, lkey, value,
+                       arena.arena(), &updates, &deltas, &touched);
+        stage_region_stats(deltas, &updates);
+        st = m_db->Write(leveldb::WriteOptions(), &updates);
+
+        for (size_t j = 0; j < touched.size(); ++j)
+        {
+            m_cache.invalidate(e::slice(touched[j]));
+        }
+
+        if (!st.ok())
+        {
+            handle_error(st);
+            return;
+        }
+
+        for (std::map<region_id, region_stats>::iterator d = deltas.begin();
+                d != deltas.end(); ++d)
+        {
+            update_region_stats(d->first, d->second);
+        }
+
+        // a key lives in one region at a time
+        return;
+    }
 }
 
 bool
-datalayer :: wipe_some_objects(const region_id& ri)
+datalayer :: relabel_object(const configuration& config,
+                            const schema& sc,
+                            const std::vector<region_id>& to,
+                            const e::slice& key,
+                            const leveldb::Slice& old_key,
+                            const leveldb::Slice& value,
+                            scratch_arena* arena,
+                            leveldb::WriteBatch* updates,
+                            std::map<region_id, region_stats>* deltas,
+                            std::vector<std::string>* touched)
 {
-    return wipe_some_common('o', ri);
+    std::vector<e::slice> attrs;
+    uint64_t version;
+    returncode rc = decode_value(e::slice(value.data(), value.size()),
+                                 &attrs, &version);
+    region_id ri;
+
+    if (rc == SUCCESS && attrs.size() + 1 == sc.attrs_sz)
+    {
+        std::vector<uint64_t> hashes(sc.attrs_sz);
+        hyperdex::hash(sc, key, attrs, &hashes.front());
+        config.lookup_region(config.subspace_of(to.front()), hashes, &ri);
+    }
+
+    if (!std::binary_search(to.begin(), to.end(), ri))
+    {
+        updates->Delete(old_key);
+        touched->push_back(std::string(old_key.data(), old_key.size()));
+        return false;
+    }
+
+    leveldb::Slice new_key;
+    encode_key(ri, sc.attrs[0].type, key, arena, &new_key);
+    std::string existing;
+    leveldb::Status st = m_db->Get(leveldb::ReadOptions(), new_key, &existing);
+
+    if (!st.ok() && !st.IsNotFound())
+    {
+        // leave it where it is rather than lose it
+        handle_error(st);
+        return true;
+    }
+
+    updates->Delete(old_key);
+    touched->push_back(std::string(old_key.data(), old_key.size()));
+
+    // anything written to the new region since is newer; the encoded value
+    // does not depend upon the region
+    if (st.IsNotFound())
+    {
+        updates->Put(new_key, value);
+        const subspace& sub(*config.get_subspace(ri));
+        leveldb::WriteBatch index_updates;
+        create_index_changes(sc, sub, ri, key, NULL, &attrs, arena, &index_updates);
+        index_bytes_counter counter(updates);
+        index_updates.Iterate(&counter);
+        region_stats& delta((*deltas)[ri]);
+        delta.objects += 1;
+        delta.bytes += logical_size(key, attrs);
+        delta.index_bytes += counter.bytes;
+        touched->push_back(std::string(new_key.data(), new_key.size()));
+    }
+
+    return true;
 }
 
 bool
-datalayer :: wipe_some_common(uint8_t c, const region_id& ri)
+datalayer :: load_relabels()
 {
-    std::auto_ptr<leveldb::Iterator> it;
-    it.reset(m_db->NewIterator(leveldb::ReadOptions()));
-    char backing[sizeof(uint8_t) + sizeof(uint64_t)];
-    e::pack8be(c, backing);
-    e::pack64be(ri.get(), backing + sizeof(uint8_t));
-    leveldb::Slice prefix(backing, sizeof(uint8_t) + sizeof(uint64_t));
+    leveldb::ReadOptions opts;
+    opts.fill_cache = false;
+    opts.verify_checksums = true;
+    opts.snapshot = NULL;
+    std::auto_ptr<leveldb::Iterator> it(m_db->NewIterator(opts));
+    leveldb::Slice prefix("m", 1);
     it->Seek(prefix);
+    po6::threads::mutex::hold hold(&m_protect);
+    m_relabeling.clear();
 
-    for (uint64_t i = 0; i < 65536 && it->Valid(); ++i)
+    while (it->Valid() && it->key().starts_with(prefix))
     {
-        if (!it->key().starts_with(prefix))
+        region_id from;
+        std::vector<region_id> to;
+        returncode rc = decode_relabel(e::slice(it->key().data(), it->key().size()),
+                                       e::slice(it->value().data(), it->value().size()),
+                                       &from, &to);
+
+        if (rc != SUCCESS)
         {
-            return true;
+            LOG(ERROR) << "could not restore from LevelDB because a previous "
+                       << "execution wrote an invalid relabel record; "
+                       << "you'll need to manually erase this DB and create a new one";
+            return false;
         }
 
-        m_db->Delete(leveldb::WriteOptions(), it->key());
+        LOG(INFO) << "resuming the move of the objects of retired " << from
+                  << " into the " << to.size() << " regions that replaced it";
+        m_relabeling.push_back(relabel_request(from, to));
         it->Next();
     }
 
-    return false;
+    if (!it->status().ok())
+    {
+        LOG(ERROR) << "could not read relabel records from LevelDB: " << it->status().ToString();
+        return false;
+    }
+
+    e::atomic::store_64_release(&m_relabels, m_relabeling.size());
+    return true;
+}
+
+bool
+datalayer :: save_relabel(const region_id& from,
+                          const std::vector<region_id>& to)
+{
+    char kbacking[RELABEL_KEY_SIZE];
+    std::string vbacking;
+    encode_relabel(from, to, kbacking, &vbacking);
+    leveldb::WriteOptions opts;
+    opts.sync = true;
+    leveldb::Status st = m_db->Put(opts, leveldb::Slice(kbacking, RELABEL_KEY_SIZE), vbacking);
+
+    if (!st.ok())
+    {
+        handle_error(st);
+        return false;
+    }
+
+    return true;
+}
+
+bool
+datalayer :: erase_relabel(const region_id& from)
+{
+    char kbacking[RELABEL_KEY_SIZE];
+    std::string vbacking;
+    encode_relabel(from, std::vector<region_id>(), kbacking, &vbacking);
+    leveldb::WriteOptions opts;
+    opts.sync = true;
+    leveldb::Status st = m_db->Delete(opts, leveldb::Slice(kbacking, RELABEL_KEY_SIZE));
+
+    if (!st.ok())
+    {
+        handle_error(st);
+        return false;
+    }
+
+    return true;
 }
 
 void
@@ -1441,6 +3363,7 @@ datalayer :: shutdown()
         po6::threads::mutex::hold hold(&m_protect);
         m_wakeup_checkpointer.broadcast();
         m_wakeup_wiper.broadcast();
+        m_wakeup_bulk_loader.broadcast();
         is_shutdown = m_shutdown;
         m_shutdown = true;
     }
@@ -1449,7 +3372,149 @@ datalayer :: shutdown()
     {
         m_checkpointer.join();
         m_wiper.join();
+        m_bulk_loader.join();
+    }
+}
+
+void
+datalayer :: bulk_load_regions(const configuration& config,
+                               const schema* sc,
+                               std::vector<region_id>* regions,
+                               std::vector<subspace_id>* subspaces)
+{
+    std::vector<region_id> mapped;
+    config.mapped_regions(m_daemon->m_us, &mapped);
+    regions->clear();
+    subspaces->clear();
+
+    for (size_t i = 0; i < mapped.size(); ++i)
+    {
+        if (config.get_schema(mapped[i]) == sc)
+        {
+            regions->push_back(mapped[i]);
+            subspaces->push_back(config.subspace_of(mapped[i]));
+        }
+    }
+
+    std::sort(regions->begin(), regions->end());
+    std::sort(subspaces->begin(), subspaces->end());
+    subspaces->erase(std::unique(subspaces->begin(), subspaces->end()), subspaces->end());
+}
+
+bool
+datalayer :: bulk_load_write(bool sync,
+                             leveldb::WriteBatch* updates,
+                             size_t* batched,
+                             std::map<region_id, region_stats>* deltas)
+{
+    stage_region_stats(*deltas, updates);
+    leveldb::WriteOptions opts;
+    opts.sync = sync;
+    leveldb::Status st = m_db->Write(opts, updates);
+    m_cache.clear();
+
+    if (!st.ok())
+    {
+        handle_error(st);
+        return false;
+    }
+
+    for (std::map<region_id, region_stats>::iterator d = deltas->begin();
+            d != deltas->end(); ++d)
+    {
+        update_region_stats(d->first, d->second);
+    }
+
+    updates->Clear();
+    *batched = 0;
+    deltas->clear();
+    return true;
+}
+
+bool
+datalayer :: bulk_load_interrupted()
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    return m_need_pause || m_shutdown;
+}
+
+bool
+datalayer :: bulk_load_pause()
+{
+    po6::threads::mutex::hold hold(&m_protect);
+
+    while (m_need_pause && !m_shutdown)
+    {
+        m_bulk_loader_paused = true;
+        m_wakeup_reconfigurer.signal();
+        m_wakeup_bulk_loader.wait();
+        m_bulk_loader_paused = false;
+    }
+
+    return !m_shutdown;
+}
+
+datalayer::returncode
+datalayer :: bulk_load_object(const schema& sc,
+                              const region_id& ri,
+                              const e::slice& key,
+                              const std::vector<e::slice>& value,
+                              leveldb::WriteBatch* updates,
+                              size_t* batched,
+                              region_stats* delta)
+{
+    scratch_arena::scope arena(scratch_arena::current());
+
+    // create the encoded key
+    leveldb::Slice lkey;
+    encode_key(ri, sc.attrs[0].type, key, arena.arena(), &lkey);
+
+    // an existing object keeps counting versions from where it was, and its
+    // old index entries must be replaced
+    leveldb::ReadOptions ropts;
+    ropts.fill_cache = false;
+    ropts.verify_checksums = true;
+    std::string backing;
+    std::vector<e::slice> old_value;
+    const std::vector<e::slice>* old_value_ptr = NULL;
+    uint64_t version = 0;
+    leveldb::Status st = m_db->Get(ropts, lkey, &backing);
+
+    if (st.ok())
+    {
+        returncode rc = decode_value(e::slice(backing.data(), backing.size()),
+                                     &old_value, &version);
+
+        if (rc != SUCCESS)
+        {
+            LOG(ERROR) << "could not decode existing object during bulk load: " << rc;
+            return rc;
+        }
+
+        old_value_ptr = &old_value;
+    }
+    else if (!st.IsNotFound())
+    {
+        return handle_error(st);
     }
+
+    // create the encoded value
+    leveldb::Slice lval;
+    encode_value(value, version + 1, arena.arena(), &lval);
+
+    // put the actual object and its index entries; the index entries go
+    // through their own batch so they can be measured
+    updates->Put(lkey, lval);
+    const subspace& sub(*m_daemon->m_config->get_subspace(ri));
+    leveldb::WriteBatch index_updates;
+    create_index_changes(sc, sub, ri, key, old_value_ptr, &value, arena.arena(), &index_updates);
+    index_bytes_counter counter(updates);
+    index_updates.Iterate(&counter);
+    *batched += lkey.size() + lval.size();
+    delta->objects += old_value_ptr ? 0 : 1;
+    delta->bytes += logical_size(key, value) - (old_value_ptr ? logical_size(key, old_value) : 0);
+    delta->index_bytes += counter.bytes;
+    return SUCCESS;
 }
 
 datalayer::returncode
@@ -1472,6 +3537,59 @@ datalayer :: handle_error(leveldb::Status st)
     }
 }
 
+datalayer :: wipe_request :: wipe_request(const transfer_id& x,
+                                          const region_id& r,
+                                          const std::vector<uint32_t>& b)
+    : xid(x)
+    , rid(r)
+    , buckets()
+    , resume()
+{
+    if (!b.empty())
+    {
+        buckets.resize(merkle_tree::BUCKETS, false);
+
+        for (size_t i = 0; i < b.size(); ++i)
+        {
+            buckets[b[i]] = true;
+        }
+    }
+}
+
+datalayer :: wipe_request :: ~wipe_request() throw ()
+{
+}
+
+datalayer :: relabel_request :: relabel_request(const region_id& f,
+                                                const std::vector<region_id>& t)
+    : from(f)
+    , to(t)
+    , resume()
+    , moved(false)
+{
+}
+
+datalayer :: relabel_request :: ~relabel_request() throw ()
+{
+}
+
+datalayer :: bulk_load_request :: bulk_load_request(const server_id& f,
+                                                    const virtual_server_id& v,
+                                                    uint64_t n,
+                                                    const std::string& s,
+                                                    const std::string& p)
+    : from(f)
+    , vto(v)
+    , nonce(n)
+    , space(s)
+    , path(p)
+{
+}
+
+datalayer :: bulk_load_request :: ~bulk_load_request() throw ()
+{
+}
+
 datalayer :: reference :: reference()
     : m_backing()
 {
@@ -30,6 +30,7 @@
 
 // STL
 #include <list>
+#include <map>
 #include <set>
 #include <sstream>
 #include <string>
@@ -54,12 +55,18 @@
 #include "common/datatypes.h"
 #include "common/ids.h"
 #include "common/schema.h"
+#include "daemon/acked_window.h"
 #include "daemon/leveldb.h"
+#include "daemon/object_cache.h"
 #include "daemon/reconfigure_returncode.h"
+#include "daemon/region_stats.h"
 #include "daemon/region_timestamp.h"
 
 BEGIN_HYPERDEX_NAMESPACE
 class daemon;
+class merkle_tree;
+class region_stats_slot;
+class scratch_arena;
 
 class datalayer
 {
@@ -84,6 +91,15 @@ class datalayer
         class unsorted_iterator;
         class intersect_iterator;
         typedef leveldb_snapshot_ptr snapshot;
+        // one object received by state transfer
+        struct transfer_object
+        {
+            transfer_object() : key(), has_value(false), value(NULL), version(0) {}
+            e::slice key;
+            bool has_value;
+            const std::vector<e::slice>* value;
+            uint64_t version;
+        };
 
     public:
         datalayer(daemon*);
@@ -106,10 +122,15 @@ class datalayer
                          const configuration& new_config,
                          const server_id& us);
         // stats
+        // "hyperdex.region-stats" reports the per-region counters; all other
+        // properties are passed through to LevelDB
         bool get_property(const e::slice& property,
                           std::string* value);
+        void get_region_stats(std::vector<std::pair<region_id, region_stats> >* stats);
+        void count_read(const region_id& ri);
         std::string get_timestamp();
         uint64_t approximate_size();
+        void collect_cache_stats(std::ostringstream* ret);
 
     public:
         // retrieve the current value of a key
@@ -118,6 +139,14 @@ class datalayer
                        std::vector<e::slice>* value,
                        uint64_t* version,
                        reference* ref);
+        // like "get", but answer only from memory; return false if the read
+        // would have to go to LevelDB
+        bool get_cached(const region_id& ri,
+                        const e::slice& key,
+                        std::vector<e::slice>* value,
+                        uint64_t* version,
+                        reference* ref,
+                        returncode* rc);
         // put, overput, or delete a key where the existing value is known
         returncode del(const region_id& ri,
                        const region_id& reg_id,
@@ -144,8 +173,19 @@ class datalayer
                                  const e::slice& key,
                                  const std::vector<e::slice>& new_value,
                                  uint64_t version);
+        // Apply a run of transferred objects as uncertain puts and deletes,
+        // using as few LevelDB writes as possible.  If "written_max" is
+        // non-NULL, the region held nothing before the transfer wrote to it,
+        // so an object whose encoded key sorts above *written_max is stored
+        // without reading back an old value; *written_max is advanced past
+        // every key written.
+        returncode apply_transfer(const region_id& ri,
+                                  const std::vector<transfer_object>& objs,
+                                  std::string* written_max);
         // state from retransmitted messages
         // XXX errors are absorbed here; short of crashing we can only log
+        // The acked state is answered from memory; the LevelDB records are
+        // written as a durable backstop and read back only on startup.
         bool check_acked(const region_id& ri,
                          const region_id& reg_id,
                          uint64_t seq_id);
@@ -169,6 +209,16 @@ class datalayer
                                        std::ostringstream* ostr);
         // backups
         bool backup(const e::slice& name);
+        // bulk loading
+        // Queue a load of every object of a sorted dump that maps to one of
+        // our regions in "space", writing index entries alongside.  Requires
+        // the cluster to be read-only so that no chain operation touches the
+        // same keys.  The bulk loading thread answers "from" once it is done.
+        void request_bulk_load(const server_id& from,
+                               const virtual_server_id& vto,
+                               uint64_t nonce,
+                               const std::string& space,
+                               const std::string& path);
         // get the object pointed to by the iterator
         returncode get_from_iterator(const region_id& ri,
                                      iterator* iter,
@@ -180,10 +230,35 @@ class datalayer
         returncode create_checkpoint(const region_timestamp& rt);
         void set_checkpoint_lower_gc(uint64_t checkpoint_gc);
         void largest_checkpoint_for(const region_id& ri, uint64_t* checkpoint);
+        // wipe only the objects in the listed Merkle tree buckets, or all of
+        // the region if "buckets" is empty
         void request_wipe(const transfer_id& xid,
-                          const region_id& ri);
-        replay_iterator* replay_region_from_checkpoint(const region_id& ri,
-                                                       uint64_t checkpoint, bool* wipe);
+                          const region_id& ri,
+                          const std::vector<uint32_t>& buckets);
+        // summarize the region's objects as they are now
+        void region_digest(const region_id& ri, merkle_tree* tree);
+        // may a replay pick up from "checkpoint", rather than having the
+        // other end wipe its copy?
+        bool can_replay_from_checkpoint(const region_id& ri, uint64_t checkpoint);
+        // Replay the region as "streams" iterators that all start from the
+        // same point and split the region's keys into disjoint ranges.  When the
+        // other end must wipe its copy and "remote" summarizes that copy,
+        // only the Merkle tree buckets that differ are returned in "buckets"
+        // to be wiped and sent in full; every other bucket is replayed from
+        // now on.  "buckets" is empty if the whole region must go.
+        void replay_region_from_checkpoint(const region_id& ri,
+                                           uint64_t checkpoint,
+                                           unsigned streams,
+                                           merkle_tree* remote,
+                                           std::vector<replay_iterator*>* iters,
+                                           bool* wipe,
+                                           std::vector<uint32_t>* buckets);
+        // true while objects of a region that a split or merge retired may
+        // still have to move into "ri"; keyed operations on "ri" move their
+        // own object first, but iterators over "ri" would miss the rest
+        bool relabel_pending(const region_id& ri);
+        // drop rather than move the objects still bound for "ri"
+        void stop_relabel(const region_id& ri);
         // used on startup
         bool only_key_is_hyperdex_key();
 
@@ -198,26 +273,204 @@ class datalayer
         bool wipe_some_indices(const region_id& rid);
         bool wipe_some_objects(const region_id& rid);
         bool wipe_some_common(uint8_t c, const region_id& rid);
+        // wipe objects in the flagged buckets, starting from "*resume" and
+        // setting it where to start next time; return true when done
+        bool wipe_some_buckets(const region_id& rid,
+                               const std::vector<bool>& buckets,
+                               std::string* resume);
+        // compact one slice of a wiped region; return true after the last
+        bool compact_some(const region_id& rid, unsigned slice);
+        // queue the regions "us" held that a split or merge retired to be
+        // moved into the regions that replaced them
+        void relabel_retired(const configuration& old_config,
+                             const configuration& new_config,
+                             const server_id& us);
+        // move objects of "from" into its replacements, starting from
+        // "*resume" and setting it where to start next time; return true
+        // when done
+        bool relabel_some(const region_id& from,
+                          std::string* resume);
+        // move the object "key" into "ri" if it is still in a retired region
+        void relabel_key(const region_id& ri, const e::slice& key);
+        // return false if the object was dropped instead of moved
+        bool relabel_object(const configuration& config,
+                            const schema& sc,
+                            const std::vector<region_id>& to,
+                            const e::slice& key,
+                            const leveldb::Slice& old_key,
+                            const leveldb::Slice& value,
+                            scratch_arena* arena,
+                            leveldb::WriteBatch* updates,
+                            std::map<region_id, region_stats>* deltas,
+                            std::vector<std::string>* touched);
+        bool load_relabels();
+        bool save_relabel(const region_id& from,
+                          const std::vector<region_id>& to);
+        bool erase_relabel(const region_id& from);
+        bool load_acked();
+        void insert_acked(const region_id& ri,
+                          const region_id& reg_id,
+                          uint64_t seq_id);
+        returncode flush_transfer(const region_id& ri,
+                                  leveldb::WriteBatch* updates,
+                                  std::set<std::string>* keys,
+                                  region_stats* delta);
+        void bulk_loader();
+        // "regions" receives the regions written to, sorted, even on failure;
+        // the load stops if a reconfiguration changes the space, our regions
+        // of it, or read-only mode
+        bool bulk_load(const char* space,
+                       const char* path,
+                       std::vector<region_id>* regions,
+                       uint64_t* loaded);
+        // the regions of "sc" that "config" maps to us, and their subspaces,
+        // each sorted
+        void bulk_load_regions(const configuration& config,
+                               const schema* sc,
+                               std::vector<region_id>* regions,
+                               std::vector<subspace_id>* subspaces);
+        bool bulk_load_write(bool sync,
+                             leveldb::WriteBatch* updates,
+                             size_t* batched,
+                             std::map<region_id, region_stats>* deltas);
+        // does a reconfiguration or shutdown wait on the bulk loader?
+        bool bulk_load_interrupted();
+        // sit out a reconfiguration; false if shutting down
+        bool bulk_load_pause();
+        returncode bulk_load_object(const schema& sc,
+                                    const region_id& ri,
+                                    const e::slice& key,
+                                    const std::vector<e::slice>& value,
+                                    leveldb::WriteBatch* updates,
+                                    size_t* batched,
+                                    region_stats* delta);
+        bool load_region_stats();
+        // the calling thread's slot, allocated on first use
+        region_stats_slot* stats_slot();
+        // add the totals "delta" will bring this thread's slot to into
+        // "updates"; call update_region_stats once "updates" is written
+        void stage_region_stats(const region_id& ri,
+                                const region_stats& delta,
+                                leveldb::WriteBatch* updates);
+        void stage_region_stats(const std::map<region_id, region_stats>& deltas,
+                                leveldb::WriteBatch* updates);
+        void update_region_stats(const region_id& ri,
+                                 const region_stats& delta);
+        void reset_region_stats(const region_id& ri);
         void shutdown();
         returncode handle_error(leveldb::Status st);
         void collect_lower_checkpoints(uint64_t checkpoint_gc);
+        // the replay timestamp of the largest checkpoint of "ri" at or below
+        // "checkpoint", or "all" if there is none or "ri" is being wiped
+        void replay_timestamp(const region_id& ri, uint64_t checkpoint,
+                              std::string* local_timestamp);
+        // split the region's keys into "streams" ranges of about the same
+        // size on disk; range i runs from (*bounds)[i] up to (*bounds)[i + 1]
+        void stream_bounds(const region_id& ri, unsigned streams,
+                           std::vector<std::string>* bounds);
 
     private:
         daemon* m_daemon;
         leveldb_db_ptr m_db;
         po6::threads::thread m_checkpointer;
         po6::threads::thread m_wiper;
+        po6::threads::thread m_bulk_loader;
         po6::threads::mutex m_protect;
         po6::threads::cond m_wakeup_checkpointer;
         po6::threads::cond m_wakeup_wiper;
+        po6::threads::cond m_wakeup_bulk_loader;
         po6::threads::cond m_wakeup_reconfigurer;
         bool m_shutdown;
         bool m_need_pause;
         bool m_checkpointer_paused;
         bool m_wiper_paused;
+        bool m_bulk_loader_paused;
         uint64_t m_checkpoint_gc;
-        typedef std::list<std::pair<transfer_id, region_id> > wipe_list_t;
+        class wipe_request
+        {
+            public:
+                wipe_request(const transfer_id& x, const region_id& r,
+                             const std::vector<uint32_t>& b);
+                ~wipe_request() throw ();
+
+            public:
+                transfer_id xid;
+                region_id rid;
+                // flags the Merkle tree buckets to wipe; empty for all
+                std::vector<bool> buckets;
+                // the key a partial wipe resumes from
+                std::string resume;
+        };
+        typedef std::list<wipe_request> wipe_list_t;
         wipe_list_t m_wiping;
+        // regions wiped whose tombstones we have yet to compact away, and
+        // the slice of the first that is next
+        std::list<region_id> m_compacting;
+        unsigned m_compact_slice;
+        // Retired regions whose objects the wiper moves a slice at a time.
+        // Each is recorded in LevelDB until done, and every slice deletes
+        // what it moves in the same write, so a restart picks up where the
+        // last slice left off.
+        class relabel_request
+        {
+            public:
+                relabel_request(const region_id& f,
+                                const std::vector<region_id>& t);
+                ~relabel_request() throw ();
+
+            public:
+                region_id from;
+                // sorted
+                std::vector<region_id> to;
+                // the key the next slice starts from
+                std::string resume;
+                // every object has moved; the index entries are left
+                bool moved;
+        };
+        typedef std::list<relabel_request> relabel_list_t;
+        relabel_list_t m_relabeling;
+        // loads waiting on the bulk loading thread; the front is in progress
+        class bulk_load_request
+        {
+            public:
+                bulk_load_request(const server_id& f,
+                                  const virtual_server_id& v,
+                                  uint64_t n,
+                                  const std::string& s,
+                                  const std::string& p);
+                ~bulk_load_request() throw ();
+
+            public:
+                server_id from;
+                virtual_server_id vto;
+                uint64_t nonce;
+                std::string space;
+                std::string path;
+        };
+        typedef std::list<bulk_load_request> bulk_load_list_t;
+        bulk_load_list_t m_bulk_loads;
+        // m_relabeling.size(), read without m_protect
+        uint64_t m_relabels;
+        // the objects' new regions are unknown until the first configuration
+        bool m_configured;
+        // serializes moving objects, so a key moves once; taken before
+        // m_protect
+        po6::threads::mutex m_relabel_protect;
+        // keyed by (point leader region, region we saw an ack for)
+        typedef std::map<std::pair<region_id, region_id>, acked_window> acked_map_t;
+        po6::threads::mutex m_acked_protect;
+        acked_map_t m_acked;
+        // counted as we write, in one slot per writing thread so writers do
+        // not contend; every write persists its slot's new totals in the
+        // same WriteBatch as its data.  Slot 0 holds the totals folded
+        // together at startup.  m_stats_protect guards the list; each slot
+        // guards its own totals.
+        typedef std::vector<region_stats_slot*> stats_slot_list_t;
+        const uint64_t m_stats_generation;
+        po6::threads::mutex m_stats_protect;
+        stats_slot_list_t m_stats_slots;
+        // invalidated by every write to an object; see object_cache.h
+        object_cache m_cache;
 };
 
 class datalayer::reference
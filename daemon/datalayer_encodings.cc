@@ -32,10 +32,16 @@
 #include <e/endian.h>
 
 // HyperDex
+#include "cityhash/city.h"
 #include "daemon/datalayer_encodings.h"
 #include "daemon/index_info.h"
 
 using hyperdex::datalayer;
+using hyperdex::index_info;
+using hyperdex::region_id;
+using hyperdex::schema;
+using hyperdex::scratch_arena;
+using hyperdex::subspace;
 
 void
 hyperdex :: encode_object_region(const region_id& ri,
@@ -75,6 +81,23 @@ hyperdex :: encode_key(const region_id& ri,
     memmove(ptr, internal_key.data(), internal_key.size());
 }
 
+static size_t
+encoded_key_size(index_info* ii, const e::slice& key)
+{
+    return sizeof(uint8_t) + sizeof(uint64_t) + ii->encoded_size(key);
+}
+
+static void
+encode_key_into(const region_id& ri,
+                index_info* ii,
+                const e::slice& key,
+                char* ptr)
+{
+    ptr = e::pack8be('o', ptr);
+    ptr = e::pack64be(ri.get(), ptr);
+    ii->encode(key, ptr);
+}
+
 void
 hyperdex :: encode_key(const region_id& ri,
                        hyperdatatype key_type,
@@ -83,7 +106,7 @@ hyperdex :: encode_key(const region_id& ri,
                        leveldb::Slice* out)
 {
     index_info* ii(index_info::lookup(key_type));
-    size_t sz = sizeof(uint8_t) + sizeof(uint64_t) + ii->encoded_size(key);
+    size_t sz = encoded_key_size(ii, key);
 
     if (scratch->size() < sz)
     {
@@ -92,9 +115,21 @@ hyperdex :: encode_key(const region_id& ri,
 
     char* ptr = &scratch->front();
     *out = leveldb::Slice(ptr, sz);
-    ptr = e::pack8be('o', ptr);
-    ptr = e::pack64be(ri.get(), ptr);
-    ii->encode(key, ptr);
+    encode_key_into(ri, ii, key, ptr);
+}
+
+void
+hyperdex :: encode_key(const region_id& ri,
+                       hyperdatatype key_type,
+                       const e::slice& key,
+                       scratch_arena* arena,
+                       leveldb::Slice* out)
+{
+    index_info* ii(index_info::lookup(key_type));
+    size_t sz = encoded_key_size(ii, key);
+    char* ptr = arena->allocate(sz);
+    *out = leveldb::Slice(ptr, sz);
+    encode_key_into(ri, ii, key, ptr);
 }
 
 bool
@@ -117,11 +152,16 @@ hyperdex :: decode_key(const leveldb::Slice& in,
     return true;
 }
 
-void
-hyperdex :: encode_value(const std::vector<e::slice>& attrs,
-                         uint64_t version,
-                         std::vector<char>* backing,
-                         leveldb::Slice* out)
+uint64_t
+hyperdex :: hash_key(const leveldb::Slice& in)
+{
+    const size_t sz = sizeof(uint8_t) + sizeof(uint64_t);
+    assert(in.size() >= sz);
+    return CityHash64(in.data() + sz, in.size() - sz);
+}
+
+static size_t
+encoded_value_size(const std::vector<e::slice>& attrs)
 {
     assert(attrs.size() < 65536);
     size_t sz = sizeof(uint64_t) + sizeof(uint16_t);
@@ -131,8 +171,14 @@ hyperdex :: encode_value(const std::vector<e::slice>& attrs,
         sz += sizeof(uint32_t) + attrs[i].size();
     }
 
-    backing->resize(sz);
-    char* ptr = &backing->front();
+    return sz;
+}
+
+static void
+encode_value_into(const std::vector<e::slice>& attrs,
+                  uint64_t version,
+                  char* ptr)
+{
     ptr = e::pack64be(version, ptr);
     ptr = e::pack16be(attrs.size(), ptr);
 
@@ -142,10 +188,32 @@ hyperdex :: encode_value(const std::vector<e::slice>& attrs,
         memmove(ptr, attrs[i].data(), attrs[i].size());
         ptr += attrs[i].size();
     }
+}
 
+void
+hyperdex :: encode_value(const std::vector<e::slice>& attrs,
+                         uint64_t version,
+                         std::vector<char>* backing,
+                         leveldb::Slice* out)
+{
+    size_t sz = encoded_value_size(attrs);
+    backing->resize(sz);
+    encode_value_into(attrs, version, &backing->front());
     *out = leveldb::Slice(&backing->front(), sz);
 }
 
+void
+hyperdex :: encode_value(const std::vector<e::slice>& attrs,
+                         uint64_t version,
+                         scratch_arena* arena,
+                         leveldb::Slice* out)
+{
+    size_t sz = encoded_value_size(attrs);
+    char* ptr = arena->allocate(sz);
+    encode_value_into(attrs, version, ptr);
+    *out = leveldb::Slice(ptr, sz);
+}
+
 datalayer::returncode
 hyperdex :: decode_value(const e::slice& in,
                          std::vector<e::slice>* attrs,
@@ -265,6 +333,141 @@ hyperdex :: decode_checkpoint(const e::slice& in,
     return t == 'c' ? datalayer::SUCCESS : datalayer::BAD_ENCODING;
 }
 
+void
+hyperdex :: encode_region_stats(const region_id& ri,
+                                uint32_t slot,
+                                const region_stats& rs,
+                                char* key,
+                                char* value)
+{
+    char* ptr = key;
+    ptr = e::pack8be('r', ptr);
+    ptr = e::pack64be(ri.get(), ptr);
+    ptr = e::pack32be(slot, ptr);
+    ptr = value;
+    ptr = e::pack64be(rs.objects, ptr);
+    ptr = e::pack64be(rs.bytes, ptr);
+    ptr = e::pack64be(rs.index_bytes, ptr);
+}
+
+datalayer::returncode
+hyperdex :: decode_region_stats(const e::slice& key,
+                                const e::slice& value,
+                                region_id* ri,
+                                uint32_t* slot,
+                                region_stats* rs)
+{
+    if (key.size() != REGION_STATS_KEY_SIZE ||
+        value.size() != REGION_STATS_VALUE_SIZE)
+    {
+        return datalayer::BAD_ENCODING;
+    }
+
+    const uint8_t* ptr = key.data();
+    uint8_t t;
+    uint64_t _ri;
+    ptr = e::unpack8be(ptr, &t);
+    ptr = e::unpack64be(ptr, &_ri);
+    ptr = e::unpack32be(ptr, slot);
+    *ri = region_id(_ri);
+    uint64_t objects;
+    uint64_t bytes;
+    uint64_t index_bytes;
+    ptr = value.data();
+    ptr = e::unpack64be(ptr, &objects);
+    ptr = e::unpack64be(ptr, &bytes);
+    ptr = e::unpack64be(ptr, &index_bytes);
+    rs->objects = objects;
+    rs->bytes = bytes;
+    rs->index_bytes = index_bytes;
+    return t == 'r' ? datalayer::SUCCESS : datalayer::BAD_ENCODING;
+}
+
+void
+hyperdex :: encode_relabel(const region_id& from,
+                           const std::vector<region_id>& to,
+                           char* key,
+                           std::string* value)
+{
+    char* ptr = key;
+    ptr = e::pack8be('m', ptr);
+    ptr = e::pack64be(from.get(), ptr);
+    value->resize(to.size() * sizeof(uint64_t));
+
+    for (size_t i = 0; i < to.size(); ++i)
+    {
+        e::pack64be(to[i].get(), &(*value)[0] + i * sizeof(uint64_t));
+    }
+}
+
+datalayer::returncode
+hyperdex :: decode_relabel(const e::slice& key,
+                           const e::slice& value,
+                           region_id* from,
+                           std::vector<region_id>* to)
+{
+    if (key.size() != RELABEL_KEY_SIZE ||
+        value.size() % sizeof(uint64_t) != 0)
+    {
+        return datalayer::BAD_ENCODING;
+    }
+
+    const uint8_t* ptr = key.data();
+    uint8_t t;
+    uint64_t _from;
+    ptr = e::unpack8be(ptr, &t);
+    ptr = e::unpack64be(ptr, &_from);
+    *from = region_id(_from);
+    to->clear();
+
+    for (ptr = value.data(); ptr < value.data() + value.size(); )
+    {
+        uint64_t _to;
+        ptr = e::unpack64be(ptr, &_to);
+        to->push_back(region_id(_to));
+    }
+
+    return t == 'm' ? datalayer::SUCCESS : datalayer::BAD_ENCODING;
+}
+
+static void
+create_index_changes_for(const schema& sc,
+                         const subspace& sub,
+                         const region_id& ri,
+                         uint16_t attr,
+                         const e::slice& key,
+                         const std::vector<e::slice>* old_value,
+                         const std::vector<e::slice>* new_value,
+                         scratch_arena* arena,
+                         leveldb::WriteBatch* updates)
+{
+    assert(attr < sc.attrs_sz);
+
+    if (attr == 0)
+    {
+        return;
+    }
+
+    if (!sub.indexed(attr))
+    {
+        return;
+    }
+
+    index_info* ki = index_info::lookup(sc.attrs[0].type);
+    index_info* ai = index_info::lookup(sc.attrs[attr].type);
+
+    if (!ai)
+    {
+        return;
+    }
+
+    assert(ki);
+    ai->index_changes(ri, attr, ki, key,
+                      old_value ? &(*old_value)[attr - 1] : NULL,
+                      new_value ? &(*new_value)[attr - 1] : NULL,
+                      arena, updates);
+}
+
 void
 hyperdex :: create_index_changes(const schema& sc,
                                  const subspace& sub,
@@ -272,53 +475,23 @@ hyperdex :: create_index_changes(const schema& sc,
                                  const e::slice& key,
                                  const std::vector<e::slice>* old_value,
                                  const std::vector<e::slice>* new_value,
+                                 scratch_arena* arena,
                                  leveldb::WriteBatch* updates)
 {
     assert(!old_value || !new_value || old_value->size() == new_value->size());
     assert(!old_value || old_value->size() + 1 == sc.attrs_sz);
     assert(!new_value || new_value->size() + 1 == sc.attrs_sz);
-    std::vector<uint16_t> attrs;
 
     for (size_t i = 0; i < sub.attrs.size(); ++i)
     {
-        uint16_t attr = sub.attrs[i];
-        attrs.push_back(attr);
+        create_index_changes_for(sc, sub, ri, sub.attrs[i], key,
+                                 old_value, new_value, arena, updates);
     }
 
     for (size_t i = 0; i < sub.indices.size(); ++i)
     {
-        uint16_t attr = sub.indices[i];
-        attrs.push_back(attr);
-    }
-
-    for (size_t i = 0; i < attrs.size(); ++i)
-    {
-        uint16_t attr = attrs[i];
-        assert(attr < sc.attrs_sz);
-
-        if (attr == 0)
-        {
-            continue;
-        }
-
-        if (!sub.indexed(attr))
-        {
-            continue;
-        }
-
-        index_info* ki = index_info::lookup(sc.attrs[0].type);
-        index_info* ai = index_info::lookup(sc.attrs[attr].type);
-
-        if (!ai)
-        {
-            continue;
-        }
-
-        assert(ki);
-        ai->index_changes(ri, attr, ki, key,
-                          old_value ? &(*old_value)[attr - 1] : NULL,
-                          new_value ? &(*new_value)[attr - 1] : NULL,
-                          updates);
+        create_index_changes_for(sc, sub, ri, sub.indices[i], key,
+                                 old_value, new_value, arena, updates);
     }
 }
 
@@ -35,6 +35,8 @@
 #include "namespace.h"
 #include "common/ids.h"
 #include "daemon/datalayer.h"
+#include "daemon/region_stats.h"
+#include "daemon/scratch_arena.h"
 
 BEGIN_HYPERDEX_NAMESPACE
 
@@ -56,16 +58,33 @@ encode_key(const region_id& ri,
            std::vector<char>* scratch,
            leveldb::Slice* out);
 
+void
+encode_key(const region_id& ri,
+           hyperdatatype key_type,
+           const e::slice& key,
+           scratch_arena* arena,
+           leveldb::Slice* out);
+
 bool
 decode_key(const leveldb::Slice& in,
            region_id* ri,
            e::slice* internal_key);
 
+// hash the region-independent part of an encoded object key; used to split a
+// region into transfer streams and Merkle tree buckets
+uint64_t
+hash_key(const leveldb::Slice& in);
+
 void
 encode_value(const std::vector<e::slice>& attrs,
              uint64_t version,
              std::vector<char>* backing,
              leveldb::Slice* out);
+void
+encode_value(const std::vector<e::slice>& attrs,
+             uint64_t version,
+             scratch_arena* arena,
+             leveldb::Slice* out);
 datalayer::returncode
 decode_value(const e::slice& in,
              std::vector<e::slice>* attrs,
@@ -95,6 +114,35 @@ decode_checkpoint(const e::slice& in,
                   region_id* ri,
                   uint64_t* checkpoint);
 
+// per-region statistics, as totalled by one writer ("slot")
+#define REGION_STATS_KEY_SIZE (sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint32_t))
+#define REGION_STATS_VALUE_SIZE (3 * sizeof(uint64_t))
+void
+encode_region_stats(const region_id& ri,
+                    uint32_t slot,
+                    const region_stats& rs,
+                    char* key,
+                    char* value);
+datalayer::returncode
+decode_region_stats(const e::slice& key,
+                    const e::slice& value,
+                    region_id* ri,
+                    uint32_t* slot,
+                    region_stats* rs);
+
+// regions a split or merge retired whose objects are still to be moved
+#define RELABEL_KEY_SIZE (sizeof(uint8_t) + sizeof(uint64_t))
+void
+encode_relabel(const region_id& from,
+               const std::vector<region_id>& to,
+               char* key,
+               std::string* value);
+datalayer::returncode
+decode_relabel(const e::slice& key,
+               const e::slice& value,
+               region_id* from,
+               std::vector<region_id>* to);
+
 void
 create_index_changes(const schema& sc,
                      const subspace& sub,
@@ -102,6 +150,7 @@ create_index_changes(const schema& sc,
                      const e::slice& key,
                      const std::vector<e::slice>* old_value,
                      const std::vector<e::slice>* new_value,
+                     scratch_arena* arena,
                      leveldb::WriteBatch* updates);
 
 void
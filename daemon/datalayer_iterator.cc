@@ -34,6 +34,7 @@
 #include "daemon/daemon.h"
 #include "daemon/datalayer_encodings.h"
 #include "daemon/datalayer_iterator.h"
+#include "daemon/merkle_tree.h"
 
 using hyperdex::datalayer;
 using hyperdex::leveldb_snapshot_ptr;
@@ -88,13 +89,26 @@ datalayer :: iterator :: ~iterator() throw ()
 
 datalayer :: replay_iterator :: replay_iterator(const region_id& ri,
                                                 leveldb_replay_iterator_ptr ptr,
-                                                index_info* di)
+                                                index_info* di,
+                                                const std::string& lower,
+                                                const std::string& upper,
+                                                leveldb_iterator_ptr snap,
+                                                const std::vector<bool>& buckets)
     : m_ri(ri)
     , m_iter(ptr.get())
     , m_ptr(ptr)
     , m_decoded()
     , m_di(di)
+    , m_lower(lower)
+    , m_upper(upper)
+    , m_snap(snap)
+    , m_buckets(buckets)
+    , m_in_snap(snap.get() != NULL)
 {
+    if (m_in_snap)
+    {
+        m_snap->Seek(m_lower);
+    }
 }
 
 bool
@@ -106,9 +120,29 @@ datalayer :: replay_iterator :: valid()
     ptr = e::pack64be(m_ri.get(), ptr);
     leveldb::Slice prefix(buf, sizeof(uint8_t) + sizeof(uint64_t));
 
+    // the snapshot was sought to "m_lower" and is in key order, so the
+    // first key past the range ends it
+    while (m_in_snap && m_snap->Valid() && m_snap->key().starts_with(prefix) &&
+           (m_upper.empty() || m_snap->key().compare(m_upper) < 0))
+    {
+        if (m_buckets.empty() ||
+            m_buckets[merkle_tree::bucket(hash_key(m_snap->key()))])
+        {
+            return true;
+        }
+
+        m_snap->Next();
+    }
+
+    m_in_snap = false;
+
+    // the replay cannot seek, so the changes to the rest of the region are
+    // skipped over
     while (m_iter->Valid())
     {
-        if (m_iter->key().starts_with(prefix))
+        leveldb::Slice k = m_iter->key();
+
+        if (k.starts_with(prefix) && in_range(k))
         {
             return true;
         }
@@ -122,20 +156,27 @@ datalayer :: replay_iterator :: valid()
 void
 datalayer :: replay_iterator :: next()
 {
-    m_iter->Next();
+    if (m_in_snap)
+    {
+        m_snap->Next();
+    }
+    else
+    {
+        m_iter->Next();
+    }
 }
 
 bool
 datalayer :: replay_iterator :: has_value()
 {
-    return m_iter->HasValue();
+    return m_in_snap || m_iter->HasValue();
 }
 
 e::slice
 datalayer :: replay_iterator :: key()
 {
     const size_t sz = sizeof(uint8_t) + sizeof(uint64_t);
-    leveldb::Slice _k = m_iter->key();
+    leveldb::Slice _k = m_in_snap ? m_snap->key() : m_iter->key();
     e::slice k = e::slice(_k.data() + sz, _k.size() - sz);
     size_t decoded_sz = m_di->decoded_size(k);
 
@@ -153,15 +194,23 @@ datalayer :: replay_iterator :: unpack_value(std::vector<e::slice>* value,
                                              uint64_t* version,
                                              reference* ref)
 {
-    ref->m_backing.assign(m_iter->value().data(), m_iter->value().size());
-    e::slice v(ref->m_backing.data(), ref->m_backing.size());
-    return decode_value(v, value, version);
+    leveldb::Slice v = m_in_snap ? m_snap->value() : m_iter->value();
+    ref->m_backing.assign(v.data(), v.size());
+    e::slice backing(ref->m_backing.data(), ref->m_backing.size());
+    return decode_value(backing, value, version);
 }
 
 leveldb::Status
 datalayer :: replay_iterator :: status()
 {
-    return m_iter->status();
+    return m_in_snap ? m_snap->status() : m_iter->status();
+}
+
+bool
+datalayer :: replay_iterator :: in_range(const leveldb::Slice& k)
+{
+    return k.compare(m_lower) >= 0 &&
+           (m_upper.empty() || k.compare(m_upper) < 0);
 }
 
 ///////////////////////////// class dummy_iterator /////////////////////////////
@@ -484,7 +533,7 @@ datalayer :: search_iterator :: valid()
 
     // Don't try to optimize by replacing m_ri with a const schema* because it
     // won't persist across reconfigurations
-    const schema& sc(*m_dl->m_daemon->m_config.get_schema(m_ri));
+    const schema& sc(*m_dl->m_daemon->m_config->get_schema(m_ri));
 
     uint64_t version;
     std::vector<e::slice> value;
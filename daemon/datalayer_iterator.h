@@ -69,7 +69,14 @@ class datalayer::iterator
 class datalayer::replay_iterator
 {
     public:
-        replay_iterator(const region_id& ri, leveldb_replay_iterator_ptr ptr, index_info* di);
+        // Only keys from "lower" up to, but not including, "upper" are
+        // visited; both are encoded object keys, and an empty "upper" means
+        // the end of the region.  If "snap" is set, the objects it holds in
+        // the Merkle tree buckets flagged in "buckets" (all of them if it is
+        // empty) come first, then the changes in "ptr".
+        replay_iterator(const region_id& ri, leveldb_replay_iterator_ptr ptr, index_info* di,
+                        const std::string& lower, const std::string& upper,
+                        leveldb_iterator_ptr snap, const std::vector<bool>& buckets);
 
     public:
         bool valid();
@@ -81,12 +88,20 @@ class datalayer::replay_iterator
                                 reference* ref);
         leveldb::Status status();
 
+    private:
+        bool in_range(const leveldb::Slice& k);
+
     private:
         region_id m_ri;
         leveldb::ReplayIterator* m_iter;
         leveldb_replay_iterator_ptr m_ptr;
         std::vector<char> m_decoded;
         index_info* m_di;
+        std::string m_lower;
+        std::string m_upper;
+        leveldb_iterator_ptr m_snap;
+        std::vector<bool> m_buckets;
+        bool m_in_snap;
 
     private:
         replay_iterator(const replay_iterator&);
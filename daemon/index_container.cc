@@ -83,12 +83,11 @@ index_container :: index_changes(const region_id& ri,
                                  const e::slice& key,
                                  const e::slice* old_value,
                                  const e::slice* new_value,
+                                 scratch_arena* arena,
                                  leveldb::WriteBatch* updates)
 {
     std::vector<e::slice> old_elems;
     std::vector<e::slice> new_elems;
-    std::vector<char> scratch;
-    leveldb::Slice slice;
 
     if (old_value)
     {
@@ -118,20 +117,20 @@ index_container :: index_changes(const region_id& ri,
         {
             ii->index_changes(ri, attr, key_ii, key,
                               &old_elems[old_idx], &new_elems[new_idx],
-                              updates);
+                              arena, updates);
             ++old_idx;
             ++new_idx;
         }
         else if (old_elems[old_idx] < new_elems[new_idx])
         {
             ii->index_changes(ri, attr, key_ii, key,
-                              &old_elems[old_idx], NULL, updates);
+                              &old_elems[old_idx], NULL, arena, updates);
             ++old_idx;
         }
         else if (old_elems[old_idx] > new_elems[new_idx])
         {
             ii->index_changes(ri, attr, key_ii, key,
-                              NULL, &new_elems[new_idx], updates);
+                              NULL, &new_elems[new_idx], arena, updates);
             ++new_idx;
         }
     }
@@ -139,14 +138,14 @@ index_container :: index_changes(const region_id& ri,
     while (old_idx < old_elems.size())
     {
         ii->index_changes(ri, attr, key_ii, key,
-                          &old_elems[old_idx], NULL, updates);
+                          &old_elems[old_idx], NULL, arena, updates);
         ++old_idx;
     }
 
     while (new_idx < new_elems.size())
     {
         ii->index_changes(ri, attr, key_ii, key,
-                          NULL, &new_elems[new_idx], updates);
+                          NULL, &new_elems[new_idx], arena, updates);
         ++new_idx;
     }
 }
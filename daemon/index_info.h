@@ -41,6 +41,7 @@
 #include "common/ids.h"
 #include "common/range.h"
 #include "daemon/datalayer.h"
+#include "daemon/scratch_arena.h"
 
 BEGIN_HYPERDEX_NAMESPACE
 
@@ -74,13 +75,14 @@ class index_info
     // override these if the type can be in a localized index
     public:
         // apply to updates all the writes necessary to transform the index from
-        // old_value to new_value
+        // old_value to new_value; temporary encodings come from arena
         virtual void index_changes(const region_id& ri,
                                    uint16_t attr,
                                    index_info* key_ii,
                                    const e::slice& key,
                                    const e::slice* old_value,
                                    const e::slice* new_value,
+                                   scratch_arena* arena,
                                    leveldb::WriteBatch* updates) = 0;
         // return an iterator that retrieves at least the keys matching r
         // if not indexable (full scan), return NULL
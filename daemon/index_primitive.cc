@@ -51,9 +51,10 @@ index_primitive :: index_changes(const region_id& ri,
                                  const e::slice& key,
                                  const e::slice* old_value,
                                  const e::slice* new_value,
+                                 scratch_arena* arena,
                                  leveldb::WriteBatch* updates)
 {
-    std::vector<char> scratch;
+    scratch_arena::scope s(arena);
     leveldb::Slice slice;
 
     if (old_value && new_value && *old_value == *new_value)
@@ -63,13 +64,13 @@ index_primitive :: index_changes(const region_id& ri,
 
     if (old_value)
     {
-        index_entry(ri, attr, key_ii, key, *old_value, &scratch, &slice);
+        index_entry(ri, attr, key_ii, key, *old_value, arena, &slice);
         updates->Delete(slice);
     }
 
     if (new_value)
     {
-        index_entry(ri, attr, key_ii, key, *new_value, &scratch, &slice);
+        index_entry(ri, attr, key_ii, key, *new_value, arena, &slice);
         updates->Put(slice, leveldb::Slice());
     }
 }
@@ -162,7 +163,7 @@ index_primitive :: index_entry(const region_id& ri,
                                index_info* key_ii,
                                const e::slice& key,
                                const e::slice& value,
-                               std::vector<char>* scratch,
+                               scratch_arena* arena,
                                leveldb::Slice* slice)
 {
     size_t key_sz = key_ii->encoded_size(key);
@@ -174,13 +175,8 @@ index_primitive :: index_entry(const region_id& ri,
               + val_sz
               + key_sz
               + (variable ? sizeof(uint32_t) : 0);
-
-    if (scratch->size() < sz)
-    {
-        scratch->resize(sz);
-    }
-
-    char* ptr = &scratch->front();
+    char* start = arena->allocate(sz);
+    char* ptr = start;
     ptr = e::pack8be('i', ptr);
     ptr = e::pack64be(ri.get(), ptr);
     ptr = e::pack16be(attr, ptr);
@@ -192,8 +188,8 @@ index_primitive :: index_entry(const region_id& ri,
         ptr = e::pack32be(key_sz, ptr);
     }
 
-    assert(ptr == &scratch->front() + sz);
-    *slice = leveldb::Slice(&scratch->front(), sz);
+    assert(ptr == start + sz);
+    *slice = leveldb::Slice(start, sz);
 }
 
 namespace
@@ -47,6 +47,7 @@ class index_primitive : public index_info
                                    const e::slice& key,
                                    const e::slice* old_value,
                                    const e::slice* new_value,
+                                   scratch_arena* arena,
                                    leveldb::WriteBatch* updates);
         virtual datalayer::index_iterator* iterator_from_range(leveldb_snapshot_ptr snap,
                                                                const region_id& ri,
@@ -74,7 +75,7 @@ class index_primitive : public index_info
                          index_info* key_ii,
                          const e::slice& key,
                          const e::slice& value,
-                         std::vector<char>* scratch,
+                         scratch_arena* arena,
                          leveldb::Slice* slice);
 };
 
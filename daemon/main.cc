@@ -25,6 +25,9 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+// STL
+#include <algorithm>
+
 // Popt
 #include <popt.h>
 
@@ -55,6 +58,10 @@ static const char* _coordinator_host = "127.0.0.1";
 static unsigned long _coordinator_port = 1982;
 static bool _coordinator = false;
 static long _threads = 0;
+static long _scan_threads = 0;
+static long _transfer_compression = 1;
+static long _background_rate = 0;
+static long _latency_target = 0;
 
 extern "C"
 {
@@ -86,6 +93,18 @@ static struct poptOption popts[] = {
     {"threads", 't', POPT_ARG_LONG, &_threads, 't',
      "the number of threads which will handle network traffic",
      "N"},
+    {"scan-threads", 's', POPT_ARG_LONG, &_scan_threads, 's',
+     "the number of threads which will run searches, counts and group operations (default: a quarter of --threads)",
+     "N"},
+    {"transfer-compression", 'z', POPT_ARG_LONG, &_transfer_compression, 'z',
+     "compress state transfers from 1 (fastest) to 9 (smallest), or 0 to send them uncompressed (default: 1)",
+     "level"},
+    {"background-rate", 'r', POPT_ARG_LONG, &_background_rate, 'r',
+     "limit state transfer and wiping to this many MB/s, or 0 for no limit (default: 0)",
+     "MB/s"},
+    {"latency-target", 'T', POPT_ARG_LONG, &_latency_target, 'T',
+     "slow background work while client operations take longer than this many microseconds, or 0 to never (default: 0)",
+     "us"},
     POPT_TABLEEND
 };
 
@@ -165,6 +184,32 @@ main(int argc, const char* argv[])
                 _coordinator = true;
                 break;
             case 't':
+                break;
+            case 's':
+                break;
+            case 'z':
+                if (_transfer_compression < 0 || _transfer_compression > 9)
+                {
+                    std::cerr << "transfer compression level must be between 0 and 9" << std::endl;
+                    return EXIT_FAILURE;
+                }
+
+                break;
+            case 'r':
+                if (_background_rate < 0)
+                {
+                    std::cerr << "background rate must not be negative" << std::endl;
+                    return EXIT_FAILURE;
+                }
+
+                break;
+            case 'T':
+                if (_latency_target < 0)
+                {
+                    std::cerr << "latency target must not be negative" << std::endl;
+                    return EXIT_FAILURE;
+                }
+
                 break;
             case POPT_ERROR_NOARG:
             case POPT_ERROR_BADOPT:
@@ -224,7 +269,19 @@ main(int argc, const char* argv[])
             return EXIT_FAILURE;
         }
 
-        return d.run(_daemonize, data, log, _listen, bind_to, _coordinator, coord, _threads);
+        if (_scan_threads <= 0)
+        {
+            _scan_threads = std::max(1L, _threads / 4);
+        }
+        else if (_scan_threads > 512)
+        {
+            std::cerr << "refusing to create more than 512 scan threads" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        return d.run(_daemonize, data, log, _listen, bind_to, _coordinator, coord, _threads, _scan_threads, _transfer_compression,
+                     _background_rate * 1024ULL * 1024ULL,
+                     _latency_target * 1000ULL);
     }
     catch (po6::error& e)
     {
@@ -0,0 +1,140 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// HyperDex
+#include "cityhash/city.h"
+#include "daemon/merkle_tree.h"
+
+using hyperdex::merkle_tree;
+
+merkle_tree :: merkle_tree()
+    : m_nodes(2 * BUCKETS, 0)
+    , m_built(false)
+{
+}
+
+merkle_tree :: ~merkle_tree() throw ()
+{
+}
+
+uint32_t
+merkle_tree :: bucket(uint64_t key_hash)
+{
+    // use the high bits; the low bits pick the transfer stream
+    return (key_hash >> 32) % BUCKETS;
+}
+
+void
+merkle_tree :: add(uint64_t key_hash, uint64_t object_hash)
+{
+    m_nodes[BUCKETS + bucket(key_hash)] ^= object_hash;
+    m_built = false;
+}
+
+uint64_t
+merkle_tree :: root()
+{
+    build();
+    return m_nodes[1];
+}
+
+void
+merkle_tree :: diff(merkle_tree* other, std::vector<uint32_t>* buckets)
+{
+    build();
+    other->build();
+    buckets->clear();
+    std::vector<uint32_t> stack;
+    stack.push_back(1);
+
+    while (!stack.empty())
+    {
+        uint32_t n = stack.back();
+        stack.pop_back();
+
+        if (m_nodes[n] == other->m_nodes[n])
+        {
+            continue;
+        }
+
+        if (n >= BUCKETS)
+        {
+            buckets->push_back(n - BUCKETS);
+        }
+        else
+        {
+            // right first so the buckets come off the stack in order
+            stack.push_back(2 * n + 1);
+            stack.push_back(2 * n);
+        }
+    }
+}
+
+void
+merkle_tree :: build()
+{
+    if (m_built)
+    {
+        return;
+    }
+
+    for (uint32_t n = BUCKETS - 1; n > 0; --n)
+    {
+        m_nodes[n] = Hash128to64(uint128_t(m_nodes[2 * n], m_nodes[2 * n + 1]));
+    }
+
+    m_built = true;
+}
+
+e::buffer::packer
+hyperdex :: operator << (e::buffer::packer lhs, const merkle_tree& rhs)
+{
+    for (uint32_t i = 0; i < merkle_tree::BUCKETS; ++i)
+    {
+        lhs = lhs << rhs.m_nodes[merkle_tree::BUCKETS + i];
+    }
+
+    return lhs;
+}
+
+e::unpacker
+hyperdex :: operator >> (e::unpacker lhs, merkle_tree& rhs)
+{
+    for (uint32_t i = 0; i < merkle_tree::BUCKETS; ++i)
+    {
+        lhs = lhs >> rhs.m_nodes[merkle_tree::BUCKETS + i];
+    }
+
+    rhs.m_built = false;
+    return lhs;
+}
+
+size_t
+hyperdex :: pack_size(const merkle_tree&)
+{
+    return merkle_tree::BUCKETS * sizeof(uint64_t);
+}
@@ -0,0 +1,92 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_merkle_tree_h_
+#define hyperdex_daemon_merkle_tree_h_
+
+// C
+#include <stdint.h>
+
+// STL
+#include <vector>
+
+// e
+#include <e/buffer.h>
+
+// HyperDex
+#include "namespace.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// A hash tree summarizing the objects of one region.
+//
+// Objects fall into BUCKETS buckets by the hash of their key.  Each leaf is the
+// XOR of the hashes of the objects in its bucket, so objects may be added in
+// any order and two replicas holding the same objects build the same tree.
+// Comparing two trees from the root down finds the buckets that differ
+// without looking at the buckets that match.  Only the leaves go over the
+// wire; each end builds the inner nodes itself.
+class merkle_tree
+{
+    public:
+        static const uint32_t BUCKETS = 1024;
+
+    public:
+        merkle_tree();
+        ~merkle_tree() throw ();
+
+    public:
+        static uint32_t bucket(uint64_t key_hash);
+        void add(uint64_t key_hash, uint64_t object_hash);
+        uint64_t root();
+        // the buckets whose contents differ between the trees, in order
+        void diff(merkle_tree* other, std::vector<uint32_t>* buckets);
+
+    private:
+        friend e::buffer::packer operator << (e::buffer::packer lhs, const merkle_tree& rhs);
+        friend e::unpacker operator >> (e::unpacker lhs, merkle_tree& rhs);
+
+    private:
+        void build();
+
+    private:
+        // a complete binary tree; node i has children 2i and 2i + 1, and the
+        // leaves are nodes BUCKETS through 2 * BUCKETS - 1
+        std::vector<uint64_t> m_nodes;
+        bool m_built;
+};
+
+e::buffer::packer
+operator << (e::buffer::packer lhs, const merkle_tree& rhs);
+e::unpacker
+operator >> (e::unpacker lhs, merkle_tree& rhs);
+size_t
+pack_size(const merkle_tree& rhs);
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_daemon_merkle_tree_h_
@@ -0,0 +1,216 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// HyperDex
+#include "daemon/object_cache.h"
+
+using hyperdex::object_cache;
+
+// per-entry bookkeeping charged against the capacity on top of key and value
+#define ENTRY_OVERHEAD 64
+
+namespace
+{
+
+uint64_t
+hash_key(const e::slice& key)
+{
+    // FNV-1a
+    uint64_t h = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < key.size(); ++i)
+    {
+        h ^= key.data()[i];
+        h *= 1099511628211ULL;
+    }
+
+    return h;
+}
+
+} // namespace
+
+class object_cache::shard
+{
+    public:
+        struct entry
+        {
+            entry(const std::string& k, const std::string& v) : key(k), value(v) {}
+            std::string key;
+            std::string value;
+        };
+        typedef std::list<entry> lru_t;
+        typedef std::tr1::unordered_map<std::string, lru_t::iterator> index_t;
+
+    public:
+        shard() : mtx(), gen(0), bytes(0), capacity(0), lru(), index() {}
+        ~shard() throw () {}
+
+    public:
+        void erase(index_t::iterator it)
+        {
+            bytes -= it->second->key.size() + it->second->value.size() + ENTRY_OVERHEAD;
+            lru.erase(it->second);
+            index.erase(it);
+        }
+
+    public:
+        po6::threads::mutex mtx;
+        uint64_t gen;
+        uint64_t bytes;
+        uint64_t capacity;
+        // most recently used at the front
+        lru_t lru;
+        index_t index;
+
+    private:
+        shard(const shard&);
+        shard& operator = (const shard&);
+};
+
+object_cache :: object_cache(uint64_t capacity)
+    : m_shards(new shard[SHARDS])
+    , m_hits()
+    , m_misses()
+{
+    for (size_t i = 0; i < SHARDS; ++i)
+    {
+        m_shards[i].capacity = capacity / SHARDS;
+    }
+}
+
+object_cache :: ~object_cache() throw ()
+{
+}
+
+bool
+object_cache :: lookup(const e::slice& key, std::string* value)
+{
+    shard* s = get_shard(key);
+    po6::threads::mutex::hold hold(&s->mtx);
+    shard::index_t::iterator it = s->index.find(std::string(reinterpret_cast<const char*>(key.data()), key.size()));
+
+    if (it == s->index.end())
+    {
+        m_misses.tap();
+        return false;
+    }
+
+    s->lru.splice(s->lru.begin(), s->lru, it->second);
+    *value = it->second->value;
+    m_hits.tap();
+    return true;
+}
+
+uint64_t
+object_cache :: generation(const e::slice& key)
+{
+    shard* s = get_shard(key);
+    po6::threads::mutex::hold hold(&s->mtx);
+    return s->gen;
+}
+
+void
+object_cache :: insert(const e::slice& key, const std::string& value, uint64_t gen)
+{
+    shard* s = get_shard(key);
+    uint64_t sz = key.size() + value.size() + ENTRY_OVERHEAD;
+    po6::threads::mutex::hold hold(&s->mtx);
+
+    // something in this shard was written since the caller read LevelDB, or
+    // the object would push out a large part of the shard
+    if (gen != s->gen || sz > s->capacity / 4)
+    {
+        return;
+    }
+
+    std::string k(reinterpret_cast<const char*>(key.data()), key.size());
+    shard::index_t::iterator it = s->index.find(k);
+
+    if (it != s->index.end())
+    {
+        s->erase(it);
+    }
+
+    s->lru.push_front(shard::entry(k, value));
+    s->index[k] = s->lru.begin();
+    s->bytes += sz;
+
+    while (s->bytes > s->capacity)
+    {
+        s->erase(s->index.find(s->lru.back().key));
+    }
+}
+
+void
+object_cache :: invalidate(const e::slice& key)
+{
+    shard* s = get_shard(key);
+    po6::threads::mutex::hold hold(&s->mtx);
+    shard::index_t::iterator it = s->index.find(std::string(reinterpret_cast<const char*>(key.data()), key.size()));
+
+    if (it != s->index.end())
+    {
+        s->erase(it);
+    }
+
+    ++s->gen;
+}
+
+void
+object_cache :: clear()
+{
+    for (size_t i = 0; i < SHARDS; ++i)
+    {
+        po6::threads::mutex::hold hold(&m_shards[i].mtx);
+        m_shards[i].lru.clear();
+        m_shards[i].index.clear();
+        m_shards[i].bytes = 0;
+        ++m_shards[i].gen;
+    }
+}
+
+void
+object_cache :: collect_stats(std::ostringstream* ret)
+{
+    uint64_t bytes = 0;
+
+    for (size_t i = 0; i < SHARDS; ++i)
+    {
+        po6::threads::mutex::hold hold(&m_shards[i].mtx);
+        bytes += m_shards[i].bytes;
+    }
+
+    *ret << " object_cache.bytes=" << bytes;
+    *ret << " object_cache.hits=" << m_hits.read();
+    *ret << " object_cache.misses=" << m_misses.read();
+}
+
+object_cache::shard*
+object_cache :: get_shard(const e::slice& key)
+{
+    return &m_shards[hash_key(key) % SHARDS];
+}
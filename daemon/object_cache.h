@@ -0,0 +1,91 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_object_cache_h_
+#define hyperdex_daemon_object_cache_h_
+
+// STL
+#include <list>
+#include <sstream>
+#include <string>
+#include <tr1/unordered_map>
+
+// po6
+#include <po6/threads/mutex.h>
+
+// e
+#include <e/array_ptr.h>
+#include <e/slice.h>
+
+// HyperDex
+#include "namespace.h"
+#include "daemon/performance_counter.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// A bounded LRU cache of encoded objects, keyed by their encoded LevelDB key.
+// It lets the network threads answer reads of recently used objects without
+// touching LevelDB, which may have to go to disk.
+//
+// Writers must invalidate a key after writing it to LevelDB.  Readers that
+// miss take the key's generation before reading LevelDB and pass it to
+// "insert", which drops the value if the key was invalidated in between so a
+// slow reader never caches a value older than the latest write.
+class object_cache
+{
+    public:
+        object_cache(uint64_t capacity);
+        ~object_cache() throw ();
+
+    public:
+        bool lookup(const e::slice& key, std::string* value);
+        uint64_t generation(const e::slice& key);
+        void insert(const e::slice& key, const std::string& value, uint64_t gen);
+        void invalidate(const e::slice& key);
+        void clear();
+        void collect_stats(std::ostringstream* ret);
+
+    private:
+        class shard;
+        static const size_t SHARDS = 16;
+
+    private:
+        shard* get_shard(const e::slice& key);
+
+    private:
+        const e::array_ptr<shard> m_shards;
+        performance_counter m_hits;
+        performance_counter m_misses;
+
+    private:
+        object_cache(const object_cache&);
+        object_cache& operator = (const object_cache&);
+};
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_daemon_object_cache_h_
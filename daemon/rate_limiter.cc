@@ -0,0 +1,198 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <algorithm>
+
+// e
+#include <e/time.h>
+
+// HyperDex
+#include "daemon/rate_limiter.h"
+
+using hyperdex::rate_limiter;
+
+// the bucket holds at most this fraction of a second's worth of tokens
+#define BURST_DIVISOR 10
+// how often, in nanoseconds, to adjust the rate to the foreground latency
+#define ADJUST_INTERVAL 100000000ULL
+// never adapt below 1/MIN_DIVISOR of the configured rate, so work finishes
+#define MIN_DIVISOR 64
+// recover 1/RECOVER_DIVISOR of the configured rate per interval
+#define RECOVER_DIVISOR 16
+
+rate_limiter :: rate_limiter()
+    : m_mtx()
+    , m_configured(0)
+    , m_rate(0)
+    , m_target(0)
+    , m_tokens(0)
+    , m_last_refill(e::time())
+    , m_last_adjust(0)
+    , m_latency(0)
+    , m_spent(0)
+    , m_throttled(0)
+{
+}
+
+rate_limiter :: ~rate_limiter() throw ()
+{
+}
+
+void
+rate_limiter :: set_rate(uint64_t rate)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    m_configured = rate;
+    m_rate = rate;
+    m_tokens = rate / BURST_DIVISOR;
+    m_last_refill = e::time();
+}
+
+void
+rate_limiter :: set_latency_target(uint64_t target)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    m_target = target;
+}
+
+bool
+rate_limiter :: may_spend()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    if (m_rate == 0)
+    {
+        return true;
+    }
+
+    refill(e::time());
+
+    if (m_tokens > 0)
+    {
+        return true;
+    }
+
+    ++m_throttled;
+    return false;
+}
+
+void
+rate_limiter :: spend(uint64_t bytes)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    m_spent += bytes;
+
+    if (m_rate > 0)
+    {
+        m_tokens -= bytes;
+    }
+}
+
+uint64_t
+rate_limiter :: delay()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    if (m_rate == 0)
+    {
+        return 0;
+    }
+
+    refill(e::time());
+
+    if (m_tokens > 0)
+    {
+        return 0;
+    }
+
+    return (static_cast<uint64_t>(-m_tokens) + 1) * 1000000000ULL / m_rate;
+}
+
+void
+rate_limiter :: observe(uint64_t latency)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    if (m_target == 0 || m_configured == 0)
+    {
+        return;
+    }
+
+    m_latency = (m_latency * 7 + latency) / 8;
+    uint64_t now = e::time();
+
+    if (now < m_last_adjust + ADJUST_INTERVAL)
+    {
+        return;
+    }
+
+    refill(now);
+    m_last_adjust = now;
+
+    if (m_latency > m_target)
+    {
+        m_rate = std::max(m_rate / 2, std::max<uint64_t>(m_configured / MIN_DIVISOR, 1));
+    }
+    else
+    {
+        m_rate = std::min(m_rate + m_configured / RECOVER_DIVISOR, m_configured);
+    }
+}
+
+uint64_t
+rate_limiter :: rate()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    return m_rate;
+}
+
+void
+rate_limiter :: collect_stats(std::ostringstream* ret)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    *ret << " background.rate=" << m_rate;
+    *ret << " background.bytes=" << m_spent;
+    *ret << " background.throttled=" << m_throttled;
+    *ret << " background.latency=" << m_latency;
+}
+
+void
+rate_limiter :: refill(uint64_t now)
+{
+    if (now <= m_last_refill)
+    {
+        return;
+    }
+
+    // a second's worth more than fills the bucket, and keeps this from
+    // overflowing
+    uint64_t elapsed = std::min<uint64_t>(now - m_last_refill, 1000000000ULL);
+    int64_t burst = m_rate / BURST_DIVISOR + 1;
+    m_tokens = std::min<int64_t>(m_tokens + elapsed * m_rate / 1000000000ULL, burst);
+    m_last_refill = now;
+}
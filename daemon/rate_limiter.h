@@ -0,0 +1,97 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_rate_limiter_h_
+#define hyperdex_daemon_rate_limiter_h_
+
+// C
+#include <stdint.h>
+
+// STL
+#include <sstream>
+
+// po6
+#include <po6/threads/mutex.h>
+
+// HyperDex
+#include "namespace.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// A token bucket, in bytes, shared by the daemon's background work (state
+// transfer and the wiper) so it cannot crowd out clients.
+//
+// Callers check "may_spend" before a unit of work and "spend" what it cost
+// afterwards; the bucket may go into debt, so callers never need to know a
+// cost up front.  When given a latency target, the rate halves each
+// adjustment interval in which foreground ops are slower than the target
+// and creeps back toward the configured rate otherwise.
+class rate_limiter
+{
+    public:
+        rate_limiter();
+        ~rate_limiter() throw ();
+
+    public:
+        // bytes per second; 0 means unlimited
+        void set_rate(uint64_t rate);
+        // nanoseconds; 0 disables adapting to foreground latency
+        void set_latency_target(uint64_t target);
+        bool may_spend();
+        void spend(uint64_t bytes);
+        // nanoseconds until "may_spend" will return true
+        uint64_t delay();
+        // report how long a foreground op took, in nanoseconds
+        void observe(uint64_t latency);
+        // the current rate; 0 means unlimited
+        uint64_t rate();
+        void collect_stats(std::ostringstream* ret);
+
+    private:
+        // caller must hold m_mtx
+        void refill(uint64_t now);
+
+    private:
+        po6::threads::mutex m_mtx;
+        uint64_t m_configured;
+        uint64_t m_rate;
+        uint64_t m_target;
+        int64_t m_tokens;
+        uint64_t m_last_refill;
+        uint64_t m_last_adjust;
+        uint64_t m_latency;
+        uint64_t m_spent;
+        uint64_t m_throttled;
+
+    private:
+        rate_limiter(const rate_limiter&);
+        rate_limiter& operator = (const rate_limiter&);
+};
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_daemon_rate_limiter_h_
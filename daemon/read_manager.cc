@@ -0,0 +1,239 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <signal.h>
+
+// Google Log
+#include <glog/logging.h>
+
+// e
+#include <e/time.h>
+
+// HyperDex
+#include "daemon/daemon.h"
+#include "daemon/read_manager.h"
+
+using hyperdex::read_manager;
+
+// past this many queued reads, network threads read for themselves
+#define READ_QUEUE_MAX 1024
+
+class read_manager::read
+{
+    public:
+        read(const server_id& f,
+             const virtual_server_id& t,
+             const region_id& r,
+             uint64_t n,
+             std::auto_ptr<e::buffer> m,
+             const e::slice& k,
+             uint64_t s)
+            : from(f), to(t), ri(r), nonce(n), backing(m.release()), key(k), start(s) {}
+        ~read() throw () {}
+
+    public:
+        server_id from;
+        virtual_server_id to;
+        region_id ri;
+        uint64_t nonce;
+        std::tr1::shared_ptr<e::buffer> backing;
+        e::slice key;
+        uint64_t start;
+};
+
+read_manager :: read_manager(daemon* d)
+    : m_daemon(d)
+    , m_threads()
+    , m_protect()
+    , m_wakeup(&m_protect)
+    , m_idle(&m_protect)
+    , m_reads()
+    , m_reads_queued(0)
+    , m_reads_running(0)
+    , m_paused(false)
+    , m_shutdown(false)
+{
+}
+
+read_manager :: ~read_manager() throw ()
+{
+}
+
+bool
+read_manager :: setup(unsigned threads)
+{
+    for (size_t i = 0; i < threads; ++i)
+    {
+        std::tr1::shared_ptr<po6::threads::thread> t(new po6::threads::thread(std::tr1::bind(&read_manager::reader, this)));
+        m_threads.push_back(t);
+        t->start();
+    }
+
+    return true;
+}
+
+void
+read_manager :: teardown()
+{
+    {
+        po6::threads::mutex::hold hold(&m_protect);
+        m_shutdown = true;
+        m_wakeup.broadcast();
+    }
+
+    for (size_t i = 0; i < m_threads.size(); ++i)
+    {
+        m_threads[i]->join();
+    }
+
+    m_threads.clear();
+    m_reads.clear();
+    m_reads_queued = 0;
+}
+
+void
+read_manager :: pause()
+{
+    // reads look up the region's schema, so let the running reads finish and
+    // hold the rest until the new configuration is in place
+    po6::threads::mutex::hold hold(&m_protect);
+    m_paused = true;
+
+    while (m_reads_running > 0)
+    {
+        m_idle.wait();
+    }
+}
+
+void
+read_manager :: unpause()
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    m_paused = false;
+    m_wakeup.broadcast();
+}
+
+bool
+read_manager :: busy()
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    return m_threads.empty() || m_reads_queued >= READ_QUEUE_MAX;
+}
+
+void
+read_manager :: get(const server_id& from,
+                    const virtual_server_id& to,
+                    uint64_t nonce,
+                    std::auto_ptr<e::buffer> msg,
+                    const e::slice& key,
+                    uint64_t start)
+{
+    region_id ri(m_daemon->m_config->get_region_id(to));
+    po6::threads::mutex::hold hold(&m_protect);
+    m_reads.push_back(read(from, to, ri, nonce, msg, key, start));
+    ++m_reads_queued;
+    m_wakeup.signal();
+}
+
+void
+read_manager :: reader()
+{
+    LOG(INFO) << "read thread started";
+    sigset_t ss;
+
+    if (sigfillset(&ss) < 0)
+    {
+        PLOG(ERROR) << "sigfillset";
+        return;
+    }
+
+    if (pthread_sigmask(SIG_BLOCK, &ss, NULL) < 0)
+    {
+        PLOG(ERROR) << "could not block signals";
+        return;
+    }
+
+    size_t slot = m_daemon->m_config.enroll();
+
+    while (true)
+    {
+        read_list_t r;
+        m_daemon->m_config.offline(slot);
+
+        {
+            po6::threads::mutex::hold hold(&m_protect);
+
+            while ((m_reads.empty() || m_paused) && !m_shutdown)
+            {
+                m_wakeup.wait();
+            }
+
+            if (m_shutdown)
+            {
+                break;
+            }
+
+            r.splice(r.begin(), m_reads, m_reads.begin());
+            --m_reads_queued;
+            ++m_reads_running;
+        }
+
+        m_daemon->m_config.online(slot);
+
+        const read& rd(r.front());
+        std::vector<e::slice> value;
+
+        // the region may have moved while the read was queued
+        if (m_daemon->m_config->get_region_id(rd.to) != rd.ri)
+        {
+            m_daemon->respond_to_get(rd.from, rd.to, rd.nonce, NET_NOTUS, value);
+        }
+        else
+        {
+            uint64_t version;
+            datalayer::reference ref;
+            datalayer::returncode rc = m_daemon->m_data.get(rd.ri, rd.key, &value, &version, &ref);
+            m_daemon->respond_to_get(rd.from, rd.to, rd.nonce, daemon::get_returncode(rc), value);
+        }
+
+        // includes the time spent queued, which is what the client saw
+        m_daemon->m_background.observe(e::time() - rd.start);
+
+        {
+            po6::threads::mutex::hold hold(&m_protect);
+            --m_reads_running;
+
+            if (m_paused && m_reads_running == 0)
+            {
+                m_idle.broadcast();
+            }
+        }
+    }
+
+    LOG(INFO) << "read thread shutting down";
+}
@@ -0,0 +1,107 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_read_manager_h_
+#define hyperdex_daemon_read_manager_h_
+
+// STL
+#include <list>
+#include <memory>
+#include <tr1/memory>
+#include <vector>
+
+// po6
+#include <po6/threads/cond.h>
+#include <po6/threads/mutex.h>
+#include <po6/threads/thread.h>
+
+// e
+#include <e/buffer.h>
+#include <e/slice.h>
+
+// HyperDex
+#include "namespace.h"
+#include "common/ids.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+class daemon;
+
+// Serve GETs that miss the object cache on a pool of I/O threads, so a read
+// that goes to disk does not hold up a network thread.
+class read_manager
+{
+    public:
+        read_manager(daemon*);
+        ~read_manager() throw ();
+
+    public:
+        bool setup(unsigned threads);
+        void teardown();
+        void pause();
+        void unpause();
+
+    public:
+        // true if enough reads are queued that the caller should read inline
+        bool busy();
+        // read "key" (which points into "msg") on an I/O thread and answer
+        // the client with RESP_GET; "start" is when the request arrived, by
+        // e::time, and the latency since then is reported to the daemon's
+        // background rate limiter
+        void get(const server_id& from,
+                 const virtual_server_id& to,
+                 uint64_t nonce,
+                 std::auto_ptr<e::buffer> msg,
+                 const e::slice& key,
+                 uint64_t start);
+
+    private:
+        class read;
+        typedef std::list<read> read_list_t;
+
+    private:
+        void reader();
+
+    private:
+        daemon* m_daemon;
+        std::vector<std::tr1::shared_ptr<po6::threads::thread> > m_threads;
+        po6::threads::mutex m_protect;
+        po6::threads::cond m_wakeup;
+        po6::threads::cond m_idle;
+        read_list_t m_reads;
+        size_t m_reads_queued;
+        size_t m_reads_running;
+        bool m_paused;
+        bool m_shutdown;
+
+    private:
+        read_manager(const read_manager&);
+        read_manager& operator = (const read_manager&);
+};
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_daemon_read_manager_h_
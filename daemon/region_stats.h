@@ -0,0 +1,74 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_region_stats_h_
+#define hyperdex_daemon_region_stats_h_
+
+// C
+#include <stdint.h>
+
+// HyperDex
+#include "namespace.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// Counters the datalayer maintains for each region as it writes.  The same
+// class carries both running totals and the delta of a single write.  Only
+// "objects", "bytes" and "index_bytes" are persisted; "writes" and "reads"
+// start from zero with the process and exist to measure load.
+class region_stats
+{
+    public:
+        region_stats() : objects(0), bytes(0), index_bytes(0), writes(0), reads(0) {}
+
+    public:
+        region_stats& operator += (const region_stats& rhs)
+        {
+            objects += rhs.objects;
+            bytes += rhs.bytes;
+            index_bytes += rhs.index_bytes;
+            writes += rhs.writes;
+            reads += rhs.reads;
+            return *this;
+        }
+
+    public:
+        // objects stored in the region
+        int64_t objects;
+        // bytes of keys and values as the client sees them
+        int64_t bytes;
+        // bytes of index entries kept for the region
+        int64_t index_bytes;
+        // chain writes applied to the region
+        int64_t writes;
+        // client reads of the region's objects
+        int64_t reads;
+};
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_daemon_region_stats_h_
@@ -53,9 +53,18 @@
 using hyperdex::reconfigure_returncode;
 using hyperdex::replication_manager;
 
+// Finished key states stay in memory, up to this many bytes, so that
+// operations on hot keys find the latest object without going to disk.
+#define RETAINED_KEY_STATES_BYTES (64ULL * 1024ULL * 1024ULL)
+
 replication_manager :: replication_manager(daemon* d)
     : m_daemon(d)
     , m_key_states()
+    , m_retained_protect()
+    , m_retained()
+    , m_retained_bytes(0)
+    , m_no_retain()
+    , m_evicted()
     , m_idgen()
     , m_idcol()
     , m_stable_counters()
@@ -72,6 +81,7 @@ replication_manager :: replication_manager(daemon* d)
     , m_paused(false)
     , m_need_post_reconfigure(false)
     , m_need_periodic(false)
+    , m_need_sweep(false)
     , m_lower_bounds()
 {
     m_key_states.set_empty_key(key_region(region_id(UINT64_MAX), e::slice("", 0)));
@@ -134,6 +144,9 @@ replication_manager :: reconfigure(const configuration&,
     std::vector<region_id> transfers_in_regions;
     new_config.transfers_in_regions(m_daemon->m_us, &transfers_in_regions);
     std::sort(transfers_in_regions.begin(), transfers_in_regions.end());
+    // retained states may be stale after the datalayer changed underneath
+    // them; they get collected by the loop below
+    drop_retained_key_states(transfers_in_regions);
 
     for (key_map_t::iterator it(&m_key_states); it.valid(); it.next())
     {
@@ -184,13 +197,55 @@ replication_manager :: reconfigure(const configuration&,
     check_is_needed();
 }
 
+void
+replication_manager :: reconfigure_in_place(const configuration& new_config)
+{
+    wait_until_paused();
+    std::vector<region_id> key_regions;
+    new_config.key_regions(m_daemon->m_us, &key_regions);
+
+    // as in reconfigure, never carry retained states across a configuration;
+    // visiting every state collects those no longer retained
+    std::vector<region_id> transfers_in_regions;
+    new_config.transfers_in_regions(m_daemon->m_us, &transfers_in_regions);
+    std::sort(transfers_in_regions.begin(), transfers_in_regions.end());
+    drop_retained_key_states(transfers_in_regions);
+
+    for (key_map_t::iterator it(&m_key_states); it.valid(); it.next())
+    {
+    }
+
+    // we're stable in the new version once everything issued so far is
+    // acked, just as at a checkpoint
+    {
+        po6::threads::mutex::hold hold(&m_block_background_thread);
+        m_unstable_regions.clear();
+        new_config.point_leaders(m_daemon->m_us, &m_unstable_regions);
+        check_is_needed();
+    }
+
+    for (size_t i = 0; i < key_regions.size(); ++i)
+    {
+        bool x;
+        uint64_t id = 0;
+        x = m_idgen.peek(key_regions[i], &id);
+        assert(x);
+
+        if (id > 0)
+        {
+            x = m_stable_counters.bump(key_regions[i], id - 1);
+            assert(x);
+        }
+    }
+}
+
 void
 replication_manager :: debug_dump()
 {
     pause();
     wait_until_paused();
     std::vector<region_id> regions;
-    m_daemon->m_config.key_regions(m_daemon->m_us, &regions);
+    m_daemon->m_config->key_regions(m_daemon->m_us, &regions);
 
     // print counters
     LOG(INFO) << "region counters ===============================================================";
@@ -237,14 +292,14 @@ replication_manager :: client_atomic(const server_id& from,
                                      const std::vector<attribute_check>& checks,
                                      const std::vector<funcall>& funcs)
 {
-    if (m_daemon->m_config.read_only())
+    if (m_daemon->m_config->read_only())
     {
         respond_to_client(to, from, nonce, NET_READONLY);
         return;
     }
 
-    const region_id ri(m_daemon->m_config.get_region_id(to));
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
+    const region_id ri(m_daemon->m_config->get_region_id(to));
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
 
     if (!datatype_info::lookup(sc.attrs[0].type)->validate(key) ||
         validate_attribute_checks(sc, checks) != checks.size() ||
@@ -257,7 +312,7 @@ replication_manager :: client_atomic(const server_id& from,
         return;
     }
 
-    if (m_daemon->m_config.point_leader(ri, key) != to)
+    if (m_daemon->m_config->point_leader(ri, key) != to)
     {
         LOG(ERROR) << "dropping nonce=" << nonce << " from client=" << from
                    << " because it doesn't map to " << ri;
@@ -306,10 +361,11 @@ replication_manager :: chain_op(const virtual_server_id& from,
                                 bool has_value,
                                 std::auto_ptr<e::buffer> backing,
                                 const e::slice& key,
-                                const std::vector<e::slice>& value)
+                                const std::vector<e::slice>& value,
+                                const e::slice& funcs)
 {
-    const region_id ri(m_daemon->m_config.get_region_id(to));
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
+    const region_id ri(m_daemon->m_config->get_region_id(to));
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
 
     if (retransmission && m_daemon->m_data.check_acked(ri, reg_id, seq_id))
     {
@@ -320,7 +376,14 @@ replication_manager :: chain_op(const virtual_server_id& from,
     bool valid = sc.attrs_sz > 0 &&
                  datatype_info::lookup(sc.attrs[0].type)->validate(key);
 
-    if (has_value)
+    if (!funcs.empty())
+    {
+        std::vector<funcall> fs;
+        valid = valid && has_value && !fresh && value.empty() &&
+                !(e::unpacker(funcs) >> fs).error() &&
+                validate_funcs(sc, fs) == fs.size();
+    }
+    else if (has_value)
     {
         valid = valid && sc.attrs_sz == value.size() + 1;
 
@@ -342,7 +405,7 @@ replication_manager :: chain_op(const virtual_server_id& from,
 
     if (op)
     {
-        op->recv_config_version = m_daemon->m_config.version();
+        op->recv_config_version = m_daemon->m_config->version();
         op->recv = from;
 
         if (op->acked)
@@ -357,7 +420,9 @@ replication_manager :: chain_op(const virtual_server_id& from,
                      reg_id, seq_id, fresh,
                      has_value, value,
                      server_id(), 0,
-                     m_daemon->m_config.version(), from);
+                     m_daemon->m_config->version(), from);
+    op->funcs = funcs;
+    op->needs_value = !funcs.empty();
     ks->insert_deferred(version, op);
     ks->move_operations_between_queues(this, to, ri, sc);
 }
@@ -374,8 +439,8 @@ replication_manager :: chain_subspace(const virtual_server_id& from,
                                       const std::vector<e::slice>& value,
                                       const std::vector<uint64_t>& hashes)
 {
-    const region_id ri(m_daemon->m_config.get_region_id(to));
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
+    const region_id ri(m_daemon->m_config->get_region_id(to));
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
 
     if (retransmission && m_daemon->m_data.check_acked(ri, reg_id, seq_id))
     {
@@ -406,7 +471,7 @@ replication_manager :: chain_subspace(const virtual_server_id& from,
 
     if (op)
     {
-        op->recv_config_version = m_daemon->m_config.version();
+        op->recv_config_version = m_daemon->m_config->version();
         op->recv = from;
 
         if (op->acked)
@@ -421,36 +486,36 @@ replication_manager :: chain_subspace(const virtual_server_id& from,
                      reg_id, seq_id, false,
                      true, value,
                      server_id(), 0,
-                     m_daemon->m_config.version(), from);
+                     m_daemon->m_config->version(), from);
     op->old_hashes.resize(sc.attrs_sz);
     op->new_hashes.resize(sc.attrs_sz);
     op->this_old_region = region_id();
     op->this_new_region = region_id();
     op->prev_region = region_id();
     op->next_region = region_id();
-    subspace_id subspace_this = m_daemon->m_config.subspace_of(ri);
-    subspace_id subspace_prev = m_daemon->m_config.subspace_prev(subspace_this);
-    subspace_id subspace_next = m_daemon->m_config.subspace_next(subspace_this);
+    subspace_id subspace_this = m_daemon->m_config->subspace_of(ri);
+    subspace_id subspace_prev = m_daemon->m_config->subspace_prev(subspace_this);
+    subspace_id subspace_next = m_daemon->m_config->subspace_next(subspace_this);
     op->old_hashes = hashes;
     hyperdex::hash(sc, key, value, &op->new_hashes.front());
 
     if (subspace_prev != subspace_id())
     {
-        m_daemon->m_config.lookup_region(subspace_prev, op->new_hashes, &op->prev_region);
+        m_daemon->m_config->lookup_region(subspace_prev, op->new_hashes, &op->prev_region);
     }
 
-    m_daemon->m_config.lookup_region(subspace_this, op->old_hashes, &op->this_old_region);
-    m_daemon->m_config.lookup_region(subspace_this, op->new_hashes, &op->this_new_region);
+    m_daemon->m_config->lookup_region(subspace_this, op->old_hashes, &op->this_old_region);
+    m_daemon->m_config->lookup_region(subspace_this, op->new_hashes, &op->this_new_region);
 
     if (subspace_next != subspace_id())
     {
-        m_daemon->m_config.lookup_region(subspace_next, op->old_hashes, &op->next_region);
+        m_daemon->m_config->lookup_region(subspace_next, op->old_hashes, &op->next_region);
     }
 
-    if (!(op->this_old_region == m_daemon->m_config.get_region_id(from) &&
-          m_daemon->m_config.tail_of_region(op->this_old_region) == from) &&
-        !(op->this_new_region == m_daemon->m_config.get_region_id(from) &&
-          m_daemon->m_config.next_in_region(from) == to))
+    if (!(op->this_old_region == m_daemon->m_config->get_region_id(from) &&
+          m_daemon->m_config->tail_of_region(op->this_old_region) == from) &&
+        !(op->this_new_region == m_daemon->m_config->get_region_id(from) &&
+          m_daemon->m_config->next_in_region(from) == to))
     {
         LOG(ERROR) << "dropping CHAIN_SUBSPACE which didn't obey chaining rules";
         return;
@@ -469,8 +534,8 @@ replication_manager :: chain_ack(const virtual_server_id& from,
                                  uint64_t version,
                                  const e::slice& key)
 {
-    const region_id ri(m_daemon->m_config.get_region_id(to));
-    const schema& sc(*m_daemon->m_config.get_schema(ri));
+    const region_id ri(m_daemon->m_config->get_region_id(to));
+    const schema& sc(*m_daemon->m_config->get_schema(ri));
 
     if (retransmission && m_daemon->m_data.check_acked(ri, reg_id, seq_id))
     {
@@ -496,10 +561,10 @@ replication_manager :: chain_ack(const virtual_server_id& from,
 
     if (op->sent == virtual_server_id() ||
         from != op->sent ||
-        m_daemon->m_config.version() != op->sent_config_version)
+        m_daemon->m_config->version() != op->sent_config_version)
     {
         LOG(ERROR) << "dropping CHAIN_ACK that came from " << from
-                   << " in version " << m_daemon->m_config.version()
+                   << " in version " << m_daemon->m_config->version()
                    << " but should have come from " << op->sent
                    << " in version " << op->sent_config_version;
         return;
@@ -512,9 +577,9 @@ replication_manager :: chain_ack(const virtual_server_id& from,
     }
 
     op->acked = true;
-    bool is_head = m_daemon->m_config.head_of_region(ri) == to;
+    bool is_head = m_daemon->m_config->head_of_region(ri) == to;
 
-    if (!is_head && m_daemon->m_config.version() == op->recv_config_version)
+    if (!is_head && m_daemon->m_config->version() == op->recv_config_version)
     {
         send_ack(to, op->recv, false, reg_id, seq_id, version, key);
     }
@@ -531,9 +596,10 @@ replication_manager :: chain_ack(const virtual_server_id& from,
     if (op->client != server_id())
     {
         respond_to_client(to, op->client, op->nonce, NET_SUCCESS);
+        m_daemon->m_background.observe(e::time() - op->recv_time);
     }
 
-    if (is_head && m_daemon->m_config.version() == op->recv_config_version)
+    if (is_head && m_daemon->m_config->version() == op->recv_config_version)
     {
         send_ack(to, op->recv, false, reg_id, seq_id, version, key);
     }
@@ -555,6 +621,22 @@ replication_manager :: chain_gc(const region_id& reg_id, uint64_t seq_id)
     m_lower_bounds.push_back(std::make_pair(reg_id, seq_id));
 }
 
+uint64_t
+replication_manager :: unpersisted_age(const region_id& ri, const e::slice& key)
+{
+    key_map_t::state_reference ksr;
+    key_state* ks = get_key_state(ri, key, &ksr);
+
+    if (!ks)
+    {
+        return 0;
+    }
+
+    uint64_t oldest = ks->oldest_unpersisted();
+    uint64_t now = e::time();
+    return oldest == 0 || oldest > now ? 0 : now - oldest;
+}
+
 void
 replication_manager :: trip_periodic()
 {
@@ -582,7 +664,7 @@ replication_manager :: begin_checkpoint(uint64_t seq)
 
         m_checkpoint = seq;
         m_unstable_regions.clear();
-        m_daemon->m_config.point_leaders(m_daemon->m_us, &m_unstable_regions);
+        m_daemon->m_config->point_leaders(m_daemon->m_us, &m_unstable_regions);
         check_is_needed();
 
         for (size_t i = 0; i < mapped_regions.size(); ++i)
@@ -647,23 +729,157 @@ replication_manager :: get_or_create_key_state(const region_id& ri,
     key_region kr(ri, key);
     key_state* ks = m_key_states.get_or_create_state(kr, ksr);
 
-    if (!ks || ks->initialized())
+    if (!ks)
+    {
+        return NULL;
+    }
+
+    if (!ks->initialized())
+    {
+        switch (ks->initialize(&m_daemon->m_data, ri))
+        {
+            case datalayer::SUCCESS:
+            case datalayer::NOT_FOUND:
+                break;
+            case datalayer::BAD_ENCODING:
+            case datalayer::CORRUPTION:
+            case datalayer::IO_ERROR:
+            case datalayer::LEVELDB_ERROR:
+            default:
+                LOG(ERROR) << "Data layer returned unexpected result when reading old value.";
+                return NULL;
+        }
+    }
+
+    retain_key_state(ks);
+    return ks;
+}
+
+void
+replication_manager :: retain_key_state(key_state* ks)
+{
+    bool wake = false;
+
+    {
+        po6::threads::mutex::hold hold(&m_retained_protect);
+
+        if (std::binary_search(m_no_retain.begin(),
+                               m_no_retain.end(),
+                               ks->state_key().region))
+        {
+            return;
+        }
+
+        size_t sz = ks->footprint();
+
+        if (ks->m_retained)
+        {
+            m_retained_bytes -= ks->m_retained_pos->second;
+            ks->m_retained_pos->second = sz;
+            m_retained.splice(m_retained.begin(), m_retained, ks->m_retained_pos);
+        }
+        else
+        {
+            m_retained.push_front(std::make_pair(e::intrusive_ptr<key_state>(ks), sz));
+            ks->m_retained_pos = m_retained.begin();
+            __sync_lock_test_and_set(&ks->m_retained, 1);
+        }
+
+        m_retained_bytes += sz;
+        wake = m_evicted.empty();
+
+        // Evicted states are not locked here, as that could deadlock against
+        // the lock on ks.  The background thread locks and unlocks them,
+        // which collects those that finished.
+        while (m_retained_bytes > RETAINED_KEY_STATES_BYTES &&
+               m_retained.size() > 1)
+        {
+            key_state* victim = m_retained.back().first.get();
+            m_retained_bytes -= m_retained.back().second;
+            __sync_lock_test_and_set(&victim->m_retained, 0);
+            m_evicted.push_back(m_retained.back().first);
+            m_retained.pop_back();
+        }
+
+        wake = wake && !m_evicted.empty();
+    }
+
+    if (wake)
     {
-        return ks;
+        po6::threads::mutex::hold hold(&m_block_background_thread);
+        m_need_sweep = true;
+        m_wakeup_background_thread.broadcast();
     }
+}
 
-    switch (ks->initialize(&m_daemon->m_data, ri))
+void
+replication_manager :: drop_retained_key_states(const std::vector<region_id>& no_retain)
+{
+    po6::threads::mutex::hold hold(&m_retained_protect);
+
+    for (retained_list_t::iterator it = m_retained.begin();
+            it != m_retained.end(); ++it)
     {
-        case datalayer::SUCCESS:
-        case datalayer::NOT_FOUND:
-            return ks;
-        case datalayer::BAD_ENCODING:
-        case datalayer::CORRUPTION:
-        case datalayer::IO_ERROR:
-        case datalayer::LEVELDB_ERROR:
-        default:
-            LOG(ERROR) << "Data layer returned unexpected result when reading old value.";
-            return NULL;
+        __sync_lock_test_and_set(&it->first->m_retained, 0);
+    }
+
+    m_retained.clear();
+    m_retained_bytes = 0;
+    m_no_retain = no_retain;
+}
+
+void
+replication_manager :: forget_key_states(const std::vector<region_id>& regions)
+{
+    bool wake = false;
+
+    {
+        po6::threads::mutex::hold hold(&m_retained_protect);
+        retained_list_t::iterator it = m_retained.begin();
+
+        while (it != m_retained.end())
+        {
+            if (std::binary_search(regions.begin(),
+                                   regions.end(),
+                                   it->first->state_key().region))
+            {
+                __sync_lock_test_and_set(&it->first->m_retained, 0);
+                m_retained_bytes -= it->second;
+                m_evicted.push_back(it->first);
+                it = m_retained.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        wake = !m_evicted.empty();
+    }
+
+    if (wake)
+    {
+        po6::threads::mutex::hold hold(&m_block_background_thread);
+        m_need_sweep = true;
+        m_wakeup_background_thread.broadcast();
+    }
+}
+
+void
+replication_manager :: sweep_evicted_key_states()
+{
+    std::vector<e::intrusive_ptr<key_state> > evicted;
+
+    {
+        po6::threads::mutex::hold hold(&m_retained_protect);
+        evicted.swap(m_evicted);
+    }
+
+    for (size_t i = 0; i < evicted.size(); ++i)
+    {
+        key_map_t::state_reference ksr;
+        ksr.lock(&m_key_states, evicted[i]);
+        ksr.unlock();
     }
 }
 
@@ -677,17 +893,17 @@ replication_manager :: send_message(const virtual_server_id& us,
     // If we've sent it somewhere, we shouldn't resend.  If the sender intends a
     // resend, they should clear "sent" first.
     assert(op->sent == virtual_server_id());
-    region_id ri(m_daemon->m_config.get_region_id(us));
+    region_id ri(m_daemon->m_config->get_region_id(us));
 
     // If there's an ongoing transfer, don't actually send
-    if (m_daemon->m_config.is_server_blocked_by_live_transfer(m_daemon->m_us, ri))
+    if (m_daemon->m_config->is_server_blocked_by_live_transfer(m_daemon->m_us, ri))
     {
         return;
     }
 
     // facts we use to decide what to do
     assert(ri == op->this_old_region || ri == op->this_new_region);
-    bool last_in_chain = m_daemon->m_config.tail_of_region(ri) == us;
+    bool last_in_chain = m_daemon->m_config->tail_of_region(ri) == us;
     bool has_next_subspace = op->next_region != region_id();
 
     // variables we fill in to determine the message type/destination
@@ -700,7 +916,7 @@ replication_manager :: send_message(const virtual_server_id& us,
         {
             if (has_next_subspace)
             {
-                dest = m_daemon->m_config.head_of_region(op->next_region);
+                dest = m_daemon->m_config->head_of_region(op->next_region);
                 type = type; // it stays the same
             }
             else
@@ -711,7 +927,7 @@ replication_manager :: send_message(const virtual_server_id& us,
         }
         else
         {
-            dest = m_daemon->m_config.next_in_region(us);
+            dest = m_daemon->m_config->next_in_region(us);
             type = type; // it stays the same
         }
     }
@@ -720,12 +936,12 @@ replication_manager :: send_message(const virtual_server_id& us,
         if (last_in_chain)
         {
             assert(op->has_value);
-            dest = m_daemon->m_config.head_of_region(op->this_new_region);
+            dest = m_daemon->m_config->head_of_region(op->this_new_region);
             type = CHAIN_SUBSPACE;
         }
         else
         {
-            dest = m_daemon->m_config.next_in_region(us);
+            dest = m_daemon->m_config->next_in_region(us);
             type = type; // it stays the same
         }
     }
@@ -735,7 +951,7 @@ replication_manager :: send_message(const virtual_server_id& us,
         {
             if (has_next_subspace)
             {
-                dest = m_daemon->m_config.head_of_region(op->next_region);
+                dest = m_daemon->m_config->head_of_region(op->next_region);
                 type = type; // it stays the same
             }
             else
@@ -747,7 +963,7 @@ replication_manager :: send_message(const virtual_server_id& us,
         else
         {
             assert(op->has_value);
-            dest = m_daemon->m_config.next_in_region(us);
+            dest = m_daemon->m_config->next_in_region(us);
             type = CHAIN_SUBSPACE;
         }
     }
@@ -760,8 +976,19 @@ replication_manager :: send_message(const virtual_server_id& us,
 
     if (type == CHAIN_OP)
     {
+        // Our successor within the region has already seen version - 1, so it
+        // can apply the funcs itself.  Retransmissions carry the whole value,
+        // as the successor may have lost track of what came before.
+        bool delta = !retransmission &&
+                     !last_in_chain &&
+                     !op->funcs.empty() &&
+                     !op->fresh && op->has_value &&
+                     op->this_old_region == ri &&
+                     op->this_new_region == ri &&
+                     pack_size(op->funcs) < pack_size(op->value);
         uint8_t flags = (op->fresh ? 1 : 0)
                       | (op->has_value ? 2 : 0)
+                      | (delta ? 4 : 0)
                       | (retransmission ? 128 : 0);
         size_t sz = HYPERDEX_HEADER_SIZE_VV
                   + sizeof(uint8_t)
@@ -770,9 +997,19 @@ replication_manager :: send_message(const virtual_server_id& us,
                   + sizeof(uint64_t)
                   + sizeof(uint32_t)
                   + key.size()
-                  + pack_size(op->value);
+                  + (delta ? pack_size(op->funcs) : pack_size(op->value));
         msg.reset(e::buffer::create(sz));
-        msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << flags << op->reg_id.get() << op->seq_id << version << key << op->value;
+        e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VV);
+        pa = pa << flags << op->reg_id.get() << op->seq_id << version << key;
+
+        if (delta)
+        {
+            pa = pa << op->funcs;
+        }
+        else
+        {
+            pa = pa << op->value;
+        }
     }
     else if (type == CHAIN_ACK)
     {
@@ -807,9 +1044,9 @@ replication_manager :: send_message(const virtual_server_id& us,
         abort();
     }
 
-    op->sent_config_version = m_daemon->m_config.version();
+    op->sent_config_version = m_daemon->m_config->version();
     op->sent = dest;
-    m_daemon->m_comm.send_exact(us, dest, type, msg);
+    m_daemon->m_comm.send_batched(us, dest, type, msg);
 }
 
 bool
@@ -831,7 +1068,7 @@ replication_manager :: send_ack(const virtual_server_id& us,
               + key.size();
     std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
     msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << flags << reg_id.get() << seq_id << version << key;
-    return m_daemon->m_comm.send_exact(us, to, CHAIN_ACK, msg);
+    return m_daemon->m_comm.send_batched(us, to, CHAIN_ACK, msg);
 }
 
 void
@@ -972,6 +1209,7 @@ replication_manager :: background_thread()
     {
         bool need_post_reconfigure = false;
         bool need_periodic = false;
+        bool need_sweep = false;
         region_id reg_id;
         uint64_t seq_id = 0;
 
@@ -980,6 +1218,7 @@ replication_manager :: background_thread()
 
             while ((!(m_need_post_reconfigure ||
                       m_need_periodic ||
+                      m_need_sweep ||
                       !m_lower_bounds.empty()) && !m_shutdown) ||
                    m_need_pause)
             {
@@ -1003,6 +1242,8 @@ replication_manager :: background_thread()
             m_need_post_reconfigure = false;
             need_periodic = m_need_periodic;
             m_need_periodic = false;
+            need_sweep = m_need_sweep;
+            m_need_sweep = false;
 
             if (!m_lower_bounds.empty())
             {
@@ -1044,6 +1285,11 @@ replication_manager :: background_thread()
             send_chain_gc();
         }
 
+        if (need_sweep || need_periodic)
+        {
+            sweep_evicted_key_states();
+        }
+
         if (seq_id > 1)
         {
             bool x;
@@ -1064,15 +1310,15 @@ void
 replication_manager :: send_chain_gc()
 {
     std::vector<std::pair<server_id, po6::net::location> > cluster_members;
-    m_daemon->m_config.get_all_addresses(&cluster_members);
+    m_daemon->m_config->get_all_addresses(&cluster_members);
     std::vector<region_id> regions;
-    m_daemon->m_config.point_leaders(m_daemon->m_us, &regions);
+    m_daemon->m_config->point_leaders(m_daemon->m_us, &regions);
 
     for (size_t i = 0; i < regions.size(); ++i)
     {
         for (size_t j = 0; j < cluster_members.size(); ++j)
         {
-            virtual_server_id us = m_daemon->m_config.get_virtual(regions[i], m_daemon->m_us);
+            virtual_server_id us = m_daemon->m_config->get_virtual(regions[i], m_daemon->m_us);
             uint64_t lb = 0;
             bool x = m_idcol.lower_bound(regions[i], &lb);
 
@@ -1106,12 +1352,12 @@ replication_manager :: retransmit(const std::vector<region_id>& point_leaders,
             ks->append_seq_ids(seq_ids);
         }
 
-        if (m_daemon->m_config.is_server_blocked_by_live_transfer(m_daemon->m_us, ri))
+        if (m_daemon->m_config->is_server_blocked_by_live_transfer(m_daemon->m_us, ri))
         {
             continue;
         }
 
-        virtual_server_id us = m_daemon->m_config.get_virtual(ri, m_daemon->m_us);
+        virtual_server_id us = m_daemon->m_config->get_virtual(ri, m_daemon->m_us);
 
         if (us == virtual_server_id() || ks->empty())
         {
@@ -1119,7 +1365,7 @@ replication_manager :: retransmit(const std::vector<region_id>& point_leaders,
             continue;
         }
 
-        const schema& sc(*m_daemon->m_config.get_schema(ri));
+        const schema& sc(*m_daemon->m_config->get_schema(ri));
         ks->resend_committable(this, us);
         ks->move_operations_between_queues(this, us, ri, sc);
     }
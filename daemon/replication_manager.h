@@ -76,7 +76,14 @@ class replication_manager
         void reconfigure(const configuration& old_config,
                          const configuration& new_config,
                          const server_id& us);
+        // for a new configuration that changes nothing we host; network
+        // threads keep running, so this only restarts the stability count
+        // and drops retained key states
+        void reconfigure_in_place(const configuration& new_config);
         void debug_dump();
+        // Stop retaining key states of "regions" (sorted) and collect them,
+        // as their cached objects no longer match what is on disk.
+        void forget_key_states(const std::vector<region_id>& regions);
 
     // Network workers call these methods.
     public:
@@ -102,7 +109,8 @@ class replication_manager
                       bool has_value,
                       std::auto_ptr<e::buffer> backing,
                       const e::slice& key,
-                      const std::vector<e::slice>& value);
+                      const std::vector<e::slice>& value,
+                      const e::slice& funcs);
         void chain_subspace(const virtual_server_id& from,
                             const virtual_server_id& to,
                             bool retransmission,
@@ -121,6 +129,10 @@ class replication_manager
                        uint64_t version,
                        const e::slice& key);
         void chain_gc(const region_id& reg_id, uint64_t seq_id);
+        // Nanoseconds since this server received the oldest operation on key
+        // that it has yet to write to the datalayer; zero if there is none.
+        // Reads served from our datalayer trail the chain by at most this.
+        uint64_t unpersisted_age(const region_id& ri, const e::slice& key);
         void trip_periodic();
         void begin_checkpoint(uint64_t seq);
         void end_checkpoint(uint64_t seq);
@@ -130,6 +142,8 @@ class replication_manager
         class key_region; // a tuple of (key, region)
         class key_state; // state for a single key
         typedef state_hash_table<key_region, key_state> key_map_t;
+        typedef std::list<std::pair<e::intrusive_ptr<key_state>, size_t> >
+                retained_list_t;
         friend class std::tr1::hash<key_region>;
 
     private:
@@ -148,6 +162,16 @@ class replication_manager
         key_state* get_or_create_key_state(const region_id& ri,
                                            const e::slice& key,
                                            key_map_t::state_reference* ksr);
+        // Keep a recently used key state (and its cached object) in memory
+        // once it finishes, evicting the least recently used states when the
+        // retained set grows beyond its budget.  Caller must hold ks's lock.
+        void retain_key_state(key_state* ks);
+        // Stop retaining every key state, and refuse to retain states for
+        // regions in "no_retain" until the next call.
+        void drop_retained_key_states(const std::vector<region_id>& no_retain);
+        // Lock and unlock every state evicted since the last sweep so those
+        // that finished get collected.  Runs on the background thread.
+        void sweep_evicted_key_states();
         // Send a response to the specified client.
         void send_message(const virtual_server_id& us,
                           bool retransmission,
@@ -186,6 +210,11 @@ class replication_manager
     private:
         daemon* m_daemon;
         key_map_t m_key_states;
+        po6::threads::mutex m_retained_protect;
+        retained_list_t m_retained;
+        size_t m_retained_bytes;
+        std::vector<region_id> m_no_retain;
+        std::vector<e::intrusive_ptr<key_state> > m_evicted;
         identifier_generator m_idgen;
         identifier_collector m_idcol;
         identifier_generator m_stable_counters;
@@ -202,6 +231,7 @@ class replication_manager
         bool m_paused;
         bool m_need_post_reconfigure;
         bool m_need_periodic;
+        bool m_need_sweep;
         std::list<std::pair<region_id, uint64_t> > m_lower_bounds;
 };
 
@@ -30,6 +30,7 @@
 
 // HyperDex
 #include "common/hash.h"
+#include "common/serialization.h"
 #include "daemon/daemon.h"
 #include "daemon/replication_manager_key_region.h"
 #include "daemon/replication_manager_key_state.h"
@@ -53,6 +54,8 @@ replication_manager :: key_state :: key_state(const key_region& kr)
     , m_old_value()
     , m_old_disk_ref()
     , m_old_backing()
+    , m_retained(0)
+    , m_retained_pos()
 {
 }
 
@@ -81,7 +84,9 @@ replication_manager :: key_state :: unlock()
 bool
 replication_manager :: key_state :: finished()
 {
-    return empty();
+    // A stale read of m_retained only delays collection until the next time
+    // the state is unlocked; the background thread visits every state.
+    return empty() && __sync_fetch_and_add(&m_retained, 0) == 0;
 }
 
 void
@@ -163,6 +168,28 @@ replication_manager :: key_state :: min_seq_id() const
     return ret;
 }
 
+uint64_t
+replication_manager :: key_state :: oldest_unpersisted() const
+{
+    const pending_list_t* lists[] = {&m_committable, &m_blocked, &m_deferred};
+    uint64_t ret = 0;
+
+    for (size_t i = 0; i < sizeof(lists) / sizeof(lists[0]); ++i)
+    {
+        for (pending_list_t::const_iterator it = lists[i]->begin();
+                it != lists[i]->end(); ++it)
+        {
+            if (it->first > m_old_version &&
+                (ret == 0 || it->second->recv_time < ret))
+            {
+                ret = it->second->recv_time;
+            }
+        }
+    }
+
+    return ret;
+}
+
 e::intrusive_ptr<replication_manager::pending>
 replication_manager :: key_state :: get_version(uint64_t version) const
 {
@@ -303,6 +330,15 @@ replication_manager :: key_state :: put_from_funcs(const schema& sc,
                      client, nonce,
                      0, virtual_server_id());
 
+    // successors that already hold the old value may apply the funcs
+    // themselves instead of receiving the whole new value
+    if (has_old_value && !funcs.empty())
+    {
+        op->funcs_backing.reset(e::buffer::create(pack_size(funcs)));
+        op->funcs_backing->pack_at(0) << funcs;
+        op->funcs = op->funcs_backing->as_slice();
+    }
+
     if (funcs_passed == funcs.size())
     {
         insert_deferred(old_version + 1, op);
@@ -338,9 +374,12 @@ replication_manager :: key_state :: persist_to_datalayer(replication_manager* rm
         e::intrusive_ptr<pending> op = get_version(version);
         assert(op);
         datalayer::returncode rc;
+        bool removed = !op->has_value ||
+                       (op->this_old_region != op->this_new_region &&
+                        ri == op->this_old_region);
 
         // if this is a case where we are to remove the object from disk
-        if (!op->has_value || (op->this_old_region != op->this_new_region && ri == op->this_old_region))
+        if (removed)
         {
             if (m_has_old_value)
             {
@@ -379,10 +418,22 @@ replication_manager :: key_state :: persist_to_datalayer(replication_manager* rm
                 return false;
         }
 
-        m_has_old_value = op->has_value;
         m_old_version = version;
-        m_old_value = op->value;
-        m_old_backing = op->backing;
+
+        // an object that moved to another subspace region is gone from ours,
+        // even though the op carries its new value
+        if (removed)
+        {
+            m_has_old_value = false;
+            m_old_value.clear();
+            m_old_backing.reset();
+        }
+        else
+        {
+            m_has_old_value = true;
+            m_old_value = op->value;
+            m_old_backing = op->backing;
+        }
     }
     else
     {
@@ -416,7 +467,7 @@ replication_manager :: key_state :: resend_committable(replication_manager* rm,
             it != m_committable.end(); ++it)
     {
         // skip those messages already sent in this version
-        if (it->second->sent_config_version == rm->m_daemon->m_config.version())
+        if (it->second->sent_config_version == rm->m_daemon->m_config->version())
         {
             continue;
         }
@@ -495,11 +546,23 @@ replication_manager :: key_state :: move_operations_between_queues(replication_m
             break;
         }
 
+        // A delta is never fresh, so the check above guarantees that we hold
+        // the version it builds upon.
+        if (op->needs_value &&
+            !apply_delta(sc, has_old_value, old_value ? *old_value : op->value, op))
+        {
+            LOG(WARNING) << "dropping deferred CHAIN_OP whose funcalls do not apply to "
+                         << "version " << old_version << " of key " << state_key().key.hex()
+                         << " in region " << state_key().region;
+            m_deferred.pop_front();
+            continue;
+        }
+
         // If this is not a subspace transfer
         if (op->this_old_region == op->this_new_region ||
             op->this_old_region == ri)
         {
-            hash_objects(&rm->m_daemon->m_config, ri, sc, op->has_value, op->value, has_old_value, old_value ? *old_value : op->value, op);
+            hash_objects(rm->m_daemon->m_config.get(), ri, sc, op->has_value, op->value, has_old_value, old_value ? *old_value : op->value, op);
 
             if (op->this_old_region != ri && op->this_new_region != ri)
             {
@@ -509,8 +572,8 @@ replication_manager :: key_state :: move_operations_between_queues(replication_m
             }
 
             if (op->recv != virtual_server_id() &&
-                rm->m_daemon->m_config.next_in_region(op->recv) != us &&
-                !rm->m_daemon->m_config.subspace_adjacent(op->recv, us))
+                rm->m_daemon->m_config->next_in_region(op->recv) != us &&
+                !rm->m_daemon->m_config->subspace_adjacent(op->recv, us))
             {
                 LOG(INFO) << "dropping deferred CHAIN_* which didn't come from the right host";
                 m_deferred.pop_front();
@@ -566,6 +629,19 @@ replication_manager :: key_state :: debug_dump()
     }
 }
 
+size_t
+replication_manager :: key_state :: footprint() const
+{
+    size_t sz = sizeof(key_state) + m_key_backing.size();
+
+    for (size_t i = 0; i < m_old_value.size(); ++i)
+    {
+        sz += sizeof(e::slice) + m_old_value[i].size();
+    }
+
+    return sz;
+}
+
 void
 replication_manager :: key_state :: get_latest(bool* has_old_value,
                                                uint64_t* old_version,
@@ -636,6 +712,28 @@ replication_manager :: key_state :: check_version(const schema& sc,
     return passes_attribute_checks(sc, checks, m_key, *old_value) == checks.size();
 }
 
+bool
+replication_manager :: key_state :: apply_delta(const schema& sc,
+                                                bool has_old_value,
+                                                const std::vector<e::slice>& old_value,
+                                                e::intrusive_ptr<pending> op)
+{
+    std::vector<funcall> funcs;
+
+    if (!has_old_value || (e::unpacker(op->funcs) >> funcs).error())
+    {
+        return false;
+    }
+
+    if (apply_funcs(sc, funcs, m_key, old_value, &op->value_backing, &op->value) != funcs.size())
+    {
+        return false;
+    }
+
+    op->needs_value = false;
+    return true;
+}
+
 void
 replication_manager :: key_state :: hash_objects(const configuration* config,
                                                  const region_id& reg,
@@ -56,6 +56,8 @@ class hyperdex::replication_manager::key_state
         void clear();
         uint64_t max_seq_id() const;
         uint64_t min_seq_id() const;
+        // when the oldest operation not yet in the datalayer arrived, or 0
+        uint64_t oldest_unpersisted() const;
         e::intrusive_ptr<pending> get_version(uint64_t version) const;
 
     public:
@@ -92,12 +94,15 @@ class hyperdex::replication_manager::key_state
                                             const region_id& ri,
                                             const schema& sc);
         void debug_dump();
+        // Bytes of memory pinned by this key state while it is retained.
+        size_t footprint() const;
 
     private:
         typedef std::list<std::pair<uint64_t, e::intrusive_ptr<pending> > >
                 pending_list_t;
         friend class e::intrusive_ptr<key_state>;
         friend class key_state_reference;
+        friend class replication_manager;
 
     private:
         void inc() { __sync_add_and_fetch(&m_ref, 1); }
@@ -122,6 +127,10 @@ class hyperdex::replication_manager::key_state
                           bool has_old_value,
                           const std::vector<e::slice>& old_value,
                           e::intrusive_ptr<pending> pend);
+        bool apply_delta(const schema& sc,
+                         bool has_old_value,
+                         const std::vector<e::slice>& old_value,
+                         e::intrusive_ptr<pending> op);
 
     private:
         const region_id m_ri;
@@ -139,6 +148,9 @@ class hyperdex::replication_manager::key_state
         std::vector<e::slice> m_old_value;
         datalayer::reference m_old_disk_ref;
         std::auto_ptr<e::buffer> m_old_backing;
+        // protected by replication_manager::m_retained_protect
+        uint32_t m_retained;
+        retained_list_t::iterator m_retained_pos;
 };
 
 #endif // hyperdex_daemon_replication_manager_key_state_h_
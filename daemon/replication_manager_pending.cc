@@ -28,6 +28,9 @@
 // Google Log
 #include <glog/logging.h>
 
+// e
+#include <e/time.h>
+
 // HyperDex
 #include "daemon/replication_manager_pending.h"
 
@@ -47,8 +50,13 @@ replication_manager :: pending :: pending(std::auto_ptr<e::buffer> _backing,
     , seq_id(_seq_id)
     , has_value(_has_value)
     , value(_value)
+    , funcs()
+    , funcs_backing()
+    , needs_value(false)
+    , value_backing()
     , recv_config_version(_recv_config_version)
     , recv(_recv)
+    , recv_time(e::time())
     , sent_config_version(0)
     , sent()
     , fresh(_fresh)
@@ -74,6 +82,7 @@ replication_manager :: pending :: debug_dump()
 {
     LOG(INFO) << "  unique op id: reg_id=" << reg_id << " seq_id=" << seq_id;
     LOG(INFO) << "  has value: " << (has_value ? "yes" : "no");
+    LOG(INFO) << "  funcs: " << funcs.size() << " bytes" << (needs_value ? " (not yet applied)" : "");
     LOG(INFO) << "  recv: version=" << recv_config_version << " from=" << recv;
     LOG(INFO) << "  sent: version=" << sent_config_version << " to=" << sent;
     LOG(INFO) << "  fresh: " << (fresh ? "yes" : "no");
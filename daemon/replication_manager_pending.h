@@ -57,8 +57,16 @@ class hyperdex::replication_manager::pending
         uint64_t seq_id;
         bool has_value;
         std::vector<e::slice> value;
+        // packed funcalls that turn version - 1 into value; when set, the op
+        // may travel down its region's chain as a delta
+        e::slice funcs;
+        std::auto_ptr<e::buffer> funcs_backing;
+        // value arrived as a delta and has yet to be computed from funcs
+        bool needs_value;
+        std::auto_ptr<e::buffer> value_backing;
         uint64_t recv_config_version;
         virtual_server_id recv; // we recv from here
+        uint64_t recv_time;
         uint64_t sent_config_version;
         virtual_server_id sent; // we sent to here
         bool fresh;
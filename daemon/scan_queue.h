@@ -0,0 +1,239 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_scan_queue_h_
+#define hyperdex_daemon_scan_queue_h_
+
+// C
+#include <stddef.h>
+
+// STL
+#include <list>
+#include <vector>
+
+// po6
+#include <po6/threads/cond.h>
+#include <po6/threads/mutex.h>
+
+// HyperDex
+#include "namespace.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// The line of scans waiting for a scan thread.  Threads "take" a scan, run a
+// batch of it, and "give_back" the scan, which goes to the back of the line
+// unless it is done.  While paused, nothing is handed out and "pause" returns
+// only once every taken scan has been given back, so the caller may then
+// inspect and prune the queue with "remove_if".
+template <typename T>
+class scan_queue
+{
+    public:
+        scan_queue(size_t max_queued);
+        ~scan_queue() throw () {}
+
+    public:
+        // false if max_queued scans are already waiting
+        bool push(const T& t);
+        // block for the next scan; false once shut down
+        bool take(T* t);
+        void give_back(const T& t, bool done);
+        void pause();
+        void unpause();
+        void shutdown();
+        void clear();
+        // move every waiting scan for which pred holds into removed
+        template <typename P>
+        void remove_if(P pred, std::vector<T>* removed);
+        // scans waiting plus scans taken
+        size_t outstanding();
+
+    private:
+        scan_queue(const scan_queue&);
+        scan_queue& operator = (const scan_queue&);
+
+    private:
+        const size_t m_max_queued;
+        po6::threads::mutex m_protect;
+        po6::threads::cond m_wakeup;
+        po6::threads::cond m_idle;
+        std::list<T> m_queue;
+        size_t m_queued;
+        size_t m_running;
+        bool m_paused;
+        bool m_shutdown;
+};
+
+template <typename T>
+scan_queue<T> :: scan_queue(size_t max_queued)
+    : m_max_queued(max_queued)
+    , m_protect()
+    , m_wakeup(&m_protect)
+    , m_idle(&m_protect)
+    , m_queue()
+    , m_queued(0)
+    , m_running(0)
+    , m_paused(false)
+    , m_shutdown(false)
+{
+}
+
+template <typename T>
+bool
+scan_queue<T> :: push(const T& t)
+{
+    po6::threads::mutex::hold hold(&m_protect);
+
+    if (m_queued >= m_max_queued)
+    {
+        return false;
+    }
+
+    m_queue.push_back(t);
+    ++m_queued;
+    m_wakeup.signal();
+    return true;
+}
+
+template <typename T>
+bool
+scan_queue<T> :: take(T* t)
+{
+    po6::threads::mutex::hold hold(&m_protect);
+
+    while ((m_queue.empty() || m_paused) && !m_shutdown)
+    {
+        m_wakeup.wait();
+    }
+
+    if (m_shutdown)
+    {
+        return false;
+    }
+
+    *t = m_queue.front();
+    m_queue.pop_front();
+    --m_queued;
+    ++m_running;
+    return true;
+}
+
+template <typename T>
+void
+scan_queue<T> :: give_back(const T& t, bool done)
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    --m_running;
+
+    // go to the back of the line so every scan makes progress
+    if (!done)
+    {
+        m_queue.push_back(t);
+        ++m_queued;
+        m_wakeup.signal();
+    }
+
+    if (m_paused && m_running == 0)
+    {
+        m_idle.broadcast();
+    }
+}
+
+template <typename T>
+void
+scan_queue<T> :: pause()
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    m_paused = true;
+
+    while (m_running > 0)
+    {
+        m_idle.wait();
+    }
+}
+
+template <typename T>
+void
+scan_queue<T> :: unpause()
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    m_paused = false;
+    m_wakeup.broadcast();
+}
+
+template <typename T>
+void
+scan_queue<T> :: shutdown()
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    m_shutdown = true;
+    m_wakeup.broadcast();
+}
+
+template <typename T>
+void
+scan_queue<T> :: clear()
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    m_queue.clear();
+    m_queued = 0;
+}
+
+template <typename T>
+template <typename P>
+void
+scan_queue<T> :: remove_if(P pred, std::vector<T>* removed)
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    typename std::list<T>::iterator it = m_queue.begin();
+
+    while (it != m_queue.end())
+    {
+        if (pred(*it))
+        {
+            removed->push_back(*it);
+            it = m_queue.erase(it);
+            --m_queued;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+template <typename T>
+size_t
+scan_queue<T> :: outstanding()
+{
+    po6::threads::mutex::hold hold(&m_protect);
+    return m_queued + m_running;
+}
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_daemon_scan_queue_h_
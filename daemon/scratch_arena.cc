@@ -0,0 +1,173 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <assert.h>
+#include <stdlib.h>
+
+// STL
+#include <algorithm>
+#include <new>
+
+// e
+#include <e/atomic.h>
+
+// HyperDex
+#include "daemon/scratch_arena.h"
+
+using hyperdex::scratch_arena;
+
+#define ALIGNMENT 8
+#define MIN_BLOCK_SIZE 4096
+// the most memory an arena holds on to across a reset; a rare oversized
+// message should not pin its memory to the thread for good
+#define MAX_RETAINED_SIZE (1024 * 1024)
+
+struct scratch_arena::block
+{
+    block() : base(NULL), size(0) {}
+    block(char* b, size_t s) : base(b), size(s) {}
+    char* base;
+    size_t size;
+};
+
+// arenas live as long as their thread, and HyperDex threads live as long as
+// the process
+static __thread scratch_arena* s_current = NULL;
+static uint64_t s_mallocs = 0;
+
+static char*
+allocate_block(size_t sz)
+{
+    e::atomic::increment_64_nobarrier(&s_mallocs, 1);
+    char* ptr = static_cast<char*>(malloc(sz));
+
+    if (!ptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    return ptr;
+}
+
+scratch_arena*
+scratch_arena :: current()
+{
+    if (!s_current)
+    {
+        s_current = new scratch_arena();
+    }
+
+    return s_current;
+}
+
+uint64_t
+scratch_arena :: mallocs()
+{
+    return e::atomic::load_64_nobarrier(&s_mallocs);
+}
+
+scratch_arena :: scratch_arena()
+    : m_blocks()
+    , m_block(0)
+    , m_offset(0)
+{
+}
+
+scratch_arena :: ~scratch_arena() throw ()
+{
+    for (size_t i = 0; i < m_blocks.size(); ++i)
+    {
+        free(m_blocks[i].base);
+    }
+}
+
+char*
+scratch_arena :: allocate(size_t sz)
+{
+    sz = (sz + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1);
+
+    while (m_block < m_blocks.size())
+    {
+        if (m_offset + sz <= m_blocks[m_block].size)
+        {
+            char* ptr = m_blocks[m_block].base + m_offset;
+            m_offset += sz;
+            return ptr;
+        }
+
+        ++m_block;
+        m_offset = 0;
+    }
+
+    size_t block_sz = m_blocks.empty() ? MIN_BLOCK_SIZE : m_blocks.back().size * 2;
+    block_sz = std::max(block_sz, sz);
+    m_blocks.push_back(block(allocate_block(block_sz), block_sz));
+    m_block = m_blocks.size() - 1;
+    m_offset = sz;
+    return m_blocks.back().base;
+}
+
+void
+scratch_arena :: reset()
+{
+    size_t total = 0;
+
+    for (size_t i = 0; i < m_blocks.size(); ++i)
+    {
+        total += m_blocks[i].size;
+    }
+
+    if (m_blocks.size() > 1 || total > MAX_RETAINED_SIZE)
+    {
+        for (size_t i = 0; i < m_blocks.size(); ++i)
+        {
+            free(m_blocks[i].base);
+        }
+
+        total = std::min(total, size_t(MAX_RETAINED_SIZE));
+        m_blocks.clear();
+        m_blocks.push_back(block(allocate_block(total), total));
+    }
+
+    m_block = 0;
+    m_offset = 0;
+}
+
+scratch_arena :: scope :: scope(scratch_arena* sa)
+    : m_sa(sa)
+    , m_block(sa->m_block)
+    , m_offset(sa->m_offset)
+{
+}
+
+scratch_arena :: scope :: ~scope() throw ()
+{
+    assert(m_block <= m_sa->m_block);
+    m_sa->m_block = m_block;
+    m_sa->m_offset = m_offset;
+}
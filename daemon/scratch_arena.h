@@ -0,0 +1,104 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef hyperdex_daemon_scratch_arena_h_
+#define hyperdex_daemon_scratch_arena_h_
+
+// C
+#include <stddef.h>
+#include <stdint.h>
+
+// STL
+#include <vector>
+
+// HyperDex
+#include "namespace.h"
+
+BEGIN_HYPERDEX_NAMESPACE
+
+// A bump allocator for the short-lived buffers used to encode keys, values,
+// and index entries.  Each thread gets its own arena; network threads reset
+// theirs after every message, so in the steady state the arena is one block
+// and allocating from it never calls malloc.
+class scratch_arena
+{
+    public:
+        class scope;
+
+    public:
+        // the calling thread's arena, created on first use
+        static scratch_arena* current();
+        // the number of times any arena has had to call malloc
+        static uint64_t mallocs();
+
+    public:
+        scratch_arena();
+        ~scratch_arena() throw ();
+
+    public:
+        // return sz bytes that remain valid until the arena is rewound
+        char* allocate(size_t sz);
+        // release everything; coalesces the backing memory into one block,
+        // trimmed to at most 1MB
+        void reset();
+
+    private:
+        struct block;
+
+    private:
+        scratch_arena(const scratch_arena&);
+        scratch_arena& operator = (const scratch_arena&);
+
+    private:
+        std::vector<block> m_blocks;
+        size_t m_block;
+        size_t m_offset;
+};
+
+// Rewinds the arena to its state at construction when going out of scope.
+class scratch_arena::scope
+{
+    public:
+        scope(scratch_arena* sa);
+        ~scope() throw ();
+
+    public:
+        scratch_arena* arena() const { return m_sa; }
+
+    private:
+        scope(const scope&);
+        scope& operator = (const scope&);
+
+    private:
+        scratch_arena* m_sa;
+        size_t m_block;
+        size_t m_offset;
+};
+
+END_HYPERDEX_NAMESPACE
+
+#endif // hyperdex_daemon_scratch_arena_h_
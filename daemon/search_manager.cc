@@ -27,6 +27,10 @@
 
 #define __STDC_LIMIT_MACROS
 
+// C
+#include <signal.h>
+#include <string.h>
+
 // STL
 #include <algorithm>
 #include <sstream>
@@ -50,6 +54,11 @@ using hyperdex::datatype_info;
 using hyperdex::search_manager;
 using hyperdex::reconfigure_returncode;
 
+// objects a scan reads before it goes to the back of the line
+#define SCAN_BATCH 1024
+// scans that may wait for a scan thread before new ones are refused
+#define SCAN_QUEUE_MAX 256
+
 /////////////////////////////// Search Manager ID //////////////////////////////
 
 class search_manager::id
@@ -155,6 +164,8 @@ search_manager :: state :: ~state() throw ()
 search_manager :: search_manager(daemon* d)
     : m_daemon(d)
     , m_searches(10)
+    , m_scan_threads()
+    , m_scans(SCAN_QUEUE_MAX)
 {
 }
 
@@ -163,32 +174,44 @@ search_manager :: ~search_manager() throw ()
 }
 
 bool
-search_manager :: setup()
+search_manager :: setup(unsigned scan_threads)
 {
+    for (size_t i = 0; i < scan_threads; ++i)
+    {
+        std::tr1::shared_ptr<po6::threads::thread> t(new po6::threads::thread(std::tr1::bind(&search_manager::scan_thread, this)));
+        m_scan_threads.push_back(t);
+        t->start();
+    }
+
     return true;
 }
 
 void
 search_manager :: teardown()
 {
+    m_scans.shutdown();
+
+    for (size_t i = 0; i < m_scan_threads.size(); ++i)
+    {
+        m_scan_threads[i]->join();
+    }
+
+    m_scan_threads.clear();
+    m_scans.clear();
 }
 
 void
 search_manager :: pause()
 {
+    // scans read the configuration, so let the running batches finish and
+    // hold the rest until the new configuration is in place
+    m_scans.pause();
 }
 
 void
 search_manager :: unpause()
 {
-}
-
-void
-search_manager :: reconfigure(const configuration&,
-                              const configuration&,
-                              const server_id&)
-{
-    // XXX cleanup dead or old searches
+    m_scans.unpause();
 }
 
 void
@@ -199,9 +222,14 @@ search_manager :: start(const server_id& from,
                         uint64_t search_id,
                         std::vector<attribute_check>* checks)
 {
-    region_id ri(m_daemon->m_config.get_region_id(to));
+    region_id ri(m_daemon->m_config->get_region_id(to));
     id sid(ri, from, search_id);
 
+    if (relabel_pending(from, to, nonce))
+    {
+        return;
+    }
+
     if (m_searches.contains(sid))
     {
         LOG(WARNING) << "received request for search " << search_id << " from client "
@@ -240,7 +268,7 @@ search_manager :: next(const server_id& from,
                        uint64_t nonce,
                        uint64_t search_id)
 {
-    region_id ri(m_daemon->m_config.get_region_id(to));
+    region_id ri(m_daemon->m_config->get_region_id(to));
     id sid(ri, from, search_id);
     e::intrusive_ptr<state> st;
 
@@ -284,7 +312,7 @@ search_manager :: stop(const server_id& from,
                        const virtual_server_id& to,
                        uint64_t search_id)
 {
-    region_id ri(m_daemon->m_config.get_region_id(to));
+    region_id ri(m_daemon->m_config->get_region_id(to));
     id sid(ri, from, search_id);
     m_searches.remove(sid);
 }
@@ -294,12 +322,15 @@ namespace hyperdex
 
 struct _sorted_search_params
 {
-    _sorted_search_params(const schema* _sc,
+    _sorted_search_params(const schema* sc,
                           uint16_t _sort_by,
                           bool _maximize)
-        : sc(_sc), sort_by(_sort_by), maximize(_maximize) {}
+        : di(_sort_by < sc->attrs_sz ? datatype_info::lookup(sc->attrs[_sort_by].type) : NULL)
+        , sort_by(_sort_by), maximize(_maximize) {}
     ~_sorted_search_params() throw () {}
-    const schema* sc;
+    // the scan may outlive the configuration that held the schema, so keep
+    // only the datatype of the sort attribute; NULL if there is none
+    datatype_info* di;
     uint16_t sort_by;
     bool maximize;
 
@@ -348,7 +379,7 @@ operator < (const _sorted_search_item& lhs, const _sorted_search_item& rhs)
     assert(lhs.params == rhs.params);
     _sorted_search_params* params = lhs.params;
 
-    if (params->sort_by >= params->sc->attrs_sz)
+    if (!params->di)
     {
         return false;
     }
@@ -357,14 +388,12 @@ operator < (const _sorted_search_item& lhs, const _sorted_search_item& rhs)
 
     if (params->sort_by == 0)
     {
-        datatype_info* di = datatype_info::lookup(params->sc->attrs[0].type);
-        cmp = di->compare(lhs.key, rhs.key);
+        cmp = params->di->compare(lhs.key, rhs.key);
     }
     else
     {
-        datatype_info* di = datatype_info::lookup(params->sc->attrs[params->sort_by].type);
-        cmp = di->compare(lhs.value[params->sort_by - 1],
-                          rhs.value[params->sort_by - 1]);
+        cmp = params->di->compare(lhs.value[params->sort_by - 1],
+                                  rhs.value[params->sort_by - 1]);
     }
 
     if (params->maximize)
@@ -383,7 +412,7 @@ operator > (const _sorted_search_item& lhs, const _sorted_search_item& rhs)
     assert(lhs.params == rhs.params);
     _sorted_search_params* params = lhs.params;
 
-    if (params->sort_by >= params->sc->attrs_sz)
+    if (!params->di)
     {
         return false;
     }
@@ -392,14 +421,12 @@ operator > (const _sorted_search_item& lhs, const _sorted_search_item& rhs)
 
     if (params->sort_by == 0)
     {
-        datatype_info* di = datatype_info::lookup(params->sc->attrs[0].type);
-        cmp = di->compare(lhs.key, rhs.key);
+        cmp = params->di->compare(lhs.key, rhs.key);
     }
     else
     {
-        datatype_info* di = datatype_info::lookup(params->sc->attrs[params->sort_by].type);
-        cmp = di->compare(lhs.value[params->sort_by - 1],
-                          rhs.value[params->sort_by - 1]);
+        cmp = params->di->compare(lhs.value[params->sort_by - 1],
+                                  rhs.value[params->sort_by - 1]);
     }
 
     if (params->maximize)
@@ -414,235 +441,361 @@ operator > (const _sorted_search_item& lhs, const _sorted_search_item& rhs)
 
 } // namespace hyperdex
 
-void
-search_manager :: sorted_search(const server_id& from,
-                                const virtual_server_id& to,
-                                uint64_t nonce,
-                                std::vector<attribute_check>* checks,
-                                uint64_t limit,
-                                uint16_t sort_by,
-                                bool maximize)
+////////////////////////////// Search Manager Scans ////////////////////////////
+
+// A request that reads every object matching its checks.  The network thread
+// that receives it opens the iterator; the scan threads then advance it a
+// batch at a time, taking turns with other scans, until it sends its reply.
+class search_manager::scan
 {
-    region_id ri(m_daemon->m_config.get_region_id(to));
-    std::stable_sort(checks->begin(), checks->end());
-    datalayer::returncode rc = datalayer::SUCCESS;
+    public:
+        scan(search_manager* sm,
+             const server_id& from,
+             const virtual_server_id& to,
+             uint64_t nonce,
+             std::auto_ptr<e::buffer> msg,
+             std::vector<attribute_check>* checks,
+             std::ostringstream* ostr);
+        virtual ~scan() throw ();
+
+    public:
+        // Advance over at most "budget" objects.  Return true once the scan
+        // has sent its response and is done.
+        virtual bool step(uint64_t budget) = 0;
+        // true if the region this scan reads is not at m_to in config
+        bool moved(const configuration& config) const
+        { return config.get_region_id(m_to) != m_ri; }
+        // answer the client with CONFIGMISMATCH instead of a result
+        void abandon();
+
+    protected:
+        daemon* const m_daemon;
+        const server_id m_from;
+        const virtual_server_id m_to;
+        const uint64_t m_nonce;
+        const std::auto_ptr<e::buffer> m_backing;
+        const region_id m_ri;
+        std::vector<attribute_check> m_checks;
+        e::intrusive_ptr<datalayer::iterator> m_iter;
+
+    private:
+        friend class e::intrusive_ptr<scan>;
+        void inc() { __sync_add_and_fetch(&m_ref, 1); }
+        void dec() { if (__sync_sub_and_fetch(&m_ref, 1) == 0) delete this; }
+        size_t m_ref;
+
+    private:
+        scan(const scan&);
+        scan& operator = (const scan&);
+};
+
+search_manager :: scan :: scan(search_manager* sm,
+                               const server_id& from,
+                               const virtual_server_id& to,
+                               uint64_t nonce,
+                               std::auto_ptr<e::buffer> msg,
+                               std::vector<attribute_check>* checks,
+                               std::ostringstream* ostr)
+    : m_daemon(sm->m_daemon)
+    , m_from(from)
+    , m_to(to)
+    , m_nonce(nonce)
+    , m_backing(msg)
+    , m_ri(sm->m_daemon->m_config->get_region_id(to))
+    , m_checks()
+    , m_iter()
+    , m_ref(0)
+{
+    m_checks.swap(*checks);
+    std::stable_sort(m_checks.begin(), m_checks.end());
+    uint64_t t_start = e::time();
     datalayer::snapshot snap = m_daemon->m_data.make_snapshot();
-    e::intrusive_ptr<datalayer::iterator> iter;
-    iter = m_daemon->m_data.make_search_iterator(snap, ri, *checks, NULL);
+    uint64_t t_end = e::time();
 
-    switch (rc)
+    if (ostr)
     {
-        case datalayer::SUCCESS:
-            break;
-        case datalayer::NOT_FOUND:
-        case datalayer::BAD_ENCODING:
-        case datalayer::CORRUPTION:
-        case datalayer::IO_ERROR:
-        case datalayer::LEVELDB_ERROR:
-            LOG(ERROR) << "could not make snapshot for search:  " << rc;
-            break;
-        default:
-            abort();
+        *ostr << " snapshot took " << t_end - t_start << "ns\n";
     }
 
-    const schema* sc = m_daemon->m_config.get_schema(ri);
-    assert(sc);
-    _sorted_search_params params(sc, sort_by, maximize);
-    std::vector<_sorted_search_item> top_n;
-    top_n.reserve(limit);
+    t_start = e::time();
+    m_iter = m_daemon->m_data.make_search_iterator(snap, m_ri, m_checks, ostr);
+    t_end = e::time();
+
+    if (ostr)
+    {
+        *ostr << " iterator took " << t_end - t_start << "ns\n";
+    }
+}
+
+search_manager :: scan :: ~scan() throw ()
+{
+}
+
+void
+search_manager :: scan :: abandon()
+{
+    std::auto_ptr<e::buffer> msg(e::buffer::create(HYPERDEX_HEADER_SIZE_VC + sizeof(uint64_t)));
+    msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << m_nonce;
+    m_daemon->m_comm.send_client(m_to, m_from, CONFIGMISMATCH, msg);
+}
+
+class search_manager::scan_moved
+{
+    public:
+        scan_moved(const configuration* config) : m_config(config) {}
+
+    public:
+        bool operator () (const e::intrusive_ptr<scan>& s) const
+        { return s->moved(*m_config); }
+
+    private:
+        const configuration* m_config;
+};
+
+class search_manager::sorted_search_scan : public scan
+{
+    public:
+        sorted_search_scan(search_manager* sm,
+                           const server_id& from,
+                           const virtual_server_id& to,
+                           uint64_t nonce,
+                           std::auto_ptr<e::buffer> msg,
+                           std::vector<attribute_check>* checks,
+                           const schema* sc,
+                           uint64_t limit,
+                           uint16_t sort_by,
+                           bool maximize)
+            : scan(sm, from, to, nonce, msg, checks, NULL)
+            , m_params(sc, sort_by, maximize)
+            , m_limit(limit)
+            , m_top_n()
+        {
+            m_top_n.reserve(std::min<uint64_t>(limit, 1024));
+        }
+
+        virtual ~sorted_search_scan() throw () {}
 
-    while (iter->valid())
+    public:
+        virtual bool step(uint64_t budget);
+
+    private:
+        _sorted_search_params m_params;
+        const uint64_t m_limit;
+        std::vector<_sorted_search_item> m_top_n;
+};
+
+bool
+search_manager :: sorted_search_scan :: step(uint64_t budget)
+{
+    for (; budget > 0 && m_iter->valid(); --budget)
     {
-        top_n.push_back(_sorted_search_item(&params));
-        m_daemon->m_data.get_from_iterator(ri, iter.get(), &top_n.back().key, &top_n.back().value, &top_n.back().version, &top_n.back().ref);
-        std::push_heap(top_n.begin(), top_n.end());
+        m_top_n.push_back(_sorted_search_item(&m_params));
+        m_daemon->m_data.get_from_iterator(m_ri, m_iter.get(), &m_top_n.back().key, &m_top_n.back().value, &m_top_n.back().version, &m_top_n.back().ref);
+        std::push_heap(m_top_n.begin(), m_top_n.end());
 
-        if (top_n.size() > limit)
+        if (m_top_n.size() > m_limit)
         {
-            std::pop_heap(top_n.begin(), top_n.end());
-            top_n.pop_back();
+            std::pop_heap(m_top_n.begin(), m_top_n.end());
+            m_top_n.pop_back();
         }
 
-        iter->next();
+        m_iter->next();
     }
 
-    std::sort(top_n.begin(), top_n.end(), std::greater<_sorted_search_item>());
+    if (m_iter->valid())
+    {
+        return false;
+    }
+
+    std::sort(m_top_n.begin(), m_top_n.end(), std::greater<_sorted_search_item>());
     size_t sz = HYPERDEX_HEADER_SIZE_VC + sizeof(uint64_t) + sizeof(uint64_t);
 
-    for (size_t i = 0; i < top_n.size(); ++i)
+    for (size_t i = 0; i < m_top_n.size(); ++i)
     {
-        sz += pack_size(top_n[i].key) + pack_size(top_n[i].value);
+        sz += pack_size(m_top_n[i].key) + pack_size(m_top_n[i].value);
     }
 
     std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
     e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VC);
-    pa = pa << nonce << static_cast<uint64_t>(top_n.size());
+    pa = pa << m_nonce << static_cast<uint64_t>(m_top_n.size());
 
-    for (size_t i = 0; i < top_n.size(); ++i)
+    for (size_t i = 0; i < m_top_n.size(); ++i)
     {
-        pa = pa << top_n[i].key << top_n[i].value;
+        pa = pa << m_top_n[i].key << m_top_n[i].value;
     }
 
-    m_daemon->m_comm.send_client(to, from, RESP_SORTED_SEARCH, msg);
+    m_daemon->m_comm.send_client(m_to, m_from, RESP_SORTED_SEARCH, msg);
+    return true;
 }
 
-void
-search_manager :: group_keyop(const server_id& from,
-                              const virtual_server_id& to,
-                              uint64_t nonce,
-                              std::vector<attribute_check>* checks,
-                              network_msgtype mt,
-                              const e::slice& remain,
-                              network_msgtype resp)
+class search_manager::group_keyop_scan : public scan
 {
-    region_id ri(m_daemon->m_config.get_region_id(to));
-    std::stable_sort(checks->begin(), checks->end());
-    datalayer::returncode rc = datalayer::SUCCESS;
-    datalayer::snapshot snap = m_daemon->m_data.make_snapshot();
-    e::intrusive_ptr<datalayer::iterator> iter;
-    iter = m_daemon->m_data.make_search_iterator(snap, ri, *checks, NULL);
-    uint64_t result = 0;
+    public:
+        group_keyop_scan(search_manager* sm,
+                         const server_id& from,
+                         const virtual_server_id& to,
+                         uint64_t nonce,
+                         std::auto_ptr<e::buffer> msg,
+                         std::vector<attribute_check>* checks,
+                         network_msgtype mt,
+                         const e::slice& remain,
+                         network_msgtype resp)
+            : scan(sm, from, to, nonce, msg, checks, NULL)
+            , m_mt(mt)
+            , m_remain(remain)
+            , m_resp(resp)
+        {
+        }
 
-    switch (rc)
-    {
-        case datalayer::SUCCESS:
-            break;
-        case datalayer::NOT_FOUND:
-        case datalayer::BAD_ENCODING:
-        case datalayer::CORRUPTION:
-        case datalayer::IO_ERROR:
-        case datalayer::LEVELDB_ERROR:
-            LOG(ERROR) << "could not make snapshot for search:  " << rc;
-            result = UINT64_MAX;
-            break;
-        default:
-            abort();
-    }
+        virtual ~group_keyop_scan() throw () {}
+
+    public:
+        virtual bool step(uint64_t budget);
+
+    private:
+        const network_msgtype m_mt;
+        const e::slice m_remain;
+        const network_msgtype m_resp;
+};
 
-    while (iter->valid() && result < UINT64_MAX)
+bool
+search_manager :: group_keyop_scan :: step(uint64_t budget)
+{
+    for (; budget > 0 && m_iter->valid(); --budget)
     {
         e::slice key;
         std::vector<e::slice> val;
         uint64_t ver;
         datalayer::reference tmp;
-        m_daemon->m_data.get_from_iterator(ri, iter.get(), &key, &val, &ver, &tmp);
+        m_daemon->m_data.get_from_iterator(m_ri, m_iter.get(), &key, &val, &ver, &tmp);
         size_t sz = HYPERDEX_HEADER_SIZE_SV // SV because we imitate a client
                   + sizeof(uint64_t)
                   + pack_size(key)
-                  + remain.size();
+                  + m_remain.size();
         std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
         e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_SV);
         pa = pa << static_cast<uint64_t>(0) << key;
-        pa = pa.copy(remain);
-        virtual_server_id vsi = m_daemon->m_config.point_leader(ri, key);
+        pa = pa.copy(m_remain);
+        virtual_server_id vsi = m_daemon->m_config->point_leader(m_ri, key);
 
         if (vsi != virtual_server_id())
         {
-            m_daemon->m_comm.send(vsi, mt, msg);
+            m_daemon->m_comm.send(vsi, m_mt, msg);
         }
 
-        iter->next();
+        m_iter->next();
     }
 
+    if (m_iter->valid())
+    {
+        return false;
+    }
+
+    uint64_t result = 0;
     size_t sz = HYPERDEX_HEADER_SIZE_VC
               + sizeof(uint64_t)
               + sizeof(uint64_t);
     std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce << result;
-    m_daemon->m_comm.send_client(to, from, resp, msg);
+    msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << m_nonce << result;
+    m_daemon->m_comm.send_client(m_to, m_from, m_resp, msg);
+    return true;
 }
 
-void
-search_manager :: count(const server_id& from,
-                        const virtual_server_id& to,
-                        uint64_t nonce,
-                        std::vector<attribute_check>* checks)
+class search_manager::count_scan : public scan
 {
-    region_id ri(m_daemon->m_config.get_region_id(to));
-    std::stable_sort(checks->begin(), checks->end());
-    datalayer::returncode rc = datalayer::SUCCESS;
-    datalayer::snapshot snap = m_daemon->m_data.make_snapshot();
-    e::intrusive_ptr<datalayer::iterator> iter;
-    iter = m_daemon->m_data.make_search_iterator(snap, ri, *checks, NULL);
-    uint64_t result = 0;
+    public:
+        count_scan(search_manager* sm,
+                   const server_id& from,
+                   const virtual_server_id& to,
+                   uint64_t nonce,
+                   std::auto_ptr<e::buffer> msg,
+                   std::vector<attribute_check>* checks)
+            : scan(sm, from, to, nonce, msg, checks, NULL)
+            , m_result(0)
+        {
+        }
 
-    switch (rc)
+        virtual ~count_scan() throw () {}
+
+    public:
+        virtual bool step(uint64_t budget);
+
+    private:
+        uint64_t m_result;
+};
+
+bool
+search_manager :: count_scan :: step(uint64_t budget)
+{
+    for (; budget > 0 && m_iter->valid(); --budget)
     {
-        case datalayer::SUCCESS:
-            break;
-        case datalayer::NOT_FOUND:
-        case datalayer::BAD_ENCODING:
-        case datalayer::CORRUPTION:
-        case datalayer::IO_ERROR:
-        case datalayer::LEVELDB_ERROR:
-            LOG(ERROR) << "could not make snapshot for search:  " << rc;
-            result = UINT64_MAX;
-            break;
-        default:
-            abort();
+        ++m_result;
+        m_iter->next();
     }
 
-    while (iter->valid() && result < UINT64_MAX)
+    if (m_iter->valid())
     {
-        ++result;
-        iter->next();
+        return false;
     }
 
     size_t sz = HYPERDEX_HEADER_SIZE_VC
               + sizeof(uint64_t)
               + sizeof(uint64_t);
     std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce << result;
-    m_daemon->m_comm.send_client(to, from, RESP_COUNT, msg);
+    msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << m_nonce << m_result;
+    m_daemon->m_comm.send_client(m_to, m_from, RESP_COUNT, msg);
+    return true;
 }
 
-void
-search_manager :: search_describe(const server_id& from,
-                                  const virtual_server_id& to,
-                                  uint64_t nonce,
-                                  std::vector<attribute_check>* checks)
+class search_manager::describe_scan : public scan
+{
+    public:
+        describe_scan(search_manager* sm,
+                      const server_id& from,
+                      const virtual_server_id& to,
+                      uint64_t nonce,
+                      std::auto_ptr<e::buffer> msg,
+                      std::vector<attribute_check>* checks,
+                      std::ostringstream* ostr)
+            : scan(sm, from, to, nonce, msg, checks, ostr)
+            , m_ostr(ostr->str())
+            , m_num(0)
+            , m_elapsed(0)
+        {
+        }
+
+        virtual ~describe_scan() throw () {}
+
+    public:
+        virtual bool step(uint64_t budget);
+
+    private:
+        const std::string m_ostr;
+        uint64_t m_num;
+        uint64_t m_elapsed;
+};
+
+bool
+search_manager :: describe_scan :: step(uint64_t budget)
 {
-    region_id ri(m_daemon->m_config.get_region_id(to));
-    std::stable_sort(checks->begin(), checks->end());
-    datalayer::returncode rc = datalayer::SUCCESS;
-    std::ostringstream ostr;
-    ostr << "search\n";
     uint64_t t_start = e::time();
-    datalayer::snapshot snap = m_daemon->m_data.make_snapshot();
-    uint64_t t_end = e::time();
-    ostr << " snapshot took " << t_end - t_start << "ns\n";
-    e::intrusive_ptr<datalayer::iterator> iter;
-    t_start = e::time();
-    iter = m_daemon->m_data.make_search_iterator(snap, ri, *checks, &ostr);
-    t_end = e::time();
-    ostr << " iterator took " << t_end - t_start << "ns\n";
 
-    switch (rc)
+    for (; budget > 0 && m_iter->valid(); --budget)
     {
-        case datalayer::SUCCESS:
-            break;
-        case datalayer::NOT_FOUND:
-        case datalayer::BAD_ENCODING:
-        case datalayer::CORRUPTION:
-        case datalayer::IO_ERROR:
-        case datalayer::LEVELDB_ERROR:
-            LOG(ERROR) << "could not make snapshot for search:  " << rc;
-            break;
-        default:
-            abort();
+        ++m_num;
+        m_iter->next();
     }
 
-    uint64_t num = 0;
-    t_start = e::time();
+    m_elapsed += e::time() - t_start;
 
-    while (iter->valid())
+    if (m_iter->valid())
     {
-        ++num;
-        iter->next();
+        return false;
     }
 
-    t_end = e::time();
-    ostr << " retrieved " << num << " objects in " << t_end - t_start << "ns\n";
+    std::ostringstream ostr;
+    ostr << m_ostr;
+    ostr << " retrieved " << m_num << " objects in " << m_elapsed << "ns\n";
     std::string str(ostr.str());
     const char* text = str.c_str();
     size_t text_sz = strlen(text);
@@ -650,9 +803,188 @@ search_manager :: search_describe(const server_id& from,
               + sizeof(uint64_t)
               + text_sz;
     std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce;
+    e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << m_nonce;
     pa.copy(e::slice(text, text_sz));
-    m_daemon->m_comm.send_client(to, from, RESP_SEARCH_DESCRIBE, msg);
+    m_daemon->m_comm.send_client(m_to, m_from, RESP_SEARCH_DESCRIBE, msg);
+    return true;
+}
+
+//////////////////////////////// Search Manager ////////////////////////////////
+
+void
+search_manager :: sorted_search(const server_id& from,
+                                const virtual_server_id& to,
+                                std::auto_ptr<e::buffer> msg,
+                                uint64_t nonce,
+                                std::vector<attribute_check>* checks,
+                                uint64_t limit,
+                                uint16_t sort_by,
+                                bool maximize)
+{
+    if (relabel_pending(from, to, nonce))
+    {
+        return;
+    }
+
+    region_id ri(m_daemon->m_config->get_region_id(to));
+    const schema* sc = m_daemon->m_config->get_schema(ri);
+    assert(sc);
+    enqueue_scan(from, to, nonce,
+                 new sorted_search_scan(this, from, to, nonce, msg, checks,
+                                        sc, limit, sort_by, maximize));
+}
+
+void
+search_manager :: group_keyop(const server_id& from,
+                              const virtual_server_id& to,
+                              std::auto_ptr<e::buffer> msg,
+                              uint64_t nonce,
+                              std::vector<attribute_check>* checks,
+                              network_msgtype mt,
+                              const e::slice& remain,
+                              network_msgtype resp)
+{
+    if (relabel_pending(from, to, nonce))
+    {
+        return;
+    }
+
+    enqueue_scan(from, to, nonce,
+                 new group_keyop_scan(this, from, to, nonce, msg, checks,
+                                      mt, remain, resp));
+}
+
+void
+search_manager :: count(const server_id& from,
+                        const virtual_server_id& to,
+                        std::auto_ptr<e::buffer> msg,
+                        uint64_t nonce,
+                        std::vector<attribute_check>* checks)
+{
+    if (relabel_pending(from, to, nonce))
+    {
+        return;
+    }
+
+    enqueue_scan(from, to, nonce,
+                 new count_scan(this, from, to, nonce, msg, checks));
+}
+
+void
+search_manager :: search_describe(const server_id& from,
+                                  const virtual_server_id& to,
+                                  std::auto_ptr<e::buffer> msg,
+                                  uint64_t nonce,
+                                  std::vector<attribute_check>* checks)
+{
+    if (relabel_pending(from, to, nonce))
+    {
+        return;
+    }
+
+    std::ostringstream ostr;
+    ostr << "search\n";
+    enqueue_scan(from, to, nonce,
+                 new describe_scan(this, from, to, nonce, msg, checks, &ostr));
+}
+
+void
+search_manager :: reconfigure(const configuration&,
+                              const configuration& new_config,
+                              const server_id&)
+{
+    // XXX cleanup dead or old searches
+
+    // a waiting scan whose region moved away or was retired by a split would
+    // read a region we no longer have; fail it so the client retries
+    std::vector<e::intrusive_ptr<scan> > moved;
+    m_scans.remove_if(scan_moved(&new_config), &moved);
+
+    for (size_t i = 0; i < moved.size(); ++i)
+    {
+        moved[i]->abandon();
+    }
+}
+
+bool
+search_manager :: relabel_pending(const server_id& from,
+                                  const virtual_server_id& to,
+                                  uint64_t nonce)
+{
+    if (!m_daemon->m_data.relabel_pending(m_daemon->m_config->get_region_id(to)))
+    {
+        return false;
+    }
+
+    std::auto_ptr<e::buffer> msg(e::buffer::create(HYPERDEX_HEADER_SIZE_VC + sizeof(uint64_t)));
+    msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce;
+    m_daemon->m_comm.send_client(to, from, CONFIGMISMATCH, msg);
+    return true;
+}
+
+void
+search_manager :: enqueue_scan(const server_id& from,
+                               const virtual_server_id& to,
+                               uint64_t nonce,
+                               e::intrusive_ptr<scan> s)
+{
+    if (m_scans.push(s))
+    {
+        return;
+    }
+
+    // too many scans are waiting already; the client may retry later
+    std::auto_ptr<e::buffer> msg(e::buffer::create(HYPERDEX_HEADER_SIZE_VC + sizeof(uint64_t)));
+    msg->pack_at(HYPERDEX_HEADER_SIZE_VC) << nonce;
+    m_daemon->m_comm.send_client(to, from, OVERLOADED, msg);
+}
+
+void
+search_manager :: scan_thread()
+{
+    LOG(INFO) << "scan thread started";
+    sigset_t ss;
+
+    if (sigfillset(&ss) < 0)
+    {
+        PLOG(ERROR) << "sigfillset";
+        return;
+    }
+
+    if (pthread_sigmask(SIG_BLOCK, &ss, NULL) < 0)
+    {
+        PLOG(ERROR) << "could not block signals";
+        return;
+    }
+
+    while (true)
+    {
+        e::intrusive_ptr<scan> s;
+
+        if (!m_scans.take(&s))
+        {
+            break;
+        }
+
+        // the region may have moved since the scan's last batch
+        if (s->moved(*m_daemon->m_config))
+        {
+            s->abandon();
+            m_scans.give_back(s, true);
+        }
+        else
+        {
+            m_scans.give_back(s, s->step(SCAN_BATCH));
+        }
+    }
+
+    LOG(INFO) << "scan thread shutting down";
+}
+
+uint64_t
+search_manager :: pending_scans()
+{
+    return m_scans.outstanding();
 }
 
 uint64_t
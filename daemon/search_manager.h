@@ -28,6 +28,12 @@
 #ifndef hyperdex_daemon_search_manager_h_
 #define hyperdex_daemon_search_manager_h_
 
+// STL
+#include <tr1/memory>
+
+// po6
+#include <po6/threads/thread.h>
+
 // e
 #include <e/intrusive_ptr.h>
 #include <e/lockfree_hash_map.h>
@@ -38,6 +44,7 @@
 #include "common/network_msgtype.h"
 #include "daemon/datalayer.h"
 #include "daemon/reconfigure_returncode.h"
+#include "daemon/scan_queue.h"
 
 BEGIN_HYPERDEX_NAMESPACE
 class daemon;
@@ -49,7 +56,7 @@ class search_manager
         ~search_manager() throw ();
 
     public:
-        bool setup();
+        bool setup(unsigned scan_threads);
         void teardown();
         void pause();
         void unpause();
@@ -71,8 +78,11 @@ class search_manager
         void stop(const server_id& from,
                   const virtual_server_id& to,
                   uint64_t search_id);
+        // These run on the scan threads; the network thread returns as soon
+        // as the iterator is open.
         void sorted_search(const server_id& from,
                            const virtual_server_id& to,
+                           std::auto_ptr<e::buffer> msg,
                            uint64_t nonce,
                            std::vector<attribute_check>* checks,
                            uint64_t limit,
@@ -80,6 +90,7 @@ class search_manager
                            bool maximize);
         void group_keyop(const server_id& from,
                          const virtual_server_id& to,
+                         std::auto_ptr<e::buffer> msg,
                          uint64_t nonce,
                          std::vector<attribute_check>* checks,
                          network_msgtype mt,
@@ -87,16 +98,26 @@ class search_manager
                          network_msgtype resp);
         void count(const server_id& from,
                    const virtual_server_id& to,
+                   std::auto_ptr<e::buffer> msg,
                    uint64_t nonce,
                    std::vector<attribute_check>* checks);
         void search_describe(const server_id& from,
                              const virtual_server_id& to,
+                             std::auto_ptr<e::buffer> msg,
                              uint64_t nonce,
                              std::vector<attribute_check>* checks);
+        // scans queued for or running on the scan threads
+        uint64_t pending_scans();
 
     private:
         class id;
         class state;
+        class scan;
+        class sorted_search_scan;
+        class group_keyop_scan;
+        class count_scan;
+        class describe_scan;
+        class scan_moved;
 
     private:
         search_manager(const search_manager&);
@@ -104,10 +125,22 @@ class search_manager
 
     private:
         static uint64_t hash(const id&);
+        // a split or merge may still be moving objects into the region;
+        // fail the search so the client retries rather than miss them
+        bool relabel_pending(const server_id& from,
+                             const virtual_server_id& to,
+                             uint64_t nonce);
+        void enqueue_scan(const server_id& from,
+                          const virtual_server_id& to,
+                          uint64_t nonce,
+                          e::intrusive_ptr<scan> s);
+        void scan_thread();
 
     private:
         daemon* m_daemon;
         e::lockfree_hash_map<id, e::intrusive_ptr<state>, hash> m_searches;
+        std::vector<std::tr1::shared_ptr<po6::threads::thread> > m_scan_threads;
+        scan_queue<e::intrusive_ptr<scan> > m_scans;
 };
 
 END_HYPERDEX_NAMESPACE
@@ -28,8 +28,12 @@
 #ifndef hyperdex_daemon_state_hash_table_h_
 #define hyperdex_daemon_state_hash_table_h_
 
+// C
+#include <assert.h>
+
 // STL
 #include <list>
+#include <tr1/functional>
 
 // Google
 #include <google/dense_hash_map>
@@ -37,12 +41,20 @@
 // po6
 #include <po6/threads/mutex.h>
 
+// e
+#include <e/array_ptr.h>
+#include <e/intrusive_ptr.h>
+
 // HyperDex
 #include "namespace.h"
 
 BEGIN_HYPERDEX_NAMESPACE
 
 // Only one iterator may be used at a time
+//
+// States are spread across independently locked shards chosen by the key's
+// hash, so threads working on different keys rarely contend.  The iterator
+// walks the shards in order.
 
 template <typename K, typename T>
 class state_hash_table
@@ -56,10 +68,8 @@ class state_hash_table
         ~state_hash_table() throw ();
 
     public:
-        void set_empty_key(const K& k)
-        { m_state_map->set_empty_key(k); }
-        void set_deleted_key(const K& k)
-        { m_state_map->set_deleted_key(k); }
+        void set_empty_key(const K& k);
+        void set_deleted_key(const K& k);
 
     public:
         T* create_state(const K& key, state_reference* sr);
@@ -67,16 +77,42 @@ class state_hash_table
         T* get_or_create_state(const K& key, state_reference* sr);
 
     private:
+        class shard;
         typedef std::list<e::intrusive_ptr<T> > state_list_t;
         typedef google::dense_hash_map<K, typename state_list_t::iterator> state_map_t;
+        static const size_t SHARD_BITS = 6;
+        static const size_t SHARDS = 1 << SHARD_BITS;
+
+    private:
+        shard* get_shard(const K& key);
 
     private:
-        po6::threads::mutex m_mtx;
-        const std::auto_ptr<state_map_t> m_state_map;
-        const std::auto_ptr<state_list_t> m_state_list;
-        typename state_list_t::iterator m_itl;
-        bool m_itl_erased;
+        const e::array_ptr<shard> m_shards;
+        po6::threads::mutex m_iter_mtx;
         bool m_iterating;
+
+    private:
+        state_hash_table(const state_hash_table&);
+        state_hash_table& operator = (const state_hash_table&);
+};
+
+template <typename K, typename T>
+class state_hash_table<K, T>::shard
+{
+    public:
+        shard();
+        ~shard() throw ();
+
+    public:
+        po6::threads::mutex mtx;
+        state_map_t state_map;
+        state_list_t state_list;
+        typename state_list_t::iterator itl;
+        bool itl_erased;
+
+    private:
+        shard(const shard&);
+        shard& operator = (const shard&);
 };
 
 template <typename K, typename T>
@@ -119,6 +155,7 @@ class state_hash_table<K, T>::iterator
         state_hash_table* m_sht;
         state_reference m_sr;
         T* m_ptr;
+        size_t m_shard;
         bool m_primed;
         bool m_valid;
 
@@ -129,11 +166,8 @@ class state_hash_table<K, T>::iterator
 
 template <typename K, typename T>
 state_hash_table<K, T> :: state_hash_table()
-    : m_mtx()
-    , m_state_map(new state_map_t())
-    , m_state_list(new state_list_t())
-    , m_itl(m_state_list->begin())
-    , m_itl_erased(false)
+    : m_shards(new shard[SHARDS])
+    , m_iter_mtx()
     , m_iterating(false)
 {
 }
@@ -141,7 +175,37 @@ state_hash_table<K, T> :: state_hash_table()
 template <typename K, typename T>
 state_hash_table<K, T> :: ~state_hash_table() throw ()
 {
-    po6::threads::mutex::hold hold(&m_mtx);
+    po6::threads::mutex::hold hold(&m_iter_mtx);
+}
+
+template <typename K, typename T>
+void
+state_hash_table<K, T> :: set_empty_key(const K& k)
+{
+    for (size_t i = 0; i < SHARDS; ++i)
+    {
+        m_shards[i].state_map.set_empty_key(k);
+    }
+}
+
+template <typename K, typename T>
+void
+state_hash_table<K, T> :: set_deleted_key(const K& k)
+{
+    for (size_t i = 0; i < SHARDS; ++i)
+    {
+        m_shards[i].state_map.set_deleted_key(k);
+    }
+}
+
+template <typename K, typename T>
+typename state_hash_table<K, T>::shard*
+state_hash_table<K, T> :: get_shard(const K& key)
+{
+    // the maps bucket by the low bits of the same hash, so pick the shard
+    // with the high bits to keep each map's keys spread evenly
+    size_t h = std::tr1::hash<K>()(key);
+    return &m_shards[h >> (sizeof(size_t) * 8 - SHARD_BITS)];
 }
 
 template <typename K, typename T>
@@ -155,14 +219,23 @@ state_hash_table<K, T> :: create_state(const K& key, state_reference* sr)
         std::pair<typename state_map_t::iterator, bool> inserted;
 
         {
-            po6::threads::mutex::hold hold(&m_mtx);
+            shard* s = get_shard(key);
+            po6::threads::mutex::hold hold(&s->mtx);
             typename state_list_t::iterator it;
-            it = m_state_list->insert(m_state_list->end(), t);
-            inserted = m_state_map->insert(std::make_pair(t->state_key(), it));
+            it = s->state_list.insert(s->state_list.end(), t);
+            inserted = s->state_map.insert(std::make_pair(t->state_key(), it));
+
+            if (!inserted.second)
+            {
+                s->state_list.erase(it);
+            }
         }
 
         if (!inserted.second)
         {
+            // never published, so unlocking must not collect the state
+            // that is published under the same key
+            t->mark_garbage();
             sr->unlock();
             return NULL;
         }
@@ -175,15 +248,17 @@ template <typename K, typename T>
 T*
 state_hash_table<K, T> :: get_state(const K& key, state_reference* sr)
 {
+    shard* s = get_shard(key);
+
     while (true)
     {
         e::intrusive_ptr<T> t;
 
         {
-            po6::threads::mutex::hold hold(&m_mtx);
-            typename state_map_t::iterator it = m_state_map->find(key);
+            po6::threads::mutex::hold hold(&s->mtx);
+            typename state_map_t::iterator it = s->state_map.find(key);
 
-            if (it == m_state_map->end())
+            if (it == s->state_map.end())
             {
                 return NULL;
             }
@@ -207,21 +282,23 @@ template <typename K, typename T>
 T*
 state_hash_table<K, T> :: get_or_create_state(const K& key, state_reference* sr)
 {
+    shard* s = get_shard(key);
+
     while (true)
     {
         e::intrusive_ptr<T> t;
 
         {
-            po6::threads::mutex::hold hold(&m_mtx);
-            typename state_map_t::iterator it = m_state_map->find(key);
+            po6::threads::mutex::hold hold(&s->mtx);
+            typename state_map_t::iterator it = s->state_map.find(key);
 
-            if (it == m_state_map->end())
+            if (it == s->state_map.end())
             {
                 t = new T(key);
                 typename state_list_t::iterator itl;
-                itl = m_state_list->insert(m_state_list->end(), t);
+                itl = s->state_list.insert(s->state_list.end(), t);
                 std::pair<typename state_map_t::iterator, bool> inserted;
-                inserted = m_state_map->insert(std::make_pair(t->state_key(), itl));
+                inserted = s->state_map.insert(std::make_pair(t->state_key(), itl));
                 assert(inserted.second);
             }
             else
@@ -242,6 +319,22 @@ state_hash_table<K, T> :: get_or_create_state(const K& key, state_reference* sr)
     }
 }
 
+template <typename K, typename T>
+state_hash_table<K, T> :: shard :: shard()
+    : mtx()
+    , state_map()
+    , state_list()
+    , itl(state_list.begin())
+    , itl_erased(false)
+{
+}
+
+template <typename K, typename T>
+state_hash_table<K, T> :: shard :: ~shard() throw ()
+{
+    po6::threads::mutex::hold hold(&mtx);
+}
+
 template <typename K, typename T>
 state_hash_table<K, T> :: state_reference :: state_reference()
     : m_locked(false)
@@ -277,10 +370,10 @@ state_hash_table<K, T> :: state_reference :: unlock()
 {
     assert(m_locked);
     // so we need to prevent a deadlock with cycle
-    // state_hash_table::m_mtx -> m_state->lock ->
+    // shard::mtx -> m_state->lock ->
     //
     // To do this, we mark garbage on key_state, release the lock, grab
-    // replication_manager::m_key_states_lock and destroy the object.
+    // the lock on the key's shard and destroy the object.
     // Everyone else will spin without holding a lock on the key state.
     bool we_collect = m_state->finished() && !m_state->marked_garbage();
 
@@ -293,20 +386,21 @@ state_hash_table<K, T> :: state_reference :: unlock()
 
     if (we_collect)
     {
-        po6::threads::mutex::hold hold(&m_sht->m_mtx);
+        shard* s = m_sht->get_shard(m_state->state_key());
+        po6::threads::mutex::hold hold(&s->mtx);
         typename state_map_t::iterator itm;
-        itm = m_sht->m_state_map->find(m_state->state_key());
+        itm = s->state_map.find(m_state->state_key());
         typename state_list_t::iterator itl;
-        bool erase_iterator = itm->second == m_sht->m_itl;
-        itl = m_sht->m_state_list->erase(itm->second);
+        bool erase_iterator = itm->second == s->itl;
+        itl = s->state_list.erase(itm->second);
 
         if (erase_iterator)
         {
-            m_sht->m_itl = itl;
-            m_sht->m_itl_erased = true;
+            s->itl = itl;
+            s->itl_erased = true;
         }
 
-        m_sht->m_state_map->erase(itm);
+        s->state_map.erase(itm);
     }
 
     m_sht = NULL;
@@ -319,14 +413,23 @@ state_hash_table<K, T> :: iterator :: iterator(state_hash_table* sht)
     : m_sht(sht)
     , m_sr()
     , m_ptr(NULL)
+    , m_shard(0)
     , m_primed(false)
     , m_valid(false)
 {
-    po6::threads::mutex::hold hold(&m_sht->m_mtx);
-    assert(!m_sht->m_iterating);
-    m_sht->m_iterating = true;
-    m_sht->m_itl = m_sht->m_state_list->begin();
-    m_sht->m_itl_erased = false;
+    {
+        po6::threads::mutex::hold hold(&m_sht->m_iter_mtx);
+        assert(!m_sht->m_iterating);
+        m_sht->m_iterating = true;
+    }
+
+    for (size_t i = 0; i < SHARDS; ++i)
+    {
+        shard* s = &m_sht->m_shards[i];
+        po6::threads::mutex::hold hold(&s->mtx);
+        s->itl = s->state_list.begin();
+        s->itl_erased = false;
+    }
 }
 
 template <typename K, typename T>
@@ -337,7 +440,7 @@ state_hash_table<K, T> :: iterator :: ~iterator() throw ()
         m_sr.unlock();
     }
 
-    po6::threads::mutex::hold hold(&m_sht->m_mtx);
+    po6::threads::mutex::hold hold(&m_sht->m_iter_mtx);
     assert(m_sht->m_iterating);
     m_sht->m_iterating = false;
 }
@@ -381,31 +484,30 @@ state_hash_table<K, T> :: iterator :: prime(bool inc)
         m_ptr = NULL;
     }
 
-    while (true)
+    while (m_shard < SHARDS)
     {
         e::intrusive_ptr<T> t;
 
         {
-            po6::threads::mutex::hold hold(&m_sht->m_mtx);
+            shard* s = &m_sht->m_shards[m_shard];
+            po6::threads::mutex::hold hold(&s->mtx);
 
-            if (m_sht->m_itl == m_sht->m_state_list->end())
+            if (inc && !s->itl_erased && s->itl != s->state_list.end())
             {
-                return;
+                ++s->itl;
             }
 
-            if (inc && !m_sht->m_itl_erased)
-            {
-                ++(m_sht->m_itl);
+            inc = false;
+            s->itl_erased = false;
 
-                if (m_sht->m_itl == m_sht->m_state_list->end())
-                {
-                    return;
-                }
+            if (s->itl == s->state_list.end())
+            {
+                // a fresh shard starts at its first state, not the second
+                ++m_shard;
+                continue;
             }
 
-            inc = false;
-            m_sht->m_itl_erased = false;
-            t = *m_sht->m_itl;
+            t = *s->itl;
         }
 
         m_sr.lock(m_sht, t);
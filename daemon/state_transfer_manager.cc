@@ -27,6 +27,7 @@
 
 // POSIX
 #include <signal.h>
+#include <time.h>
 
 // STL
 #include <algorithm>
@@ -36,19 +37,31 @@
 
 // HyperDex
 #include "common/serialization.h"
+#include "daemon/compression.h"
 #include "daemon/daemon.h"
 #include "daemon/datalayer_iterator.h"
+#include "daemon/merkle_tree.h"
 #include "daemon/state_transfer_manager.h"
 #include "daemon/state_transfer_manager_pending.h"
 #include "daemon/state_transfer_manager_transfer_in_state.h"
 #include "daemon/state_transfer_manager_transfer_out_state.h"
 
 using hyperdex::reconfigure_returncode;
+using hyperdex::region_id;
+using hyperdex::region_stats;
 using hyperdex::state_transfer_manager;
 using hyperdex::transfer_id;
 
+// objects are sent in frames of roughly this many bytes
+#define XFER_FRAME_BYTES (256ULL * 1024ULL)
+// the window never grows beyond this many unacked bytes
+#define XFER_WINDOW_MAX (64ULL * 1024ULL * 1024ULL)
+// regions get one stream for each this many bytes, up to XFER_MAX_STREAMS
+#define XFER_STREAM_BYTES (1ULL << 30)
+
 state_transfer_manager :: state_transfer_manager(daemon* d)
     : m_daemon(d)
+    , m_compression(0)
     , m_transfers_in()
     , m_transfers_out()
     , m_kickstarter(std::tr1::bind(&state_transfer_manager::kickstarter, this))
@@ -56,6 +69,8 @@ state_transfer_manager :: state_transfer_manager(daemon* d)
     , m_wakeup_kickstarter(&m_block_kickstarter)
     , m_wakeup_reconfigurer(&m_block_kickstarter)
     , m_need_kickstart(false)
+    , m_need_digests(false)
+    , m_throttled(false)
     , m_shutdown(true)
     , m_need_pause(false)
     , m_paused(false)
@@ -68,8 +83,10 @@ state_transfer_manager :: ~state_transfer_manager() throw ()
 }
 
 bool
-state_transfer_manager :: setup()
+state_transfer_manager :: setup(unsigned compression)
 {
+    m_compression = compression;
+
     po6::threads::mutex::hold hold(&m_block_kickstarter);
     m_kickstarter.start();
     m_shutdown = false;
@@ -108,6 +125,20 @@ setup_transfer_state(const char* desc,
                      const std::vector<hyperdex::transfer> transfers,
                      std::vector<e::intrusive_ptr<S> >* transfer_states)
 {
+    bool same = transfers.size() == transfer_states->size();
+
+    for (size_t i = 0; same && i < transfers.size(); ++i)
+    {
+        same = transfers[i].id == (*transfer_states)[i]->xfer.id;
+    }
+
+    // leave the vector be; network threads may be reading it when the
+    // daemon reconfigures without pausing them
+    if (same)
+    {
+        return;
+    }
+
     std::vector<e::intrusive_ptr<S> > tmp;
     tmp.reserve(transfers.size());
     size_t t_idx = 0;
@@ -182,7 +213,9 @@ state_transfer_manager :: reconfigure(const configuration&,
 
 void
 state_transfer_manager :: handshake_syn(const virtual_server_id& from,
-                                        const transfer_id& xid)
+                                        const transfer_id& xid,
+                                        uint8_t codecs,
+                                        uint8_t flags)
 {
     transfer_in_state* tis = get_tis(xid);
 
@@ -200,9 +233,48 @@ state_transfer_manager :: handshake_syn(const virtual_server_id& from,
         return;
     }
 
+    // the transfer replaces whatever a split or merge has yet to move into
+    // our copy; moving more in after the digest could resurrect deletes
+    m_daemon->m_data.stop_relabel(tis->xfer.rid);
+
     uint64_t timestamp = 0;
     m_daemon->m_data.largest_checkpoint_for(tis->xfer.rid, &timestamp);
-    send_handshake_synack(tis->xfer, timestamp);
+    std::vector<std::pair<region_id, region_stats> > stats;
+    m_daemon->m_data.get_region_stats(&stats);
+    bool have_objects = false;
+
+    for (size_t i = 0; i < stats.size(); ++i)
+    {
+        if (stats[i].first == tis->xfer.rid)
+        {
+            have_objects = stats[i].second.objects > 0;
+        }
+    }
+
+    // we can decompress whatever we know of, regardless of our own setting
+    tis->codecs = codecs & XFER_CODEC_LZ;
+
+    if (!have_objects)
+    {
+        send_handshake_synack(tis->xfer, timestamp, tis->codecs, XFER_DIGEST_NONE, NULL);
+    }
+    else if (!(flags & XFER_HS_WANT_DIGEST))
+    {
+        // the sender may well replay from our checkpoint, and then a digest
+        // would be wasted; it asks for one if it cannot
+        send_handshake_synack(tis->xfer, timestamp, tis->codecs, XFER_DIGEST_AVAILABLE, NULL);
+    }
+    else if (tis->digest.get())
+    {
+        send_handshake_synack(tis->xfer, timestamp, tis->codecs, XFER_DIGEST_INCLUDED, tis->digest.get());
+    }
+    else if (!tis->digest_wanted && !tis->digest_building)
+    {
+        // the kickstarter sends the syn-ack once the digest is built
+        tis->digest_wanted = true;
+        note_digest_wanted();
+    }
+
     LOG(INFO) << "received handshake_syn for " << xid;
 }
 
@@ -210,7 +282,10 @@ void
 state_transfer_manager :: handshake_synack(const server_id& from,
                                            const virtual_server_id& to,
                                            const transfer_id& xid,
-                                           uint64_t timestamp)
+                                           uint64_t timestamp,
+                                           uint8_t codecs,
+                                           uint8_t has_digest,
+                                           const merkle_tree* digest)
 {
     transfer_out_state* tos = get_tos(xid);
 
@@ -228,21 +303,57 @@ state_transfer_manager :: handshake_synack(const server_id& from,
         return;
     }
 
+    if (tos->handshake_syn)
+    {
+        // a duplicate; the streams are already going
+        send_handshake_ack(tos->xfer, tos->wipe, tos->wipe_buckets);
+        return;
+    }
+
+    if (tos->digest_building || tos->remote_digest.get())
+    {
+        // a duplicate; the kickstarter is comparing digests
+        return;
+    }
+
+    // our copy is incomplete until a split or merge finishes moving objects
+    // into it; the datalayer kickstarts us to send the handshake again
+    if (m_daemon->m_data.relabel_pending(tos->xfer.rid))
+    {
+        return;
+    }
+
+    if (has_digest == XFER_DIGEST_INCLUDED && digest)
+    {
+        tos->remote_digest.reset(new merkle_tree(*digest));
+        tos->remote_timestamp = timestamp;
+        tos->remote_codecs = codecs;
+        note_digest_wanted();
+        return;
+    }
+
+    if (has_digest == XFER_DIGEST_AVAILABLE &&
+        !m_daemon->m_data.can_replay_from_checkpoint(tos->xfer.rid, timestamp))
+    {
+        // the other end must wipe; its digest lets it keep what matches
+        tos->digest_wanted = true;
+        send_handshake_syn(tos->xfer, true);
+        return;
+    }
+
+    // without a digest, this is no more than a look at the checkpoints
     bool wipe = false;
-    std::auto_ptr<datalayer::replay_iterator> iter;
-    iter.reset(m_daemon->m_data.replay_region_from_checkpoint(tos->xfer.rid, timestamp, &wipe));
-    tos->handshake_syn = true;
-    tos->wipe = wipe;
-    tos->iter = iter;
-    send_handshake_ack(tos->xfer, tos->wipe);
-    transfer_more_state(tos);
-    LOG(INFO) << "received handshake_synack for " << xid << " @ " << timestamp;
+    std::vector<datalayer::replay_iterator*> iters;
+    std::vector<uint32_t> buckets;
+    replay(tos->xfer, timestamp, NULL, &iters, &wipe, &buckets);
+    start_streams(tos, timestamp, codecs, iters, wipe, &buckets);
 }
 
 void
 state_transfer_manager :: handshake_ack(const virtual_server_id& from,
                                         const transfer_id& xid,
-                                        bool wipe)
+                                        bool wipe,
+                                        const std::vector<uint32_t>& buckets)
 {
     transfer_in_state* tis = get_tis(xid);
 
@@ -252,22 +363,25 @@ state_transfer_manager :: handshake_ack(const virtual_server_id& from,
         return;
     }
 
-    po6::threads::mutex::hold hold(&tis->mtx);
-
-    if (tis->xfer.vsrc != from || tis->xfer.id != xid)
     {
-        LOG(INFO) << "dropping XFER_HA that came from the wrong host";
-        return;
-    }
+        po6::threads::mutex::hold hold(&tis->mtx);
 
-    if (!tis->handshake_complete)
-    {
-        tis->handshake_complete = true;
-        tis->wipe = wipe;
-        LOG(INFO) << "received handshake_ack for " << xid << (wipe ? " (and we must wipe our previous state)" : "");
+        if (tis->xfer.vsrc != from || tis->xfer.id != xid)
+        {
+            LOG(INFO) << "dropping XFER_HA that came from the wrong host";
+            return;
+        }
+
+        if (!tis->handshake_complete)
+        {
+            tis->handshake_complete = true;
+            tis->wipe = wipe;
+            tis->wipe_buckets = buckets;
+            LOG(INFO) << "received handshake_ack for " << xid << (wipe ? " (and we must wipe our previous state)" : "");
+        }
     }
 
-    put_to_disk_and_send_acks(tis);
+    flush_streams(tis);
 }
 
 void
@@ -306,21 +420,22 @@ state_transfer_manager :: report_wiped(const transfer_id& xid)
         return;
     }
 
-    po6::threads::mutex::hold hold(&tis->mtx);
-    tis->wiped = true;
-    put_to_disk_and_send_acks(tis);
+    {
+        po6::threads::mutex::hold hold(&tis->mtx);
+        tis->wiped = true;
+    }
+
+    flush_streams(tis);
     LOG(INFO) << "we've wiped our state for " << xid;
 }
 
 void
 state_transfer_manager :: xfer_op(const virtual_server_id& from,
                                   const transfer_id& xid,
-                                  uint64_t seq_no,
-                                  bool has_value,
-                                  uint64_t version,
-                                  std::auto_ptr<e::buffer> msg,
-                                  const e::slice& key,
-                                  const std::vector<e::slice>& value)
+                                  uint16_t stream,
+                                  uint32_t count,
+                                  std::auto_ptr<e::buffer> _msg,
+                                  e::unpacker up)
 {
     transfer_in_state* tis = get_tis(xid);
 
@@ -330,51 +445,95 @@ state_transfer_manager :: xfer_op(const virtual_server_id& from,
         return;
     }
 
-    po6::threads::mutex::hold hold(&tis->mtx);
-
     if (tis->xfer.vsrc != from || tis->xfer.id != xid)
     {
         LOG(INFO) << "dropping XFER_OP that came from the wrong host";
         return;
     }
 
-    if (seq_no < tis->upper_bound_acked)
+    if (stream >= tis->streams.size())
     {
-        return send_ack(tis->xfer, seq_no);
+        LOG(INFO) << "dropping XFER_OP for nonexistent stream " << stream;
+        return;
     }
 
-    std::list<e::intrusive_ptr<pending> >::iterator where_to_put_it;
+    transfer_in_stream* s = tis->streams[stream].get();
+    po6::threads::mutex::hold hold(&s->mtx);
+    std::tr1::shared_ptr<e::buffer> msg(_msg.release());
+    bool reack = false;
 
-    for (where_to_put_it = tis->queued.begin();
-            where_to_put_it != tis->queued.end(); ++where_to_put_it)
+    for (uint32_t i = 0; i < count; ++i)
     {
-        if ((*where_to_put_it)->seq_no == seq_no)
+        uint8_t flags;
+        uint64_t seq_no;
+        e::intrusive_ptr<pending> op(new pending());
+        up = up >> flags >> seq_no >> op->version >> op->key >> op->value;
+
+        if (up.error())
         {
-            // silently drop it
-            return;
+            LOG(WARNING) << "unpack of XFER_OP failed; here's some hex:  " << msg->hex();
+            break;
         }
 
-        if ((*where_to_put_it)->seq_no > seq_no)
+        if (seq_no < s->upper_bound_acked)
         {
-            break;
+            reack = true;
+            continue;
         }
+
+        // frames usually arrive in order, so search from the back
+        std::list<e::intrusive_ptr<pending> >::iterator where_to_put_it = s->queued.end();
+        bool dup = false;
+
+        while (where_to_put_it != s->queued.begin())
+        {
+            std::list<e::intrusive_ptr<pending> >::iterator prev = where_to_put_it;
+            --prev;
+
+            if ((*prev)->seq_no == seq_no)
+            {
+                dup = true;
+                break;
+            }
+
+            if ((*prev)->seq_no < seq_no)
+            {
+                break;
+            }
+
+            where_to_put_it = prev;
+        }
+
+        if (dup)
+        {
+            // silently drop it
+            continue;
+        }
+
+        op->seq_no = seq_no;
+        op->has_value = flags & 1;
+        op->msg = msg;
+        s->queued.insert(where_to_put_it, op);
     }
 
-    e::intrusive_ptr<pending> op(new pending());
-    op->seq_no = seq_no;
-    op->has_value = has_value;
-    op->version = version;
-    op->key = key;
-    op->value = value;
-    op->msg = msg;
-    tis->queued.insert(where_to_put_it, op);
-    put_to_disk_and_send_acks(tis);
+    if (reack)
+    {
+        send_ack(tis->xfer, stream, s->upper_bound_acked - 1);
+    }
+
+    bool emptied = false;
+
+    if (ready_to_apply(tis, &emptied))
+    {
+        put_to_disk_and_send_acks(tis->xfer, emptied, stream, s);
+    }
 }
 
 void
 state_transfer_manager :: xfer_ack(const server_id& from,
                                    const virtual_server_id& to,
                                    const transfer_id& xid,
+                                   uint16_t stream,
                                    uint64_t seq_no)
 {
     transfer_out_state* tos = get_tos(xid);
@@ -385,41 +544,63 @@ state_transfer_manager :: xfer_ack(const server_id& from,
         return;
     }
 
-    po6::threads::mutex::hold hold(&tos->mtx);
-
     if (tos->xfer.dst != from || tos->xfer.vsrc != to || tos->xfer.id != xid)
     {
         LOG(INFO) << "dropping XFER_ACK that came from the wrong host";
         return;
     }
 
-    std::list<e::intrusive_ptr<pending> >::iterator it;
+    std::tr1::shared_ptr<transfer_out_stream> s;
+    uint8_t codec;
 
-    for (it = tos->window.begin(); it != tos->window.end(); ++it)
     {
-        if ((*it)->seq_no == seq_no)
+        po6::threads::mutex::hold hold(&tos->mtx);
+
+        if (stream >= tos->streams.size())
         {
-            break;
+            LOG(INFO) << "dropping XFER_ACK for nonexistent stream " << stream;
+            return;
         }
+
+        s = tos->streams[stream];
+        codec = tos->codec;
     }
 
-    if (it != tos->window.end())
+    bool first_ack = false;
+    bool idle = false;
+
     {
-        (*it)->acked = true;
-        tos->handshake_ack = true;
+        po6::threads::mutex::hold hold(&s->mtx);
+        uint64_t acked_bytes = 0;
 
-        if (tos->window_sz < 1024)
+        while (!s->window.empty() && s->window.front()->seq_no <= seq_no)
         {
-            ++tos->window_sz;
+            first_ack = first_ack || !s->acked;
+            s->acked = true;
+            acked_bytes += s->window.front()->bytes;
+            s->inflight_bytes -= s->window.front()->bytes;
+            s->window.pop_front();
         }
+
+        // grow by what was acked, doubling the window each round trip
+        s->window_bytes = std::min<uint64_t>(s->window_bytes + acked_bytes, XFER_WINDOW_MAX);
+        transfer_more_state(tos->xfer, codec, s.get());
+        idle = s->idle();
     }
 
-    while (!tos->window.empty() && (*tos->window.begin())->acked)
+    // only the first ack and the last one on each stream can change the
+    // state of the transfer as a whole
+    if (first_ack || idle)
     {
-        tos->window.pop_front();
-    }
+        po6::threads::mutex::hold hold(&tos->mtx);
 
-    transfer_more_state(tos);
+        if (first_ack)
+        {
+            tos->handshake_ack = true;
+        }
+
+        maybe_go_live(tos);
+    }
 }
 
 state_transfer_manager::transfer_in_state*
@@ -450,35 +631,148 @@ state_transfer_manager :: get_tos(const transfer_id& xid)
     return NULL;
 }
 
+void
+state_transfer_manager :: replay(const transfer& xfer,
+                                 uint64_t timestamp,
+                                 merkle_tree* digest,
+                                 std::vector<datalayer::replay_iterator*>* iters,
+                                 bool* wipe,
+                                 std::vector<uint32_t>* buckets)
+{
+    std::vector<std::pair<region_id, region_stats> > stats;
+    m_daemon->m_data.get_region_stats(&stats);
+    uint64_t bytes = 0;
+
+    for (size_t i = 0; i < stats.size(); ++i)
+    {
+        if (stats[i].first == xfer.rid)
+        {
+            bytes = stats[i].second.bytes;
+        }
+    }
+
+    unsigned streams = std::min<uint64_t>(1 + bytes / XFER_STREAM_BYTES, XFER_MAX_STREAMS);
+    m_daemon->m_data.replay_region_from_checkpoint(xfer.rid, timestamp, streams, digest,
+                                                   iters, wipe, buckets);
+}
+
+void
+state_transfer_manager :: start_streams(transfer_out_state* tos,
+                                        uint64_t timestamp,
+                                        uint8_t codecs,
+                                        const std::vector<datalayer::replay_iterator*>& iters,
+                                        bool wipe,
+                                        std::vector<uint32_t>* buckets)
+{
+    for (size_t i = 0; i < iters.size(); ++i)
+    {
+        tos->streams.push_back(std::tr1::shared_ptr<transfer_out_stream>(new transfer_out_stream(i, iters[i])));
+    }
+
+    tos->handshake_syn = true;
+    tos->wipe = wipe;
+    tos->wipe_buckets.swap(*buckets);
+    tos->codec = m_compression > 0 ? (codecs & XFER_CODEC_LZ) : 0;
+    send_handshake_ack(tos->xfer, tos->wipe, tos->wipe_buckets);
+    transfer_more_state(tos);
+    LOG(INFO) << "received handshake_synack for " << tos->xfer.id << " @ " << timestamp
+              << " using " << iters.size() << " streams";
+
+    if (wipe && !tos->wipe_buckets.empty())
+    {
+        LOG(INFO) << "resending " << tos->wipe_buckets.size() << " of "
+                  << merkle_tree::BUCKETS << " buckets for " << tos->xfer.id;
+    }
+}
+
 void
 state_transfer_manager :: transfer_more_state(transfer_out_state* tos)
 {
     if (!tos->handshake_syn)
     {
-        send_handshake_syn(tos->xfer);
+        // a digest being compared is as good as a syn-ack
+        if (!tos->digest_building && !tos->remote_digest.get())
+        {
+            send_handshake_syn(tos->xfer, tos->digest_wanted);
+        }
+
         return;
     }
 
     if (!tos->handshake_ack)
     {
-        send_handshake_ack(tos->xfer, tos->wipe);
+        send_handshake_ack(tos->xfer, tos->wipe, tos->wipe_buckets);
+    }
+
+    for (size_t i = 0; i < tos->streams.size(); ++i)
+    {
+        po6::threads::mutex::hold hold(&tos->streams[i]->mtx);
+        transfer_more_state(tos->xfer, tos->codec, tos->streams[i].get());
+    }
+
+    maybe_go_live(tos);
+}
+
+void
+state_transfer_manager :: retransmit(transfer_out_state* tos)
+{
+    for (size_t i = 0; i < tos->streams.size(); ++i)
+    {
+        po6::threads::mutex::hold hold(&tos->streams[i]->mtx);
+        retransmit(tos->xfer, tos->codec, tos->streams[i].get());
+    }
+}
+
+void
+state_transfer_manager :: maybe_go_live(transfer_out_state* tos)
+{
+    if (!tos->handshake_ack)
+    {
+        // pass!  we need the other end to give us some sign that it's ready,
+        // otherwise we cannot consider moving forward, even if we're ready.
+    }
+    else if (!tos->streams_idle())
+    {
+        // pass!  the streams go live together
+    }
+    else if (m_daemon->m_config->is_transfer_live(tos->xfer.id))
+    {
+        m_daemon->m_coord.transfer_complete(tos->xfer.id);
+    }
+    else
+    {
+        m_daemon->m_coord.transfer_go_live(tos->xfer.id);
     }
+}
 
-    assert(tos->iter.get());
+void
+state_transfer_manager :: transfer_more_state(const transfer& xfer,
+                                              uint8_t codec,
+                                              transfer_out_stream* s)
+{
+    assert(s->iter.get());
+    std::vector<pending*> frame;
+    size_t frame_bytes = 0;
 
-    while (tos->window.size() < tos->window_sz && tos->iter->valid())
+    while (s->inflight_bytes < s->window_bytes && s->iter->valid())
     {
+        if (frame.empty() && !m_daemon->m_background.may_spend())
+        {
+            note_throttled();
+            break;
+        }
+
         e::intrusive_ptr<pending> op(new pending());
-        op->seq_no = tos->next_seq_no;
-        ++tos->next_seq_no;
-        op->kref.assign(reinterpret_cast<const char*>(tos->iter->key().data()), tos->iter->key().size());
+        op->seq_no = s->next_seq_no;
+        ++s->next_seq_no;
+        op->kref.assign(reinterpret_cast<const char*>(s->iter->key().data()), s->iter->key().size());
         op->key = e::slice(op->kref);
 
-        if (tos->iter->has_value())
+        if (s->iter->has_value())
         {
             op->has_value = true;
 
-            if (tos->iter->unpack_value(&op->value, &op->version, &op->vref) != datalayer::SUCCESS)
+            if (s->iter->unpack_value(&op->value, &op->version, &op->vref) != datalayer::SUCCESS)
             {
                 LOG(ERROR) << "error doing state transfer";
                 break;
@@ -490,137 +784,211 @@ state_transfer_manager :: transfer_more_state(transfer_out_state* tos)
             op->version = 0;
         }
 
-        tos->window.push_back(op);
-        send_object(tos->xfer, op.get());
-        tos->iter->next();
-    }
+        op->bytes = object_size(op.get());
+        s->window.push_back(op);
+        s->inflight_bytes += op->bytes;
+        frame.push_back(op.get());
+        frame_bytes += op->bytes;
 
-    if (!tos->handshake_ack)
-    {
-        // pass!  we need the other end to give us some sign that it's ready,
-        // otherwise we cannot consider moving forward, even if we're ready.
-    }
-    else if (tos->window.empty() && m_daemon->m_config.is_transfer_live(tos->xfer.id))
-    {
-        m_daemon->m_coord.transfer_complete(tos->xfer.id);
+        if (frame_bytes >= XFER_FRAME_BYTES)
+        {
+            send_objects(xfer, codec, s->id, frame);
+            m_daemon->m_background.spend(frame_bytes);
+            frame.clear();
+            frame_bytes = 0;
+        }
+
+        s->iter->next();
     }
-    else if (tos->window.empty())
+
+    if (!frame.empty())
     {
-        m_daemon->m_coord.transfer_go_live(tos->xfer.id);
+        send_objects(xfer, codec, s->id, frame);
+        m_daemon->m_background.spend(frame_bytes);
     }
 }
 
 void
-state_transfer_manager :: retransmit(transfer_out_state* tos)
+state_transfer_manager :: retransmit(const transfer& xfer,
+                                     uint8_t codec,
+                                     transfer_out_stream* s)
 {
-    for (std::list<e::intrusive_ptr<pending> >::iterator it = tos->window.begin();
-            it != tos->window.end(); ++it)
+    std::vector<pending*> frame;
+    size_t frame_bytes = 0;
+
+    for (std::list<e::intrusive_ptr<pending> >::iterator it = s->window.begin();
+            it != s->window.end(); ++it)
     {
-        send_object(tos->xfer, it->get());
+        frame.push_back(it->get());
+        frame_bytes += (*it)->bytes;
+
+        if (frame_bytes >= XFER_FRAME_BYTES)
+        {
+            send_objects(xfer, codec, s->id, frame);
+            frame.clear();
+            frame_bytes = 0;
+        }
+    }
+
+    if (!frame.empty())
+    {
+        send_objects(xfer, codec, s->id, frame);
     }
 }
 
-void
-state_transfer_manager :: put_to_disk_and_send_acks(transfer_in_state* tis)
+bool
+state_transfer_manager :: ready_to_apply(transfer_in_state* tis, bool* emptied)
 {
+    po6::threads::mutex::hold hold(&tis->mtx);
+    *emptied = tis->wipe && tis->wipe_buckets.empty();
+
     if (!tis->handshake_complete)
     {
-        return;
+        return false;
     }
 
     if (tis->wipe && !tis->wiped)
     {
-        m_daemon->m_data.request_wipe(tis->xfer.id, tis->xfer.rid);
-        return;
+        m_daemon->m_data.request_wipe(tis->xfer.id, tis->xfer.rid, tis->wipe_buckets);
+        return false;
     }
 
-    if (tis->queued.empty())
+    return true;
+}
+
+void
+state_transfer_manager :: flush_streams(transfer_in_state* tis)
+{
+    bool emptied = false;
+
+    for (size_t i = 0; i < tis->streams.size(); ++i)
     {
-        send_handshake_wiped(tis->xfer);
+        po6::threads::mutex::hold hold(&tis->streams[i]->mtx);
+
+        if (!ready_to_apply(tis, &emptied))
+        {
+            return;
+        }
+
+        put_to_disk_and_send_acks(tis->xfer, emptied, i, tis->streams[i].get());
     }
 
-    while (!tis->queued.empty() &&
-           tis->queued.front()->seq_no == tis->upper_bound_acked)
+    // tell the sender we're ready, in case it has nothing to send us
+    send_handshake_wiped(tis->xfer);
+}
+
+void
+state_transfer_manager :: put_to_disk_and_send_acks(const transfer& xfer,
+                                                    bool emptied,
+                                                    uint16_t id,
+                                                    transfer_in_stream* s)
+{
+    // once live, chain operations write the region too
+    if (s->fresh && (!emptied || m_daemon->m_config->is_transfer_live(xfer.id)))
     {
-        e::intrusive_ptr<pending> op = tis->queued.front();
+        s->fresh = false;
+    }
 
-        if (op->has_value)
-        {
-            datalayer::returncode rc = m_daemon->m_data.uncertain_put(tis->xfer.rid, op->key, op->value, op->version);
+    // write the run of objects that are next in sequence all at once
+    std::vector<datalayer::transfer_object> objs;
+    std::list<e::intrusive_ptr<pending> >::iterator it = s->queued.begin();
 
-            switch (rc)
-            {
-                case datalayer::SUCCESS:
-                    break;
-                case datalayer::NOT_FOUND:
-                case datalayer::BAD_ENCODING:
-                case datalayer::CORRUPTION:
-                case datalayer::IO_ERROR:
-                case datalayer::LEVELDB_ERROR:
-                    LOG(ERROR) << "state transfer caused error " << rc;
-                    break;
-                default:
-                    LOG(ERROR) << "state transfer caused unknown error";
-                    break;
-            }
-        }
-        else
-        {
-            datalayer::returncode rc = m_daemon->m_data.uncertain_del(tis->xfer.rid, op->key);
+    while (it != s->queued.end() &&
+           (*it)->seq_no == s->upper_bound_acked + objs.size())
+    {
+        objs.push_back(datalayer::transfer_object());
+        objs.back().key = (*it)->key;
+        objs.back().has_value = (*it)->has_value;
+        objs.back().value = &(*it)->value;
+        objs.back().version = (*it)->version;
+        ++it;
+    }
 
-            switch (rc)
-            {
-                case datalayer::SUCCESS:
-                case datalayer::NOT_FOUND:
-                    break;
-                case datalayer::BAD_ENCODING:
-                case datalayer::CORRUPTION:
-                case datalayer::IO_ERROR:
-                case datalayer::LEVELDB_ERROR:
-                    LOG(ERROR) << "state transfer caused error " << rc;
-                    break;
-                default:
-                    LOG(ERROR) << "state transfer caused unknown error";
-                    break;
-            }
-        }
+    if (objs.empty())
+    {
+        return;
+    }
 
-        send_ack(tis->xfer, op->seq_no);
-        tis->upper_bound_acked = std::max(tis->upper_bound_acked, op->seq_no + 1);
-        tis->queued.pop_front();
+    datalayer::returncode rc;
+    rc = m_daemon->m_data.apply_transfer(xfer.rid, objs,
+                                         s->fresh ? &s->written_max : NULL);
+
+    switch (rc)
+    {
+        case datalayer::SUCCESS:
+            break;
+        case datalayer::NOT_FOUND:
+        case datalayer::BAD_ENCODING:
+        case datalayer::CORRUPTION:
+        case datalayer::IO_ERROR:
+        case datalayer::LEVELDB_ERROR:
+            LOG(ERROR) << "state transfer caused error " << rc;
+            break;
+        default:
+            LOG(ERROR) << "state transfer caused unknown error";
+            break;
     }
+
+    s->upper_bound_acked += objs.size();
+    s->queued.erase(s->queued.begin(), it);
+    send_ack(xfer, id, s->upper_bound_acked - 1);
 }
 
 void
-state_transfer_manager :: send_handshake_syn(const transfer& xfer)
+state_transfer_manager :: send_handshake_syn(const transfer& xfer, bool want_digest)
 {
+    uint8_t codecs = m_compression > 0 ? XFER_CODEC_LZ : 0;
+    uint8_t flags = want_digest ? XFER_HS_WANT_DIGEST : 0;
     size_t sz = HYPERDEX_HEADER_SIZE_VV
-              + sizeof(uint64_t);
+              + sizeof(uint64_t)
+              + sizeof(uint8_t)
+              + sizeof(uint8_t);
     std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << xfer.id;
+    msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << xfer.id << codecs << flags;
     m_daemon->m_comm.send_exact(xfer.vsrc, xfer.vdst, XFER_HS, msg);
 }
 
 void
-state_transfer_manager :: send_handshake_synack(const transfer& xfer, uint64_t timestamp)
+state_transfer_manager :: send_handshake_synack(const transfer& xfer, uint64_t timestamp, uint8_t codecs,
+                                                uint8_t has_digest, const merkle_tree* digest)
 {
+    assert((has_digest == XFER_DIGEST_INCLUDED) == (digest != NULL));
     size_t sz = HYPERDEX_HEADER_SIZE_VV
               + sizeof(uint64_t)
-              + sizeof(uint64_t);
+              + sizeof(uint64_t)
+              + sizeof(uint8_t)
+              + sizeof(uint8_t)
+              + (digest ? pack_size(*digest) : 0);
     std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << xfer.id << timestamp;
+    e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VV);
+    pa = pa << xfer.id << timestamp << codecs << has_digest;
+
+    if (digest)
+    {
+        pa = pa << *digest;
+    }
+
     m_daemon->m_comm.send_exact(xfer.vdst, xfer.vsrc, XFER_HSA, msg);
 }
 
 void
-state_transfer_manager :: send_handshake_ack(const transfer& xfer, bool wipe)
+state_transfer_manager :: send_handshake_ack(const transfer& xfer, bool wipe,
+                                             const std::vector<uint32_t>& buckets)
 {
-    uint8_t flags = wipe ? 0x1 : 0;
+    uint8_t flags = (wipe ? 0x1 : 0) | (buckets.empty() ? 0 : 0x2);
     size_t sz = HYPERDEX_HEADER_SIZE_VV
               + sizeof(uint64_t)
-              + sizeof(uint8_t);
+              + sizeof(uint8_t)
+              + (buckets.empty() ? 0 : sizeof(uint32_t) + buckets.size() * sizeof(uint32_t));
     std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << xfer.id << flags;
+    e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VV);
+    pa = pa << xfer.id << flags;
+
+    if (!buckets.empty())
+    {
+        pa = pa << buckets;
+    }
+
     m_daemon->m_comm.send_exact(xfer.vsrc, xfer.vdst, XFER_HA, msg);
 }
 
@@ -634,37 +1002,169 @@ state_transfer_manager :: send_handshake_wiped(const transfer& xfer)
     m_daemon->m_comm.send_exact(xfer.vdst, xfer.vsrc, XFER_HW, msg);
 }
 
+size_t
+state_transfer_manager :: object_size(pending* op)
+{
+    return sizeof(uint8_t)
+         + sizeof(uint64_t)
+         + sizeof(uint64_t)
+         + sizeof(uint32_t) + op->key.size()
+         + pack_size(op->value);
+}
+
 void
-state_transfer_manager :: send_object(const transfer& xfer,
-                                      pending* op)
+state_transfer_manager :: send_objects(const transfer& xfer,
+                                       uint8_t accepted,
+                                       uint16_t stream,
+                                       const std::vector<pending*>& ops)
 {
-    uint8_t flags = (op->has_value ? 1 : 0);
-    size_t sz = HYPERDEX_HEADER_SIZE_VV
-              + sizeof(uint8_t)
-              + sizeof(uint64_t)
-              + sizeof(uint64_t)
-              + sizeof(uint64_t)
-              + sizeof(uint32_t) + op->key.size()
-              + pack_size(op->value);
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << flags << xfer.id.get() << op->seq_no
-                                          << op->version << op->key << op->value;
+    // the frame's body is everything after its xid, codec and stream; it is
+    // what gets compressed
+    const size_t body_off = HYPERDEX_HEADER_SIZE_VV
+                          + sizeof(uint64_t)
+                          + sizeof(uint8_t)
+                          + sizeof(uint16_t);
+    size_t body_sz = sizeof(uint32_t);
+
+    for (size_t i = 0; i < ops.size(); ++i)
+    {
+        body_sz += ops[i]->bytes;
+    }
+
+    uint8_t codec = 0;
+    std::auto_ptr<e::buffer> msg(e::buffer::create(body_off + body_sz));
+    e::buffer::packer pa = msg->pack_at(HYPERDEX_HEADER_SIZE_VV);
+    pa = pa << xfer.id.get() << codec << stream << static_cast<uint32_t>(ops.size());
+
+    for (size_t i = 0; i < ops.size(); ++i)
+    {
+        uint8_t flags = (ops[i]->has_value ? 1 : 0);
+        pa = pa << flags << ops[i]->seq_no << ops[i]->version
+                << ops[i]->key << ops[i]->value;
+    }
+
+    if ((accepted & XFER_CODEC_LZ) && body_sz <= XFER_MAX_FRAME_BYTES)
+    {
+        codec = XFER_CODEC_LZ;
+        std::auto_ptr<e::buffer> z(e::buffer::create(body_off + sizeof(uint32_t) + lz_compress_bound(body_sz)));
+        size_t z_sz = lz_compress(msg->data() + body_off, body_sz, m_compression,
+                                  z->data() + body_off + sizeof(uint32_t));
+
+        // send whichever is smaller
+        if (sizeof(uint32_t) + z_sz < body_sz)
+        {
+            z->pack_at(HYPERDEX_HEADER_SIZE_VV) << xfer.id.get() << codec << stream
+                                                << static_cast<uint32_t>(body_sz);
+            z->resize(body_off + sizeof(uint32_t) + z_sz);
+            msg = z;
+        }
+    }
+
     m_daemon->m_comm.send_exact(xfer.vsrc, xfer.vdst, XFER_OP, msg);
 }
 
 void
-state_transfer_manager :: send_ack(const transfer& xfer, uint64_t seq_no)
+state_transfer_manager :: send_ack(const transfer& xfer, uint16_t stream, uint64_t seq_no)
 {
     uint8_t flags = 0;
     size_t sz = HYPERDEX_HEADER_SIZE_VV
               + sizeof(uint8_t)
               + sizeof(uint64_t)
+              + sizeof(uint16_t)
               + sizeof(uint64_t);
     std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << flags << xfer.id.get() << seq_no;
+    msg->pack_at(HYPERDEX_HEADER_SIZE_VV) << flags << xfer.id.get() << stream << seq_no;
     m_daemon->m_comm.send_exact(xfer.vdst, xfer.vsrc, XFER_ACK, msg);
 }
 
+void
+state_transfer_manager :: kickstart()
+{
+    po6::threads::mutex::hold hold(&m_block_kickstarter);
+    m_need_kickstart = true;
+    m_wakeup_kickstarter.broadcast();
+}
+
+void
+state_transfer_manager :: note_throttled()
+{
+    po6::threads::mutex::hold hold(&m_block_kickstarter);
+    m_throttled = true;
+    m_wakeup_kickstarter.broadcast();
+}
+
+void
+state_transfer_manager :: note_digest_wanted()
+{
+    po6::threads::mutex::hold hold(&m_block_kickstarter);
+    m_need_digests = true;
+    m_wakeup_kickstarter.broadcast();
+}
+
+void
+state_transfer_manager :: build_digests()
+{
+    // Each transfer's lock is dropped while its region is walked, so the
+    // network threads handling its retransmitted handshakes do not wait on
+    // the walk; "digest_building" tells them one is under way.
+    for (size_t idx = 0; idx < m_transfers_in.size(); ++idx)
+    {
+        transfer_in_state* tis = m_transfers_in[idx].get();
+
+        {
+            po6::threads::mutex::hold hold(&tis->mtx);
+
+            if (!tis->digest_wanted || tis->digest_building)
+            {
+                continue;
+            }
+
+            tis->digest_wanted = false;
+            tis->digest_building = true;
+        }
+
+        std::auto_ptr<merkle_tree> digest(new merkle_tree());
+        m_daemon->m_data.region_digest(tis->xfer.rid, digest.get());
+        uint64_t timestamp = 0;
+        m_daemon->m_data.largest_checkpoint_for(tis->xfer.rid, &timestamp);
+        po6::threads::mutex::hold hold(&tis->mtx);
+        tis->digest_building = false;
+        tis->digest = digest;
+        send_handshake_synack(tis->xfer, timestamp, tis->codecs, XFER_DIGEST_INCLUDED, tis->digest.get());
+        LOG(INFO) << "sent a digest of our copy for " << tis->xfer.id;
+    }
+
+    for (size_t idx = 0; idx < m_transfers_out.size(); ++idx)
+    {
+        transfer_out_state* tos = m_transfers_out[idx].get();
+        std::auto_ptr<merkle_tree> remote;
+        uint64_t timestamp;
+        uint8_t codecs;
+
+        {
+            po6::threads::mutex::hold hold(&tos->mtx);
+
+            if (!tos->remote_digest.get() || tos->handshake_syn)
+            {
+                continue;
+            }
+
+            remote = tos->remote_digest;
+            timestamp = tos->remote_timestamp;
+            codecs = tos->remote_codecs;
+            tos->digest_building = true;
+        }
+
+        bool wipe = false;
+        std::vector<datalayer::replay_iterator*> iters;
+        std::vector<uint32_t> buckets;
+        replay(tos->xfer, timestamp, remote.get(), &iters, &wipe, &buckets);
+        po6::threads::mutex::hold hold(&tos->mtx);
+        tos->digest_building = false;
+        start_streams(tos, timestamp, codecs, iters, wipe, &buckets);
+    }
+}
+
 void
 state_transfer_manager :: kickstarter()
 {
@@ -685,10 +1185,14 @@ state_transfer_manager :: kickstarter()
 
     while (true)
     {
+        bool kickstart = false;
+        bool throttled = false;
+        bool digests = false;
+
         {
             po6::threads::mutex::hold hold(&m_block_kickstarter);
 
-            while ((!m_need_kickstart && !m_shutdown) || m_need_pause)
+            while ((!m_need_kickstart && !m_need_digests && !m_throttled && !m_shutdown) || m_need_pause)
             {
                 m_paused = true;
 
@@ -706,24 +1210,54 @@ state_transfer_manager :: kickstarter()
                 break;
             }
 
+            kickstart = m_need_kickstart;
             m_need_kickstart = false;
+            throttled = m_throttled;
+            m_throttled = false;
+            digests = m_need_digests;
+            m_need_digests = false;
         }
 
-        size_t idx = 0;
+        // reconfiguration changes the transfers only while this thread is
+        // paused; see below
+        if (digests)
+        {
+            build_digests();
+        }
 
-        while (true)
+        if (!kickstart && !throttled)
         {
-            po6::threads::mutex::hold hold(&m_block_kickstarter);
+            continue;
+        }
+
+        if (!kickstart)
+        {
+            // throttled; wait until the rate limit lets us send again
+            uint64_t delay = m_daemon->m_background.delay();
+            timespec ts;
+            ts.tv_sec = 0;
+            ts.tv_nsec = std::min<uint64_t>(delay, 10000000ULL);
+            nanosleep(&ts, NULL);
+        }
+
+        // reconfiguration changes m_transfers_out only while this thread is
+        // paused, so the transfers may be walked without m_block_kickstarter,
+        // leaving the network threads free to call note_throttled while
+        // holding a transfer's lock
+        for (size_t idx = 0; idx < m_transfers_out.size(); ++idx)
+        {
+            transfer_out_state* tos = m_transfers_out[idx].get();
+            po6::threads::mutex::hold hold(&tos->mtx);
 
-            if (idx >= m_transfers_out.size())
+            if (kickstart)
             {
-                break;
+                retransmit(tos);
+                transfer_more_state(tos);
+            }
+            else if (tos->handshake_syn)
+            {
+                transfer_more_state(tos);
             }
-
-            po6::threads::mutex::hold hold2(&m_transfers_out[idx]->mtx);
-            retransmit(m_transfers_out[idx].get());
-            transfer_more_state(m_transfers_out[idx].get());
-            ++idx;
         }
     }
 
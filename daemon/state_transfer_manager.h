@@ -37,15 +37,33 @@
 #include <po6/threads/thread.h>
 
 // e
+#include <e/buffer.h>
 #include <e/intrusive_ptr.h>
 
 // HyperDex
 #include "namespace.h"
 #include "common/configuration.h"
+#include "daemon/datalayer.h"
 #include "daemon/reconfigure_returncode.h"
 
+// codecs an XFER_OP frame may be compressed with, offered in XFER_HS and
+// accepted in XFER_HSA
+#define XFER_CODEC_LZ 0x1
+// set in XFER_HS once the sender knows it cannot replay from the receiver's
+// checkpoint and wants a digest of the receiver's copy
+#define XFER_HS_WANT_DIGEST 0x1
+// what XFER_HSA says of a digest of the receiver's copy
+#define XFER_DIGEST_NONE 0 // the copy is empty; there is nothing to save
+#define XFER_DIGEST_INCLUDED 1
+#define XFER_DIGEST_AVAILABLE 2 // sent if the sender asks for it
+// frames that would decompress to more than this are sent uncompressed
+#define XFER_MAX_FRAME_BYTES (64U * 1024U * 1024U)
+// a transfer is split into at most this many streams
+#define XFER_MAX_STREAMS 8
+
 BEGIN_HYPERDEX_NAMESPACE
 class daemon;
+class merkle_tree;
 
 class state_transfer_manager
 {
@@ -55,7 +73,8 @@ class state_transfer_manager
 
     // Reconfigure this layer.
     public:
-        bool setup();
+        // "compression" is the lz_compress level for outgoing transfers, or 0
+        bool setup(unsigned compression);
         void teardown();
         void pause();
         void unpause();
@@ -64,54 +83,95 @@ class state_transfer_manager
                          const server_id& us);
 
     public:
+        // "flags" are XFER_HS_*
         void handshake_syn(const virtual_server_id& from,
-                           const transfer_id& xid);
+                           const transfer_id& xid,
+                           uint8_t codecs,
+                           uint8_t flags);
+        // "has_digest" is an XFER_DIGEST_*; "digest" summarizes the other
+        // end's copy of the region if it is XFER_DIGEST_INCLUDED
         void handshake_synack(const server_id& from,
                               const virtual_server_id& to,
                               const transfer_id& xid,
-                              uint64_t timestamp);
+                              uint64_t timestamp,
+                              uint8_t codecs,
+                              uint8_t has_digest,
+                              const merkle_tree* digest);
+        // if "wipe" is set and "buckets" is not empty, wipe just the buckets
         void handshake_ack(const virtual_server_id& from,
                            const transfer_id& xid,
-                           bool wipe);
+                           bool wipe,
+                           const std::vector<uint32_t>& buckets);
         void handshake_wiped(const server_id& from,
                              const virtual_server_id& to,
                              const transfer_id& xid);
         void report_wiped(const transfer_id& xid);
+        // resend the handshakes the datalayer held back; see handshake_synack
+        void kickstart();
+        // "up" holds the frame's "count" objects
         void xfer_op(const virtual_server_id& from,
                      const transfer_id& xid,
-                     uint64_t seq_no,
-                     bool has_value,
-                     uint64_t version,
+                     uint16_t stream,
+                     uint32_t count,
                      std::auto_ptr<e::buffer> msg,
-                     const e::slice& key,
-                     const std::vector<e::slice>& value);
+                     e::unpacker up);
+        // acknowledges every object on the stream up to and including seq_no
         void xfer_ack(const server_id& from,
                       const virtual_server_id& to,
                       const transfer_id& xid,
+                      uint16_t stream,
                       uint64_t seq_no);
 
     private:
         class pending;
         class transfer_in_state;
+        class transfer_in_stream;
         class transfer_out_state;
+        class transfer_out_stream;
 
     private:
         // get the appropriate state
         transfer_in_state* get_tis(const transfer_id& xid);
         transfer_out_state* get_tos(const transfer_id& xid);
+        // replay the transfer's region; see datalayer::replay_region_from_checkpoint
+        void replay(const transfer& xfer, uint64_t timestamp, merkle_tree* digest,
+                    std::vector<datalayer::replay_iterator*>* iters,
+                    bool* wipe, std::vector<uint32_t>* buckets);
         // caller must hold mtx on tos
+        void start_streams(transfer_out_state* tos, uint64_t timestamp, uint8_t codecs,
+                           const std::vector<datalayer::replay_iterator*>& iters,
+                           bool wipe, std::vector<uint32_t>* buckets);
         void transfer_more_state(transfer_out_state* tos);
         void retransmit(transfer_out_state* tos);
-        // caller must hold mtx on tis
-        void put_to_disk_and_send_acks(transfer_in_state* tis);
-        // caller must hold mtx on tos
-        // send the last object in tos
-        void send_handshake_syn(const transfer& xfer);
-        void send_handshake_synack(const transfer& xfer, uint64_t timestamp);
-        void send_handshake_ack(const transfer& xfer, bool wipe);
+        void maybe_go_live(transfer_out_state* tos);
+        // caller must hold mtx on the stream
+        void transfer_more_state(const transfer& xfer, uint8_t codec, transfer_out_stream* s);
+        void retransmit(const transfer& xfer, uint8_t codec, transfer_out_stream* s);
+        // may the incoming transfer write to disk yet?  "emptied" says if the
+        // region was wiped whole; caller must not hold mtx on tis
+        bool ready_to_apply(transfer_in_state* tis, bool* emptied);
+        void flush_streams(transfer_in_state* tis);
+        // caller must hold mtx on the stream
+        void put_to_disk_and_send_acks(const transfer& xfer, bool emptied,
+                                       uint16_t id, transfer_in_stream* s);
+        void send_handshake_syn(const transfer& xfer, bool want_digest);
+        void send_handshake_synack(const transfer& xfer, uint64_t timestamp, uint8_t codecs,
+                                   uint8_t has_digest, const merkle_tree* digest);
+        void send_handshake_ack(const transfer& xfer, bool wipe,
+                                const std::vector<uint32_t>& buckets);
         void send_handshake_wiped(const transfer& xfer);
-        void send_object(const transfer& xfer, pending* op);
-        void send_ack(const transfer& xfer, uint64_t seq_id);
+        static size_t object_size(pending* op);
+        void send_objects(const transfer& xfer, uint8_t accepted, uint16_t stream,
+                          const std::vector<pending*>& ops);
+        void send_ack(const transfer& xfer, uint16_t stream, uint64_t seq_id);
+        // have the kickstarter resume transfers once the rate limit allows
+        void note_throttled();
+        // have the kickstarter compute the digests handshakes wait on
+        void note_digest_wanted();
+        // walking a region is too slow for a network thread, so digests of
+        // incoming transfers' regions, and the trees outgoing transfers
+        // compare them to, are built by the kickstarter
+        void build_digests();
         void kickstarter();
         void shutdown();
 
@@ -121,6 +181,7 @@ class state_transfer_manager
 
     private:
         daemon* m_daemon;
+        unsigned m_compression;
         std::vector<e::intrusive_ptr<transfer_in_state> > m_transfers_in;
         std::vector<e::intrusive_ptr<transfer_out_state> > m_transfers_out;
         po6::threads::thread m_kickstarter;
@@ -128,6 +189,8 @@ class state_transfer_manager
         po6::threads::cond m_wakeup_kickstarter;
         po6::threads::cond m_wakeup_reconfigurer;
         bool m_need_kickstart;
+        bool m_need_digests;
+        bool m_throttled;
         bool m_shutdown;
         bool m_need_pause;
         bool m_paused;
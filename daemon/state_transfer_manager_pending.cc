@@ -36,8 +36,8 @@ state_transfer_manager :: state_transfer_manager :: pending :: pending()
     , version(0)
     , key()
     , value()
-    , acked(false)
     , msg()
+    , bytes(0)
     , kref()
     , vref()
     , m_ref(0)
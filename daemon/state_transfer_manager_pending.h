@@ -28,6 +28,9 @@
 #ifndef hyperdex_daemon_state_transfer_manager_pending_h_
 #define hyperdex_daemon_state_transfer_manager_pending_h_
 
+// STL
+#include <tr1/memory>
+
 // HyperDex
 #include "daemon/datalayer.h"
 #include "daemon/state_transfer_manager.h"
@@ -44,8 +47,10 @@ class hyperdex::state_transfer_manager::pending
         uint64_t version;
         e::slice key;
         std::vector<e::slice> value;
-        bool acked;
-        std::auto_ptr<e::buffer> msg;
+        // incoming objects share the frame they arrived in
+        std::tr1::shared_ptr<e::buffer> msg;
+        // packed size of the object; counted against the window
+        size_t bytes;
         std::string kref;
         datalayer::reference vref;
 
@@ -36,15 +36,36 @@ using hyperdex::state_transfer_manager;
 state_transfer_manager :: transfer_in_state :: transfer_in_state(const transfer& _xfer)
     : xfer(_xfer)
     , mtx()
-    , upper_bound_acked(1)
-    , queued()
     , handshake_complete(false)
     , wipe(false)
+    , wipe_buckets()
     , wiped(false)
+    , codecs(0)
+    , digest_wanted(false)
+    , digest_building(false)
+    , digest()
+    , streams()
     , m_ref(0)
 {
+    for (size_t i = 0; i < XFER_MAX_STREAMS; ++i)
+    {
+        streams.push_back(std::tr1::shared_ptr<transfer_in_stream>(new transfer_in_stream()));
+    }
 }
 
 state_transfer_manager :: transfer_in_state :: ~transfer_in_state() throw ()
 {
 }
+
+state_transfer_manager :: transfer_in_stream :: transfer_in_stream()
+    : mtx()
+    , upper_bound_acked(1)
+    , queued()
+    , fresh(true)
+    , written_max()
+{
+}
+
+state_transfer_manager :: transfer_in_stream :: ~transfer_in_stream() throw ()
+{
+}
@@ -29,12 +29,17 @@
 #define hyperdex_daemon_state_transfer_manager_transfer_in_state_h_
 
 // STL
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
 #include <tr1/memory>
 
 // e
 #include <e/intrusive_ptr.h>
 
 // HyperDex
+#include "daemon/merkle_tree.h"
 #include "daemon/state_transfer_manager.h"
 
 class hyperdex::state_transfer_manager::transfer_in_state
@@ -45,12 +50,20 @@ class hyperdex::state_transfer_manager::transfer_in_state
 
     public:
         transfer xfer;
-        po6::threads::mutex mtx;
-        uint64_t upper_bound_acked;
-        std::list<e::intrusive_ptr<pending> > queued;
+        po6::threads::mutex mtx; // protects all but the streams' contents
         bool handshake_complete;
         bool wipe;
+        std::vector<uint32_t> wipe_buckets; // if empty, wipe it all
         bool wiped;
+        uint8_t codecs; // XFER_CODEC_* the sender offered
+        // the sender asked for a digest that has yet to be built; once built
+        // it is kept for retransmitted handshakes
+        bool digest_wanted;
+        bool digest_building;
+        std::auto_ptr<merkle_tree> digest;
+        // objects may arrive before the handshake says how many streams the
+        // sender uses, so every stream the sender may use exists up front
+        std::vector<std::tr1::shared_ptr<transfer_in_stream> > streams;
 
     private:
         friend class e::intrusive_ptr<transfer_in_state>;
@@ -63,4 +76,26 @@ class hyperdex::state_transfer_manager::transfer_in_state
         size_t m_ref;
 };
 
+class hyperdex::state_transfer_manager::transfer_in_stream
+{
+    public:
+        transfer_in_stream();
+        ~transfer_in_stream() throw ();
+
+    public:
+        po6::threads::mutex mtx;
+        uint64_t upper_bound_acked;
+        std::list<e::intrusive_ptr<pending> > queued;
+        // After a whole wipe and until the transfer goes live, nothing but this
+        // transfer writes the region, and the sender replays each stream in
+        // key order, so keys above the largest one the stream has written
+        // need not be read back before writing them.
+        bool fresh;
+        std::string written_max;
+
+    private:
+        transfer_in_stream(const transfer_in_stream&);
+        transfer_in_stream& operator = (const transfer_in_stream&);
+};
+
 #endif // hyperdex_daemon_state_transfer_manager_transfer_in_state_h_
@@ -32,16 +32,23 @@
 
 using hyperdex::state_transfer_manager;
 
+// the window starts here and doubles every round trip
+#define XFER_WINDOW_INITIAL (1ULL << 20)
+
 state_transfer_manager :: transfer_out_state :: transfer_out_state(const transfer& _xfer)
     : xfer(_xfer)
     , mtx()
-    , next_seq_no(1)
-    , window()
-    , window_sz(1)
-    , iter()
     , handshake_syn(false)
     , handshake_ack(false)
     , wipe(false)
+    , wipe_buckets()
+    , codec(0)
+    , digest_wanted(false)
+    , digest_building(false)
+    , remote_digest()
+    , remote_timestamp(0)
+    , remote_codecs(0)
+    , streams()
     , m_ref(0)
 {
 }
@@ -49,3 +56,42 @@ state_transfer_manager :: transfer_out_state :: transfer_out_state(const transfe
 state_transfer_manager :: transfer_out_state :: ~transfer_out_state() throw ()
 {
 }
+
+bool
+state_transfer_manager :: transfer_out_state :: streams_idle()
+{
+    for (size_t i = 0; i < streams.size(); ++i)
+    {
+        po6::threads::mutex::hold hold(&streams[i]->mtx);
+
+        if (!streams[i]->idle())
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+state_transfer_manager :: transfer_out_stream :: transfer_out_stream(uint16_t _id,
+                                                            datalayer::replay_iterator* _iter)
+    : id(_id)
+    , mtx()
+    , next_seq_no(1)
+    , window()
+    , window_bytes(XFER_WINDOW_INITIAL)
+    , inflight_bytes(0)
+    , iter(_iter)
+    , acked(false)
+{
+}
+
+state_transfer_manager :: transfer_out_stream :: ~transfer_out_stream() throw ()
+{
+}
+
+bool
+state_transfer_manager :: transfer_out_stream :: idle()
+{
+    return window.empty() && !iter->valid();
+}
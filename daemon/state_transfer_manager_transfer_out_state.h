@@ -30,6 +30,8 @@
 
 // STL
 #include <list>
+#include <memory>
+#include <vector>
 #include <tr1/memory>
 
 // po6
@@ -40,6 +42,7 @@
 
 // HyperDex
 #include "daemon/datalayer.h"
+#include "daemon/merkle_tree.h"
 #include "daemon/state_transfer_manager.h"
 
 using hyperdex::state_transfer_manager;
@@ -50,16 +53,28 @@ class state_transfer_manager::transfer_out_state
         transfer_out_state(const transfer& xfer);
         ~transfer_out_state() throw ();
 
+    public:
+        // true if every stream has sent all it has and had it acked
+        bool streams_idle();
+
     public:
         transfer xfer;
-        po6::threads::mutex mtx;
-        uint64_t next_seq_no;
-        std::list<e::intrusive_ptr<pending> > window;
-        size_t window_sz;
-        std::auto_ptr<datalayer::replay_iterator> iter;
+        po6::threads::mutex mtx; // protects all but the streams' contents
         bool handshake_syn; // do we know the other end got a syn?
         bool handshake_ack; // do we know the other end got a ack?
         bool wipe;
+        std::vector<uint32_t> wipe_buckets; // if empty, wipe it all
+        uint8_t codec; // XFER_CODEC_* the other end accepted, or 0
+        // we cannot replay from the other end's checkpoint and asked it for a
+        // digest; once it arrives, the kickstarter compares it to our copy
+        // and starts the streams
+        bool digest_wanted;
+        bool digest_building;
+        std::auto_ptr<merkle_tree> remote_digest;
+        uint64_t remote_timestamp;
+        uint8_t remote_codecs;
+        // set once when the syn-ack arrives; never resized afterwards
+        std::vector<std::tr1::shared_ptr<transfer_out_stream> > streams;
 
     private:
         friend class e::intrusive_ptr<transfer_out_state>;
@@ -76,4 +91,32 @@ class state_transfer_manager::transfer_out_state
         transfer_out_state& operator = (const transfer_out_state&);
 };
 
+// One of the independent streams a transfer is split into.  Each has its own
+// replay iterator, sequence numbers and window, so acks for one stream never
+// wait on another.
+class state_transfer_manager::transfer_out_stream
+{
+    public:
+        transfer_out_stream(uint16_t id, datalayer::replay_iterator* iter);
+        ~transfer_out_stream() throw ();
+
+    public:
+        bool idle();
+
+    public:
+        const uint16_t id;
+        po6::threads::mutex mtx;
+        uint64_t next_seq_no;
+        std::list<e::intrusive_ptr<pending> > window;
+        // bytes of unacked objects we may have outstanding, and have
+        uint64_t window_bytes;
+        uint64_t inflight_bytes;
+        std::auto_ptr<datalayer::replay_iterator> iter;
+        bool acked; // has the other end acked anything on this stream?
+
+    private:
+        transfer_out_stream(const transfer_out_stream&);
+        transfer_out_stream& operator = (const transfer_out_stream&);
+};
+
 #endif // hyperdex_daemon_state_transfer_manager_transfer_out_state_h_
@@ -0,0 +1,92 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <stdint.h>
+
+// STL
+#include <vector>
+
+// HyperDex
+#include "test/th.h"
+#include "daemon/acked_window.h"
+
+using hyperdex::acked_window;
+
+TEST(AckedWindow, Test)
+{
+    acked_window aw;
+    uint64_t seq_id = 0;
+    std::vector<uint64_t> cleared;
+    // nothing acked
+    ASSERT_TRUE(aw.empty());
+    ASSERT_FALSE(aw.contains(0));
+    ASSERT_FALSE(aw.contains(5));
+    ASSERT_FALSE(aw.max(&seq_id));
+    // ack a few
+    aw.insert(5);
+    aw.insert(70);
+    aw.insert(200);
+    ASSERT_FALSE(aw.empty());
+    ASSERT_TRUE(aw.contains(5));
+    ASSERT_TRUE(aw.contains(70));
+    ASSERT_TRUE(aw.contains(200));
+    ASSERT_FALSE(aw.contains(6));
+    ASSERT_FALSE(aw.contains(199));
+    ASSERT_FALSE(aw.contains(1000));
+    ASSERT_TRUE(aw.max(&seq_id));
+    ASSERT_EQ(seq_id, 200U);
+    // ack below the current base
+    aw.insert(1);
+    ASSERT_TRUE(aw.contains(1));
+    ASSERT_TRUE(aw.contains(5));
+    // clear a prefix
+    aw.clear_below(70, &cleared);
+    ASSERT_EQ(cleared.size(), 2U);
+    ASSERT_EQ(cleared[0], 1U);
+    ASSERT_EQ(cleared[1], 5U);
+    ASSERT_FALSE(aw.contains(1));
+    ASSERT_FALSE(aw.contains(5));
+    ASSERT_TRUE(aw.contains(70));
+    // clear within a word
+    cleared.clear();
+    aw.clear_below(71, &cleared);
+    ASSERT_EQ(cleared.size(), 1U);
+    ASSERT_EQ(cleared[0], 70U);
+    ASSERT_TRUE(aw.contains(200));
+    ASSERT_TRUE(aw.max(&seq_id));
+    ASSERT_EQ(seq_id, 200U);
+    // clear everything
+    cleared.clear();
+    aw.clear_below(UINT64_MAX, &cleared);
+    ASSERT_EQ(cleared.size(), 1U);
+    ASSERT_EQ(cleared[0], 200U);
+    ASSERT_TRUE(aw.empty());
+    ASSERT_FALSE(aw.max(&seq_id));
+}
@@ -0,0 +1,107 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// HyperDex
+#include "test/th.h"
+#include "daemon/admission_control.h"
+
+using hyperdex::admission_control;
+using hyperdex::server_id;
+
+TEST(AdmissionControl, Classify)
+{
+    ASSERT_EQ(admission_control::classify(hyperdex::REQ_GET), admission_control::POINT);
+    ASSERT_EQ(admission_control::classify(hyperdex::REQ_ATOMIC), admission_control::POINT);
+    ASSERT_EQ(admission_control::classify(hyperdex::REQ_SORTED_SEARCH), admission_control::SCAN);
+    ASSERT_EQ(admission_control::classify(hyperdex::REQ_GROUP_DEL), admission_control::SCAN);
+    ASSERT_EQ(admission_control::classify(hyperdex::REQ_SEARCH_NEXT), admission_control::BACKGROUND);
+    ASSERT_EQ(admission_control::classify(hyperdex::CHAIN_OP), admission_control::BACKGROUND);
+}
+
+TEST(AdmissionControl, ScansLeaveThreadsForPointOps)
+{
+    admission_control ac;
+    ac.set_threads(4);
+    // half the threads may scan
+    ASSERT_TRUE(ac.admit(server_id(1), admission_control::SCAN, 0));
+    ASSERT_TRUE(ac.admit(server_id(2), admission_control::SCAN, 0));
+    ASSERT_FALSE(ac.admit(server_id(3), admission_control::SCAN, 0));
+    // point ops still get in
+    ASSERT_TRUE(ac.admit(server_id(3), admission_control::POINT, 0));
+    ac.finish(admission_control::POINT);
+    // a finished scan frees its slot
+    ac.finish(admission_control::SCAN);
+    ASSERT_TRUE(ac.admit(server_id(3), admission_control::SCAN, 0));
+    ac.finish(admission_control::SCAN);
+    ac.finish(admission_control::SCAN);
+}
+
+TEST(AdmissionControl, OverRateClientsYieldWhenBusy)
+{
+    admission_control ac;
+    ac.set_threads(2);
+    // keep the daemon busy
+    ASSERT_TRUE(ac.admit(server_id(1), admission_control::POINT, 0));
+    // client 2 spends its burst and is then shed
+    size_t i = 0;
+
+    while (i < 1000000 && ac.admit(server_id(2), admission_control::POINT, 0))
+    {
+        ac.finish(admission_control::POINT);
+        ++i;
+    }
+
+    ASSERT_LT(i, 1000000U);
+    // other clients are unaffected
+    ASSERT_TRUE(ac.admit(server_id(3), admission_control::POINT, 0));
+    ac.finish(admission_control::POINT);
+    // background traffic is never shed
+    ASSERT_TRUE(ac.admit(server_id(2), admission_control::BACKGROUND, 0));
+    ac.finish(admission_control::BACKGROUND);
+    // once idle, client 2 is served again
+    ac.finish(admission_control::POINT);
+    ASSERT_TRUE(ac.admit(server_id(2), admission_control::POINT, 0));
+    ac.finish(admission_control::POINT);
+}
+
+TEST(AdmissionControl, PendingScansCountAgainstTheCap)
+{
+    admission_control ac;
+    ac.set_threads(4);
+    // one scan on a network thread and one queued for a scan thread fill
+    // the two slots
+    ASSERT_TRUE(ac.admit(server_id(1), admission_control::SCAN, 0));
+    ASSERT_FALSE(ac.admit(server_id(2), admission_control::SCAN, 1));
+    // point ops still get in
+    ASSERT_TRUE(ac.admit(server_id(2), admission_control::POINT, 0));
+    ac.finish(admission_control::POINT);
+    ac.finish(admission_control::SCAN);
+    // a backlog alone fills the slots too
+    ASSERT_FALSE(ac.admit(server_id(2), admission_control::SCAN, 2));
+    ASSERT_TRUE(ac.admit(server_id(2), admission_control::SCAN, 1));
+    ac.finish(admission_control::SCAN);
+}
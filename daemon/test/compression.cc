@@ -0,0 +1,135 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <stdio.h>
+#include <stdlib.h>
+
+// STL
+#include <string>
+#include <vector>
+
+// HyperDex
+#include "test/th.h"
+#include "daemon/compression.h"
+
+namespace
+{
+
+void
+roundtrip(const std::string& input, unsigned level, size_t* compressed)
+{
+    const uint8_t* in = reinterpret_cast<const uint8_t*>(input.data());
+    std::vector<uint8_t> z(hyperdex::lz_compress_bound(input.size()));
+    size_t z_sz = hyperdex::lz_compress(in, input.size(), level, &z[0]);
+    ASSERT_LE(z_sz, z.size());
+    std::vector<uint8_t> out(input.size() + 1);
+    ASSERT_TRUE(hyperdex::lz_decompress(&z[0], z_sz, &out[0], input.size()));
+    ASSERT_TRUE(std::string(reinterpret_cast<const char*>(&out[0]), input.size()) == input);
+    // the exact size is part of the format
+    ASSERT_FALSE(hyperdex::lz_decompress(&z[0], z_sz, &out[0], input.size() + 1));
+    *compressed = z_sz;
+}
+
+std::string
+json_ish(size_t n)
+{
+    std::string s;
+    char buf[128];
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        snprintf(buf, sizeof(buf), "{\"user\": \"user%lu\", \"visits\": %lu, \"tags\": [\"a\", \"b\"]}",
+                 static_cast<unsigned long>(i % 97), static_cast<unsigned long>(i * 7));
+        s += buf;
+    }
+
+    return s;
+}
+
+} // namespace
+
+TEST(Compression, SmallInputs)
+{
+    size_t z_sz;
+    roundtrip("", 1, &z_sz);
+    roundtrip("a", 1, &z_sz);
+    roundtrip("aaaaaaaaaaaa", 1, &z_sz);
+    roundtrip("aaaaaaaaaaaaa", 9, &z_sz);
+}
+
+TEST(Compression, CompressibleInput)
+{
+    std::string input(json_ish(4096));
+    size_t fast;
+    size_t small;
+    roundtrip(input, 1, &fast);
+    roundtrip(input, 9, &small);
+    ASSERT_LT(fast * 4, input.size());
+    ASSERT_LE(small, fast);
+}
+
+TEST(Compression, RandomInput)
+{
+    std::string input;
+    srand(42);
+
+    for (size_t i = 0; i < 100000; ++i)
+    {
+        input.push_back(static_cast<char>(rand()));
+    }
+
+    size_t z_sz;
+    roundtrip(input, 1, &z_sz);
+    roundtrip(input, 5, &z_sz);
+}
+
+TEST(Compression, MalformedInputIsRejected)
+{
+    std::string input(json_ish(256));
+    const uint8_t* in = reinterpret_cast<const uint8_t*>(input.data());
+    std::vector<uint8_t> z(hyperdex::lz_compress_bound(input.size()));
+    size_t z_sz = hyperdex::lz_compress(in, input.size(), 3, &z[0]);
+    std::vector<uint8_t> out(input.size());
+
+    // every truncation fails
+    for (size_t i = 0; i < z_sz; ++i)
+    {
+        ASSERT_FALSE(hyperdex::lz_decompress(&z[0], i, &out[0], out.size()));
+    }
+
+    // corrupt bytes never overrun the output; decompression either fails
+    // or produces the right number of bytes
+    srand(7);
+
+    for (size_t i = 0; i < 1000; ++i)
+    {
+        std::vector<uint8_t> bad(z.begin(), z.begin() + z_sz);
+        bad[rand() % z_sz] = static_cast<uint8_t>(rand());
+        hyperdex::lz_decompress(&bad[0], bad.size(), &out[0], out.size());
+    }
+}
@@ -0,0 +1,95 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <algorithm>
+
+// HyperDex
+#include "test/th.h"
+#include "daemon/merkle_tree.h"
+
+using hyperdex::merkle_tree;
+
+TEST(MerkleTree, OrderDoesNotMatter)
+{
+    merkle_tree a;
+    merkle_tree b;
+
+    for (uint64_t i = 0; i < 10000; ++i)
+    {
+        a.add(i * 0x9e3779b97f4a7c15ULL, i);
+        b.add((9999 - i) * 0x9e3779b97f4a7c15ULL, 9999 - i);
+    }
+
+    ASSERT_EQ(a.root(), b.root());
+    std::vector<uint32_t> buckets;
+    a.diff(&b, &buckets);
+    ASSERT_TRUE(buckets.empty());
+}
+
+TEST(MerkleTree, DiffFindsChangedBuckets)
+{
+    merkle_tree a;
+    merkle_tree b;
+
+    for (uint64_t i = 0; i < 10000; ++i)
+    {
+        a.add(i * 0x9e3779b97f4a7c15ULL, i);
+        b.add(i * 0x9e3779b97f4a7c15ULL, i);
+    }
+
+    // a changed value in one bucket, an extra object in another
+    uint64_t k1 = 17 * 0x9e3779b97f4a7c15ULL;
+    uint64_t k2 = 12345 * 0x9e3779b97f4a7c15ULL;
+    b.add(k1, 17);
+    b.add(k1, 18);
+    b.add(k2, 12345);
+    ASSERT_NE(a.root(), b.root());
+    std::vector<uint32_t> buckets;
+    a.diff(&b, &buckets);
+    ASSERT_EQ(buckets.size(), 2U);
+    uint32_t b1 = merkle_tree::bucket(k1);
+    uint32_t b2 = merkle_tree::bucket(k2);
+    ASSERT_EQ(buckets[0], std::min(b1, b2));
+    ASSERT_EQ(buckets[1], std::max(b1, b2));
+}
+
+TEST(MerkleTree, PackUnpack)
+{
+    merkle_tree a;
+
+    for (uint64_t i = 0; i < 1000; ++i)
+    {
+        a.add(i * 0x9e3779b97f4a7c15ULL, i);
+    }
+
+    std::auto_ptr<e::buffer> buf(e::buffer::create(pack_size(a)));
+    buf->pack_at(0) << a;
+    merkle_tree b;
+    ASSERT_FALSE((buf->unpack_from(0) >> b).error());
+    ASSERT_EQ(a.root(), b.root());
+}
@@ -0,0 +1,99 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <stdio.h>
+
+// HyperDex
+#include "test/th.h"
+#include "daemon/object_cache.h"
+
+using hyperdex::object_cache;
+
+TEST(ObjectCache, LookupAfterInsert)
+{
+    object_cache oc(1 << 20);
+    std::string value;
+    ASSERT_FALSE(oc.lookup(e::slice("key"), &value));
+    oc.insert(e::slice("key"), "value", oc.generation(e::slice("key")));
+    ASSERT_TRUE(oc.lookup(e::slice("key"), &value));
+    ASSERT_EQ(value, std::string("value"));
+    oc.invalidate(e::slice("key"));
+    ASSERT_FALSE(oc.lookup(e::slice("key"), &value));
+}
+
+TEST(ObjectCache, StaleInsertIsDropped)
+{
+    object_cache oc(1 << 20);
+    std::string value;
+    // a reader takes the generation, then a writer invalidates the key
+    uint64_t gen = oc.generation(e::slice("key"));
+    oc.invalidate(e::slice("key"));
+    oc.insert(e::slice("key"), "old", gen);
+    ASSERT_FALSE(oc.lookup(e::slice("key"), &value));
+    // the same holds across a clear
+    gen = oc.generation(e::slice("key"));
+    oc.clear();
+    oc.insert(e::slice("key"), "old", gen);
+    ASSERT_FALSE(oc.lookup(e::slice("key"), &value));
+}
+
+TEST(ObjectCache, EvictsLeastRecentlyUsed)
+{
+    // a single key's shard holds 1/16 of the capacity
+    object_cache oc(16 * 4096);
+    std::string value;
+    std::string big(512, 'x');
+    char buf[16];
+    size_t inserted = 0;
+
+    // fill well past capacity
+    for (size_t i = 0; i < 4096; ++i)
+    {
+        snprintf(buf, sizeof(buf), "k%lu", static_cast<unsigned long>(i));
+        oc.insert(e::slice(buf), big, oc.generation(e::slice(buf)));
+        ++inserted;
+    }
+
+    size_t present = 0;
+
+    for (size_t i = 0; i < inserted; ++i)
+    {
+        snprintf(buf, sizeof(buf), "k%lu", static_cast<unsigned long>(i));
+
+        if (oc.lookup(e::slice(buf), &value))
+        {
+            ++present;
+        }
+    }
+
+    ASSERT_GT(present, 0U);
+    ASSERT_LE(present * (512 + 64), 16U * 4096U);
+    // the most recent insert survives
+    snprintf(buf, sizeof(buf), "k%lu", static_cast<unsigned long>(inserted - 1));
+    ASSERT_TRUE(oc.lookup(e::slice(buf), &value));
+}
@@ -0,0 +1,69 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// HyperDex
+#include "test/th.h"
+#include "daemon/rate_limiter.h"
+
+using hyperdex::rate_limiter;
+
+TEST(RateLimiter, UnlimitedNeverWaits)
+{
+    rate_limiter rl;
+    ASSERT_TRUE(rl.may_spend());
+    rl.spend(1ULL << 40);
+    ASSERT_TRUE(rl.may_spend());
+    ASSERT_EQ(rl.delay(), 0U);
+    ASSERT_EQ(rl.rate(), 0U);
+}
+
+TEST(RateLimiter, DebtDelaysSpending)
+{
+    rate_limiter rl;
+    rl.set_rate(1 << 20);
+    ASSERT_TRUE(rl.may_spend());
+    // a second's worth on top of the burst puts the bucket in debt
+    rl.spend((1 << 20) + (1 << 20) / 10);
+    ASSERT_FALSE(rl.may_spend());
+    uint64_t delay = rl.delay();
+    ASSERT_LT(delay, 1100000000ULL);
+    ASSERT_GT(delay, 500000000ULL);
+    rl.set_rate(0);
+    ASSERT_TRUE(rl.may_spend());
+}
+
+TEST(RateLimiter, BacksOffWhenForegroundIsSlow)
+{
+    rate_limiter rl;
+    rl.set_rate(1600);
+    rl.set_latency_target(1000);
+    rl.observe(1000000);
+    ASSERT_EQ(rl.rate(), 800U);
+    // adjustments happen at most once per interval
+    rl.observe(1000000);
+    ASSERT_EQ(rl.rate(), 800U);
+}
@@ -0,0 +1,124 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <stdint.h>
+
+// STL
+#include <tr1/functional>
+#include <vector>
+
+// po6
+#include <po6/threads/thread.h>
+
+// HyperDex
+#include "test/th.h"
+#include "daemon/scan_queue.h"
+
+using hyperdex::scan_queue;
+
+namespace
+{
+
+bool
+is_odd(int x)
+{
+    return x & 1;
+}
+
+void
+take_and_give_back(scan_queue<int>* sq, int* out)
+{
+    int x = 0;
+
+    if (sq->take(&x))
+    {
+        *out = x;
+        sq->give_back(x, true);
+    }
+}
+
+} // namespace
+
+TEST(ScanQueue, RoundRobin)
+{
+    scan_queue<int> sq(2);
+    ASSERT_TRUE(sq.push(1));
+    ASSERT_TRUE(sq.push(2));
+    // the queue is full
+    ASSERT_FALSE(sq.push(3));
+    int x = 0;
+    ASSERT_TRUE(sq.take(&x));
+    ASSERT_EQ(x, 1);
+    ASSERT_EQ(sq.outstanding(), 2U);
+    // an unfinished scan goes behind the one that waited
+    sq.give_back(x, false);
+    ASSERT_TRUE(sq.take(&x));
+    ASSERT_EQ(x, 2);
+    sq.give_back(x, true);
+    ASSERT_EQ(sq.outstanding(), 1U);
+    ASSERT_TRUE(sq.take(&x));
+    ASSERT_EQ(x, 1);
+    sq.give_back(x, true);
+    ASSERT_EQ(sq.outstanding(), 0U);
+}
+
+TEST(ScanQueue, RemoveWhilePaused)
+{
+    scan_queue<int> sq(16);
+
+    for (int i = 1; i <= 6; ++i)
+    {
+        ASSERT_TRUE(sq.push(i));
+    }
+
+    int x = 0;
+    ASSERT_TRUE(sq.take(&x));
+    ASSERT_EQ(x, 1);
+    // pause returns only once the taken scan is given back
+    po6::threads::thread t(std::tr1::bind(&scan_queue<int>::give_back, &sq, x, false));
+    t.start();
+    sq.pause();
+    t.join();
+    std::vector<int> removed;
+    sq.remove_if(is_odd, &removed);
+    ASSERT_EQ(removed.size(), 3U);
+    ASSERT_EQ(removed[0], 3);
+    ASSERT_EQ(removed[1], 5);
+    ASSERT_EQ(removed[2], 1);
+    ASSERT_EQ(sq.outstanding(), 3U);
+    // nothing is handed out until unpaused
+    int out = 0;
+    po6::threads::thread u(std::tr1::bind(take_and_give_back, &sq, &out));
+    u.start();
+    sq.unpause();
+    u.join();
+    ASSERT_EQ(out, 2);
+    ASSERT_EQ(sq.outstanding(), 2U);
+    sq.shutdown();
+    ASSERT_FALSE(sq.take(&x));
+}
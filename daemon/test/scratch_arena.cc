@@ -0,0 +1,92 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <stdint.h>
+#include <string.h>
+
+// HyperDex
+#include "test/th.h"
+#include "daemon/scratch_arena.h"
+
+using hyperdex::scratch_arena;
+
+TEST(ScratchArena, Test)
+{
+    scratch_arena sa;
+    uint64_t base = scratch_arena::mallocs();
+    // first allocation creates a block
+    char* a = sa.allocate(16);
+    ASSERT_TRUE(a != NULL);
+    ASSERT_EQ(scratch_arena::mallocs(), base + 1);
+    memset(a, 'a', 16);
+    // small allocations come from the same block
+    char* b = sa.allocate(100);
+    ASSERT_EQ(b, a + 16);
+    ASSERT_EQ(scratch_arena::mallocs(), base + 1);
+    // a scope rewinds to where it started
+    {
+        scratch_arena::scope s(&sa);
+        char* c = s.arena()->allocate(8);
+        ASSERT_EQ(c, b + 104);
+    }
+    char* d = sa.allocate(8);
+    ASSERT_EQ(d, b + 104);
+    // outgrow the first block
+    char* e = sa.allocate(1 << 16);
+    ASSERT_TRUE(e != NULL);
+    ASSERT_EQ(scratch_arena::mallocs(), base + 2);
+    ASSERT_EQ(a[15], 'a');
+    // reset coalesces into one block
+    sa.reset();
+    ASSERT_EQ(scratch_arena::mallocs(), base + 3);
+    // after which the same workload needs no more mallocs
+    for (size_t i = 0; i < 10; ++i)
+    {
+        sa.allocate(16);
+        sa.allocate(100);
+        sa.allocate(8);
+        sa.allocate(1 << 16);
+        sa.reset();
+    }
+    ASSERT_EQ(scratch_arena::mallocs(), base + 3);
+}
+
+TEST(ScratchArena, Cap)
+{
+    scratch_arena sa;
+    // one oversized message
+    sa.allocate(1 << 24);
+    sa.reset();
+    uint64_t base = scratch_arena::mallocs();
+    // the arena kept enough for ordinary messages
+    sa.allocate(1 << 16);
+    ASSERT_EQ(scratch_arena::mallocs(), base);
+    // but not the oversized one
+    sa.allocate(1 << 24);
+    ASSERT_EQ(scratch_arena::mallocs(), base + 1);
+}
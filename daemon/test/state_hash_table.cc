@@ -0,0 +1,208 @@
+// Copyright (c) 2013, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of HyperDex nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <stdint.h>
+
+// STL
+#include <set>
+#include <tr1/functional>
+#include <vector>
+
+// po6
+#include <po6/threads/mutex.h>
+#include <po6/threads/thread.h>
+
+// e
+#include <e/intrusive_ptr.h>
+
+// HyperDex
+#include "test/th.h"
+#include "daemon/state_hash_table.h"
+
+#define KEYS 97
+#define THREADS 8
+#define ITERATIONS 20000
+
+namespace
+{
+
+// a key state that is collected after every third use
+class counter
+{
+    public:
+        counter(const uint64_t& key)
+            : hits(0), m_ref(0), m_key(key), m_mtx(), m_garbage(false) {}
+        ~counter() throw () {}
+
+    public:
+        const uint64_t& state_key() const { return m_key; }
+        void lock() { m_mtx.lock(); }
+        void unlock() { m_mtx.unlock(); }
+        bool finished() { return hits % 3 == 0; }
+        void mark_garbage() { m_garbage = true; }
+        bool marked_garbage() const { return m_garbage; }
+
+    public:
+        uint64_t hits;
+
+    private:
+        friend class e::intrusive_ptr<counter>;
+
+    private:
+        void inc() { __sync_add_and_fetch(&m_ref, 1); }
+        void dec() { if (__sync_sub_and_fetch(&m_ref, 1) == 0) delete this; }
+
+    private:
+        size_t m_ref;
+        const uint64_t m_key;
+        po6::threads::mutex m_mtx;
+        bool m_garbage;
+
+    private:
+        counter(const counter&);
+        counter& operator = (const counter&);
+};
+
+typedef hyperdex::state_hash_table<uint64_t, counter> table_t;
+
+void
+use_keys(table_t* table, uint64_t* totals, size_t offset)
+{
+    for (size_t i = 0; i < ITERATIONS; ++i)
+    {
+        uint64_t key = (i + offset) % KEYS;
+        table_t::state_reference sr;
+        counter* c = table->get_or_create_state(key, &sr);
+        // "totals" is guarded only by the key's state, so any lapse in
+        // mutual exclusion shows up as a lost update
+        ++totals[key];
+        ++c->hits;
+    }
+}
+
+void
+iterate(table_t* table, size_t* seen)
+{
+    for (size_t i = 0; i < 10; ++i)
+    {
+        for (table_t::iterator it(table); it.valid(); it.next())
+        {
+            ++*seen;
+        }
+    }
+}
+
+} // namespace
+
+TEST(StateHashTable, CreateAndGet)
+{
+    table_t table;
+    table.set_empty_key(UINT64_MAX);
+    table.set_deleted_key(UINT64_MAX - 1);
+
+    {
+        table_t::state_reference sr;
+        ASSERT_TRUE(table.get_state(5, &sr) == NULL);
+    }
+
+    {
+        table_t::state_reference sr;
+        counter* c = table.create_state(5, &sr);
+        ASSERT_TRUE(c != NULL);
+        c->hits = 1;
+    }
+
+    {
+        table_t::state_reference sr;
+        ASSERT_TRUE(table.create_state(5, &sr) == NULL);
+    }
+
+    {
+        // finishing the state collects it on unlock
+        table_t::state_reference sr;
+        counter* c = table.get_state(5, &sr);
+        ASSERT_TRUE(c != NULL);
+        ASSERT_EQ(c->hits, 1U);
+        c->hits = 3;
+    }
+
+    {
+        table_t::state_reference sr;
+        ASSERT_TRUE(table.get_state(5, &sr) == NULL);
+    }
+}
+
+TEST(StateHashTable, Concurrent)
+{
+    table_t table;
+    table.set_empty_key(UINT64_MAX);
+    table.set_deleted_key(UINT64_MAX - 1);
+    std::vector<uint64_t> totals(KEYS, 0);
+    std::vector<po6::threads::thread*> threads;
+
+    for (size_t i = 0; i < THREADS; ++i)
+    {
+        threads.push_back(new po6::threads::thread(std::tr1::bind(use_keys, &table, &totals[0], i * 13)));
+    }
+
+    // iterating while states are created and collected must not trip over
+    // erased cursors
+    size_t seen = 0;
+    po6::threads::thread iterator(std::tr1::bind(iterate, &table, &seen));
+
+    for (size_t i = 0; i < threads.size(); ++i)
+    {
+        threads[i]->start();
+    }
+
+    iterator.start();
+
+    for (size_t i = 0; i < threads.size(); ++i)
+    {
+        threads[i]->join();
+        delete threads[i];
+    }
+
+    iterator.join();
+    uint64_t total = 0;
+
+    for (size_t i = 0; i < KEYS; ++i)
+    {
+        total += totals[i];
+    }
+
+    ASSERT_EQ(total, uint64_t(THREADS) * ITERATIONS);
+    // what remains is one unfinished state per key
+    std::set<uint64_t> keys;
+
+    for (table_t::iterator it(&table); it.valid(); it.next())
+    {
+        ASSERT_NE(it.get()->hits % 3, 0U);
+        ASSERT_TRUE(keys.insert(it.get()->state_key()).second);
+    }
+}
@@ -55,6 +55,8 @@ main(int argc, const char* argv[])
     cmds.push_back(e::subcommand("set-read-only",         "Put the cluster into read-only mode, blocking writes"));
     cmds.push_back(e::subcommand("set-read-write",        "Put the cluster into read-write mode, permitting writes"));
     cmds.push_back(e::subcommand("raw-backup",            "Take a raw backup of a single HyperDex daemon"));
+    cmds.push_back(e::subcommand("region-stats",          "Show the per-region object and byte counts of a single HyperDex daemon"));
+    cmds.push_back(e::subcommand("bulk-load",             "Load a pre-sorted dump directly into a single HyperDex daemon"));
     cmds.push_back(e::subcommand("wait-until-stable",     "Wait for the cluster to become stable on the new configuration"));
     return dispatch_to_subcommands(argc, argv,
                                    "hyperdex", "HyperDex",
@@ -159,6 +159,18 @@ hyperdex_admin_raw_backup(const char* host, uint16_t port,
                           const char* name,
                           enum hyperdex_admin_returncode* status);
 
+int
+hyperdex_admin_bulk_load(const char* host, uint16_t port,
+                         const char* space, const char* path,
+                         enum hyperdex_admin_returncode* status);
+
+/* one line per region:  "<region> <objects> <bytes> <index-bytes>";
+ * the caller must free() *stats */
+int
+hyperdex_admin_region_stats(const char* host, uint16_t port,
+                            char** stats,
+                            enum hyperdex_admin_returncode* status);
+
 const char*
 hyperdex_admin_error_message(struct hyperdex_admin* admin);
 const char*
@@ -97,6 +97,7 @@ enum hyperdex_client_returncode
     HYPERDEX_CLIENT_INTERRUPTED  = 8530,
     HYPERDEX_CLIENT_CLUSTER_JUMP = 8531,
     HYPERDEX_CLIENT_OFFLINE      = 8533,
+    HYPERDEX_CLIENT_OVERLOADED   = 8535, /* retry later */
 
     /* This should never happen.  It indicates a bug */
     HYPERDEX_CLIENT_INTERNAL     = 8573,
@@ -104,6 +105,17 @@ enum hyperdex_client_returncode
     HYPERDEX_CLIENT_GARBAGE      = 8575
 };
 
+/* Where GETs are served */
+enum hyperdex_client_read_mode
+{
+    /* the point leader; reads observe every completed write */
+    HYPERDEX_CLIENT_READ_POINT_LEADER = 0,
+    /* the last server in the key's chain */
+    HYPERDEX_CLIENT_READ_TAIL         = 1,
+    /* any server in the key's chain */
+    HYPERDEX_CLIENT_READ_ANY_REPLICA  = 2
+};
+
 struct hyperdex_client*
 hyperdex_client_create(const char* coordinator, uint16_t port);
 void
@@ -612,6 +624,14 @@ int64_t
 hyperdex_client_loop(struct hyperdex_client* client, int timeout,
                      enum hyperdex_client_returncode* status);
 
+/* Reads served away from the point leader may miss writes completed within
+ * the last max_lag_ms milliseconds; servers that cannot promise that much
+ * bounce the read to the point leader. */
+void
+hyperdex_client_set_read_mode(struct hyperdex_client* client,
+                              enum hyperdex_client_read_mode mode,
+                              uint64_t max_lag_ms);
+
 enum hyperdatatype
 hyperdex_client_attribute_type(struct hyperdex_client* client,
                                const char* space, const char* name,
@@ -357,6 +357,8 @@ class Client
     public:
         int64_t loop(int timeout, hyperdex_client_returncode* status)
             { return hyperdex_client_loop(m_cl, timeout, status); }
+        void set_read_mode(hyperdex_client_read_mode mode, uint64_t max_lag_ms)
+            { hyperdex_client_set_read_mode(m_cl, mode, max_lag_ms); }
         std::string error_message()
             { return hyperdex_client_error_message(m_cl); }
         std::string error_location()